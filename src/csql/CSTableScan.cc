@@ -11,6 +11,8 @@
 #include <csql/qtree/ColumnReferenceNode.h>
 #include <csql/runtime/defaultruntime.h>
 #include <csql/runtime/compiler.h>
+#include <csql/runtime/SortKey.h>
+#include <csql/runtime/ScanCheckpoint.h>
 #include <stx/ieee754.h>
 #include <stx/logging.h>
 
@@ -30,8 +32,22 @@ CSTableScan::CSTableScan(
     colindex_(0),
     aggr_strategy_(stmt_->aggregationStrategy()),
     rows_scanned_(0),
-    opened_(false) {
+    rows_filtered_(0),
+    bytes_read_(0),
+    opened_(false),
+    scan_done_(false),
+    num_rows_(0),
+    num_records_(0),
+    records_end_(0),
+    fetch_level_(0),
+    select_level_(0),
+    filter_pred_(true),
+    abort_check_(txn) {
   column_names_ = stmt_->outputColumns();
+
+  if (aggr_strategy_ == AggregationStrategy::NO_AGGREGATION) {
+    limit_ = stmt_->limit();
+  }
 }
 
 CSTableScan::CSTableScan(
@@ -46,8 +62,22 @@ CSTableScan::CSTableScan(
     colindex_(0),
     aggr_strategy_(stmt_->aggregationStrategy()),
     rows_scanned_(0),
-    opened_(false) {
+    rows_filtered_(0),
+    bytes_read_(0),
+    opened_(false),
+    scan_done_(false),
+    num_rows_(0),
+    num_records_(0),
+    records_end_(0),
+    fetch_level_(0),
+    select_level_(0),
+    filter_pred_(true),
+    abort_check_(txn) {
   column_names_ = stmt_->outputColumns();
+
+  if (aggr_strategy_ == AggregationStrategy::NO_AGGREGATION) {
+    limit_ = stmt_->limit();
+  }
 }
 
 void CSTableScan::open() {
@@ -57,6 +87,19 @@ void CSTableScan::open() {
     cstable_ = cstable::CSTableReader::openFile(cstable_filename_);
   }
 
+  /* the statement is hashed before its column references are resolved */
+  if (!table_key_.isEmpty() &&
+      aggr_strategy_ == AggregationStrategy::AGGREGATE_ALL &&
+      !filter_fn_ &&
+      !txn_->getRuntime()->cacheDir().isEmpty()) {
+    checkpoint_key_ = Some(
+        SHA1::compute(
+            StringUtil::format(
+                "$0~$1",
+                table_key_.get().toString(),
+                stmt_->toString())));
+  }
+
   Set<String> column_names;
   for (const auto& slnode : stmt_->selectList()) {
     findColumns(slnode->expression(), &column_names);
@@ -113,435 +156,579 @@ void CSTableScan::open() {
     resolveColumns(where_expr.get());
     where_expr_ = runtime_->buildValueExpression(txn_, where_expr.get());
   }
+
+  /* runtime filters are only applied to rows that are emitted as-is */
+  if (!runtime_filter_spec_.isEmpty() &&
+      aggr_strategy_ == AggregationStrategy::NO_AGGREGATION) {
+    auto select_list = stmt_->selectList();
+    for (auto idx : runtime_filter_spec_.get().key_columns) {
+      if (idx >= select_list.size()) {
+        RAISE(kIllegalStateError, "invalid runtime filter column");
+      }
+
+      runtime_filter_keys_.emplace_back(
+          runtime_->buildValueExpression(
+              txn_,
+              select_list[idx]->expression()));
+    }
+
+    runtime_filter_ = txn_->getRuntimeFilter(
+        runtime_filter_spec_.get().filter_id);
+  }
+
+  in_row_ = Vector<SValue>(colindex_, SValue{});
+  records_end_ = cstable_->numRecords();
+
+  if (!checkpoint_key_.isEmpty()) {
+    loadCheckpoint();
+  }
+}
+
+void CSTableScan::loadCheckpoint() {
+  ScanCheckpoint checkpoint;
+  auto found = loadScanCheckpoint(
+      txn_->getRuntime()->cacheDir().get(),
+      checkpoint_key_.get(),
+      &checkpoint);
+
+  /* if the table has fewer records, it was rewritten rather than appended */
+  if (!found || checkpoint.num_records > cstable_->numRecords()) {
+    return;
+  }
+
+  auto is = StringInputStream::fromString(checkpoint.state);
+  for (auto& e : select_list_) {
+    VM::loadState(txn_, e.compiled.program(), &e.instance, is.get());
+  }
+
+  skipRecords(checkpoint.num_records);
+}
+
+void CSTableScan::skipRecords(uint64_t num_records) {
+  for (auto& col : columns_) {
+    auto& reader = col.second.reader;
+    for (uint64_t i = 0; i < num_records; ++i) {
+      abort_check_.tick();
+      do {
+        reader->skipValue();
+      } while (reader->nextRepetitionLevel() > 0);
+    }
+  }
+
+  num_records_ += num_records;
+}
+
+void CSTableScan::setRecordRange(uint64_t begin, uint64_t end) {
+  if (!opened_) {
+    open();
+  }
+
+  if (begin < num_records_ || fetch_level_ > 0) {
+    RAISE(kIllegalStateError, "record ranges must be set in ascending order");
+  }
+
+  skipRecords(begin - num_records_);
+  records_end_ = std::min(end, uint64_t(cstable_->numRecords()));
+  scan_done_ = false;
+}
+
+void CSTableScan::storeCheckpoint() {
+  if (checkpoint_key_.isEmpty()) {
+    return;
+  }
+
+  ScanCheckpoint checkpoint;
+  checkpoint.num_records = num_records_;
+  auto os = StringOutputStream::fromString(&checkpoint.state);
+  for (const auto& e : select_list_) {
+    VM::saveState(txn_, e.compiled.program(), &e.instance, os.get());
+  }
+
+  storeScanCheckpoint(
+      txn_->getRuntime()->cacheDir().get(),
+      checkpoint_key_.get(),
+      checkpoint);
 }
 
 bool CSTableScan::nextRow(SValue* out, int out_len) {
-  return false;
+  if (!limit_.isEmpty() && num_rows_ >= limit_.get()) {
+    close();
+    return false;
+  }
+
+  if (!opened_) {
+    open();
+  }
+
+  bool row;
+  if (columns_.empty()) {
+    row = scanWithoutColumns(out, out_len);
+  } else {
+    row = scan(out, out_len);
+  }
+
+  /* don't read any more column data once the last row was emitted */
+  if (row && !limit_.isEmpty() && ++num_rows_ == limit_.get()) {
+    close();
+  }
+
+  return row;
+}
+
+void CSTableScan::close() {
+  opened_ = true;
+  scan_done_ = true;
+  columns_.clear();
+  cstable_ = RefPtr<cstable::CSTableReader>();
+}
+
+bool CSTableScan::scan(SValue* out, int out_len) {
+  if (scan_done_) {
+    return false;
+  }
+
+  size_t total_records = records_end_;
+  while (num_records_ < total_records) {
+    abort_check_.tick();
+    ++rows_scanned_;
+    uint64_t next_level = 0;
+
+    if (fetch_level_ == 0) {
+      if (num_records_ < total_records && filter_fn_) {
+        filter_pred_ = filter_fn_();
+      }
+    }
+
+    for (auto& col : columns_) {
+      auto nextr = col.second.reader->nextRepetitionLevel();
+
+      if (nextr >= fetch_level_) {
+        auto& reader = col.second.reader;
+
+        uint64_t r;
+        uint64_t d;
+
+        switch (col.second.reader->type()) {
+
+          case cstable::ColumnType::STRING: {
+            String v;
+            reader->readString(&r, &d, &v);
+            bytes_read_ += v.size();
+
+            if (d < reader->maxDefinitionLevel()) {
+              in_row_[col.second.index] = SValue();
+            } else {
+              switch (col.second.type) {
+                case SQL_NULL:
+                  in_row_[col.second.index] = SValue::newNull();
+                  break;
+                case SQL_STRING:
+                  in_row_[col.second.index] = SValue::newString(v);
+                  break;
+                case SQL_FLOAT:
+                  in_row_[col.second.index] = SValue::newFloat(v);
+                  break;
+                case SQL_INTEGER:
+                  in_row_[col.second.index] = SValue::newInteger(v);
+                  break;
+                case SQL_BOOL:
+                  in_row_[col.second.index] = SValue::newBool(v);
+                  break;
+                case SQL_TIMESTAMP:
+                  in_row_[col.second.index] = SValue::newTimestamp(v);
+                  break;
+              }
+            }
+
+            break;
+          }
+
+          case cstable::ColumnType::UNSIGNED_INT: {
+            uint64_t v = 0;
+            reader->readUnsignedInt(&r, &d, &v);
+            bytes_read_ += sizeof(v);
+
+            if (d < reader->maxDefinitionLevel()) {
+              in_row_[col.second.index] = SValue();
+            } else {
+              switch (col.second.type) {
+                case SQL_NULL:
+                  in_row_[col.second.index] = SValue::newNull();
+                  break;
+                case SQL_STRING:
+                  in_row_[col.second.index] = SValue::newInteger(v).toString();
+                  break;
+                case SQL_FLOAT:
+                  in_row_[col.second.index] = SValue::newFloat(v);
+                  break;
+                case SQL_INTEGER:
+                  in_row_[col.second.index] = SValue::newInteger(v);
+                  break;
+                case SQL_BOOL:
+                  in_row_[col.second.index] = SValue::newBool(v);
+                  break;
+                case SQL_TIMESTAMP:
+                  in_row_[col.second.index] = SValue::newTimestamp(v);
+                  break;
+              }
+            }
+
+            break;
+          }
+
+          case cstable::ColumnType::SIGNED_INT: {
+            int64_t v = 0;
+            reader->readSignedInt(&r, &d, &v);
+            bytes_read_ += sizeof(v);
+
+            if (d < reader->maxDefinitionLevel()) {
+              in_row_[col.second.index] = SValue();
+            } else {
+              switch (col.second.type) {
+                case SQL_NULL:
+                  in_row_[col.second.index] = SValue::newNull();
+                  break;
+                case SQL_STRING:
+                  in_row_[col.second.index] = SValue::newInteger(v).toString();
+                  break;
+                case SQL_FLOAT:
+                  in_row_[col.second.index] = SValue::newFloat(v);
+                  break;
+                case SQL_INTEGER:
+                  in_row_[col.second.index] = SValue::newInteger(v);
+                  break;
+                case SQL_BOOL:
+                  in_row_[col.second.index] = SValue::newBool(v);
+                  break;
+                case SQL_TIMESTAMP:
+                  in_row_[col.second.index] = SValue::newTimestamp(v);
+                  break;
+              }
+            }
+
+            break;
+          }
+
+          case cstable::ColumnType::BOOLEAN: {
+            bool v = 0;
+            reader->readBoolean(&r, &d, &v);
+            bytes_read_ += sizeof(v);
+
+            if (d < reader->maxDefinitionLevel()) {
+              in_row_[col.second.index] = SValue(SValue::BoolType(false));
+            } else {
+              switch (col.second.type) {
+                case SQL_NULL:
+                  in_row_[col.second.index] = SValue::newNull();
+                  break;
+                case SQL_STRING:
+                  in_row_[col.second.index] = SValue::newBool(v).toString();
+                  break;
+                case SQL_FLOAT:
+                  in_row_[col.second.index] = SValue::newFloat(v);
+                  break;
+                case SQL_INTEGER:
+                  in_row_[col.second.index] = SValue::newInteger(v);
+                  break;
+                case SQL_BOOL:
+                  in_row_[col.second.index] = SValue::newBool(v);
+                  break;
+                case SQL_TIMESTAMP:
+                  in_row_[col.second.index] = SValue::newTimestamp(v);
+                  break;
+              }
+            }
+
+            break;
+          }
+
+          case cstable::ColumnType::FLOAT: {
+            double v = 0;
+            reader->readFloat(&r, &d, &v);
+            bytes_read_ += sizeof(v);
+
+            if (d < reader->maxDefinitionLevel()) {
+              in_row_[col.second.index] = SValue();
+            } else {
+              switch (col.second.type) {
+                case SQL_NULL:
+                  in_row_[col.second.index] = SValue::newNull();
+                  break;
+                case SQL_STRING:
+                  in_row_[col.second.index] = SValue::newFloat(v).toString();
+                  break;
+                case SQL_FLOAT:
+                  in_row_[col.second.index] = SValue::newFloat(v);
+                  break;
+                case SQL_INTEGER:
+                  in_row_[col.second.index] = SValue::newInteger(v);
+                  break;
+                case SQL_BOOL:
+                  in_row_[col.second.index] = SValue::newBool(v);
+                  break;
+                case SQL_TIMESTAMP:
+                  in_row_[col.second.index] = SValue::newTimestamp(v);
+                  break;
+              }
+            }
+
+            break;
+          }
+
+          case cstable::ColumnType::DATETIME: {
+            UnixTime v;
+            reader->readDateTime(&r, &d, &v);
+            bytes_read_ += sizeof(uint64_t);
+
+            if (d < reader->maxDefinitionLevel()) {
+              in_row_[col.second.index] = SValue();
+            } else {
+              switch (col.second.type) {
+                case SQL_NULL:
+                  in_row_[col.second.index] = SValue::newNull();
+                  break;
+                case SQL_STRING:
+                  in_row_[col.second.index] = SValue::newTimestamp(v).toString();
+                  break;
+                case SQL_FLOAT:
+                  in_row_[col.second.index] = SValue::newTimestamp(v).toFloat();
+                  break;
+                case SQL_INTEGER:
+                  in_row_[col.second.index] = SValue::newTimestamp(v).toInteger();
+                  break;
+                case SQL_TIMESTAMP:
+                  in_row_[col.second.index] = SValue::newTimestamp(v);
+                  break;
+                default:
+                  RAISE(kIllegalStateError);
+              }
+            }
+
+            break;
+          }
+
+          case cstable::ColumnType::SUBRECORD:
+            RAISE(kIllegalStateError);
+
+        }
+      }
+
+      next_level = std::max(
+          next_level,
+          col.second.reader->nextRepetitionLevel());
+    }
+
+    fetch_level_ = next_level;
+    if (fetch_level_ == 0) {
+      ++num_records_;
+    }
+
+    bool where_pred = filter_pred_;
+    if (where_pred && where_expr_.program() != nullptr) {
+      SValue where_tmp;
+      VM::evaluate(
+          txn_,
+          where_expr_.program(),
+          in_row_.size(),
+          in_row_.data(),
+          &where_tmp);
+
+      where_pred = where_tmp.getBool();
+    }
+
+    if (where_pred && !runtime_filter_keys_.empty()) {
+      where_pred = evaluateRuntimeFilter(in_row_.size(), in_row_.data());
+    }
+
+    bool emit_row = false;
+    if (where_pred) {
+      for (int i = 0; i < select_list_.size(); ++i) {
+        if (select_list_[i].rep_level >= select_level_) {
+          VM::accumulate(
+              txn_,
+              select_list_[i].compiled.program(),
+              &select_list_[i].instance,
+              in_row_.size(),
+              in_row_.data());
+        }
+      }
+
+      switch (aggr_strategy_) {
+
+        case AggregationStrategy::AGGREGATE_ALL:
+          break;
+
+        case AggregationStrategy::AGGREGATE_WITHIN_RECORD_FLAT:
+          if (next_level != 0) {
+            break;
+          }
+
+        case AggregationStrategy::AGGREGATE_WITHIN_RECORD_DEEP:
+          for (int i = 0; i < select_list_.size(); ++i) {
+            if (i < out_len) {
+              VM::result(
+                  txn_,
+                  select_list_[i].compiled.program(),
+                  &select_list_[i].instance,
+                  &out[i]);
+            }
+
+            VM::reset(
+                txn_,
+                select_list_[i].compiled.program(),
+                &select_list_[i].instance);
+          }
+
+          emit_row = true;
+          break;
+
+        case AggregationStrategy::NO_AGGREGATION:
+          for (int i = 0; i < select_list_.size() && i < out_len; ++i) {
+            VM::evaluate(
+                txn_,
+                select_list_[i].compiled.program(),
+                in_row_.size(),
+                in_row_.data(),
+                &out[i]);
+          }
+
+          emit_row = true;
+          break;
+
+      }
+
+      select_level_ = fetch_level_;
+    } else {
+      select_level_ = std::min(select_level_, fetch_level_);
+    }
+
+    for (const auto& col : columns_) {
+      if (col.second.reader->maxRepetitionLevel() >= select_level_) {
+        in_row_[col.second.index] = SValue();
+      }
+    }
+
+    if (emit_row) {
+      return true;
+    }
+  }
+
+  scan_done_ = true;
+
+  switch (aggr_strategy_) {
+    case AggregationStrategy::AGGREGATE_ALL:
+      storeCheckpoint();
+
+      for (int i = 0; i < select_list_.size() && i < out_len; ++i) {
+        VM::result(
+            txn_,
+            select_list_[i].compiled.program(),
+            &select_list_[i].instance,
+            &out[i]);
+      }
+
+      return true;
+
+    default:
+      return false;
+
+  }
+}
+
+bool CSTableScan::scanWithoutColumns(SValue* out, int out_len) {
+  if (scan_done_) {
+    return false;
+  }
+
+  size_t total_records = records_end_;
+  while (num_records_ < total_records) {
+    abort_check_.tick();
+    ++num_records_;
+    ++rows_scanned_;
+
+    bool where_pred = true;
+    if (where_expr_.program() != nullptr) {
+      SValue where_tmp;
+      VM::evaluate(txn_, where_expr_.program(), 0, nullptr, &where_tmp);
+      where_pred = where_tmp.getBool();
+    }
+
+    if (where_pred && !runtime_filter_keys_.empty()) {
+      where_pred = evaluateRuntimeFilter(0, nullptr);
+    }
+
+    if (where_pred) {
+      switch (aggr_strategy_) {
+
+        case AggregationStrategy::AGGREGATE_ALL:
+          for (int i = 0; i < select_list_.size(); ++i) {
+            VM::accumulate(
+                txn_,
+                select_list_[i].compiled.program(),
+                &select_list_[i].instance,
+                0,
+                nullptr);
+          }
+          break;
+
+        case AggregationStrategy::AGGREGATE_WITHIN_RECORD_DEEP:
+        case AggregationStrategy::AGGREGATE_WITHIN_RECORD_FLAT:
+        case AggregationStrategy::NO_AGGREGATION:
+          for (int i = 0; i < select_list_.size() && i < out_len; ++i) {
+            VM::evaluate(
+                txn_,
+                select_list_[i].compiled.program(),
+                0,
+                nullptr,
+                &out[i]);
+          }
+
+          return true;
+      }
+    }
+  }
+
+  scan_done_ = true;
+
+  switch (aggr_strategy_) {
+    case AggregationStrategy::AGGREGATE_ALL:
+      storeCheckpoint();
+
+      for (int i = 0; i < select_list_.size() && i < out_len; ++i) {
+        VM::result(
+            txn_,
+            select_list_[i].compiled.program(),
+            &select_list_[i].instance,
+            &out[i]);
+      }
+
+      return true;
+
+    default:
+      return false;
+
+  }
+}
+
+bool CSTableScan::evaluateRuntimeFilter(int argc, const SValue* argv) {
+  String key;
+  bool exact = true;
+  for (const auto& expr : runtime_filter_keys_) {
+    SValue val;
+    VM::evaluate(txn_, expr.program(), argc, argv, &val);
+    if (!SortKey::encodeEquiJoinKey(val, &key, &exact)) {
+      return false;
+    }
+  }
+
+  if (runtime_filter_->mightContain(key)) {
+    return true;
+  } else {
+    ++rows_filtered_;
+    return false;
+  }
 }
 
-//void CSTableScan::onInputsReady() {
-//  logTrace("sql", "Scanning cstable: $0", cstable_filename_);
-//
-//  if (!opened_) {
-//    open();
-//  }
-//
-//  if (columns_.empty()) {
-//    scanWithoutColumns();
-//  } else {
-//    scan();
-//  }
-//
-//  //txn_->incrNumSubtasksCompleted(1);
-//}
-
-//void CSTableScan::scan() {
-//  uint64_t select_level = 0;
-//  uint64_t fetch_level = 0;
-//  bool filter_pred = true;
-//
-//  Vector<SValue> in_row(colindex_, SValue{});
-//  Vector<SValue> out_row(select_list_.size(), SValue{});
-//
-//  size_t num_records = 0;
-//  size_t total_records = cstable_->numRecords();
-//  while (num_records < total_records) {
-//    ++rows_scanned_;
-//    uint64_t next_level = 0;
-//
-//    if (fetch_level == 0) {
-//      if (num_records < total_records && filter_fn_) {
-//        filter_pred = filter_fn_();
-//      }
-//    }
-//
-//    for (auto& col : columns_) {
-//      auto nextr = col.second.reader->nextRepetitionLevel();
-//
-//      if (nextr >= fetch_level) {
-//        auto& reader = col.second.reader;
-//
-//        uint64_t r;
-//        uint64_t d;
-//
-//        switch (col.second.reader->type()) {
-//
-//          case cstable::ColumnType::STRING: {
-//            String v;
-//            reader->readString(&r, &d, &v);
-//
-//            if (d < reader->maxDefinitionLevel()) {
-//              in_row[col.second.index] = SValue();
-//            } else {
-//              switch (col.second.type) {
-//                case SQL_NULL:
-//                  in_row[col.second.index] = SValue::newNull();
-//                  break;
-//                case SQL_STRING:
-//                  in_row[col.second.index] = SValue::newString(v);
-//                  break;
-//                case SQL_FLOAT:
-//                  in_row[col.second.index] = SValue::newFloat(v);
-//                  break;
-//                case SQL_INTEGER:
-//                  in_row[col.second.index] = SValue::newInteger(v);
-//                  break;
-//                case SQL_BOOL:
-//                  in_row[col.second.index] = SValue::newBool(v);
-//                  break;
-//                case SQL_TIMESTAMP:
-//                  in_row[col.second.index] = SValue::newTimestamp(v);
-//                  break;
-//              }
-//            }
-//
-//            break;
-//          }
-//
-//          case cstable::ColumnType::UNSIGNED_INT: {
-//            uint64_t v = 0;
-//            reader->readUnsignedInt(&r, &d, &v);
-//
-//            if (d < reader->maxDefinitionLevel()) {
-//              in_row[col.second.index] = SValue();
-//            } else {
-//              switch (col.second.type) {
-//                case SQL_NULL:
-//                  in_row[col.second.index] = SValue::newNull();
-//                  break;
-//                case SQL_STRING:
-//                  in_row[col.second.index] = SValue::newInteger(v).toString();
-//                  break;
-//                case SQL_FLOAT:
-//                  in_row[col.second.index] = SValue::newFloat(v);
-//                  break;
-//                case SQL_INTEGER:
-//                  in_row[col.second.index] = SValue::newInteger(v);
-//                  break;
-//                case SQL_BOOL:
-//                  in_row[col.second.index] = SValue::newBool(v);
-//                  break;
-//                case SQL_TIMESTAMP:
-//                  in_row[col.second.index] = SValue::newTimestamp(v);
-//                  break;
-//              }
-//            }
-//
-//            break;
-//          }
-//
-//          case cstable::ColumnType::SIGNED_INT: {
-//            int64_t v = 0;
-//            reader->readSignedInt(&r, &d, &v);
-//
-//            if (d < reader->maxDefinitionLevel()) {
-//              in_row[col.second.index] = SValue();
-//            } else {
-//              switch (col.second.type) {
-//                case SQL_NULL:
-//                  in_row[col.second.index] = SValue::newNull();
-//                  break;
-//                case SQL_STRING:
-//                  in_row[col.second.index] = SValue::newInteger(v).toString();
-//                  break;
-//                case SQL_FLOAT:
-//                  in_row[col.second.index] = SValue::newFloat(v);
-//                  break;
-//                case SQL_INTEGER:
-//                  in_row[col.second.index] = SValue::newInteger(v);
-//                  break;
-//                case SQL_BOOL:
-//                  in_row[col.second.index] = SValue::newBool(v);
-//                  break;
-//                case SQL_TIMESTAMP:
-//                  in_row[col.second.index] = SValue::newTimestamp(v);
-//                  break;
-//              }
-//            }
-//
-//            break;
-//          }
-//
-//          case cstable::ColumnType::BOOLEAN: {
-//            bool v = 0;
-//            reader->readBoolean(&r, &d, &v);
-//
-//            if (d < reader->maxDefinitionLevel()) {
-//              in_row[col.second.index] = SValue(SValue::BoolType(false));
-//            } else {
-//              switch (col.second.type) {
-//                case SQL_NULL:
-//                  in_row[col.second.index] = SValue::newNull();
-//                  break;
-//                case SQL_STRING:
-//                  in_row[col.second.index] = SValue::newBool(v).toString();
-//                  break;
-//                case SQL_FLOAT:
-//                  in_row[col.second.index] = SValue::newFloat(v);
-//                  break;
-//                case SQL_INTEGER:
-//                  in_row[col.second.index] = SValue::newInteger(v);
-//                  break;
-//                case SQL_BOOL:
-//                  in_row[col.second.index] = SValue::newBool(v);
-//                  break;
-//                case SQL_TIMESTAMP:
-//                  in_row[col.second.index] = SValue::newTimestamp(v);
-//                  break;
-//              }
-//            }
-//
-//            break;
-//          }
-//
-//          case cstable::ColumnType::FLOAT: {
-//            double v = 0;
-//            reader->readFloat(&r, &d, &v);
-//
-//            if (d < reader->maxDefinitionLevel()) {
-//              in_row[col.second.index] = SValue();
-//            } else {
-//              switch (col.second.type) {
-//                case SQL_NULL:
-//                  in_row[col.second.index] = SValue::newNull();
-//                  break;
-//                case SQL_STRING:
-//                  in_row[col.second.index] = SValue::newFloat(v).toString();
-//                  break;
-//                case SQL_FLOAT:
-//                  in_row[col.second.index] = SValue::newFloat(v);
-//                  break;
-//                case SQL_INTEGER:
-//                  in_row[col.second.index] = SValue::newInteger(v);
-//                  break;
-//                case SQL_BOOL:
-//                  in_row[col.second.index] = SValue::newBool(v);
-//                  break;
-//                case SQL_TIMESTAMP:
-//                  in_row[col.second.index] = SValue::newTimestamp(v);
-//                  break;
-//              }
-//            }
-//
-//            break;
-//          }
-//
-//          case cstable::ColumnType::DATETIME: {
-//            UnixTime v;
-//            reader->readDateTime(&r, &d, &v);
-//
-//            if (d < reader->maxDefinitionLevel()) {
-//              in_row[col.second.index] = SValue();
-//            } else {
-//              switch (col.second.type) {
-//                case SQL_NULL:
-//                  in_row[col.second.index] = SValue::newNull();
-//                  break;
-//                case SQL_STRING:
-//                  in_row[col.second.index] = SValue::newTimestamp(v).toString();
-//                  break;
-//                case SQL_FLOAT:
-//                  in_row[col.second.index] = SValue::newTimestamp(v).toFloat();
-//                  break;
-//                case SQL_INTEGER:
-//                  in_row[col.second.index] = SValue::newTimestamp(v).toInteger();
-//                  break;
-//                case SQL_TIMESTAMP:
-//                  in_row[col.second.index] = SValue::newTimestamp(v);
-//                  break;
-//                default:
-//                  RAISE(kIllegalStateError);
-//              }
-//            }
-//
-//            break;
-//          }
-//
-//          case cstable::ColumnType::SUBRECORD:
-//            RAISE(kIllegalStateError);
-//
-//        }
-//      }
-//
-//      next_level = std::max(
-//          next_level,
-//          col.second.reader->nextRepetitionLevel());
-//    }
-//
-//    fetch_level = next_level;
-//    if (fetch_level == 0) {
-//      ++num_records;
-//    }
-//
-//    bool where_pred = filter_pred;
-//    if (where_pred && where_expr_.program() != nullptr) {
-//      SValue where_tmp;
-//      VM::evaluate(
-//          txn_,
-//          where_expr_.program(),
-//          in_row.size(),
-//          in_row.data(),
-//          &where_tmp);
-//
-//      where_pred = where_tmp.getBool();
-//    }
-//
-//    if (where_pred) {
-//      for (int i = 0; i < select_list_.size(); ++i) {
-//        if (select_list_[i].rep_level >= select_level) {
-//          VM::accumulate(
-//              txn_,
-//              select_list_[i].compiled.program(),
-//              &select_list_[i].instance,
-//              in_row.size(),
-//              in_row.data());
-//        }
-//      }
-//
-//      switch (aggr_strategy_) {
-//
-//        case AggregationStrategy::AGGREGATE_ALL:
-//          break;
-//
-//        case AggregationStrategy::AGGREGATE_WITHIN_RECORD_FLAT:
-//          if (next_level != 0) {
-//            break;
-//          }
-//
-//        case AggregationStrategy::AGGREGATE_WITHIN_RECORD_DEEP:
-//          for (int i = 0; i < select_list_.size(); ++i) {
-//            VM::result(
-//                txn_,
-//                select_list_[i].compiled.program(),
-//                &select_list_[i].instance,
-//                &out_row[i]);
-//
-//            VM::reset(
-//                txn_,
-//                select_list_[i].compiled.program(),
-//                &select_list_[i].instance);
-//          }
-//
-//          if (!output_(out_row.data(), out_row.size())) {
-//            return;
-//          }
-//
-//          break;
-//
-//        case AggregationStrategy::NO_AGGREGATION:
-//          for (int i = 0; i < select_list_.size(); ++i) {
-//            VM::evaluate(
-//                txn_,
-//                select_list_[i].compiled.program(),
-//                in_row.size(),
-//                in_row.data(),
-//                &out_row[i]);
-//          }
-//
-//          if (!output_(out_row.data(), out_row.size())) {
-//            return;
-//          }
-//
-//          break;
-//
-//      }
-//
-//      select_level = fetch_level;
-//    } else {
-//      select_level = std::min(select_level, fetch_level);
-//    }
-//
-//    for (const auto& col : columns_) {
-//      if (col.second.reader->maxRepetitionLevel() >= select_level) {
-//        in_row[col.second.index] = SValue();
-//      }
-//    }
-//  }
-//
-//  switch (aggr_strategy_) {
-//    case AggregationStrategy::AGGREGATE_ALL:
-//      for (int i = 0; i < select_list_.size(); ++i) {
-//        VM::result(
-//            txn_,
-//            select_list_[i].compiled.program(),
-//            &select_list_[i].instance,
-//            &out_row[i]);
-//      }
-//
-//      output_(out_row.data(), out_row.size());
-//      break;
-//
-//    default:
-//      break;
-//
-//  }
-//}
-
-//void CSTableScan::scanWithoutColumns() {
-//  Vector<SValue> out_row(select_list_.size(), SValue{});
-//
-//  size_t total_records = cstable_->numRecords();
-//  for (size_t i = 0; i < total_records; ++i) {
-//    bool where_pred = true;
-//    if (where_expr_.program() != nullptr) {
-//      SValue where_tmp;
-//      VM::evaluate(txn_, where_expr_.program(), 0, nullptr, &where_tmp);
-//      where_pred = where_tmp.getBool();
-//    }
-//
-//    if (where_pred) {
-//      switch (aggr_strategy_) {
-//
-//        case AggregationStrategy::AGGREGATE_ALL:
-//          for (int i = 0; i < select_list_.size(); ++i) {
-//            VM::accumulate(
-//                txn_,
-//                select_list_[i].compiled.program(),
-//                &select_list_[i].instance,
-//                0,
-//                nullptr);
-//          }
-//          break;
-//
-//        case AggregationStrategy::AGGREGATE_WITHIN_RECORD_DEEP:
-//        case AggregationStrategy::AGGREGATE_WITHIN_RECORD_FLAT:
-//        case AggregationStrategy::NO_AGGREGATION:
-//          for (int i = 0; i < select_list_.size(); ++i) {
-//            VM::evaluate(
-//                txn_,
-//                select_list_[i].compiled.program(),
-//                0,
-//                nullptr,
-//                &out_row[i]);
-//          }
-//
-//          if (!output_(out_row.data(), out_row.size())) {
-//            return;
-//          }
-//          break;
-//      }
-//    }
-//  }
-//
-//  switch (aggr_strategy_) {
-//    case AggregationStrategy::AGGREGATE_ALL:
-//      for (int i = 0; i < select_list_.size(); ++i) {
-//        VM::result(
-//            txn_,
-//            select_list_[i].compiled.program(),
-//            &select_list_[i].instance,
-//            &out_row[i]);
-//      }
-//
-//      output_(out_row.data(), out_row.size());
-//      break;
-//
-//    default:
-//      break;
-//
-//  }
-//}
-//
 void CSTableScan::findColumns(
     RefPtr<ValueExpressionNode> expr,
     Set<String>* column_names) const {
@@ -613,10 +800,31 @@ void CSTableScan::setCacheKey(const SHA1Hash& key) {
   cache_key_ = Some(key);
 }
 
+void CSTableScan::setCheckpointKey(const SHA1Hash& table_key) {
+  table_key_ = Some(table_key);
+}
+
+void CSTableScan::setRuntimeFilter(const RuntimeFilterSpec& spec) {
+  runtime_filter_spec_ = Some(spec);
+}
+
+size_t CSTableScan::rowsFiltered() const {
+  return rows_filtered_;
+}
+
 size_t CSTableScan::rowsScanned() const {
   return rows_scanned_;
 }
 
+uint64_t CSTableScan::bytesRead() const {
+  return bytes_read_;
+}
+
+void CSTableScan::collectStats(TaskStats* stats) const {
+  stats->num_rows_in += rows_scanned_;
+  stats->bytes_read += bytes_read_;
+}
+
 void CSTableScan::setFilter(Function<bool ()> filter_fn) {
   filter_fn_ = filter_fn;
 }
@@ -663,4 +871,228 @@ CSTableScan::ExpressionRef::~ExpressionRef() {
 }
 
 
+const size_t CSTableMorselSource::kMorselSize;
+
+CSTableMorselSource::CSTableMorselSource(
+    Transaction* txn,
+    RefPtr<SequentialScanNode> stmt,
+    const String& cstable_filename,
+    const Option<RuntimeFilterSpec>& runtime_filter /* = None */,
+    size_t morsel_size /* = kMorselSize */) :
+    txn_(txn),
+    stmt_(stmt),
+    cstable_filename_(cstable_filename),
+    runtime_filter_(runtime_filter),
+    morsel_size_(morsel_size),
+    num_records_(
+        cstable::CSTableReader::openFile(cstable_filename)->numRecords()),
+    num_cursors_(0) {}
+
+PipelineStage* CSTableMorselSource::buildStage(Transaction* txn) {
+  return new PassThroughStage();
+}
+
+ScopedPtr<ResultCursor> CSTableMorselSource::openCursor() {
+  auto scan = mkRef(
+      new CSTableScan(
+          txn_,
+          stmt_,
+          cstable_filename_,
+          txn_->getRuntime()->queryBuilder().get()));
+
+  if (!runtime_filter_.isEmpty()) {
+    scan->setRuntimeFilter(runtime_filter_.get());
+  }
+
+  size_t cursor_idx;
+  {
+    std::unique_lock<std::mutex> lk(mutex_);
+    cursor_idx = num_cursors_++;
+    cursor_positions_.emplace_back(0);
+  }
+
+  return mkScoped<ResultCursor>(
+      new CSTableMorselCursor(this, cursor_idx, scan.get()));
+}
+
+bool CSTableMorselSource::nextMorsel(
+    size_t cursor_idx,
+    uint64_t* begin,
+    uint64_t* end) {
+  std::unique_lock<std::mutex> lk(mutex_);
+
+  if (stripes_.empty()) {
+    auto num_stripes = std::max(num_cursors_, size_t(1));
+    for (size_t i = 0; i < num_stripes; ++i) {
+      Stripe stripe;
+      stripe.begin = (num_records_ * i) / num_stripes;
+      stripe.end = (num_records_ * (i + 1)) / num_stripes;
+      stripes_.emplace_back(stripe);
+    }
+  }
+
+  auto& position = cursor_positions_[cursor_idx];
+
+  /* take the next range of the cursor's own stripe */
+  if (cursor_idx < stripes_.size()) {
+    auto& stripe = stripes_[cursor_idx];
+    if (stripe.begin < stripe.end) {
+      *begin = stripe.begin;
+      *end = std::min(stripe.begin + morsel_size_, stripe.end);
+      stripe.begin = *end;
+      position = *end;
+      return true;
+    }
+  }
+
+  /* otherwise take the last range of the stripe with the most records left
+   * that is still ahead of the cursor */
+  Stripe* victim = nullptr;
+  for (auto& stripe : stripes_) {
+    if (stripe.begin == stripe.end) {
+      continue;
+    }
+
+    auto range_begin = std::max(
+        stripe.begin,
+        stripe.end - std::min(stripe.end, uint64_t(morsel_size_)));
+
+    if (range_begin < position) {
+      continue;
+    }
+
+    if (victim == nullptr ||
+        stripe.end - stripe.begin > victim->end - victim->begin) {
+      victim = &stripe;
+    }
+  }
+
+  if (victim == nullptr) {
+    return false;
+  }
+
+  *end = victim->end;
+  *begin = std::max(
+      victim->begin,
+      victim->end - std::min(victim->end, uint64_t(morsel_size_)));
+  victim->end = *begin;
+  position = *end;
+  return true;
+}
+
+CSTableMorselCursor::CSTableMorselCursor(
+    RefPtr<CSTableMorselSource> source,
+    size_t cursor_idx,
+    RefPtr<CSTableScan> scan) :
+    source_(source),
+    cursor_idx_(cursor_idx),
+    scan_(scan),
+    in_morsel_(false),
+    closed_(false) {}
+
+bool CSTableMorselCursor::next(SValue* row, int row_len) {
+  while (!closed_) {
+    if (!in_morsel_) {
+      uint64_t begin;
+      uint64_t end;
+      if (!source_->nextMorsel(cursor_idx_, &begin, &end)) {
+        close();
+        return false;
+      }
+
+      scan_->setRecordRange(begin, end);
+      in_morsel_ = true;
+    }
+
+    if (scan_->nextRow(row, row_len)) {
+      return true;
+    }
+
+    in_morsel_ = false;
+  }
+
+  return false;
+}
+
+void CSTableMorselCursor::close() {
+  if (closed_) {
+    return;
+  }
+
+  closed_ = true;
+  scan_->close();
+
+  auto stats = source_->stats();
+  if (stats) {
+    stats->bytes_read += scan_->bytesRead();
+  }
+}
+
+CSTableScanFactory::CSTableScanFactory(
+    RefPtr<SequentialScanNode> stmt,
+    const String& cstable_filename) :
+    stmt_(stmt),
+    cstable_filename_(cstable_filename) {}
+
+RefPtr<Task> CSTableScanFactory::build(
+    Transaction* txn,
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input) const {
+  auto scan = new CSTableScan(
+      txn,
+      stmt_,
+      cstable_filename_,
+      txn->getRuntime()->queryBuilder().get());
+
+  if (!checkpoint_key_.isEmpty()) {
+    scan->setCheckpointKey(checkpoint_key_.get());
+  }
+
+  if (!runtime_filter_.isEmpty()) {
+    scan->setRuntimeFilter(runtime_filter_.get());
+  }
+
+  return scan;
+}
+
+RefPtr<MorselSource> CSTableScanFactory::buildMorselSource(
+    Transaction* txn) const {
+  /* the aggregate of all records and the row limit need a single scan */
+  if (stmt_->aggregationStrategy() == AggregationStrategy::AGGREGATE_ALL ||
+      !stmt_->limit().isEmpty()) {
+    return RefPtr<MorselSource>();
+  }
+
+  return new CSTableMorselSource(
+      txn,
+      stmt_,
+      cstable_filename_,
+      runtime_filter_);
+}
+
+Option<SHA1Hash> CSTableScanFactory::cacheKey(
+    const Vector<SHA1Hash>& input_keys) const {
+  if (!runtime_filter_.isEmpty()) {
+    return None<SHA1Hash>();
+  }
+
+  return cache_key_;
+}
+
+size_t CSTableScanFactory::numOutputColumns() const {
+  return stmt_->selectList().size();
+}
+
+void CSTableScanFactory::setCacheKey(const SHA1Hash& key) {
+  cache_key_ = Some(key);
+}
+
+void CSTableScanFactory::setCheckpointKey(const SHA1Hash& table_key) {
+  checkpoint_key_ = Some(table_key);
+}
+
+bool CSTableScanFactory::setRuntimeFilter(const RuntimeFilterSpec& spec) {
+  runtime_filter_ = Some(spec);
+  return true;
+}
+
 } // namespace csql
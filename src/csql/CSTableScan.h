@@ -8,13 +8,17 @@
  * <http://www.gnu.org/licenses/>.
  */
 #pragma once
+#include <mutex>
 #include <stx/stdtypes.h>
 #include <stx/protobuf/MessageSchema.h>
+#include <csql/Transaction.h>
 #include <csql/qtree/SequentialScanNode.h>
 #include <csql/runtime/compiler.h>
 #include <csql/runtime/defaultruntime.h>
 #include <csql/runtime/TableExpression.h>
 #include <csql/runtime/ValueExpression.h>
+#include <csql/tasks/TaskFactory.h>
+#include <csql/tasks/morsel.h>
 #include <cstable/CSTableReader.h>
 
 using namespace stx;
@@ -38,6 +42,13 @@ public:
 
   bool nextRow(SValue* out, int out_len) override;
 
+  /**
+   * Stops the scan and closes the column readers and the cstable file
+   */
+  void close() override;
+
+  void collectStats(TaskStats* stats) const override;
+
   virtual Vector<String> columnNames() const;
   virtual size_t numColumns() const;
 
@@ -48,8 +59,46 @@ public:
   Option<SHA1Hash> cacheKey() const override;
   void setCacheKey(const SHA1Hash& key);
 
+  /**
+   * Enable incremental aggregation for a table that is only ever appended to.
+   * table_key must identify the table across appends (e.g. its partition id).
+   * If the scan aggregates all records, the aggregate state is checkpointed
+   * to the runtime's cache dir together with the number of scanned records
+   * (see ScanCheckpoint). Later scans with the same table key and statement
+   * load the checkpoint and only evaluate the records that were appended
+   * since. The checkpointed records are still read to skip them, since the
+   * column readers can't seek (see skipRecords)
+   */
+  void setCheckpointKey(const SHA1Hash& table_key);
+
+  /**
+   * Drop the rows that don't pass the runtime filter (see RuntimeFilterSpec).
+   * Only applied if the scan doesn't aggregate. Must be called before the
+   * scan is opened
+   */
+  void setRuntimeFilter(const RuntimeFilterSpec& spec);
+
+  /**
+   * Only scan the records [begin, end). The column readers can only be read
+   * sequentially, so the records before begin are skipped (without decoding
+   * their values) and ranges must be set in ascending order. The next range
+   * may be set once nextRow returned false
+   */
+  void setRecordRange(uint64_t begin, uint64_t end);
+
   size_t rowsScanned() const;
 
+  /**
+   * Returns the number of bytes of the decoded column values read so far.
+   * Skipped records are not counted (see skipRecords)
+   */
+  uint64_t bytesRead() const;
+
+  /**
+   * Returns the number of rows that were dropped by the runtime filter
+   */
+  size_t rowsFiltered() const;
+
   void setFilter(Function<bool ()> filter_fn);
   void setColumnType(String column, sql_type type);
 
@@ -78,8 +127,13 @@ protected:
     VM::Instance instance;
   };
 
-  void scan();
-  void scanWithoutColumns();
+  bool scan(SValue* out, int out_len);
+  bool scanWithoutColumns(SValue* out, int out_len);
+
+  /**
+   * Returns false if the row's key is not contained in the runtime filter
+   */
+  bool evaluateRuntimeFilter(int argc, const SValue* argv);
 
   void findColumns(
       RefPtr<ValueExpressionNode> expr,
@@ -91,6 +145,22 @@ protected:
 
   void fetch();
 
+  /**
+   * Loads the checkpoint, if any, and skips the records it covers. Since the
+   * records are skipped with skipRecords, refreshing a checkpointed scan
+   * still reads the covered records of each column, it only doesn't
+   * evaluate them
+   */
+  void loadCheckpoint();
+  void storeCheckpoint();
+
+  /**
+   * Skips the next num_records records of every column. The cstable column
+   * readers can't seek, so this reads and discards each value, i.e. it costs
+   * O(num_records) per column rather than O(1)
+   */
+  void skipRecords(uint64_t num_records);
+
   Transaction* txn_;
   Vector<String> column_names_;
   ScratchMemory scratch_;
@@ -104,10 +174,151 @@ protected:
   size_t colindex_;
   AggregationStrategy aggr_strategy_;
   Option<SHA1Hash> cache_key_;
+  Option<SHA1Hash> table_key_;
+  Option<SHA1Hash> checkpoint_key_;
   size_t rows_scanned_;
+  size_t rows_filtered_;
+  uint64_t bytes_read_;
   Function<bool ()> filter_fn_;
   bool opened_;
+  bool scan_done_;
+  Option<size_t> limit_;
+  size_t num_rows_;
+  size_t num_records_;
+  uint64_t records_end_;
+  uint64_t fetch_level_;
+  uint64_t select_level_;
+  bool filter_pred_;
+  Vector<SValue> in_row_;
+  Option<RuntimeFilterSpec> runtime_filter_spec_;
+  RefPtr<RuntimeFilter> runtime_filter_;
+  Vector<ValueExpression> runtime_filter_keys_;
+  AbortCheck abort_check_;
 };
 
+/**
+ * Splits the records of a cstable into ranges of up to morsel_size records.
+ * Each worker cursor scans the ranges it takes with its own CSTableScan, i.e.
+ * with its own column readers, so decoding and evaluating the records of
+ * different ranges runs in parallel.
+ *
+ * Since column readers can't seek, a worker reads every record before the
+ * range it takes (see CSTableScan::skipRecords). So rather than handing out
+ * the ranges in turns, which makes every worker read the whole table, the
+ * records are split into one contiguous stripe per cursor. Each cursor takes
+ * the ranges of its own stripe in order and only skips the records before its
+ * stripe once. A cursor that is done with its stripe takes ranges from the end
+ * of the later stripes
+ */
+class CSTableMorselSource : public MorselSource {
+public:
+
+  static const size_t kMorselSize = 8192;
+
+  CSTableMorselSource(
+      Transaction* txn,
+      RefPtr<SequentialScanNode> stmt,
+      const String& cstable_filename,
+      const Option<RuntimeFilterSpec>& runtime_filter =
+          None<RuntimeFilterSpec>(),
+      size_t morsel_size = kMorselSize);
+
+  /**
+   * The rows are evaluated by the scan of each cursor, so the stage is a
+   * PassThroughStage
+   */
+  PipelineStage* buildStage(Transaction* txn) override;
+
+  ScopedPtr<ResultCursor> openCursor() override;
+
+  /**
+   * Takes the next range of records for the cursor with the given index. The
+   * stripes are split once the first range is taken, so all cursors should be
+   * opened before. The ranges of each cursor are ascending. Returns false once
+   * the cursor can't take any more records
+   */
+  bool nextMorsel(size_t cursor_idx, uint64_t* begin, uint64_t* end);
+
+protected:
+  Transaction* txn_;
+  RefPtr<SequentialScanNode> stmt_;
+  String cstable_filename_;
+  Option<RuntimeFilterSpec> runtime_filter_;
+  uint64_t morsel_size_;
+  uint64_t num_records_;
+
+  struct Stripe {
+    uint64_t begin;
+    uint64_t end;
+  };
+
+  std::mutex mutex_;
+  size_t num_cursors_;
+  Vector<Stripe> stripes_;
+  Vector<uint64_t> cursor_positions_;
+};
+
+class CSTableMorselCursor : public ResultCursor {
+public:
+
+  CSTableMorselCursor(
+      RefPtr<CSTableMorselSource> source,
+      size_t cursor_idx,
+      RefPtr<CSTableScan> scan);
+
+  bool next(SValue* row, int row_len) override;
+  void close() override;
+
+protected:
+  RefPtr<CSTableMorselSource> source_;
+  size_t cursor_idx_;
+  RefPtr<CSTableScan> scan_;
+  bool in_morsel_;
+  bool closed_;
+};
+
+/**
+ * Builds CSTableScan tasks on a cstable file. Scans that neither aggregate
+ * all records nor have a row limit can also be executed as a morsel source
+ * (see CSTableMorselSource)
+ */
+class CSTableScanFactory : public TaskFactory {
+public:
+
+  CSTableScanFactory(
+      RefPtr<SequentialScanNode> stmt,
+      const String& cstable_filename);
+
+  RefPtr<Task> build(
+      Transaction* txn,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input) const override;
+
+  RefPtr<MorselSource> buildMorselSource(Transaction* txn) const override;
+
+  /**
+   * Returns None if the scan applies a runtime filter, since its output then
+   * depends on the build side of a join and not only on the table
+   */
+  Option<SHA1Hash> cacheKey(
+      const Vector<SHA1Hash>& input_keys) const override;
+
+  size_t numOutputColumns() const override;
+
+  void setCacheKey(const SHA1Hash& key);
+
+  /**
+   * See CSTableScan::setCheckpointKey
+   */
+  void setCheckpointKey(const SHA1Hash& table_key);
+
+  bool setRuntimeFilter(const RuntimeFilterSpec& spec) override;
+
+protected:
+  RefPtr<SequentialScanNode> stmt_;
+  String cstable_filename_;
+  Option<SHA1Hash> cache_key_;
+  Option<SHA1Hash> checkpoint_key_;
+  Option<RuntimeFilterSpec> runtime_filter_;
+};
 
 } // namespace csql
@@ -29,20 +29,23 @@ TaskIDList CSTableScanProvider::buildSequentialScan(
     RAISEF(kNotFoundError, "table not found: '$0'", node->tableName());
   }
 
-  auto self = mkRef(const_cast<CSTableScanProvider*>(this));
-  auto task_factory = [self, node] (
-      Transaction* txn,
-      HashMap<TaskID, ScopedPtr<ResultCursor>> input) -> RefPtr<Task> {
-    return new CSTableScan(
-        txn,
-        node,
-        self->cstable_file_,
-        txn->getRuntime()->queryBuilder().get());
-  };
-
-  auto task = new TaskDAGNode(new SimpleTableExpressionFactory(task_factory));
+  auto factory = mkRef(new CSTableScanFactory(node, cstable_file_));
+  if (!checkpoint_key_.isEmpty()) {
+    factory->setCheckpointKey(checkpoint_key_.get());
+  }
+
+  if (!cache_key_.isEmpty()) {
+    factory->setCacheKey(
+        SHA1::compute(
+            StringUtil::format(
+                "$0~$1",
+                cache_key_.get().toString(),
+                node->toString())));
+  }
+
+  auto task = new TaskDAGNode(factory.get());
   TaskIDList input;
-  input.emplace_back(tasks->addTask(task));
+  input.emplace_back(tasks->addTask(task, node.get()));
   return input;
 }
 
@@ -74,6 +77,7 @@ csql::TableInfo CSTableScanProvider::tableInfo() const {
 
   csql::TableInfo ti;
   ti.table_name = table_name_;
+  ti.sort_columns = sort_columns_;
 
   for (const auto& col : cstable->columns()) {
     csql::ColumnInfo ci;
@@ -115,4 +119,17 @@ csql::TableInfo CSTableScanProvider::tableInfo() const {
   return ti;
 }
 
+void CSTableScanProvider::setSortColumns(
+    const Vector<String>& sort_columns) {
+  sort_columns_ = sort_columns;
+}
+
+void CSTableScanProvider::setCacheKey(const SHA1Hash& cache_key) {
+  cache_key_ = Some(cache_key);
+}
+
+void CSTableScanProvider::setCheckpointKey(const SHA1Hash& table_key) {
+  checkpoint_key_ = Some(table_key);
+}
+
 } // namespace csql
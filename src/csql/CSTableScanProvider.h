@@ -9,6 +9,7 @@
  */
 #pragma once
 #include <stx/stdtypes.h>
+#include <stx/SHA1.h>
 #include <csql/runtime/tablerepository.h>
 #include <cstable/CSTableReader.h>
 
@@ -35,9 +36,33 @@ public:
 
   csql::TableInfo tableInfo() const;
 
+  /**
+   * Declare that the rows in the cstable file are stored in ascending order of
+   * the provided columns
+   */
+  void setSortColumns(const Vector<String>& sort_columns);
+
+  /**
+   * Declare a key that identifies the current version of the cstable file so
+   * that the results of scans on this table can be cached (see ResultCache).
+   * The key must change whenever the file changes
+   */
+  void setCacheKey(const SHA1Hash& cache_key);
+
+  /**
+   * Declare that records are only ever appended to the cstable file and
+   * enable incremental aggregation for scans on this table (see
+   * CSTableScan::setCheckpointKey). Unlike the cache key, table_key must not
+   * change when records are appended
+   */
+  void setCheckpointKey(const SHA1Hash& table_key);
+
 protected:
   const String table_name_;
   const String cstable_file_;
+  Vector<String> sort_columns_;
+  Option<SHA1Hash> cache_key_;
+  Option<SHA1Hash> checkpoint_key_;
 };
 
 
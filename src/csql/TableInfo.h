@@ -25,6 +25,7 @@ struct TableInfo {
   Option<String> description;
   Vector<ColumnInfo> columns;
   Set<String> tags;
+  Vector<String> sort_columns; // rows are stored in ascending order of these
 };
 
 } // namespace csql
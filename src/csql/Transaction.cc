@@ -15,10 +15,20 @@ using namespace stx;
 
 namespace csql {
 
+const size_t AbortCheck::kInterval;
+
 Transaction::Transaction(
     Runtime* runtime) :
     runtime_(runtime),
-    now_(WallClock::now()) {}
+    now_(WallClock::now()),
+    cancelled_(false),
+    deadline_(0),
+    priority_(QueryPriority::INTERACTIVE),
+    num_admissions_(0) {
+  memory_tracker_.setLimits(
+      runtime_->memorySoftLimit(),
+      runtime_->memoryHardLimit());
+}
 
 Runtime* Transaction::getRuntime() const {
   return runtime_;
@@ -44,4 +54,97 @@ RefPtr<TableProvider> Transaction::getTableProvider() const {
   return table_provider_;
 }
 
+MemoryTracker* Transaction::getMemoryTracker() {
+  return &memory_tracker_;
+}
+
+ExecutionStats* Transaction::getExecutionStats() {
+  return &execution_stats_;
+}
+
+void Transaction::cancel() {
+  cancelled_ = true;
+}
+
+bool Transaction::isCancelled() const {
+  return cancelled_;
+}
+
+void Transaction::setDeadline(UnixTime deadline) {
+  deadline_ = deadline.unixMicros();
+}
+
+Option<UnixTime> Transaction::getDeadline() const {
+  auto deadline = deadline_.load();
+  if (deadline == 0) {
+    return None<UnixTime>();
+  }
+
+  return Some(UnixTime(deadline));
+}
+
+void Transaction::checkAborted() const {
+  if (cancelled_) {
+    RAISE(kRuntimeError, "query cancelled");
+  }
+
+  auto deadline = deadline_.load();
+  if (deadline > 0 && WallClock::unixMicros() >= deadline) {
+    RAISE(kRuntimeError, "query exceeded its deadline");
+  }
+}
+
+RefPtr<RuntimeFilter> Transaction::getRuntimeFilter(
+    const SHA1Hash& filter_id) {
+  std::unique_lock<std::mutex> lk(runtime_filters_mutex_);
+  auto& filter = runtime_filters_[filter_id];
+  if (filter.get() == nullptr) {
+    filter = mkRef(new RuntimeFilter());
+  }
+
+  return filter;
+}
+
+void Transaction::clearRuntimeFilters() {
+  std::unique_lock<std::mutex> lk(runtime_filters_mutex_);
+  runtime_filters_.clear();
+}
+
+void Transaction::setPriority(QueryPriority priority) {
+  priority_ = priority;
+}
+
+QueryPriority Transaction::getPriority() const {
+  return priority_;
+}
+
+void Transaction::admit() {
+  std::unique_lock<std::mutex> lk(admission_mutex_);
+  if (!admission_.get()) {
+    admission_ = runtime_->admissionController()->admit(this);
+  }
+
+  ++num_admissions_;
+}
+
+void Transaction::release() {
+  std::unique_lock<std::mutex> lk(admission_mutex_);
+  if (num_admissions_ == 0) {
+    return;
+  }
+
+  if (--num_admissions_ == 0) {
+    admission_.reset(nullptr);
+  }
+}
+
+size_t Transaction::getMaxThreads() const {
+  std::unique_lock<std::mutex> lk(admission_mutex_);
+  if (!admission_.get()) {
+    return 0;
+  }
+
+  return admission_->maxThreads();
+}
+
 } // namespace csql
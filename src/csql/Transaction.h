@@ -8,10 +8,16 @@
  * <http://www.gnu.org/licenses/>.
  */
 #pragma once
+#include <atomic>
+#include <mutex>
 #include <stx/stdtypes.h>
 #include <stx/UnixTime.h>
 #include <csql/csql.h>
 #include <csql/runtime/tablerepository.h>
+#include <csql/runtime/MemoryTracker.h>
+#include <csql/runtime/TaskStats.h>
+#include <csql/runtime/AdmissionController.h>
+#include <csql/runtime/RuntimeFilter.h>
 
 using namespace stx;
 
@@ -26,6 +32,10 @@ public:
     return (sql_txn*) ctx;
   }
 
+  static inline Transaction* get(sql_txn* ctx) {
+    return (Transaction*) ctx;
+  }
+
   Transaction(Runtime* runtime);
 
   UnixTime now() const;
@@ -37,10 +47,115 @@ public:
   void setTableProvider(RefPtr<TableProvider> provider);
   RefPtr<TableProvider> getTableProvider() const;
 
+  /**
+   * Returns the tracker that counts the memory held by the operators of this
+   * transaction. The limits are initialized from the runtime's memory limits
+   */
+  MemoryTracker* getMemoryTracker();
+
+  /**
+   * Returns the statistics of all tasks executed in this transaction
+   */
+  ExecutionStats* getExecutionStats();
+
+  /**
+   * Cancel the transaction. Running operators stop at their next abort check
+   * (see AbortCheck) and the query fails with an error. Thread safe
+   */
+  void cancel();
+  bool isCancelled() const;
+
+  /**
+   * Abort the transaction once the wallclock passes deadline
+   */
+  void setDeadline(UnixTime deadline);
+  Option<UnixTime> getDeadline() const;
+
+  /**
+   * Raises an error if the transaction was cancelled or its deadline has
+   * passed
+   */
+  void checkAborted() const;
+
+  /**
+   * Returns the runtime filter with the provided id (see RuntimeFilterSpec)
+   * for the current execution of a query plan. The filter is created on first
+   * use, so the join that publishes it and the scans that apply it share the
+   * same instance. Thread safe
+   */
+  RefPtr<RuntimeFilter> getRuntimeFilter(const SHA1Hash& filter_id);
+
+  /**
+   * Drop all runtime filters. Called before a query plan is executed so that
+   * each execution starts with unpublished filters
+   */
+  void clearRuntimeFilters();
+
+  /**
+   * The priority class of the transaction's queries (see AdmissionController).
+   * Defaults to INTERACTIVE
+   */
+  void setPriority(QueryPriority priority);
+  QueryPriority getPriority() const;
+
+  /**
+   * Blocks until the runtime's admission controller admits the transaction.
+   * Called by QueryPlan::execute before a query is executed. Admissions nest:
+   * the transaction counts as running until every admit was matched by a call
+   * to release
+   */
+  void admit();
+
+  /**
+   * Called once a query is finished or its result cursor is destroyed (see
+   * QueryPlan::execute)
+   */
+  void release();
+
+  /**
+   * Returns the number of threads the transaction's queries may use or zero if
+   * the transaction isn't admitted
+   */
+  size_t getMaxThreads() const;
+
 protected:
   Runtime* runtime_;
   UnixTime now_;
   RefPtr<TableProvider> table_provider_;
+  MemoryTracker memory_tracker_;
+  ExecutionStats execution_stats_;
+  std::atomic<bool> cancelled_;
+  std::atomic<uint64_t> deadline_; // unix micros, 0 == no deadline
+  QueryPriority priority_;
+  ScopedPtr<AdmissionTicket> admission_;
+  size_t num_admissions_;
+  mutable std::mutex admission_mutex_;
+  HashMap<SHA1Hash, RefPtr<RuntimeFilter>> runtime_filters_;
+  std::mutex runtime_filters_mutex_;
+};
+
+/**
+ * Calls Transaction::checkAborted once every kInterval calls to tick(). Row
+ * loops call tick() once per row so that the check (which reads the clock if
+ * the transaction has a deadline) is amortized over a batch of rows
+ */
+class AbortCheck {
+public:
+
+  static const size_t kInterval = 1024;
+
+  explicit AbortCheck(Transaction* txn) : txn_(txn), count_(0) {}
+
+  inline void tick() {
+    if (++count_ >= kInterval) {
+      count_ = 0;
+      txn_->checkAborted();
+    }
+  }
+
+protected:
+  Transaction* txn_;
+  size_t count_;
 };
 
 
@@ -53,20 +53,18 @@ TaskIDList CSVTableProvider::buildSequentialScan(
   }
 
   auto self = mkRef(const_cast<CSVTableProvider*>(this));
-  auto task_factory = [self, node] (Transaction* txn, HashMap<TaskID, ScopedPtr<ResultCursor>> input) -> RefPtr<Task> {
+  auto iter_factory = [self] () -> ScopedPtr<TableIterator> {
     auto stream = self->stream_factory_();
     stream->skipNextRow();
 
-    return new TableScan(
-          txn,
-          node,
-          mkScoped(new CSVTableScan(self->headers_, std::move(stream))));
+    return mkScoped<TableIterator>(
+        new CSVTableScan(self->headers_, std::move(stream)));
   };
 
-  auto task = new TaskDAGNode(new SimpleTableExpressionFactory(task_factory));
+  auto task = new TaskDAGNode(new TableScanFactory(node, iter_factory));
 
   TaskIDList input;
-  input.emplace_back(tasks->addTask(task));
+  input.emplace_back(tasks->addTask(task, node.get()));
   return input;
 }
 
@@ -19,15 +19,24 @@ CSVTableScan::CSVTableScan(
     const Vector<String>& headers,
     ScopedPtr<CSVInputStream> csv) :
     headers_(headers),
-    csv_(std::move(csv)) {}
+    csv_(std::move(csv)),
+    bytes_read_(0) {}
 
 bool CSVTableScan::nextRow(SValue* row) {
+  if (csv_.get() == nullptr) {
+    return false;
+  }
+
   Vector<String> inrow;
   if (!csv_->readNextRow(&inrow)) {
     return false;
   }
 
 
+  for (const auto& field : inrow) {
+    bytes_read_ += field.size() + 1;
+  }
+
   auto ncols = std::min(headers_.size(), inrow.size());
   for (size_t i = 0; i < ncols; i++) {
     row[i] = SValue(inrow[i]);
@@ -54,6 +63,14 @@ size_t CSVTableScan::numColumns() const {
   return headers_.size();
 }
 
+void CSVTableScan::close() {
+  csv_.reset(nullptr);
+}
+
+uint64_t CSVTableScan::bytesRead() const {
+  return bytes_read_;
+}
+
 } // namespace csv
 } // namespace backends
 } // namespace csql
@@ -30,9 +30,17 @@ public:
   size_t findColumn(const String& name) override;
   size_t numColumns() const override;
 
+  void close() override;
+
+  /**
+   * Returns the number of bytes of the fields and separators read so far
+   */
+  uint64_t bytesRead() const override;
+
 protected:
   Vector<String> headers_;
   ScopedPtr<CSVInputStream> csv_;
+  uint64_t bytes_read_;
 };
 
 } // namespace csv
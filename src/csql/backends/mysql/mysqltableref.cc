@@ -71,6 +71,15 @@ void MySQLTableRef::executeScan(TableScan* scan) {
   mysql_query.append(" FROM ");
   mysql_query.append(table_name_);
 
+  /* let the server stop after the last row instead of streaming all rows.
+   * the WHERE expression and the runtime filter are evaluated locally, so
+   * the limit can only be sent if every row the server returns is emitted */
+  auto limit = scan->limit();
+  if (!limit.isEmpty() && !scan->filtersRows()) {
+    mysql_query.append(" LIMIT ");
+    mysql_query.append(std::to_string(limit.get()));
+  }
+
   conn_->executeQuery(
       mysql_query,
       [this, scan] (const std::vector<std::string>& row) -> bool {
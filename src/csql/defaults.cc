@@ -18,6 +18,16 @@ void installDefaultSymbols(SymbolTable* rt) {
   /* expressions/aggregate.h */
   rt->registerFunction("count", expressions::kCountExpr);
   rt->registerFunction("sum", expressions::kSumExpr);
+  rt->registerFunction("count_distinct", expressions::kCountDistinctExpr);
+  rt->registerFunction(
+      "approx_count_distinct",
+      expressions::kApproxCountDistinctExpr);
+  rt->registerFunction(
+      "approx_percentile",
+      expressions::kApproxPercentileExpr);
+  rt->registerFunction("approx_median", expressions::kApproxMedianExpr);
+  rt->registerFunction("min", expressions::kMinExpr);
+  rt->registerFunction("max", expressions::kMaxExpr);
 
   //rt->registerSymbol(
   //    "mean",
@@ -37,18 +47,6 @@ void installDefaultSymbols(SymbolTable* rt) {
   //    expressions::meanExprScratchpadSize(),
   //    &expressions::meanExprFree);
 
-  //rt->registerSymbol(
-  //    "min",
-  //    &expressions::minExpr,
-  //    expressions::minExprScratchpadSize(),
-  //    &expressions::minExprFree);
-
-  //rt->registerSymbol(
-  //    "max",
-  //    &expressions::maxExpr,
-  //    expressions::maxExprScratchpadSize(),
-  //    &expressions::maxExprFree);
-
   /* expressions/boolean.h */
   rt->registerFunction("eq",  PureFunction(&expressions::eqExpr));
   rt->registerFunction("neq", PureFunction(&expressions::neqExpr));
@@ -10,6 +10,11 @@
 #include <stdlib.h>
 #include <csql/expressions/aggregate.h>
 #include <csql/svalue.h>
+#include <csql/runtime/SortKey.h>
+#include <csql/runtime/HyperLogLog.h>
+#include <csql/runtime/DistinctSet.h>
+#include <csql/runtime/TDigest.h>
+#include <csql/runtime/MemoryTracker.h>
 
 namespace csql {
 namespace expressions {
@@ -157,6 +162,344 @@ const AggregateFunction kSumExpr {
   .loadstate = &sumExprLoad
 };
 
+/**
+ * COUNT(DISTINCT) expression
+ */
+void countDistinctExprAcc(
+    sql_txn* ctx,
+    void* scratchpad,
+    int argc,
+    SValue* argv) {
+  if (argc != 1) {
+    RAISE(
+        kRuntimeError,
+        "wrong number of arguments for count(DISTINCT). "
+        "expected: 1, got: %i\n",
+        argc);
+  }
+
+  /* NULL values are not counted */
+  String key;
+  if (SortKey::encodeJoinKey(*argv, &key)) {
+    static_cast<DistinctSet*>(scratchpad)->insert(Transaction::get(ctx), key);
+  }
+}
+
+void countDistinctExprGet(sql_txn* ctx, void* scratchpad, SValue* out) {
+  *out = SValue(SValue::IntegerType(
+      static_cast<DistinctSet*>(scratchpad)->count()));
+}
+
+void countDistinctExprInit(sql_txn* ctx, void* scratchpad) {
+  new (scratchpad) DistinctSet();
+}
+
+void countDistinctExprFree(sql_txn* ctx, void* scratchpad) {
+  static_cast<DistinctSet*>(scratchpad)->~DistinctSet();
+}
+
+void countDistinctExprReset(sql_txn* ctx, void* scratchpad) {
+  static_cast<DistinctSet*>(scratchpad)->clear();
+}
+
+void countDistinctExprMerge(sql_txn* ctx, void* scratchpad, const void* other) {
+  static_cast<DistinctSet*>(scratchpad)->merge(
+      Transaction::get(ctx),
+      *static_cast<const DistinctSet*>(other));
+}
+
+void countDistinctExprSave(sql_txn* ctx, void* scratchpad, OutputStream* os) {
+  static_cast<DistinctSet*>(scratchpad)->encode(os);
+}
+
+void countDistinctExprLoad(sql_txn* ctx, void* scratchpad, InputStream* is) {
+  static_cast<DistinctSet*>(scratchpad)->decode(Transaction::get(ctx), is);
+}
+
+const AggregateFunction kCountDistinctExpr {
+  .scratch_size = sizeof(DistinctSet),
+  .accumulate = &countDistinctExprAcc,
+  .get = &countDistinctExprGet,
+  .reset = &countDistinctExprReset,
+  .init = &countDistinctExprInit,
+  .free = &countDistinctExprFree,
+  .merge = &countDistinctExprMerge,
+  .savestate = &countDistinctExprSave,
+  .loadstate = &countDistinctExprLoad
+};
+
+/**
+ * Reserves the memory allocated by the state of a sketch aggregate (see
+ * HyperLogLog::memoryUsage) from the transaction's memory tracker
+ */
+static void reserveStateMemory(
+    sql_txn* ctx,
+    MemoryReservation* memory,
+    size_t bytes) {
+  if (memory->tracker() == nullptr) {
+    memory->setTracker(Transaction::get(ctx)->getMemoryTracker());
+  }
+
+  if (bytes != memory->bytes()) {
+    memory->resize(bytes);
+  }
+}
+
+/**
+ * APPROX_COUNT_DISTINCT() expression
+ */
+struct approx_count_distinct_expr_scratchpad {
+  HyperLogLog hll;
+  MemoryReservation memory;
+};
+
+void approxCountDistinctExprAcc(
+    sql_txn* ctx,
+    void* scratchpad,
+    int argc,
+    SValue* argv) {
+  if (argc != 1) {
+    RAISE(
+        kRuntimeError,
+        "wrong number of arguments for approx_count_distinct(). "
+        "expected: 1, got: %i\n",
+        argc);
+  }
+
+  /* NULL values are not counted */
+  String key;
+  if (SortKey::encodeJoinKey(*argv, &key)) {
+    auto data = (approx_count_distinct_expr_scratchpad*) scratchpad;
+    data->hll.insert(key);
+    reserveStateMemory(ctx, &data->memory, data->hll.memoryUsage());
+  }
+}
+
+void approxCountDistinctExprGet(sql_txn* ctx, void* scratchpad, SValue* out) {
+  auto data = (approx_count_distinct_expr_scratchpad*) scratchpad;
+  *out = SValue(SValue::IntegerType(data->hll.estimate()));
+}
+
+void approxCountDistinctExprInit(sql_txn* ctx, void* scratchpad) {
+  new (scratchpad) approx_count_distinct_expr_scratchpad();
+}
+
+void approxCountDistinctExprFree(sql_txn* ctx, void* scratchpad) {
+  auto data = (approx_count_distinct_expr_scratchpad*) scratchpad;
+  data->~approx_count_distinct_expr_scratchpad();
+}
+
+void approxCountDistinctExprReset(sql_txn* ctx, void* scratchpad) {
+  auto data = (approx_count_distinct_expr_scratchpad*) scratchpad;
+  data->hll.clear();
+  data->memory.resize(data->hll.memoryUsage());
+}
+
+void approxCountDistinctExprMerge(
+    sql_txn* ctx,
+    void* scratchpad,
+    const void* other) {
+  auto this_data = (approx_count_distinct_expr_scratchpad*) scratchpad;
+  auto other_data = (const approx_count_distinct_expr_scratchpad*) other;
+  this_data->hll.merge(other_data->hll);
+  reserveStateMemory(ctx, &this_data->memory, this_data->hll.memoryUsage());
+}
+
+void approxCountDistinctExprSave(
+    sql_txn* ctx,
+    void* scratchpad,
+    OutputStream* os) {
+  auto data = (approx_count_distinct_expr_scratchpad*) scratchpad;
+  data->hll.encode(os);
+}
+
+void approxCountDistinctExprLoad(
+    sql_txn* ctx,
+    void* scratchpad,
+    InputStream* is) {
+  auto data = (approx_count_distinct_expr_scratchpad*) scratchpad;
+  data->hll.decode(is);
+  reserveStateMemory(ctx, &data->memory, data->hll.memoryUsage());
+}
+
+const AggregateFunction kApproxCountDistinctExpr {
+  .scratch_size = sizeof(approx_count_distinct_expr_scratchpad),
+  .accumulate = &approxCountDistinctExprAcc,
+  .get = &approxCountDistinctExprGet,
+  .reset = &approxCountDistinctExprReset,
+  .init = &approxCountDistinctExprInit,
+  .free = &approxCountDistinctExprFree,
+  .merge = &approxCountDistinctExprMerge,
+  .savestate = &approxCountDistinctExprSave,
+  .loadstate = &approxCountDistinctExprLoad
+};
+
+/**
+ * APPROX_PERCENTILE() and APPROX_MEDIAN() expressions
+ */
+struct approx_percentile_expr_scratchpad {
+  TDigest digest;
+  MemoryReservation memory;
+  double p;
+  bool has_p;
+};
+
+static void approxPercentileExprInsert(
+    sql_txn* ctx,
+    approx_percentile_expr_scratchpad* data,
+    double p,
+    const SValue& val) {
+  if (!data->has_p) {
+    data->p = p;
+    data->has_p = true;
+  }
+
+  /* NULL values are ignored */
+  if (val.getType() != SQL_NULL) {
+    data->digest.insert(val.getFloat());
+    reserveStateMemory(ctx, &data->memory, data->digest.memoryUsage());
+  }
+}
+
+void approxPercentileExprAcc(
+    sql_txn* ctx,
+    void* scratchpad,
+    int argc,
+    SValue* argv) {
+  if (argc != 2) {
+    RAISE(
+        kRuntimeError,
+        "wrong number of arguments for approx_percentile(). "
+        "expected: 2, got: %i\n",
+        argc);
+  }
+
+  auto p = argv[1].getFloat();
+  if (!(p >= 0 && p <= 1)) {
+    RAISE(
+        kRuntimeError,
+        "approx_percentile(): percentile must be between 0 and 1");
+  }
+
+  approxPercentileExprInsert(
+      ctx,
+      (approx_percentile_expr_scratchpad*) scratchpad,
+      p,
+      argv[0]);
+}
+
+void approxMedianExprAcc(
+    sql_txn* ctx,
+    void* scratchpad,
+    int argc,
+    SValue* argv) {
+  if (argc != 1) {
+    RAISE(
+        kRuntimeError,
+        "wrong number of arguments for approx_median(). "
+        "expected: 1, got: %i\n",
+        argc);
+  }
+
+  approxPercentileExprInsert(
+      ctx,
+      (approx_percentile_expr_scratchpad*) scratchpad,
+      0.5,
+      argv[0]);
+}
+
+void approxPercentileExprGet(sql_txn* ctx, void* scratchpad, SValue* out) {
+  auto data = (approx_percentile_expr_scratchpad*) scratchpad;
+  if (data->digest.totalWeight() == 0) {
+    *out = SValue();
+  } else {
+    *out = SValue(SValue::FloatType(data->digest.quantile(data->p)));
+  }
+}
+
+void approxPercentileExprInit(sql_txn* ctx, void* scratchpad) {
+  auto data = new (scratchpad) approx_percentile_expr_scratchpad();
+  data->p = 0;
+  data->has_p = false;
+}
+
+void approxPercentileExprFree(sql_txn* ctx, void* scratchpad) {
+  auto data = (approx_percentile_expr_scratchpad*) scratchpad;
+  data->~approx_percentile_expr_scratchpad();
+}
+
+void approxPercentileExprReset(sql_txn* ctx, void* scratchpad) {
+  auto data = (approx_percentile_expr_scratchpad*) scratchpad;
+  data->digest.clear();
+  data->memory.resize(data->digest.memoryUsage());
+  data->p = 0;
+  data->has_p = false;
+}
+
+void approxPercentileExprMerge(
+    sql_txn* ctx,
+    void* scratchpad,
+    const void* other) {
+  auto this_data = (approx_percentile_expr_scratchpad*) scratchpad;
+  auto other_data = (const approx_percentile_expr_scratchpad*) other;
+
+  this_data->digest.merge(other_data->digest);
+  reserveStateMemory(
+      ctx,
+      &this_data->memory,
+      this_data->digest.memoryUsage());
+
+  if (!this_data->has_p && other_data->has_p) {
+    this_data->p = other_data->p;
+    this_data->has_p = true;
+  }
+}
+
+void approxPercentileExprSave(
+    sql_txn* ctx,
+    void* scratchpad,
+    OutputStream* os) {
+  auto data = (approx_percentile_expr_scratchpad*) scratchpad;
+  os->appendUInt8(data->has_p);
+  os->appendDouble(data->p);
+  data->digest.encode(os);
+}
+
+void approxPercentileExprLoad(
+    sql_txn* ctx,
+    void* scratchpad,
+    InputStream* is) {
+  auto data = (approx_percentile_expr_scratchpad*) scratchpad;
+  data->has_p = is->readUInt8();
+  data->p = is->readDouble();
+  data->digest.decode(is);
+  reserveStateMemory(ctx, &data->memory, data->digest.memoryUsage());
+}
+
+const AggregateFunction kApproxPercentileExpr {
+  .scratch_size = sizeof(approx_percentile_expr_scratchpad),
+  .accumulate = &approxPercentileExprAcc,
+  .get = &approxPercentileExprGet,
+  .reset = &approxPercentileExprReset,
+  .init = &approxPercentileExprInit,
+  .free = &approxPercentileExprFree,
+  .merge = &approxPercentileExprMerge,
+  .savestate = &approxPercentileExprSave,
+  .loadstate = &approxPercentileExprLoad
+};
+
+const AggregateFunction kApproxMedianExpr {
+  .scratch_size = sizeof(approx_percentile_expr_scratchpad),
+  .accumulate = &approxMedianExprAcc,
+  .get = &approxPercentileExprGet,
+  .reset = &approxPercentileExprReset,
+  .init = &approxPercentileExprInit,
+  .free = &approxPercentileExprFree,
+  .merge = &approxPercentileExprMerge,
+  .savestate = &approxPercentileExprSave,
+  .loadstate = &approxPercentileExprLoad
+};
+
 /**
  * MEAN() expression
  */
@@ -237,92 +580,316 @@ const AggregateFunction kMeanExpr {
 };
 
 /**
- * MAX() expression
+ * MIN() and MAX() expressions
+ *
+ * Integers, floats and timestamps are compared in their native type. Strings
+ * that look like numbers (e.g. from CSV files) are compared as numbers, all
+ * other strings lexicographically. If a group contains values of different
+ * numeric types they are compared as floats, if it contains strings and
+ * numbers they are compared as strings
  */
-union max_expr_scratchpad {
-  double max;
-  int count;
+struct minmax_expr_scratchpad {
+  sql_type type;
+  int64_t t_integer;
+  double t_float;
+  String t_string;
 };
 
-void maxExpr(sql_txn* ctx, void* scratchpad, int argc, SValue* argv, SValue* out) {
-  SValue* val = argv;
-  union max_expr_scratchpad* data = (union max_expr_scratchpad*) scratchpad;
+static void minMaxExprToSValue(
+    const minmax_expr_scratchpad* data,
+    SValue* out) {
+  switch (data->type) {
 
-  if (argc != 1) {
-    RAISE(
-        kRuntimeError,
-        "wrong number of arguments for max(). expected: 1, got: %i\n",
-        argc);
-  }
+    case SQL_INTEGER:
+      *out = SValue(SValue::IntegerType(data->t_integer));
+      return;
 
-  switch(val->getType()) {
-    case SQL_NULL:
+    case SQL_TIMESTAMP:
+      *out = SValue(SValue::TimeType(data->t_integer));
       return;
 
-    default: {
-      auto fval = val->getFloat();
-      if (data->count == 0 || fval > data->max) {
-        data->max = fval;
+    case SQL_FLOAT:
+      *out = SValue(SValue::FloatType(data->t_float));
+      return;
+
+    case SQL_STRING:
+      *out = SValue(data->t_string);
+      return;
+
+    default:
+      *out = SValue();
+      return;
+
+  }
+}
+
+template <bool kIsMax>
+static void minMaxExprUpdate(
+    minmax_expr_scratchpad* data,
+    sql_type type,
+    int64_t t_integer,
+    double t_float,
+    const String& t_string) {
+  if (data->type == SQL_NULL) {
+    data->type = type;
+    data->t_integer = t_integer;
+    data->t_float = t_float;
+    data->t_string = t_string;
+    return;
+  }
+
+  if (data->type != type) {
+    if (data->type == SQL_STRING || type == SQL_STRING) {
+      if (data->type != SQL_STRING) {
+        SValue cur;
+        minMaxExprToSValue(data, &cur);
+        data->t_string = cur.getString();
       }
 
-      data->count = 1;
-      *out = SValue(data->max);
+      SValue other;
+      switch (type) {
+        case SQL_INTEGER:
+          other = SValue(SValue::IntegerType(t_integer));
+          break;
+        case SQL_TIMESTAMP:
+          other = SValue(SValue::TimeType(t_integer));
+          break;
+        case SQL_FLOAT:
+          other = SValue(SValue::FloatType(t_float));
+          break;
+        default:
+          other = SValue(t_string);
+          break;
+      }
+
+      data->type = SQL_STRING;
+      minMaxExprUpdate<kIsMax>(data, SQL_STRING, 0, 0, other.getString());
       return;
     }
+
+    if (data->type != SQL_FLOAT) {
+      data->t_float = data->t_integer;
+    }
+
+    if (type != SQL_FLOAT) {
+      t_float = t_integer;
+    }
+
+    data->type = SQL_FLOAT;
+    type = SQL_FLOAT;
   }
-}
 
-void maxExprFree(sql_txn* ctx, void* scratchpad) {
-  /* noop */
-}
+  switch (type) {
 
-size_t maxExprScratchpadSize() {
-  return sizeof(union max_expr_scratchpad);
-}
+    case SQL_INTEGER:
+    case SQL_TIMESTAMP:
+      if (kIsMax ? t_integer > data->t_integer : t_integer < data->t_integer) {
+        data->t_integer = t_integer;
+      }
+      return;
 
-/**
- * MIN() expression
- */
-union min_expr_scratchpad {
-  double min;
-  int count;
-};
+    case SQL_FLOAT:
+      if (kIsMax ? t_float > data->t_float : t_float < data->t_float) {
+        data->t_float = t_float;
+      }
+      return;
 
-void minExpr(sql_txn* ctx, void* scratchpad, int argc, SValue* argv, SValue* out) {
-  SValue* val = argv;
-  union min_expr_scratchpad* data = (union min_expr_scratchpad*) scratchpad;
+    default:
+      if (kIsMax ? t_string > data->t_string : t_string < data->t_string) {
+        data->t_string = t_string;
+      }
+      return;
+
+  }
+}
 
+template <bool kIsMax>
+static void minMaxExprAcc(
+    const char* name,
+    minmax_expr_scratchpad* data,
+    int argc,
+    SValue* argv) {
   if (argc != 1) {
     RAISE(
         kRuntimeError,
-        "wrong number of arguments for min(). expected: 1, got: %i\n",
+        "wrong number of arguments for %s(). expected: 1, got: %i\n",
+        name,
         argc);
   }
 
-  switch(val->getType()) {
+  switch (argv->getType()) {
+
     case SQL_NULL:
       return;
 
-    default: {
-      auto fval = val->getFloat();
-      if (data->count == 0 || fval < data->min) {
-        data->min = fval;
+    case SQL_INTEGER:
+      minMaxExprUpdate<kIsMax>(
+          data,
+          SQL_INTEGER,
+          argv->getInteger(),
+          0,
+          String());
+      return;
+
+    case SQL_TIMESTAMP:
+      minMaxExprUpdate<kIsMax>(
+          data,
+          SQL_TIMESTAMP,
+          argv->getTimestamp().unixMicros(),
+          0,
+          String());
+      return;
+
+    case SQL_FLOAT:
+      minMaxExprUpdate<kIsMax>(data, SQL_FLOAT, 0, argv->getFloat(), String());
+      return;
+
+    default:
+      /* empty strings (e.g. empty csv fields) pass isConvertibleToNumeric
+       * but can't be parsed as numbers, so they are compared as strings */
+      if (!argv->getString().empty() && argv->isConvertibleToNumeric()) {
+        auto num = argv->toNumeric();
+        minMaxExprAcc<kIsMax>(name, data, 1, &num);
+      } else {
+        minMaxExprUpdate<kIsMax>(data, SQL_STRING, 0, 0, argv->getString());
       }
+      return;
+
+  }
+}
+
+template <bool kIsMax>
+static void minMaxExprMerge(
+    minmax_expr_scratchpad* data,
+    const minmax_expr_scratchpad* other) {
+  if (other->type == SQL_NULL) {
+    return;
+  }
+
+  minMaxExprUpdate<kIsMax>(
+      data,
+      other->type,
+      other->t_integer,
+      other->t_float,
+      other->t_string);
+}
+
+void minMaxExprGet(sql_txn* ctx, void* scratchpad, SValue* out) {
+  minMaxExprToSValue((minmax_expr_scratchpad*) scratchpad, out);
+}
+
+void minMaxExprInit(sql_txn* ctx, void* scratchpad) {
+  auto data = new (scratchpad) minmax_expr_scratchpad();
+  data->type = SQL_NULL;
+  data->t_integer = 0;
+  data->t_float = 0;
+}
+
+void minMaxExprFree(sql_txn* ctx, void* scratchpad) {
+  auto data = (minmax_expr_scratchpad*) scratchpad;
+  data->~minmax_expr_scratchpad();
+}
+
+void minMaxExprReset(sql_txn* ctx, void* scratchpad) {
+  auto data = (minmax_expr_scratchpad*) scratchpad;
+  data->type = SQL_NULL;
+  data->t_integer = 0;
+  data->t_float = 0;
+  data->t_string.clear();
+}
+
+void minMaxExprSave(sql_txn* ctx, void* scratchpad, OutputStream* os) {
+  auto data = (minmax_expr_scratchpad*) scratchpad;
+  os->appendUInt8(data->type);
 
-      data->count = 1;
-      *out = SValue(data->min);
+  switch (data->type) {
+    case SQL_INTEGER:
+    case SQL_TIMESTAMP:
+      os->appendUInt64(data->t_integer);
+      return;
+    case SQL_FLOAT:
+      os->appendDouble(data->t_float);
+      return;
+    case SQL_STRING:
+      os->appendLenencString(data->t_string.data(), data->t_string.size());
+      return;
+    default:
       return;
-    }
   }
 }
 
-void minExprFree(sql_txn* ctx, void* scratchpad) {
-  /* noop */
+void minMaxExprLoad(sql_txn* ctx, void* scratchpad, InputStream* is) {
+  auto data = (minmax_expr_scratchpad*) scratchpad;
+  minMaxExprReset(ctx, scratchpad);
+  data->type = (sql_type) is->readUInt8();
+
+  switch (data->type) {
+    case SQL_INTEGER:
+    case SQL_TIMESTAMP:
+      data->t_integer = is->readUInt64();
+      return;
+    case SQL_FLOAT:
+      data->t_float = is->readDouble();
+      return;
+    case SQL_STRING:
+      data->t_string = is->readLenencString();
+      return;
+    default:
+      return;
+  }
 }
 
-size_t minExprScratchpadSize() {
-  return sizeof(union min_expr_scratchpad);
+void maxExprAcc(sql_txn* ctx, void* scratchpad, int argc, SValue* argv) {
+  minMaxExprAcc<true>(
+      "max",
+      (minmax_expr_scratchpad*) scratchpad,
+      argc,
+      argv);
 }
 
+void maxExprMerge(sql_txn* ctx, void* scratchpad, const void* other) {
+  minMaxExprMerge<true>(
+      (minmax_expr_scratchpad*) scratchpad,
+      (const minmax_expr_scratchpad*) other);
+}
+
+const AggregateFunction kMaxExpr {
+  .scratch_size = sizeof(minmax_expr_scratchpad),
+  .accumulate = &maxExprAcc,
+  .get = &minMaxExprGet,
+  .reset = &minMaxExprReset,
+  .init = &minMaxExprInit,
+  .free = &minMaxExprFree,
+  .merge = &maxExprMerge,
+  .savestate = &minMaxExprSave,
+  .loadstate = &minMaxExprLoad
+};
+
+void minExprAcc(sql_txn* ctx, void* scratchpad, int argc, SValue* argv) {
+  minMaxExprAcc<false>(
+      "min",
+      (minmax_expr_scratchpad*) scratchpad,
+      argc,
+      argv);
+}
+
+void minExprMerge(sql_txn* ctx, void* scratchpad, const void* other) {
+  minMaxExprMerge<false>(
+      (minmax_expr_scratchpad*) scratchpad,
+      (const minmax_expr_scratchpad*) other);
+}
+
+const AggregateFunction kMinExpr {
+  .scratch_size = sizeof(minmax_expr_scratchpad),
+  .accumulate = &minExprAcc,
+  .get = &minMaxExprGet,
+  .reset = &minMaxExprReset,
+  .init = &minMaxExprInit,
+  .free = &minMaxExprFree,
+  .merge = &minExprMerge,
+  .savestate = &minMaxExprSave,
+  .loadstate = &minMaxExprLoad
+};
+
 }
 }
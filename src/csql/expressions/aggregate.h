@@ -17,19 +17,17 @@ namespace expressions {
 
 extern const AggregateFunction kCountExpr;
 extern const AggregateFunction kSumExpr;
+extern const AggregateFunction kCountDistinctExpr;
+extern const AggregateFunction kApproxCountDistinctExpr;
+extern const AggregateFunction kApproxPercentileExpr;
+extern const AggregateFunction kApproxMedianExpr;
+extern const AggregateFunction kMinExpr;
+extern const AggregateFunction kMaxExpr;
 
 void meanExpr(void* scratchpad, int argc, SValue* argv, SValue* out);
 void meanExprFree(void* scratchpad);
 size_t meanExprScratchpadSize();
 
-void minExpr(void* scratchpad, int argc, SValue* argv, SValue* out);
-void minExprFree(void* scratchpad);
-size_t minExprScratchpadSize();
-
-void maxExpr(void* scratchpad, int argc, SValue* argv, SValue* out);
-void maxExprFree(void* scratchpad);
-size_t maxExprScratchpadSize();
-
 }
 }
 #endif
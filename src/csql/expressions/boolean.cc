@@ -37,11 +37,24 @@ void eqExpr(sql_txn* ctx, int argc, SValue* argv, SValue* out) {
     return;
   }
 
-  if (lhs->getType() == SQL_STRING || rhs->getType() == SQL_STRING) {
+  if (lhs->getType() == SQL_TIMESTAMP && rhs->getType() == SQL_TIMESTAMP) {
+    *out = SValue::newBool(lhs->getInteger() == rhs->getInteger());
+    return;
+  }
+
+  /* timestamps compare to any other type by their string representation */
+  if (lhs->getType() == SQL_STRING || rhs->getType() == SQL_STRING ||
+      lhs->getType() == SQL_TIMESTAMP || rhs->getType() == SQL_TIMESTAMP) {
     *out = SValue::newBool(lhs->getString() == rhs->getString());
     return;
   }
 
+  /* booleans compare to numbers as 0 and 1 */
+  if (lhs->isNumeric() || rhs->isNumeric()) {
+    *out = SValue::newBool(lhs->getFloat() == rhs->getFloat());
+    return;
+  }
+
   if (lhs->isConvertibleToBool() || rhs->isConvertibleToBool()) {
     *out = SValue::newBool(lhs->getBool() == rhs->getBool());
     return;
@@ -200,6 +200,21 @@ TEST_CASE(ParserTest, TestMethodCallValueExpression, [] () {
   EXPECT(*from == ASTNode::T_FROM);
 });
 
+TEST_CASE(ParserTest, TestCountDistinctExpression, [] () {
+  auto parser = parseTestQuery("SELECT count(DISTINCT x) FROM sometable;");
+  EXPECT(parser.getStatements().size() == 1);
+  const auto& stmt = parser.getStatements()[0];
+  const auto& sl = stmt->getChildren()[0];
+  EXPECT(*sl == ASTNode::T_SELECT_LIST);
+  auto derived = sl->getChildren()[0];
+  EXPECT(*derived == ASTNode::T_DERIVED_COLUMN);
+  auto mcall = derived->getChildren()[0];
+  EXPECT(*mcall == ASTNode::T_METHOD_CALL_DISTINCT);
+  EXPECT(*mcall->getToken() == "count");
+  EXPECT(mcall->getChildren().size() == 1);
+  EXPECT(*mcall->getChildren()[0] == ASTNode::T_COLUMN_NAME);
+});
+
 TEST_CASE(ParserTest, TestNegatedValueExpression, [] () {
   auto parser = parseTestQuery("SELECT -(23 + 5.123) AS fucol FROM tbl;");
   EXPECT(parser.getStatements().size() == 1);
@@ -704,3 +719,36 @@ TEST_CASE(ParserTest, TestInnerJoin, [] () {
   EXPECT(*join3 == ASTNode::T_INNER_JOIN);
   EXPECT(join3->getChildren().size() == 3);
 });
+
+TEST_CASE(ParserTest, TestSubqueryPredicates, [] () {
+  auto parser = parseTestQuery("select x from t1 where x IN (select y from t2) AND z NOT IN (select y from t3) AND NOT EXISTS (select 1 from t4);");
+  EXPECT(parser.getStatements().size() == 1);
+  const auto& stmt = parser.getStatements()[0];
+  EXPECT(stmt->getChildren().size() == 3);
+  const auto& where = stmt->getChildren()[2];
+  EXPECT(*where == ASTNode::T_WHERE);
+  const auto& and1 = where->getChildren()[0];
+  EXPECT(*and1 == ASTNode::T_AND_EXPR);
+  const auto& not_exists = and1->getChildren()[1];
+  EXPECT(*not_exists == ASTNode::T_NEGATE_EXPR);
+  EXPECT(*not_exists->getChildren()[0] == ASTNode::T_EXISTS_EXPR);
+  EXPECT(*not_exists->getChildren()[0]->getChildren()[0] == ASTNode::T_SELECT);
+  const auto& and2 = and1->getChildren()[0];
+  EXPECT(*and2 == ASTNode::T_AND_EXPR);
+  const auto& in_expr = and2->getChildren()[0];
+  EXPECT(*in_expr == ASTNode::T_IN_SUBQUERY_EXPR);
+  EXPECT(*in_expr->getChildren()[0] == ASTNode::T_COLUMN_NAME);
+  EXPECT(*in_expr->getChildren()[1] == ASTNode::T_SELECT);
+  const auto& not_in_expr = and2->getChildren()[1];
+  EXPECT(*not_in_expr == ASTNode::T_NOT_IN_SUBQUERY_EXPR);
+  EXPECT(*not_in_expr->getChildren()[1] == ASTNode::T_SELECT);
+});
+
+TEST_CASE(ParserTest, TestExplainAnalyze, [] () {
+  auto parser = parseTestQuery("EXPLAIN ANALYZE select x from t1 order by x;");
+  EXPECT(parser.getStatements().size() == 1);
+  const auto& stmt = parser.getStatements()[0];
+  EXPECT(*stmt == ASTNode::T_EXPLAIN_ANALYZE);
+  EXPECT(stmt->getChildren().size() == 1);
+  EXPECT(*stmt->getChildren()[0] == ASTNode::T_SELECT);
+});
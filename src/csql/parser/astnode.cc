@@ -184,6 +184,15 @@ void ASTNode::debugPrint(int indent /* = 0 */) const {
     case T_NATURAL_RIGHT_JOIN:
       printf("- NATURAL_RIGHT_JOIN");
       break;
+    case T_SEMI_JOIN:
+      printf("- SEMI_JOIN");
+      break;
+    case T_ANTI_JOIN:
+      printf("- ANTI_JOIN");
+      break;
+    case T_NULL_AWARE_ANTI_JOIN:
+      printf("- NULL_AWARE_ANTI_JOIN");
+      break;
     case T_FROM:
       printf("- FROM");
       break;
@@ -229,6 +238,15 @@ void ASTNode::debugPrint(int indent /* = 0 */) const {
     case T_NEGATE_EXPR:
       printf("- NEGATE_EXPR");
       break;
+    case T_IN_SUBQUERY_EXPR:
+      printf("- IN_SUBQUERY_EXPR");
+      break;
+    case T_NOT_IN_SUBQUERY_EXPR:
+      printf("- NOT_IN_SUBQUERY_EXPR");
+      break;
+    case T_EXISTS_EXPR:
+      printf("- EXISTS_EXPR");
+      break;
     case T_EQ_EXPR:
       printf("- EQ_EXPR");
       break;
@@ -271,6 +289,9 @@ void ASTNode::debugPrint(int indent /* = 0 */) const {
     case T_METHOD_CALL_WITHIN_RECORD:
       printf("- METHOD_CALL_WITHIN_RECORD");
       break;
+    case T_METHOD_CALL_DISTINCT:
+      printf("- METHOD_CALL_DISTINCT");
+      break;
     default:
       printf("- <unknown ASTNode>");
       break;
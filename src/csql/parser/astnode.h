@@ -26,6 +26,7 @@ public:
     T_LITERAL,
     T_METHOD_CALL,
     T_METHOD_CALL_WITHIN_RECORD,
+    T_METHOD_CALL_DISTINCT,
     T_RESOLVED_CALL,
     T_COLUMN_NAME,
     T_COLUMN_ALIAS,
@@ -59,6 +60,9 @@ public:
     T_NATURAL_INNER_JOIN,
     T_NATURAL_LEFT_JOIN,
     T_NATURAL_RIGHT_JOIN,
+    T_SEMI_JOIN,
+    T_ANTI_JOIN,
+    T_NULL_AWARE_ANTI_JOIN,
 
     T_IF_EXPR,
     T_EQ_EXPR,
@@ -78,10 +82,14 @@ public:
     T_POW_EXPR,
     T_REGEX_EXPR,
     T_LIKE_EXPR,
+    T_IN_SUBQUERY_EXPR,
+    T_NOT_IN_SUBQUERY_EXPR,
+    T_EXISTS_EXPR,
 
     T_SHOW_TABLES,
     T_DESCRIBE_TABLE,
     T_EXPLAIN_QUERY,
+    T_EXPLAIN_ANALYZE,
 
     T_DRAW,
     T_IMPORT,
@@ -91,6 +91,18 @@ String ASTUtil::columnNameForExpression(ASTNode* expr) {
           StringUtil::join(args, ", "));
     }
 
+    case ASTNode::T_METHOD_CALL_DISTINCT: {
+      Vector<String> args;
+      for (const auto& c : expr->getChildren()) {
+        args.emplace_back(columnNameForExpression(c));
+      }
+
+      return StringUtil::format(
+          "$0(DISTINCT $1)",
+          expr->getToken()->getString(),
+          StringUtil::join(args, ", "));
+    }
+
     case ASTNode::T_METHOD_CALL_WITHIN_RECORD: {
       Vector<String> args;
       for (const auto& c : expr->getChildren()) {
@@ -116,7 +116,12 @@ ASTNode* Parser::unaryExpr() {
     case Token::T_NOT: {
       consumeToken();
       auto e = new ASTNode(ASTNode::T_NEGATE_EXPR);
-      e->appendChild(expr());
+      if (*cur_token_ == Token::T_EXISTS) {
+        /* NOT EXISTS only negates the subquery predicate */
+        e->appendChild(existsExpr());
+      } else {
+        e->appendChild(expr());
+      }
       return e;
     }
 
@@ -136,6 +141,11 @@ ASTNode* Parser::unaryExpr() {
       return columnName();
     }
 
+    /* EXISTS (subquery) */
+    case Token::T_EXISTS: {
+      return existsExpr();
+    }
+
     default:
       return nullptr;
 
@@ -188,6 +198,12 @@ ASTNode* Parser::methodCall() {
     e->setType(ASTNode::T_COLUMN_INDEX);
   }
 
+  /* e.g. count(DISTINCT expr) */
+  if (lookahead(1, Token::T_DISTINCT)) {
+    consumeToken();
+    e->setType(ASTNode::T_METHOD_CALL_DISTINCT);
+  }
+
   /* read arguments */
   do {
     consumeToken();
@@ -284,6 +300,17 @@ ASTNode* Parser::binaryExpr(ASTNode* lhs, int precedence) {
     case Token::T_LIKE:
       return likeExpr(lhs, precedence);
 
+    /* IN (subquery) and NOT IN (subquery) */
+    case Token::T_IN:
+      return inExpr(lhs, precedence);
+
+    case Token::T_NOT:
+      if (lookahead(1, Token::T_IN)) {
+        return inExpr(lhs, precedence);
+      } else {
+        return nullptr;
+      }
+
     // FIXPAUL: lshift, rshift, ampersand, pipe, tilde, noq, and, or
     default:
       return nullptr;
@@ -425,6 +452,8 @@ ASTNode* Parser::explainStatement() {
   switch (cur_token_->getType()) {
     case Token::T_SELECT:
       return explainQueryStatement();
+    case Token::T_ANALYZE:
+      return explainAnalyzeStatement();
     default:
       return describeTableStatement();
   }
@@ -437,6 +466,15 @@ ASTNode* Parser::explainQueryStatement() {
   return stmt;
 }
 
+ASTNode* Parser::explainAnalyzeStatement() {
+  consumeToken();
+
+  auto stmt = new ASTNode(ASTNode::T_EXPLAIN_ANALYZE);
+  stmt->appendChild(selectStatement());
+  consumeIf(Token::T_SEMICOLON);
+  return stmt;
+}
+
 ASTNode* Parser::describeTableStatement() {
   auto stmt = new ASTNode(ASTNode::T_DESCRIBE_TABLE);
   stmt->appendChild(tableName());
@@ -1274,6 +1312,46 @@ ASTNode* Parser::likeExpr(ASTNode* lhs, int precedence) {
   return e;
 }
 
+ASTNode* Parser::inExpr(ASTNode* lhs, int precedence) {
+  if (precedence >= 6) {
+    return nullptr;
+  }
+
+  auto e = new ASTNode(ASTNode::T_IN_SUBQUERY_EXPR);
+  if (*cur_token_ == Token::T_NOT) {
+    e->setType(ASTNode::T_NOT_IN_SUBQUERY_EXPR);
+    consumeToken();
+  }
+
+  consumeToken();
+  e->appendChild(lhs);
+  e->appendChild(subqueryExpr());
+  return e;
+}
+
+ASTNode* Parser::existsExpr() {
+  consumeToken();
+
+  auto e = new ASTNode(ASTNode::T_EXISTS_EXPR);
+  e->appendChild(subqueryExpr());
+  return e;
+}
+
+ASTNode* Parser::subqueryExpr() {
+  expectAndConsume(Token::T_LPAREN);
+
+  if (!(*cur_token_ == Token::T_SELECT)) {
+    RAISE(
+        kParseError,
+        "IN and EXISTS are only supported with a subquery: expected "
+        "'(SELECT ...)'");
+  }
+
+  auto subquery = selectStatement();
+  expectAndConsume(Token::T_RPAREN);
+  return subquery;
+}
+
 bool Parser::assertExpectation(Token::kTokenType expectation) {
   if (!(*cur_token_ == expectation)) {
     RAISE(
@@ -96,6 +96,7 @@ protected:
   ASTNode* showStatement();
   ASTNode* explainStatement();
   ASTNode* explainQueryStatement();
+  ASTNode* explainAnalyzeStatement();
   ASTNode* describeTableStatement();
 
   ASTNode* fromClause();
@@ -129,6 +130,9 @@ protected:
 
   ASTNode* likeExpr(ASTNode* lhs, int precedence);
   ASTNode* regexExpr(ASTNode* lhs, int precedence);
+  ASTNode* inExpr(ASTNode* lhs, int precedence);
+  ASTNode* existsExpr();
+  ASTNode* subqueryExpr();
 
   bool assertExpectation(Token::kTokenType expectation);
 
@@ -92,6 +92,9 @@ const char* Token::getTypeName(kTokenType type) {
     case T_LTE: return "T_LTE";
     case T_GT: return "T_GT";
     case T_GTE: return "T_GTE";
+    case T_IN: return "T_IN";
+    case T_EXISTS: return "T_EXISTS";
+    case T_DISTINCT: return "T_DISTINCT";
     case T_BEGIN: return "T_BEGIN";
     case T_WITHIN: return "T_WITHIN";
     case T_RECORD: return "T_RECORD";
@@ -105,6 +108,7 @@ const char* Token::getTypeName(kTokenType type) {
     case T_SHOW: return "T_SHOW";
     case T_DESCRIBE: return "T_DESCRIBE";
     case T_EXPLAIN: return "T_EXPLAIN";
+    case T_ANALYZE: return "T_ANALYZE";
     case T_EOF: return "T_EOF";
     case T_DRAW: return "T_DRAW";
     case T_LINECHART: return "T_LINECHART";
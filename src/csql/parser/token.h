@@ -67,6 +67,9 @@ public:
     T_GTE,
     T_LIKE,
     T_REGEX,
+    T_IN,
+    T_EXISTS,
+    T_DISTINCT,
     T_BEGIN,
     T_CREATE,
     T_WITH,
@@ -77,6 +80,7 @@ public:
     T_SHOW,
     T_DESCRIBE,
     T_EXPLAIN,
+    T_ANALYZE,
 
     T_JOIN,
     T_CROSS,
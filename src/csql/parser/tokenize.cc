@@ -403,6 +403,21 @@ next:
     goto next;
   }
 
+  if (token == "IN") {
+    token_list->emplace_back(Token::T_IN);
+    goto next;
+  }
+
+  if (token == "EXISTS") {
+    token_list->emplace_back(Token::T_EXISTS);
+    goto next;
+  }
+
+  if (token == "DISTINCT") {
+    token_list->emplace_back(Token::T_DISTINCT);
+    goto next;
+  }
+
   if (token == "BEGIN") {
     token_list->emplace_back(Token::T_BEGIN);
     goto next;
@@ -543,6 +558,11 @@ next:
     goto next;
   }
 
+  if (token == "ANALYZE") {
+    token_list->emplace_back(Token::T_ANALYZE);
+    goto next;
+  }
+
   if (token == "JOIN") {
     token_list->emplace_back(Token::T_JOIN);
     goto next;
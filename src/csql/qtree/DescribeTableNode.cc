@@ -63,7 +63,7 @@ Vector<TaskID> DescribeTableNode::build(Transaction* txn, TaskDAG* tree) const {
   auto out_task = mkRef(
       new TaskDAGNode(
           new DescribeTableFactory(table_name_)));
-  output.emplace_back(tree->addTask(out_task));
+  output.emplace_back(tree->addTask(out_task, this));
   return output;
 }
 
@@ -0,0 +1,187 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <csql/qtree/ExplainAnalyzeNode.h>
+#include <csql/qtree/SequentialScanNode.h>
+#include <csql/qtree/JoinNode.h>
+#include <csql/qtree/GroupByNode.h>
+#include <csql/qtree/OrderByNode.h>
+#include <csql/qtree/LimitNode.h>
+#include <csql/qtree/SubqueryNode.h>
+#include <csql/qtree/SelectExpressionNode.h>
+#include <csql/qtree/UnionNode.h>
+#include <csql/tasks/explain_analyze.h>
+
+using namespace stx;
+
+namespace csql {
+
+static String operatorLabel(QueryTreeNode* node) {
+  if (auto scan = dynamic_cast<SequentialScanNode*>(node)) {
+    return "scan " + scan->tableName();
+  }
+
+  if (dynamic_cast<JoinNode*>(node)) {
+    return "join";
+  }
+
+  if (dynamic_cast<GroupByNode*>(node)) {
+    return "group by";
+  }
+
+  if (dynamic_cast<OrderByNode*>(node)) {
+    return "order by";
+  }
+
+  if (dynamic_cast<LimitNode*>(node)) {
+    return "limit";
+  }
+
+  if (dynamic_cast<SubqueryNode*>(node)) {
+    return "subquery";
+  }
+
+  if (dynamic_cast<SelectExpressionNode*>(node)) {
+    return "select";
+  }
+
+  if (dynamic_cast<UnionNode*>(node)) {
+    return "union";
+  }
+
+  return "operator";
+}
+
+static void collectOperators(
+    QueryTreeNode* node,
+    size_t depth,
+    const TaskDAG* tree,
+    Vector<ExplainAnalyzeOperator>* operators) {
+  ExplainAnalyzeOperator op;
+  op.label = String(depth * 2, ' ') + operatorLabel(node);
+  op.tasks = tree->getTasksForNode(node);
+
+  /* nodes without tasks of their own (e.g. unions) only forward their input */
+  if (op.tasks.empty()) {
+    for (size_t i = 0; i < node->numChildren(); ++i) {
+      collectOperators(node->child(i).get(), depth, tree, operators);
+    }
+
+    return;
+  }
+
+  Set<TaskID> own_tasks(op.tasks.begin(), op.tasks.end());
+  Set<TaskID> internal_inputs;
+  Set<TaskID> input_tasks;
+  for (const auto& task_id : op.tasks) {
+    for (const auto& input_id : tree->getInputTasksFor(task_id)) {
+      if (own_tasks.count(input_id) > 0) {
+        internal_inputs.emplace(input_id);
+      } else {
+        input_tasks.emplace(input_id);
+      }
+    }
+  }
+
+  /* e.g. the partial limits of a LimitNode are inputs of its final limit */
+  for (const auto& task_id : op.tasks) {
+    if (internal_inputs.count(task_id) == 0) {
+      op.output_tasks.emplace_back(task_id);
+    }
+  }
+
+  op.input_tasks.insert(
+      op.input_tasks.end(),
+      input_tasks.begin(),
+      input_tasks.end());
+  operators->emplace_back(op);
+
+  for (size_t i = 0; i < node->numChildren(); ++i) {
+    collectOperators(node->child(i).get(), depth + 1, tree, operators);
+  }
+}
+
+ExplainAnalyzeNode::ExplainAnalyzeNode(
+    RefPtr<QueryTreeNode> table) :
+    table_(table) {
+  addChild(&table_);
+}
+
+RefPtr<QueryTreeNode> ExplainAnalyzeNode::inputTable() const {
+  return table_;
+}
+
+Vector<String> ExplainAnalyzeNode::outputColumns() const {
+  return Vector<String> {
+    "operator",
+    "rows_in",
+    "rows_out",
+    "batches",
+    "wall_time_ms",
+    "cpu_time_ms",
+    "bytes_read",
+    "peak_memory",
+    "spill_bytes"
+  };
+}
+
+Vector<QualifiedColumn> ExplainAnalyzeNode::allColumns() const {
+  Vector<QualifiedColumn> cols;
+
+  for (const auto& c : outputColumns()) {
+    QualifiedColumn  qc;
+    qc.short_name = c;
+    qc.qualified_name = c;
+    cols.emplace_back(qc);
+  }
+
+  return cols;
+}
+
+size_t ExplainAnalyzeNode::getColumnIndex(
+    const String& column_name,
+    bool allow_add /* = false */) {
+  return -1;
+}
+
+Vector<TaskID> ExplainAnalyzeNode::build(
+    Transaction* txn,
+    TaskDAG* tree) const {
+  auto table = table_.asInstanceOf<TableExpressionNode>();
+  auto input = table->build(txn, tree);
+
+  Vector<ExplainAnalyzeOperator> operators;
+  collectOperators(table_.get(), 0, tree, &operators);
+
+  TaskIDList output;
+  auto out_task = mkRef(
+      new TaskDAGNode(
+          new ExplainAnalyzeFactory(
+              operators,
+              table->outputColumns().size())));
+
+  for (const auto& in_task_id : input) {
+    TaskDAGNode::Dependency dep;
+    dep.task_id = in_task_id;
+    out_task->addDependency(dep);
+  }
+
+  output.emplace_back(tree->addTask(out_task, this));
+  return output;
+}
+
+RefPtr<QueryTreeNode> ExplainAnalyzeNode::deepCopy() const {
+  return new ExplainAnalyzeNode(table_->deepCopy());
+}
+
+String ExplainAnalyzeNode::toString() const {
+  return StringUtil::format("(explain-analyze (subexpr $0))", table_->toString());
+}
+
+} // namespace csql
@@ -0,0 +1,48 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <csql/qtree/TableExpressionNode.h>
+
+using namespace stx;
+
+namespace csql {
+
+/**
+ * Executes the query and returns the execution stats of each of its operators
+ * instead of its rows (EXPLAIN ANALYZE). The operators are returned in the
+ * order of the query tree with the label indented by their depth
+ */
+class ExplainAnalyzeNode : public TableExpressionNode {
+public:
+
+  ExplainAnalyzeNode(RefPtr<QueryTreeNode> table);
+
+  RefPtr<QueryTreeNode> inputTable() const;
+
+  Vector<String> outputColumns() const override;
+
+  Vector<QualifiedColumn> allColumns() const override;
+
+  RefPtr<QueryTreeNode> deepCopy() const override;
+
+  String toString() const override;
+
+  size_t getColumnIndex(
+      const String& column_name,
+      bool allow_add = false) override;
+
+  Vector<TaskID> build(Transaction* txn, TaskDAG* tree) const override;
+
+protected:
+  RefPtr<QueryTreeNode> table_;
+};
+
+} // namespace csql
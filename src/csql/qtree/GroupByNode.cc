@@ -85,16 +85,17 @@ size_t GroupByNode::getColumnIndex(
 
 Vector<TaskID> GroupByNode::build(Transaction* txn, TaskDAG* tree) const {
   auto input = table_.asInstanceOf<TableExpressionNode>()->build(txn, tree);
+  auto ncols = table_.asInstanceOf<TableExpressionNode>()->numColumns();
 
   TaskIDList output;
   auto out_task = mkRef(new TaskDAGNode(
-      new GroupByFactory(selectList(), groupExpressions())));
+      new GroupByFactory(ncols, selectList(), groupExpressions())));
   for (const auto& in_task_id : input) {
     TaskDAGNode::Dependency dep;
     dep.task_id = in_task_id;
     out_task->addDependency(dep);
   }
-  output.emplace_back(tree->addTask(out_task));
+  output.emplace_back(tree->addTask(out_task, this));
 
   return output;
 }
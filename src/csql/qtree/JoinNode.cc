@@ -7,10 +7,17 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
+#include <stx/random.h>
 #include <csql/qtree/JoinNode.h>
 #include <csql/qtree/ColumnReferenceNode.h>
+#include <csql/qtree/CallExpressionNode.h>
 #include <csql/qtree/QueryTreeUtil.h>
+#include <csql/qtree/SequentialScanNode.h>
 #include <csql/tasks/nested_loop_join.h>
+#include <csql/tasks/hash_join.h>
+#include <csql/tasks/merge_join.h>
+#include <csql/tasks/hash_semi_join.h>
 
 using namespace stx;
 
@@ -62,6 +69,17 @@ JoinType JoinNode::joinType() const {
   return join_type_;
 }
 
+bool JoinNode::isSemiJoin() const {
+  switch (join_type_) {
+    case JoinType::SEMI:
+    case JoinType::ANTI:
+    case JoinType::NULL_AWARE_ANTI:
+      return true;
+    default:
+      return false;
+  }
+}
+
 RefPtr<QueryTreeNode> JoinNode::baseTable() const {
   return base_table_;
 }
@@ -86,6 +104,10 @@ Vector<QualifiedColumn> JoinNode::allColumns() const {
     cols.emplace_back(c);
   }
 
+  if (isSemiJoin()) {
+    return cols;
+  }
+
   for (const auto& c :
       joined_table_.asInstanceOf<TableExpressionNode>()->allColumns()) {
     cols.emplace_back(c);
@@ -104,7 +126,8 @@ size_t JoinNode::getColumnIndex(
   }
 
   auto input_idx = getInputColumnIndex(column_name);
-  if (input_idx != size_t(-1)) {
+  if (input_idx != size_t(-1) &&
+      (!isSemiJoin() || input_map_[input_idx].table_idx == 0)) {
     auto slnode = new SelectListNode(new ColumnReferenceNode(input_idx));
     slnode->setAlias(column_name);
     select_list_.emplace_back(slnode);
@@ -127,9 +150,14 @@ size_t JoinNode::getInputColumnIndex(
       .asInstanceOf<TableExpressionNode>()
       ->getColumnIndex(column_name, allow_add);
 
-  auto joined_table_idx = joined_table_
-      .asInstanceOf<TableExpressionNode>()
-      ->getColumnIndex(column_name, allow_add);
+  /* the base table is the outer scope of semi join conditions; all inner
+     columns are qualified with the joined table's alias */
+  size_t joined_table_idx = -1;
+  if (!isSemiJoin() || base_table_idx == size_t(-1)) {
+    joined_table_idx = joined_table_
+        .asInstanceOf<TableExpressionNode>()
+        ->getColumnIndex(column_name, allow_add);
+  }
 
   if (base_table_idx != size_t(-1) && joined_table_idx != size_t(-1)) {
     RAISEF(
@@ -169,6 +197,293 @@ Option<RefPtr<ValueExpressionNode>> JoinNode::joinCondition() const {
   return join_cond_;
 }
 
+static void splitConjunction(
+    RefPtr<ValueExpressionNode> expr,
+    Vector<RefPtr<ValueExpressionNode>>* conjuncts) {
+  auto call_expr = dynamic_cast<CallExpressionNode*>(expr.get());
+  if (call_expr && call_expr->symbol() == "logical_and") {
+    for (const auto& arg : call_expr->arguments()) {
+      splitConjunction(arg, conjuncts);
+    }
+  } else {
+    conjuncts->emplace_back(expr);
+  }
+}
+
+Vector<JoinNode::EquiJoinKey> JoinNode::equiJoinKeys(
+    Option<RefPtr<ValueExpressionNode>>* residual_cond) const {
+  Vector<EquiJoinKey> keys;
+  *residual_cond = None<RefPtr<ValueExpressionNode>>();
+  if (join_cond_.isEmpty()) {
+    return keys;
+  }
+
+  Vector<RefPtr<ValueExpressionNode>> conjuncts;
+  splitConjunction(join_cond_.get(), &conjuncts);
+
+  RefPtr<ValueExpressionNode> residual;
+  for (const auto& conj : conjuncts) {
+    auto call_expr = dynamic_cast<CallExpressionNode*>(conj.get());
+    if (call_expr &&
+        call_expr->symbol() == "eq" &&
+        call_expr->arguments().size() == 2) {
+      auto args = call_expr->arguments();
+      auto ltbl = findTableIndex(args[0]);
+      auto rtbl = findTableIndex(args[1]);
+
+      if (ltbl == 0 && rtbl == 1) {
+        keys.emplace_back(EquiJoinKey { args[0], args[1] });
+        continue;
+      }
+
+      if (ltbl == 1 && rtbl == 0) {
+        keys.emplace_back(EquiJoinKey { args[1], args[0] });
+        continue;
+      }
+    }
+
+    if (residual.get() == nullptr) {
+      residual = conj;
+    } else {
+      residual = mkRef<ValueExpressionNode>(
+          new CallExpressionNode(
+              "logical_and",
+              Vector<RefPtr<ValueExpressionNode>>{ residual, conj }));
+    }
+  }
+
+  if (residual.get() != nullptr) {
+    *residual_cond = Some(residual);
+  }
+
+  return keys;
+}
+
+Option<JoinNode::RangeJoinBounds> JoinNode::rangeJoinBounds() const {
+  if (join_cond_.isEmpty()) {
+    return None<RangeJoinBounds>();
+  }
+
+  Vector<RefPtr<ValueExpressionNode>> conjuncts;
+  splitConjunction(join_cond_.get(), &conjuncts);
+
+  Vector<RangeJoinBounds> candidates;
+  for (const auto& conj : conjuncts) {
+    auto call_expr = dynamic_cast<CallExpressionNode*>(conj.get());
+    if (!call_expr || call_expr->arguments().size() != 2) {
+      continue;
+    }
+
+    bool is_less;
+    const auto& symbol = call_expr->symbol();
+    if (symbol == "lt" || symbol == "lte") {
+      is_less = true;
+    } else if (symbol == "gt" || symbol == "gte") {
+      is_less = false;
+    } else {
+      continue;
+    }
+
+    auto args = call_expr->arguments();
+    for (size_t arg = 0; arg < 2; ++arg) {
+      for (size_t table_idx = 0; table_idx < 2; ++table_idx) {
+        auto column_idx = findInputColumnIndex(args[arg], table_idx);
+        if (column_idx == size_t(-1) ||
+            findTableIndex(args[1 - arg]) != 1 - table_idx) {
+          continue;
+        }
+
+        auto candidate = std::find_if(
+            candidates.begin(),
+            candidates.end(),
+            [table_idx, column_idx] (const RangeJoinBounds& c) {
+          return c.table_idx == table_idx && c.column_idx == column_idx;
+        });
+
+        if (candidate == candidates.end()) {
+          candidates.emplace_back(RangeJoinBounds {
+            .table_idx = table_idx,
+            .column_idx = column_idx
+          });
+
+          candidate = candidates.end() - 1;
+        }
+
+        /* "column < expr" is an upper bound, "expr < column" a lower bound */
+        if (is_less == (arg == 0)) {
+          candidate->upper_bounds.emplace_back(args[1 - arg]);
+        } else {
+          candidate->lower_bounds.emplace_back(args[1 - arg]);
+        }
+      }
+    }
+  }
+
+  /* prefer columns with both bounds, then the joined table */
+  auto score = [] (const RangeJoinBounds& c) -> size_t {
+    return
+        (c.lower_bounds.empty() ? 0 : 2) +
+        (c.upper_bounds.empty() ? 0 : 2) +
+        c.table_idx;
+  };
+
+  Option<RangeJoinBounds> best;
+  for (const auto& c : candidates) {
+    if (best.isEmpty() || score(c) > score(best.get())) {
+      best = Some(c);
+    }
+  }
+
+  return best;
+}
+
+size_t JoinNode::findTableIndex(RefPtr<ValueExpressionNode> expr) const {
+  size_t table_idx = -1;
+  bool mixed = false;
+
+  QueryTreeUtil::findColumns(
+      expr,
+      [this, &table_idx, &mixed] (const RefPtr<ColumnReferenceNode>& col) {
+    if (!col->hasColumnIndex() || col->columnIndex() >= input_map_.size()) {
+      mixed = true;
+      return;
+    }
+
+    auto col_tbl = input_map_[col->columnIndex()].table_idx;
+    if (table_idx != size_t(-1) && table_idx != col_tbl) {
+      mixed = true;
+    }
+
+    table_idx = col_tbl;
+  });
+
+  return mixed ? size_t(-1) : table_idx;
+}
+
+size_t JoinNode::findInputColumnIndex(
+    RefPtr<ValueExpressionNode> expr,
+    size_t table_idx) const {
+  auto colref = dynamic_cast<ColumnReferenceNode*>(expr.get());
+  if (!colref ||
+      !colref->hasColumnIndex() ||
+      colref->columnIndex() >= input_map_.size()) {
+    return -1;
+  }
+
+  const auto& input_col = input_map_[colref->columnIndex()];
+  if (input_col.table_idx != table_idx) {
+    return -1;
+  }
+
+  return input_col.column_idx;
+}
+
+bool JoinNode::orderJoinKeys(Vector<EquiJoinKey>* keys) const {
+  auto base_order =
+      base_table_.asInstanceOf<TableExpressionNode>()->sortOrder();
+  auto joined_order =
+      joined_table_.asInstanceOf<TableExpressionNode>()->sortOrder();
+
+  if (base_order.size() < keys->size() || joined_order.size() < keys->size()) {
+    return false;
+  }
+
+  /* the i-th key must join the i-th sort column of both tables */
+  Vector<EquiJoinKey> ordered;
+  Set<size_t> used;
+  for (size_t i = 0; i < keys->size(); ++i) {
+    size_t found = -1;
+    for (size_t j = 0; j < keys->size(); ++j) {
+      const auto& key = (*keys)[j];
+      if (used.count(j) == 0 &&
+          findInputColumnIndex(key.base_key, 0) == base_order[i] &&
+          findInputColumnIndex(key.joined_key, 1) == joined_order[i]) {
+        found = j;
+        break;
+      }
+    }
+
+    if (found == size_t(-1)) {
+      return false;
+    }
+
+    used.emplace(found);
+    ordered.emplace_back((*keys)[found]);
+  }
+
+  *keys = ordered;
+  return true;
+}
+
+static String joinKeyTypeClass(const String& type) {
+  if (type == "int64" || type == "uint64") {
+    return "integer";
+  }
+
+  return type;
+}
+
+bool JoinNode::joinKeyTypesMatch(const Vector<EquiJoinKey>& keys) const {
+  auto base_table = base_table_.asInstanceOf<TableExpressionNode>();
+  auto joined_table = joined_table_.asInstanceOf<TableExpressionNode>();
+
+  for (const auto& key : keys) {
+    auto base_idx = findInputColumnIndex(key.base_key, 0);
+    auto joined_idx = findInputColumnIndex(key.joined_key, 1);
+    if (base_idx == size_t(-1) || joined_idx == size_t(-1)) {
+      return false;
+    }
+
+    auto base_type = joinKeyTypeClass(base_table->columnType(base_idx));
+    auto joined_type = joinKeyTypeClass(joined_table->columnType(joined_idx));
+    if (base_type.empty() || base_type != joined_type) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+Option<SHA1Hash> JoinNode::attachRuntimeFilter(
+    size_t table_idx,
+    const Vector<EquiJoinKey>& keys,
+    const Vector<TaskID>& table_tasks,
+    TaskDAG* tree) const {
+  auto table = table_idx == 0 ? base_table_ : joined_table_;
+  auto scan = dynamic_cast<SequentialScanNode*>(table.get());
+  if (!scan ||
+      scan->aggregationStrategy() != AggregationStrategy::NO_AGGREGATION ||
+      table_tasks.size() != 1) {
+    return None<SHA1Hash>();
+  }
+
+  Vector<size_t> key_columns;
+  for (const auto& key : keys) {
+    auto col_idx = findInputColumnIndex(
+        table_idx == 0 ? key.base_key : key.joined_key,
+        table_idx);
+
+    if (col_idx == size_t(-1)) {
+      return None<SHA1Hash>();
+    }
+
+    key_columns.emplace_back(col_idx);
+  }
+
+  /* the plan only stores the filter id, each execution of the plan creates
+     its own filter (see Transaction::getRuntimeFilter) */
+  RuntimeFilterSpec spec;
+  spec.filter_id = Random::singleton()->sha1();
+  spec.key_columns = key_columns;
+
+  auto factory = tree->getTask(table_tasks[0])->getFactory();
+  if (!factory->setRuntimeFilter(spec)) {
+    return None<SHA1Hash>();
+  }
+
+  return Some(spec.filter_id);
+}
+
 Vector<TaskID> JoinNode::build(Transaction* txn, TaskDAG* tree) const {
   auto base_table_tasks =
       base_table_.asInstanceOf<TableExpressionNode>()->build(txn, tree);
@@ -187,15 +502,102 @@ Vector<TaskID> JoinNode::build(Transaction* txn, TaskDAG* tree) const {
     joined_table_tasks_idset.emplace(task_id);
   }
 
-  auto out_task = mkRef(new TaskDAGNode(
-      new NestedLoopJoinFactory(
+  /* use a merge join if both inputs are already sorted on join keys of the
+     same type and a hash join if the join condition has any other equality
+     conjuncts */
+  RefPtr<TaskFactory> join_factory;
+  if (isSemiJoin()) {
+    Option<RefPtr<ValueExpressionNode>> residual_cond;
+    auto join_keys = equiJoinKeys(&residual_cond);
+    auto semi_join = mkRef(new HashSemiJoinFactory(
+        join_type_,
+        base_table_tasks_idset,
+        joined_table_tasks_idset,
+        input_map_,
+        selectList(),
+        join_keys,
+        residual_cond,
+        whereExpression()));
+
+    /* rows of the base table without a match never qualify for SEMI joins */
+    if (join_type_ == JoinType::SEMI && !join_keys.empty()) {
+      auto filter_id = attachRuntimeFilter(
+          0,
+          join_keys,
+          base_table_tasks,
+          tree);
+
+      if (!filter_id.isEmpty()) {
+        semi_join->setRuntimeFilter(filter_id.get());
+      }
+    }
+
+    join_factory = semi_join.asInstanceOf<TaskFactory>();
+  } else if (join_type_ != JoinType::CARTESIAN) {
+    Option<RefPtr<ValueExpressionNode>> residual_cond;
+    auto join_keys = equiJoinKeys(&residual_cond);
+    if (!join_keys.empty() &&
+        base_table_tasks.size() == 1 &&
+        joined_table_tasks.size() == 1 &&
+        orderJoinKeys(&join_keys) &&
+        joinKeyTypesMatch(join_keys)) {
+      join_factory = new MergeJoinFactory(
           join_type_,
           base_table_tasks_idset,
           joined_table_tasks_idset,
           input_map_,
           selectList(),
-          joinCondition(),
-          whereExpression())));
+          join_keys,
+          residual_cond,
+          whereExpression());
+    } else if (!join_keys.empty()) {
+      auto hash_join = mkRef(new HashJoinFactory(
+          join_type_,
+          base_table_tasks_idset,
+          joined_table_tasks_idset,
+          input_map_,
+          selectList(),
+          join_keys,
+          residual_cond,
+          whereExpression()));
+
+      for (size_t table_idx = 0; table_idx < 2; ++table_idx) {
+        auto filter_id = attachRuntimeFilter(
+            table_idx,
+            join_keys,
+            table_idx == 0 ? base_table_tasks : joined_table_tasks,
+            tree);
+
+        if (!filter_id.isEmpty()) {
+          hash_join->setRuntimeFilter(table_idx, filter_id.get());
+        }
+      }
+
+      join_factory = hash_join.asInstanceOf<TaskFactory>();
+    }
+  }
+
+  /* otherwise use a block nested loop join, with a range index on the inner
+     table if the join condition has any range conjuncts */
+  if (join_factory.get() == nullptr) {
+    auto nested_loop_join = mkRef(new NestedLoopJoinFactory(
+        join_type_,
+        base_table_tasks_idset,
+        joined_table_tasks_idset,
+        input_map_,
+        selectList(),
+        joinCondition(),
+        whereExpression()));
+
+    auto range_bounds = rangeJoinBounds();
+    if (!range_bounds.isEmpty()) {
+      nested_loop_join->setRangeIndex(range_bounds.get());
+    }
+
+    join_factory = nested_loop_join.asInstanceOf<TaskFactory>();
+  }
+
+  auto out_task = mkRef(new TaskDAGNode(join_factory));
 
   for (const auto& in_task_id : input_tasks_idset) {
     TaskDAGNode::Dependency dep;
@@ -204,7 +606,7 @@ Vector<TaskID> JoinNode::build(Transaction* txn, TaskDAG* tree) const {
   }
 
   TaskIDList output;
-  output.emplace_back(tree->addTask(out_task));
+  output.emplace_back(tree->addTask(out_task, this));
   return output;
 }
 
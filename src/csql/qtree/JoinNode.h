@@ -14,13 +14,19 @@
 #include <csql/qtree/TableExpressionNode.h>
 #include <csql/qtree/ValueExpressionNode.h>
 #include <csql/qtree/SelectListNode.h>
+#include <csql/runtime/RuntimeFilter.h>
 
 using namespace stx;
 
 namespace csql {
 
+/**
+ * SEMI, ANTI and NULL_AWARE_ANTI joins only output base table rows (IN,
+ * EXISTS, NOT EXISTS and NOT IN subqueries). The columns of the joined table
+ * can only be referenced from the join condition
+ */
 enum class JoinType {
-  CARTESIAN, INNER, OUTER
+  CARTESIAN, INNER, OUTER, SEMI, ANTI, NULL_AWARE_ANTI
 };
 
 class JoinNode : public TableExpressionNode {
@@ -32,6 +38,18 @@ public:
     size_t column_idx;
   };
 
+  struct EquiJoinKey {
+    RefPtr<ValueExpressionNode> base_key;
+    RefPtr<ValueExpressionNode> joined_key;
+  };
+
+  struct RangeJoinBounds {
+    size_t table_idx;
+    size_t column_idx;
+    Vector<RefPtr<ValueExpressionNode>> lower_bounds;
+    Vector<RefPtr<ValueExpressionNode>> upper_bounds;
+  };
+
   JoinNode(
       JoinType join_type,
       RefPtr<QueryTreeNode> base_table,
@@ -44,6 +62,11 @@ public:
 
   JoinType joinType() const;
 
+  /**
+   * Returns true for SEMI, ANTI and NULL_AWARE_ANTI joins
+   */
+  bool isSemiJoin() const;
+
   RefPtr<QueryTreeNode> baseTable() const;
   RefPtr<QueryTreeNode> joinedTable() const;
 
@@ -66,6 +89,22 @@ public:
   Option<RefPtr<ValueExpressionNode>> whereExpression() const;
   Option<RefPtr<ValueExpressionNode>> joinCondition() const;
 
+  /**
+   * Splits the join condition into conjuncts of the form
+   * "<base table expr> = <joined table expr>" and the remaining residual
+   * condition. Returns an empty list if there are no such conjuncts
+   */
+  Vector<EquiJoinKey> equiJoinKeys(
+      Option<RefPtr<ValueExpressionNode>>* residual_cond) const;
+
+  /**
+   * Finds conjuncts of the join condition of the form "<column> <op> <expr>"
+   * where op is one of <, <=, > or >=, column is a plain column of one table
+   * and expr only references columns of the other table. Returns the bounds
+   * of the column with the most selective set of bounds, if any
+   */
+  Option<RangeJoinBounds> rangeJoinBounds() const;
+
   RefPtr<QueryTreeNode> deepCopy() const override;
 
   String toString() const override;
@@ -74,6 +113,48 @@ public:
 
 protected:
 
+  /**
+   * Returns the index of the table that all columns referenced by expr belong
+   * to or -1 if expr references no columns or columns from both tables
+   */
+  size_t findTableIndex(RefPtr<ValueExpressionNode> expr) const;
+
+  /**
+   * Reorders the join keys to match the sort order of both input tables.
+   * Returns false if the inputs are not both sorted on the join keys
+   */
+  bool orderJoinKeys(Vector<EquiJoinKey>* keys) const;
+
+  /**
+   * Returns true if the key columns of both tables have the same declared
+   * type class (see TableExpressionNode::columnType), so that comparing the
+   * keys in sort order gives the same result as the = operator. A string
+   * key never sorts next to an equal numeric key, so tables joined on keys
+   * of different or unknown types are never merge joined
+   */
+  bool joinKeyTypesMatch(const Vector<EquiJoinKey>& keys) const;
+
+  /**
+   * Returns the column index in the base (table_idx = 0) or joined
+   * (table_idx = 1) table if expr is a plain column reference into that table
+   * or -1 otherwise
+   */
+  size_t findInputColumnIndex(
+      RefPtr<ValueExpressionNode> expr,
+      size_t table_idx) const;
+
+  /**
+   * Attaches a runtime filter on the join keys to the scan task of the base
+   * (table_idx = 0) or joined (table_idx = 1) table if it is a plain
+   * sequential scan (see TaskFactory::setRuntimeFilter). The query tree is
+   * not modified. Returns the filter id or None if the table can't be
+   * filtered
+   */
+  Option<SHA1Hash> attachRuntimeFilter(
+      size_t table_idx,
+      const Vector<EquiJoinKey>& keys,
+      const Vector<TaskID>& table_tasks,
+      TaskDAG* tree) const;
 
   JoinType join_type_;
   RefPtr<QueryTreeNode> base_table_;
@@ -8,7 +8,9 @@
  * <http://www.gnu.org/licenses/>.
  */
 #include <csql/qtree/LimitNode.h>
+#include <csql/qtree/OrderByNode.h>
 #include <csql/tasks/limit.h>
+#include <csql/tasks/topn.h>
 
 using namespace stx;
 
@@ -45,6 +47,11 @@ size_t LimitNode::getColumnIndex(
 }
 
 Vector<TaskID> LimitNode::build(Transaction* txn, TaskDAG* tree) const {
+  auto order_by = dynamic_cast<OrderByNode*>(table_.get());
+  if (order_by) {
+    return buildTopN(txn, tree, order_by);
+  }
+
   auto input = table_.asInstanceOf<TableExpressionNode>()->build(txn, tree);
 
   TaskIDList output;
@@ -54,7 +61,52 @@ Vector<TaskID> LimitNode::build(Transaction* txn, TaskDAG* tree) const {
     dep.task_id = in_task_id;
     out_task->addDependency(dep);
   }
-  output.emplace_back(tree->addTask(out_task));
+  output.emplace_back(tree->addTask(out_task, this));
+
+  return output;
+}
+
+Vector<TaskID> LimitNode::buildTopN(
+    Transaction* txn,
+    TaskDAG* tree,
+    OrderByNode* order_by) const {
+  auto input_tbl = order_by->inputTable().asInstanceOf<TableExpressionNode>();
+  auto input = input_tbl->build(txn, tree);
+  auto ncols = input_tbl->outputColumns().size();
+
+  Vector<TopNFactory::SortExpr> sort_exprs;
+  for (const auto& ss : order_by->sortSpecs()) {
+    TopNFactory::SortExpr se;
+    se.descending = ss.descending;
+    se.expr = ss.expr;
+    sort_exprs.emplace_back(std::move(se));
+  }
+
+  /* compute a partial top (limit + offset) for each input and merge them */
+  if (input.size() > 1) {
+    TaskIDList partials;
+    for (const auto& in_task_id : input) {
+      auto partial_task = mkRef(new TaskDAGNode(
+          new TopNFactory(sort_exprs, limit_ + offset_, 0, ncols)));
+
+      TaskDAGNode::Dependency dep;
+      dep.task_id = in_task_id;
+      partial_task->addDependency(dep);
+      partials.emplace_back(tree->addTask(partial_task, this));
+    }
+
+    input = partials;
+  }
+
+  TaskIDList output;
+  auto out_task = mkRef(new TaskDAGNode(
+      new TopNFactory(sort_exprs, limit_, offset_, ncols)));
+  for (const auto& in_task_id : input) {
+    TaskDAGNode::Dependency dep;
+    dep.task_id = in_task_id;
+    out_task->addDependency(dep);
+  }
+  output.emplace_back(tree->addTask(out_task, this));
 
   return output;
 }
@@ -66,6 +118,14 @@ RefPtr<QueryTreeNode> LimitNode::deepCopy() const {
       table_->deepCopy().asInstanceOf<QueryTreeNode>());
 }
 
+Vector<size_t> LimitNode::sortOrder() const {
+  return table_.asInstanceOf<TableExpressionNode>()->sortOrder();
+}
+
+String LimitNode::columnType(size_t column_idx) const {
+  return table_.asInstanceOf<TableExpressionNode>()->columnType(column_idx);
+}
+
 size_t LimitNode::limit() const {
   return limit_;
 }
@@ -14,6 +14,7 @@
 using namespace stx;
 
 namespace csql {
+class OrderByNode;
 
 class LimitNode : public TableExpressionNode {
 public:
@@ -37,6 +38,10 @@ public:
 
   size_t offset() const;
 
+  Vector<size_t> sortOrder() const override;
+
+  String columnType(size_t column_idx) const override;
+
   RefPtr<QueryTreeNode> deepCopy() const override;
 
   String toString() const override;
@@ -44,6 +49,16 @@ public:
   Vector<TaskID> build(Transaction* txn, TaskDAG* tree) const override;
 
 protected:
+
+  /**
+   * LIMIT directly on top of ORDER BY is executed as a single TopN task that
+   * only retains the best (limit + offset) rows instead of sorting all rows
+   */
+  Vector<TaskID> buildTopN(
+      Transaction* txn,
+      TaskDAG* tree,
+      OrderByNode* order_by) const;
+
   size_t limit_;
   size_t offset_;
   RefPtr<QueryTreeNode> table_;
@@ -8,6 +8,7 @@
  * <http://www.gnu.org/licenses/>.
  */
 #include <csql/qtree/OrderByNode.h>
+#include <csql/qtree/ColumnReferenceNode.h>
 #include <csql/tasks/orderby.h>
 
 using namespace stx;
@@ -61,7 +62,7 @@ TaskIDList OrderByNode::build(Transaction* txn, TaskDAG* tree) const {
     dep.task_id = in_task_id;
     out_task->addDependency(dep);
   }
-  output.emplace_back(tree->addTask(out_task));
+  output.emplace_back(tree->addTask(out_task, this));
 
   return output;
 }
@@ -70,6 +71,24 @@ const Vector<OrderByNode::SortSpec>& OrderByNode::sortSpecs() const {
   return sort_specs_;
 }
 
+Vector<size_t> OrderByNode::sortOrder() const {
+  Vector<size_t> order;
+  for (const auto& spec : sort_specs_) {
+    auto colref = dynamic_cast<ColumnReferenceNode*>(spec.expr.get());
+    if (spec.descending || !colref || !colref->hasColumnIndex()) {
+      break;
+    }
+
+    order.emplace_back(colref->columnIndex());
+  }
+
+  return order;
+}
+
+String OrderByNode::columnType(size_t column_idx) const {
+  return table_.asInstanceOf<TableExpressionNode>()->columnType(column_idx);
+}
+
 RefPtr<QueryTreeNode> OrderByNode::deepCopy() const {
   return new OrderByNode(
       sort_specs_,
@@ -36,6 +36,10 @@ public:
 
   const Vector<SortSpec>& sortSpecs() const;
 
+  Vector<size_t> sortOrder() const override;
+
+  String columnType(size_t column_idx) const override;
+
   RefPtr<QueryTreeNode> deepCopy() const override;
 
   String toString() const override;
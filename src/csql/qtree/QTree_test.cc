@@ -18,6 +18,7 @@
 #include "csql/qtree/CallExpressionNode.h"
 #include "csql/qtree/LiteralExpressionNode.h"
 #include "csql/qtree/QueryTreeUtil.h"
+#include "csql/qtree/LimitNode.h"
 #include "csql/CSTableScanProvider.h"
 
 using namespace stx;
@@ -415,3 +416,52 @@ TEST_CASE(QTreeTest, TestPruneConstraints, [] () {
 });
 
 
+
+TEST_CASE(QTreeTest, TestFoldLimitIntoSequentialScan, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto txn = runtime->newTransaction();
+
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new CSTableScanProvider(
+          "testtable",
+          "src/csql/testdata/testtbl.cst"));
+
+  auto qtree_builder = runtime->queryPlanBuilder();
+
+  {
+    String query = "select time from testtable where time > 1234 limit 10 offset 5;";
+    csql::Parser parser;
+    parser.parse(query.data(), query.size());
+
+    auto qtrees = qtree_builder->build(
+        txn.get(),
+        parser.getStatements(),
+        estrat->tableProvider());
+
+    EXPECT_EQ(qtrees.size(), 1);
+    auto limit = dynamic_cast<LimitNode*>(qtrees[0].get());
+    EXPECT_TRUE(limit != nullptr);
+    auto seqscan = dynamic_cast<SequentialScanNode*>(limit->inputTable().get());
+    EXPECT_TRUE(seqscan != nullptr);
+    EXPECT_EQ(seqscan->limit().isEmpty(), false);
+    EXPECT_EQ(seqscan->limit().get(), 15);
+  }
+
+  {
+    String query = "select time from testtable order by time limit 10;";
+    csql::Parser parser;
+    parser.parse(query.data(), query.size());
+
+    auto qtrees = qtree_builder->build(
+        txn.get(),
+        parser.getStatements(),
+        estrat->tableProvider());
+
+    EXPECT_EQ(qtrees.size(), 1);
+    auto limit = dynamic_cast<LimitNode*>(qtrees[0].get());
+    EXPECT_TRUE(limit != nullptr);
+    EXPECT_TRUE(
+        dynamic_cast<SequentialScanNode*>(limit->inputTable().get()) == nullptr);
+  }
+});
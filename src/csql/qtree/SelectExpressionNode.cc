@@ -60,7 +60,7 @@ size_t SelectExpressionNode::getColumnIndex(
 Vector<TaskID> SelectExpressionNode::build(Transaction* txn, TaskDAG* tree) const {
   TaskIDList output;
   auto out_task = mkRef(new TaskDAGNode(new SelectFactory(selectList())));
-  output.emplace_back(tree->addTask(out_task));
+  output.emplace_back(tree->addTask(out_task, this));
   return output;
 }
 
@@ -48,11 +48,13 @@ SequentialScanNode::SequentialScanNode(
     AggregationStrategy aggr_strategy) :
     table_name_(table_info.table_name),
     table_provider_(table_provider),
+    sort_columns_(table_info.sort_columns),
     select_list_(select_list),
     where_expr_(where_expr),
     aggr_strategy_(aggr_strategy) {
   for (const auto& col : table_info.columns) {
     table_columns_.emplace_back(col.column_name);
+    table_column_types_.emplace(col.column_name, col.type);
   }
 
   if (!where_expr_.isEmpty()) {
@@ -63,9 +65,12 @@ SequentialScanNode::SequentialScanNode(
 SequentialScanNode::SequentialScanNode(
     const SequentialScanNode& other) :
     table_name_(other.table_name_),
+    table_column_types_(other.table_column_types_),
+    sort_columns_(other.sort_columns_),
     output_columns_(other.output_columns_),
     aggr_strategy_(other.aggr_strategy_),
-    constraints_(other.constraints_) {
+    constraints_(other.constraints_),
+    limit_(other.limit_) {
   for (const auto& e : other.select_list_) {
     select_list_.emplace_back(e->deepCopyAs<SelectListNode>());
   }
@@ -167,6 +172,65 @@ void SequentialScanNode::normalizeColumnNames() {
   }
 }
 
+Vector<size_t> SequentialScanNode::sortOrder() const {
+  Vector<size_t> order;
+  if (aggr_strategy_ != AggregationStrategy::NO_AGGREGATION) {
+    return order;
+  }
+
+  /* the longest prefix of the table's sort columns that is selected as-is */
+  for (const auto& sort_col : sort_columns_) {
+    auto col = normalizeColumnName(sort_col);
+    size_t idx = -1;
+    for (size_t i = 0; i < select_list_.size(); ++i) {
+      auto colref = dynamic_cast<ColumnReferenceNode*>(
+          select_list_[i]->expression().get());
+
+      if (colref && normalizeColumnName(colref->columnName()) == col) {
+        idx = i;
+        break;
+      }
+    }
+
+    if (idx == size_t(-1)) {
+      break;
+    }
+
+    order.emplace_back(idx);
+  }
+
+  return order;
+}
+
+String SequentialScanNode::columnType(size_t column_idx) const {
+  if (aggr_strategy_ != AggregationStrategy::NO_AGGREGATION ||
+      column_idx >= select_list_.size()) {
+    return String();
+  }
+
+  auto colref = dynamic_cast<ColumnReferenceNode*>(
+      select_list_[column_idx]->expression().get());
+  if (!colref) {
+    return String();
+  }
+
+  auto type = table_column_types_.find(
+      normalizeColumnName(colref->columnName()));
+  if (type == table_column_types_.end()) {
+    return String();
+  }
+
+  return type->second;
+}
+
+void SequentialScanNode::setLimit(size_t limit) {
+  limit_ = Some(limit);
+}
+
+Option<size_t> SequentialScanNode::limit() const {
+  return limit_;
+}
+
 String SequentialScanNode::normalizeColumnName(const String& column_name) const {
   if (!table_name_.empty() &&
       StringUtil::beginsWith(column_name, table_name_ + ".")) {
@@ -273,6 +337,10 @@ String SequentialScanNode::toString() const {
     str += StringUtil::format(" (where $0)", where_expr_.get()->toString());
   }
 
+  if (!limit_.isEmpty()) {
+    str += StringUtil::format(" (limit $0)", limit_.get());
+  }
+
   str += ")";
   return str;
 }
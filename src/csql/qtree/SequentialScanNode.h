@@ -127,6 +127,17 @@ public:
   AggregationStrategy aggregationStrategy() const;
   void setAggregationStrategy(AggregationStrategy strategy);
 
+  Vector<size_t> sortOrder() const override;
+
+  String columnType(size_t column_idx) const override;
+
+  /**
+   * Limit the number of rows emitted by the scan. The limit is applied after
+   * the WHERE expression and is only honored if the scan doesn't aggregate
+   */
+  void setLimit(size_t limit);
+  Option<size_t> limit() const;
+
   RefPtr<QueryTreeNode> deepCopy() const override;
 
   String toString() const override;
@@ -142,12 +153,15 @@ protected:
   String table_name_;
   String table_alias_;
   Vector<String> table_columns_;
+  HashMap<String, String> table_column_types_;
+  Vector<String> sort_columns_;
   RefPtr<TableProvider> table_provider_;
   Vector<RefPtr<SelectListNode>> select_list_;
   Vector<String> output_columns_;
   Option<RefPtr<ValueExpressionNode>> where_expr_;
   AggregationStrategy aggr_strategy_;
   Vector<ScanConstraint> constraints_;
+  Option<size_t> limit_;
 };
 
 } // namespace csql
@@ -45,7 +45,7 @@ Vector<QualifiedColumn> ShowTablesNode::allColumns() const {
 Vector<TaskID> ShowTablesNode::build(Transaction* txn, TaskDAG* tree) const {
   TaskIDList output;
   auto out_task = mkRef(new TaskDAGNode(new ShowTablesFactory()));
-  output.emplace_back(tree->addTask(out_task));
+  output.emplace_back(tree->addTask(out_task, this));
   return output;
 }
 
@@ -65,6 +65,50 @@ Vector<String> SubqueryNode::outputColumns() const {
   return column_names_;
 }
 
+Vector<size_t> SubqueryNode::sortOrder() const {
+  auto input_order =
+      subquery_.asInstanceOf<TableExpressionNode>()->sortOrder();
+
+  Vector<size_t> order;
+  for (auto input_idx : input_order) {
+    size_t idx = -1;
+    for (size_t i = 0; i < select_list_.size(); ++i) {
+      auto colref = dynamic_cast<ColumnReferenceNode*>(
+          select_list_[i]->expression().get());
+
+      if (colref &&
+          colref->hasColumnIndex() &&
+          colref->columnIndex() == input_idx) {
+        idx = i;
+        break;
+      }
+    }
+
+    if (idx == size_t(-1)) {
+      break;
+    }
+
+    order.emplace_back(idx);
+  }
+
+  return order;
+}
+
+String SubqueryNode::columnType(size_t column_idx) const {
+  if (column_idx >= select_list_.size()) {
+    return String();
+  }
+
+  auto colref = dynamic_cast<ColumnReferenceNode*>(
+      select_list_[column_idx]->expression().get());
+  if (!colref || !colref->hasColumnIndex()) {
+    return String();
+  }
+
+  return subquery_.asInstanceOf<TableExpressionNode>()->columnType(
+      colref->columnIndex());
+}
+
 Vector<QualifiedColumn> SubqueryNode::allColumns() const {
   String qualifier;
   if (!alias_.empty()) {
@@ -118,16 +162,18 @@ Option<RefPtr<ValueExpressionNode>> SubqueryNode::whereExpression() const {
 }
 
 Vector<TaskID> SubqueryNode::build(Transaction* txn, TaskDAG* tree) const {
-  auto input = subquery_.asInstanceOf<TableExpressionNode>()->build(txn, tree);
+  auto subquery_tbl = subquery_.asInstanceOf<TableExpressionNode>();
+  auto input = subquery_tbl->build(txn, tree);
+  auto ncols = subquery_tbl->outputColumns().size();
 
   TaskIDList output;
   for (const auto& in_task_id : input) {
     auto out_task = mkRef(new TaskDAGNode(
-        new SubqueryFactory(selectList(), whereExpression())));
+        new SubqueryFactory(ncols, selectList(), whereExpression())));
     TaskDAGNode::Dependency dep;
     dep.task_id = in_task_id;
     out_task->addDependency(dep);
-    output.emplace_back(tree->addTask(out_task));
+    output.emplace_back(tree->addTask(out_task, this));
   }
 
   return output;
@@ -42,6 +42,13 @@ public:
 
   Option<RefPtr<ValueExpressionNode>> whereExpression() const;
 
+  /**
+   * The subquery's sort order, as far as its sort columns are selected as-is
+   */
+  Vector<size_t> sortOrder() const override;
+
+  String columnType(size_t column_idx) const override;
+
   RefPtr<QueryTreeNode> deepCopy() const override;
 
   String toString() const override;
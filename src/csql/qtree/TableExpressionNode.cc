@@ -18,6 +18,14 @@ size_t TableExpressionNode::numColumns() const {
   return outputColumns().size();
 }
 
+Vector<size_t> TableExpressionNode::sortOrder() const {
+  return Vector<size_t>{};
+}
+
+String TableExpressionNode::columnType(size_t column_idx) const {
+  return String();
+}
+
 //size_t TableExpressionNode::getColumnIndex(const String& column_name) const {
 //  {
 //    auto iter = internal_columns_.find(column_name);
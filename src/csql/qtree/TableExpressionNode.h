@@ -36,6 +36,20 @@ public:
 
   size_t numColumns() const;
 
+  /**
+   * Returns the indexes of the output columns by which the rows returned by
+   * each task of this table expression are sorted in ascending order. Returns
+   * an empty list if the order of the rows is unknown
+   */
+  virtual Vector<size_t> sortOrder() const;
+
+  /**
+   * Returns the declared type (see ColumnInfo::type) of the output column if
+   * the column is a table column that is passed through as-is or an empty
+   * string if the type is not known
+   */
+  virtual String columnType(size_t column_idx) const;
+
   virtual Vector<TaskID> build(Transaction* txn, TaskDAG* tree) const = 0;
 
 };
@@ -7,6 +7,8 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <chrono>
+#include <time.h>
 #include <csql/result_cursor.h>
 
 using namespace stx;
@@ -15,23 +17,179 @@ namespace csql {
 
 ResultCursorList::ResultCursorList(
     Vector<ScopedPtr<ResultCursor>> cursors) :
-    cursors_(std::move(cursors)) {}
+    cursors_(std::move(cursors)),
+    current_cursor_(0),
+    prefetched_(false) {}
 
 ResultCursorList::ResultCursorList(
-    HashMap<TaskID, ScopedPtr<ResultCursor>> cursors) {
+    HashMap<TaskID, ScopedPtr<ResultCursor>> cursors) :
+    current_cursor_(0),
+    prefetched_(false) {
   for (auto& cur : cursors) {
     cursors_.emplace_back(std::move(cur.second));
   }
 }
 
 bool ResultCursorList::next(SValue* row, int row_len) {
+  prefetch(row_len);
+
+  while (current_cursor_ < cursors_.size()) {
+    if (cursors_[current_cursor_]->next(row, row_len)) {
+      return true;
+    }
+
+    ++current_cursor_;
+  }
+
   return false;
 }
 
-TaskResultCursor::TaskResultCursor(RefPtr<Task> task) : task_(task) {}
+bool ResultCursorList::poll() {
+  if (current_cursor_ < cursors_.size()) {
+    return cursors_[current_cursor_]->poll();
+  } else {
+    return true;
+  }
+}
+
+void ResultCursorList::wait(Function<void ()> callback) {
+  if (current_cursor_ < cursors_.size()) {
+    cursors_[current_cursor_]->wait(callback);
+  } else {
+    callback();
+  }
+}
+
+void ResultCursorList::prefetch(int row_len) {
+  if (prefetched_) {
+    return;
+  }
+
+  prefetched_ = true;
+  for (const auto& cursor : cursors_) {
+    cursor->prefetch(row_len);
+  }
+}
+
+void ResultCursorList::close() {
+  for (; current_cursor_ < cursors_.size(); ++current_cursor_) {
+    cursors_[current_cursor_]->close();
+  }
+}
+
+const size_t TaskResultCursor::kStatsBatchSize;
+
+static uint64_t wallTimeNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t threadCPUTimeNanos() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+    return 0;
+  }
+
+  return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+TaskResultCursor::TaskResultCursor(
+    RefPtr<Task> task,
+    TaskStats* stats /* = nullptr */) :
+    task_(task),
+    closed_(false),
+    stats_(stats),
+    stats_finished_(false),
+    num_calls_(0),
+    num_rows_(0),
+    wall_time_nanos_(0),
+    cpu_time_nanos_(0) {}
+
+TaskResultCursor::~TaskResultCursor() {
+  finishStats();
+}
 
 bool TaskResultCursor::next(SValue* row, int row_len) {
-  return task_->nextRow(row, row_len);
+  if (closed_) {
+    return false;
+  }
+
+  auto more = stats_ ?
+      nextWithStats(row, row_len) :
+      task_->nextRow(row, row_len);
+
+  if (more) {
+    return true;
+  }
+
+  /* the task is done, so it doesn't need to be closed anymore */
+  closed_ = true;
+  finishStats();
+  return false;
+}
+
+void TaskResultCursor::close() {
+  if (closed_) {
+    return;
+  }
+
+  closed_ = true;
+  task_->close();
+  finishStats();
+}
+
+bool TaskResultCursor::nextWithStats(SValue* row, int row_len) {
+  /* the first calls are always timed, so that e.g. the time to build a hash
+   * table isn't scaled up */
+  const auto interval = TaskStats::kTimingSampleInterval;
+  auto scale = num_calls_ < interval ? 1 : interval;
+  auto timed = scale == 1 || num_calls_ % interval == 0;
+  ++num_calls_;
+
+  if (!timed) {
+    if (!task_->nextRow(row, row_len)) {
+      return false;
+    }
+  } else {
+    auto wall_begin = wallTimeNanos();
+    auto cpu_begin = threadCPUTimeNanos();
+    auto more = task_->nextRow(row, row_len);
+    wall_time_nanos_ += (wallTimeNanos() - wall_begin) * scale;
+    cpu_time_nanos_ += (threadCPUTimeNanos() - cpu_begin) * scale;
+
+    if (!more) {
+      return false;
+    }
+  }
+
+  if (++num_rows_ >= kStatsBatchSize) {
+    flushStats();
+  }
+
+  return true;
+}
+
+void TaskResultCursor::flushStats() {
+  stats_->num_rows_out += num_rows_;
+  stats_->num_batches += 1;
+  stats_->wall_time_micros += wall_time_nanos_ / 1000;
+  stats_->cpu_time_micros += cpu_time_nanos_ / 1000;
+  num_rows_ = 0;
+  wall_time_nanos_ %= 1000;
+  cpu_time_nanos_ %= 1000;
+}
+
+void TaskResultCursor::finishStats() {
+  if (stats_ == nullptr || stats_finished_) {
+    return;
+  }
+
+  stats_finished_ = true;
+  if (num_rows_ > 0 || wall_time_nanos_ > 0) {
+    flushStats();
+  }
+
+  task_->collectStats(stats_);
 }
 
 }
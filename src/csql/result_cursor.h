@@ -55,6 +55,20 @@ public:
     callback();
   }
 
+  /**
+   * Close the cursor before all rows have been read. The close is propagated
+   * to all upstream tasks so that they stop producing rows. All subsequent
+   * calls to next return false
+   */
+  virtual void close() {}
+
+  /**
+   * Announce that rows with row_len columns will be read from this cursor.
+   * Asynchronous cursors start to produce rows in the background once this
+   * is called. The row_len of subsequent calls to next must be the same
+   */
+  virtual void prefetch(int row_len) {}
+
 };
 
 class ResultCursorList : public ResultCursor {
@@ -64,20 +78,53 @@ public:
   ResultCursorList(HashMap<TaskID, ScopedPtr<ResultCursor>> cursors);
 
   bool next(SValue* row, int row_len) override;
+  bool poll() override;
+  void wait(Function<void ()> callback) override;
+  void close() override;
+
+  /**
+   * Prefetches from all cursors in the list so that asynchronous cursors
+   * produce rows concurrently. Called by the first call to next
+   */
+  void prefetch(int row_len) override;
 
 protected:
   Vector<ScopedPtr<ResultCursor>> cursors_;
+  size_t current_cursor_;
+  bool prefetched_;
 };
 
+/**
+ * Returns the rows of a task. If stats are provided, the output rows and the
+ * (sampled) time spent in the task are counted locally and added to the stats
+ * once per kStatsBatchSize rows. The task's own counters are collected once
+ * the task is finished or closed (see Task::collectStats)
+ */
 class TaskResultCursor : public ResultCursor {
 public:
 
-  TaskResultCursor(RefPtr<Task> task);
+  static const size_t kStatsBatchSize = 1024;
+
+  TaskResultCursor(RefPtr<Task> task, TaskStats* stats = nullptr);
+  ~TaskResultCursor();
 
   bool next(SValue* row, int row_len) override;
+  void close() override;
 
 protected:
+
+  bool nextWithStats(SValue* row, int row_len);
+  void flushStats();
+  void finishStats();
+
   RefPtr<Task> task_;
+  bool closed_;
+  TaskStats* stats_;
+  bool stats_finished_;
+  uint64_t num_calls_;
+  uint64_t num_rows_;
+  uint64_t wall_time_nanos_;
+  uint64_t cpu_time_nanos_;
 };
 
 }
@@ -0,0 +1,174 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <stx/UnixTime.h>
+#include <stx/wallclock.h>
+#include <csql/runtime/AdmissionController.h>
+#include <csql/Transaction.h>
+
+using namespace stx;
+
+namespace csql {
+
+const uint64_t AdmissionController::kDefaultQueueTimeoutMicros =
+    30 * kMicrosPerSecond;
+
+const uint64_t AdmissionController::kPollIntervalMicros =
+    100 * kMicrosPerMilli;
+
+AdmissionController::AdmissionController(
+    size_t num_threads) :
+    num_threads_(std::max(num_threads, size_t(1))),
+    max_queries_(0),
+    max_batch_queries_(0),
+    queue_timeout_(kDefaultQueueTimeoutMicros),
+    num_running_(0),
+    num_running_batch_(0),
+    next_waiter_id_(0) {}
+
+void AdmissionController::setLimits(
+    size_t max_queries,
+    size_t max_batch_queries) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  max_queries_ = max_queries;
+  max_batch_queries_ = max_batch_queries;
+  lk.unlock();
+  cv_.notify_all();
+}
+
+void AdmissionController::setQueueTimeout(uint64_t timeout_micros) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  queue_timeout_ = timeout_micros;
+}
+
+ScopedPtr<AdmissionTicket> AdmissionController::admit(Transaction* txn) {
+  auto priority = txn->getPriority();
+
+  std::unique_lock<std::mutex> lk(mutex_);
+
+  uint64_t timeout_at = 0;
+  if (queue_timeout_ > 0) {
+    timeout_at = WallClock::unixMicros() + queue_timeout_;
+  }
+
+  auto txn_deadline = txn->getDeadline();
+  if (!txn_deadline.isEmpty()) {
+    auto deadline = txn_deadline.get().unixMicros();
+    if (timeout_at == 0 || deadline < timeout_at) {
+      timeout_at = deadline;
+    }
+  }
+
+  auto& queue = queues_[(int) priority];
+  auto waiter_id = next_waiter_id_++;
+  queue.emplace_back(waiter_id);
+
+  while (!canAdmit(priority, waiter_id)) {
+    auto now = WallClock::unixMicros();
+    if (txn->isCancelled() || (timeout_at > 0 && now >= timeout_at)) {
+      queue.erase(std::find(queue.begin(), queue.end(), waiter_id));
+      lk.unlock();
+      cv_.notify_all();
+
+      txn->checkAborted();
+      RAISE(kRuntimeError, "query timed out waiting for admission");
+    }
+
+    /* wake up periodically to notice cancellation */
+    auto wait_micros = kPollIntervalMicros;
+    if (timeout_at > 0) {
+      wait_micros = std::min(wait_micros, timeout_at - now);
+    }
+
+    cv_.wait_for(lk, std::chrono::microseconds(wait_micros));
+  }
+
+  queue.pop_front();
+  ++num_running_;
+  if (priority == QueryPriority::BATCH) {
+    ++num_running_batch_;
+  }
+
+  /* the next waiter in line may be admissible as well */
+  lk.unlock();
+  cv_.notify_all();
+
+  return mkScoped(new AdmissionTicket(this, priority));
+}
+
+size_t AdmissionController::numRunningQueries() const {
+  std::unique_lock<std::mutex> lk(mutex_);
+  return num_running_;
+}
+
+size_t AdmissionController::numQueuedQueries() const {
+  std::unique_lock<std::mutex> lk(mutex_);
+  return queues_[0].size() + queues_[1].size();
+}
+
+size_t AdmissionController::maxThreadsPerQuery() const {
+  std::unique_lock<std::mutex> lk(mutex_);
+  return std::max(num_threads_ / std::max(num_running_, size_t(1)), size_t(1));
+}
+
+bool AdmissionController::canAdmit(
+    QueryPriority priority,
+    uint64_t waiter_id) const {
+  if (queues_[(int) priority].front() != waiter_id) {
+    return false;
+  }
+
+  if (max_queries_ > 0 && num_running_ >= max_queries_) {
+    return false;
+  }
+
+  if (priority == QueryPriority::BATCH) {
+    if (!queues_[(int) QueryPriority::INTERACTIVE].empty()) {
+      return false;
+    }
+
+    if (max_batch_queries_ > 0 && num_running_batch_ >= max_batch_queries_) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void AdmissionController::release(QueryPriority priority) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  --num_running_;
+  if (priority == QueryPriority::BATCH) {
+    --num_running_batch_;
+  }
+
+  lk.unlock();
+  cv_.notify_all();
+}
+
+AdmissionTicket::AdmissionTicket(
+    AdmissionController* controller,
+    QueryPriority priority) :
+    controller_(controller),
+    priority_(priority) {}
+
+AdmissionTicket::~AdmissionTicket() {
+  controller_->release(priority_);
+}
+
+QueryPriority AdmissionTicket::priority() const {
+  return priority_;
+}
+
+size_t AdmissionTicket::maxThreads() const {
+  return controller_->maxThreadsPerQuery();
+}
+
+} // namespace csql
@@ -0,0 +1,114 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stx/stdtypes.h>
+
+using namespace stx;
+
+namespace csql {
+class Transaction;
+class AdmissionTicket;
+
+enum class QueryPriority {
+  INTERACTIVE,
+  BATCH
+};
+
+/**
+ * Limits the number of concurrently executing queries of a runtime.
+ *
+ * A query waits in the queue of its priority class until it is admitted.
+ * Interactive queries are always admitted before waiting batch queries, and
+ * batch queries never occupy more than max_batch_queries slots, so that an
+ * export can't take the slots of interactive queries. Within a class queries
+ * are admitted in FIFO order. A query fails with an error if it isn't admitted
+ * within the queue timeout, before its deadline or before it is cancelled.
+ *
+ * Each running query gets an equal share of the runtime's worker threads (see
+ * AdmissionTicket::maxThreads). A limit of zero means unlimited.
+ */
+class AdmissionController {
+public:
+
+  static const uint64_t kDefaultQueueTimeoutMicros;
+  static const uint64_t kPollIntervalMicros;
+
+  AdmissionController(size_t num_threads);
+
+  /**
+   * Set the maximum number of concurrently executing queries and the maximum
+   * number of those that may be batch queries
+   */
+  void setLimits(size_t max_queries, size_t max_batch_queries);
+
+  void setQueueTimeout(uint64_t timeout_micros);
+
+  /**
+   * Blocks until the transaction's query may execute. The query counts as
+   * running until the returned ticket is destroyed
+   */
+  ScopedPtr<AdmissionTicket> admit(Transaction* txn);
+
+  size_t numRunningQueries() const;
+  size_t numQueuedQueries() const;
+
+  /**
+   * Returns the share of the worker threads of each running query
+   */
+  size_t maxThreadsPerQuery() const;
+
+protected:
+  friend class AdmissionTicket;
+
+  bool canAdmit(QueryPriority priority, uint64_t waiter_id) const;
+  void release(QueryPriority priority);
+
+  size_t num_threads_;
+  size_t max_queries_;
+  size_t max_batch_queries_;
+  uint64_t queue_timeout_;
+  size_t num_running_;
+  size_t num_running_batch_;
+  uint64_t next_waiter_id_;
+  std::deque<uint64_t> queues_[2];
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
+class AdmissionTicket {
+public:
+
+  AdmissionTicket(
+      AdmissionController* controller,
+      QueryPriority priority);
+
+  ~AdmissionTicket();
+
+  AdmissionTicket(const AdmissionTicket& other) = delete;
+  AdmissionTicket& operator=(const AdmissionTicket& other) = delete;
+
+  QueryPriority priority() const;
+
+  /**
+   * Returns the number of threads the query may use (see LocalScheduler).
+   * The share shrinks as other queries are admitted and grows as they finish;
+   * the scheduler reads it once when a statement starts executing
+   */
+  size_t maxThreads() const;
+
+protected:
+  AdmissionController* controller_;
+  QueryPriority priority_;
+};
+
+} // namespace csql
@@ -0,0 +1,234 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <stx/io/fileutil.h>
+#include <csql/runtime/DistinctSet.h>
+#include <csql/runtime/SpillFile.h>
+#include <csql/runtime/runtime.h>
+#include <csql/Transaction.h>
+
+using namespace stx;
+
+namespace csql {
+
+const size_t DistinctSet::kMaxInMemoryBytes = 64 * 1024 * 1024;
+const size_t DistinctSet::kMinSpillBytes = 1024 * 1024;
+const size_t DistinctSet::kMaxRuns = 16;
+
+/* approximate per key overhead of the hash set */
+static const size_t kKeyOverheadBytes = sizeof(String) + 2 * sizeof(void*);
+
+DistinctSet::DistinctSet() {}
+
+DistinctSet::~DistinctSet() {
+  clear();
+}
+
+void DistinctSet::insert(Transaction* txn, const String& key) {
+  if (!keys_.emplace(key).second) {
+    return;
+  }
+
+  if (memory_.tracker() == nullptr) {
+    memory_.setTracker(txn->getMemoryTracker());
+  }
+
+  memory_.grow(key.size() + kKeyOverheadBytes);
+  if (memory_.bytes() > kMaxInMemoryBytes) {
+    spill(txn);
+    return;
+  }
+
+  /* spill early if the transaction is over its soft limit and we can, but
+   * not so early that every few keys end up in their own run */
+  if (memory_.bytes() >= kMinSpillBytes &&
+      memory_.exceedsSoftLimit() &&
+      !txn->getRuntime()->cacheDir().isEmpty()) {
+    spill(txn);
+  }
+}
+
+void DistinctSet::merge(Transaction* txn, const DistinctSet& other) {
+  other.forEachKey([this, txn] (const String& key) {
+    insert(txn, key);
+  });
+}
+
+uint64_t DistinctSet::count() const {
+  if (runs_.empty()) {
+    return keys_.size();
+  }
+
+  uint64_t n = 0;
+  forEachKey([&n] (const String& key) {
+    ++n;
+  });
+
+  return n;
+}
+
+void DistinctSet::clear() {
+  keys_.clear();
+  memory_.resize(0);
+
+  for (const auto& run : runs_) {
+    FileUtil::rm(run.path);
+  }
+
+  runs_.clear();
+}
+
+void DistinctSet::encode(OutputStream* os) const {
+  os->appendVarUInt(count());
+  forEachKey([os] (const String& key) {
+    os->appendLenencString(key.data(), key.size());
+  });
+}
+
+void DistinctSet::decode(Transaction* txn, InputStream* is) {
+  clear();
+
+  auto n = is->readVarUInt();
+  for (size_t i = 0; i < n; ++i) {
+    insert(txn, is->readLenencString());
+  }
+}
+
+void DistinctSet::spill(Transaction* txn) {
+  auto cache_dir = txn->getRuntime()->cacheDir();
+  if (cache_dir.isEmpty()) {
+    RAISE(
+        kRuntimeError,
+        "count(DISTINCT) exceeds the memory limit and no cache dir is"
+        " configured for spilling");
+  }
+
+  Vector<String> keys(keys_.begin(), keys_.end());
+  std::sort(keys.begin(), keys.end());
+
+  SpillFileWriter writer(makeSpillFilePath(cache_dir.get(), "distinct"));
+  for (const auto& key : keys) {
+    SValue val(key);
+    writer.appendRow(&val, 1);
+  }
+
+  writer.close();
+
+  SortedRun run;
+  run.path = writer.path();
+  run.num_keys = keys.size();
+  runs_.emplace_back(run);
+
+  keys_.clear();
+  memory_.resize(0);
+
+  if (runs_.size() >= kMaxRuns) {
+    mergeRuns(txn);
+  }
+}
+
+void DistinctSet::mergeRuns(Transaction* txn) {
+  auto cache_dir = txn->getRuntime()->cacheDir();
+
+  SpillFileWriter writer(makeSpillFilePath(cache_dir.get(), "distinct"));
+  size_t num_keys = 0;
+  forEachKey([&writer, &num_keys] (const String& key) {
+    SValue val(key);
+    writer.appendRow(&val, 1);
+    ++num_keys;
+  }, false);
+
+  writer.close();
+
+  for (const auto& run : runs_) {
+    FileUtil::rm(run.path);
+  }
+
+  SortedRun run;
+  run.path = writer.path();
+  run.num_keys = num_keys;
+  runs_.clear();
+  runs_.emplace_back(run);
+}
+
+void DistinctSet::forEachKey(
+    Function<void (const String& key)> fn,
+    bool include_memory /* = true */) const {
+  if (runs_.empty()) {
+    if (include_memory) {
+      for (const auto& key : keys_) {
+        fn(key);
+      }
+    }
+
+    return;
+  }
+
+  /* merge the sorted runs and the sorted in-memory keys */
+  Vector<String> mem_keys;
+  if (include_memory) {
+    mem_keys.assign(keys_.begin(), keys_.end());
+    std::sort(mem_keys.begin(), mem_keys.end());
+  }
+
+  size_t mem_pos = 0;
+
+  Vector<ScopedPtr<SpillFileReader>> readers;
+  Vector<String> heads(runs_.size());
+  Vector<bool> valid(runs_.size());
+  Vector<SValue> row;
+  auto advance = [&] (size_t i) {
+    valid[i] = readers[i]->readRow(&row);
+    if (valid[i]) {
+      heads[i] = row[0].getString();
+    }
+  };
+
+  for (size_t i = 0; i < runs_.size(); ++i) {
+    readers.emplace_back(new SpillFileReader(runs_[i].path, runs_[i].num_keys));
+    advance(i);
+  }
+
+  String last;
+  bool first = true;
+  for (;;) {
+    const String* min = nullptr;
+    size_t min_idx = runs_.size();
+
+    if (mem_pos < mem_keys.size()) {
+      min = &mem_keys[mem_pos];
+    }
+
+    for (size_t i = 0; i < runs_.size(); ++i) {
+      if (valid[i] && (min == nullptr || heads[i] < *min)) {
+        min = &heads[i];
+        min_idx = i;
+      }
+    }
+
+    if (min == nullptr) {
+      break;
+    }
+
+    if (first || *min != last) {
+      last = *min;
+      first = false;
+      fn(last);
+    }
+
+    if (min_idx == runs_.size()) {
+      ++mem_pos;
+    } else {
+      advance(min_idx);
+    }
+  }
+}
+
+} // namespace csql
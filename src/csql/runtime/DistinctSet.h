@@ -0,0 +1,94 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <unordered_set>
+#include <stx/stdtypes.h>
+#include <stx/io/inputstream.h>
+#include <stx/io/outputstream.h>
+#include <csql/runtime/MemoryTracker.h>
+
+using namespace stx;
+
+namespace csql {
+class Transaction;
+
+/**
+ * Counts the exact number of distinct keys, e.g. normalized values (see
+ * SortKey::encodeJoinKey). The keys are kept in a hash set until the set
+ * exceeds kMaxInMemoryBytes, or until it holds at least kMinSpillBytes while
+ * the transaction exceeds its soft memory limit. Then the keys are sorted,
+ * written to a spill file in the runtime's cache dir as a sorted run and the
+ * set is cleared. Once there are kMaxRuns runs, they are merged into a single
+ * run, so that the number of open files stays bounded.
+ * The distinct keys are counted by merging all sorted runs and the keys
+ * that are still in memory, so duplicates across runs are removed without
+ * loading a whole run into memory.
+ */
+class DistinctSet {
+public:
+
+  static const size_t kMaxInMemoryBytes;
+  static const size_t kMinSpillBytes;
+  static const size_t kMaxRuns;
+
+  DistinctSet();
+  DistinctSet(const DistinctSet& other) = delete;
+  DistinctSet& operator=(const DistinctSet& other) = delete;
+  ~DistinctSet();
+
+  void insert(Transaction* txn, const String& key);
+
+  /**
+   * Insert all keys of the other set into this set
+   */
+  void merge(Transaction* txn, const DistinctSet& other);
+
+  uint64_t count() const;
+
+  void clear();
+
+  /**
+   * Encodes all distinct keys, i.e. including the spilled keys. The keys are
+   * streamed from the runs, but the aggregate states this is used for (see
+   * VM::saveState) are held in memory, so a spilled set is loaded back into
+   * memory when its state is saved, e.g. by a partial GROUP BY
+   */
+  void encode(OutputStream* os) const;
+  void decode(Transaction* txn, InputStream* is);
+
+protected:
+
+  struct SortedRun {
+    String path;
+    size_t num_keys;
+  };
+
+  void spill(Transaction* txn);
+
+  /**
+   * Merge all sorted runs into a single run
+   */
+  void mergeRuns(Transaction* txn);
+
+  /**
+   * Calls the function once for each distinct key in ascending order if there
+   * are sorted runs. If include_memory is false, only the keys of the sorted
+   * runs are returned
+   */
+  void forEachKey(
+      Function<void (const String& key)> fn,
+      bool include_memory = true) const;
+
+  std::unordered_set<String> keys_;
+  MemoryReservation memory_;
+  Vector<SortedRun> runs_;
+};
+
+} // namespace csql
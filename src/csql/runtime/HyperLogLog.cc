@@ -0,0 +1,281 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <math.h>
+#include <csql/runtime/HyperLogLog.h>
+#include <stx/exception.h>
+
+using namespace stx;
+
+namespace csql {
+
+const uint32_t HyperLogLog::kPrecision;
+const uint32_t HyperLogLog::kSparsePrecision;
+const size_t HyperLogLog::kNumRegisters;
+const size_t HyperLogLog::kMaxSparseSize;
+const size_t HyperLogLog::kMaxSparseBufferSize;
+
+static const uint8_t kRegisterBits = 6;
+
+HyperLogLog::HyperLogLog() : sparse_(true) {}
+
+void HyperLogLog::insert(const String& key) {
+  insertHash(hashKey(key));
+}
+
+void HyperLogLog::insertHash(uint64_t hash) {
+  if (sparse_) {
+    sparse_buf_.emplace_back(encodeSparse(hash));
+    if (sparse_buf_.size() >= kMaxSparseBufferSize) {
+      flushSparseBuffer();
+      if (sparse_list_.size() > kMaxSparseSize) {
+        convertToDense();
+      }
+    }
+
+    return;
+  }
+
+  auto index = hash >> (64 - kPrecision);
+  auto w = hash << kPrecision;
+  uint8_t rank = w == 0 ? 64 - kPrecision + 1 : __builtin_clzll(w) + 1;
+  if (rank > registers_[index]) {
+    registers_[index] = rank;
+  }
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+  if (other.sparse_) {
+    other.flushSparseBuffer();
+    insertSparse(other.sparse_list_);
+    return;
+  }
+
+  if (sparse_) {
+    convertToDense();
+  }
+
+  for (size_t i = 0; i < kNumRegisters; ++i) {
+    registers_[i] = std::max(registers_[i], other.registers_[i]);
+  }
+}
+
+uint64_t HyperLogLog::estimate() const {
+  if (sparse_) {
+    /* linear counting at the sparse precision */
+    flushSparseBuffer();
+    double m = 1ULL << kSparsePrecision;
+    double v = m - sparse_list_.size();
+    return llround(m * log(m / v));
+  }
+
+  double m = kNumRegisters;
+  double sum = 0;
+  size_t num_zeros = 0;
+  for (auto r : registers_) {
+    sum += 1.0 / (1ULL << r);
+    if (r == 0) {
+      ++num_zeros;
+    }
+  }
+
+  if (num_zeros > 0) {
+    auto lc = m * log(m / num_zeros);
+    if (lc <= 2.5 * m) {
+      return llround(lc);
+    }
+  }
+
+  auto alpha = 0.7213 / (1.0 + 1.079 / m);
+  return llround(alpha * m * m / sum);
+}
+
+void HyperLogLog::clear() {
+  sparse_ = true;
+  sparse_list_.clear();
+  sparse_buf_.clear();
+  Vector<uint8_t>().swap(registers_);
+}
+
+void HyperLogLog::encode(OutputStream* os) const {
+  os->appendUInt8(sparse_);
+
+  if (sparse_) {
+    flushSparseBuffer();
+    os->appendVarUInt(sparse_list_.size());
+
+    uint32_t last = 0;
+    for (auto e : sparse_list_) {
+      os->appendVarUInt(e - last);
+      last = e;
+    }
+
+    return;
+  }
+
+  String packed((kNumRegisters * kRegisterBits + 7) / 8, 0);
+  for (size_t i = 0; i < kNumRegisters; ++i) {
+    auto bit = i * kRegisterBits;
+    uint16_t v = uint16_t(registers_[i]) << (bit % 8);
+    packed[bit / 8] |= v & 0xff;
+    if ((bit % 8) + kRegisterBits > 8) {
+      packed[bit / 8 + 1] |= v >> 8;
+    }
+  }
+
+  os->appendLenencString(packed.data(), packed.size());
+}
+
+void HyperLogLog::decode(InputStream* is) {
+  clear();
+
+  sparse_ = is->readUInt8();
+  if (sparse_) {
+    auto size = is->readVarUInt();
+    sparse_list_.reserve(size);
+
+    uint32_t last = 0;
+    for (size_t i = 0; i < size; ++i) {
+      last += is->readVarUInt();
+      sparse_list_.emplace_back(last);
+    }
+
+    return;
+  }
+
+  auto packed = is->readLenencString();
+  if (packed.size() != (kNumRegisters * kRegisterBits + 7) / 8) {
+    RAISE(kRuntimeError, "invalid HyperLogLog state");
+  }
+
+  registers_.resize(kNumRegisters);
+  for (size_t i = 0; i < kNumRegisters; ++i) {
+    auto bit = i * kRegisterBits;
+    uint16_t v = (unsigned char) packed[bit / 8];
+    if ((bit % 8) + kRegisterBits > 8) {
+      v |= uint16_t((unsigned char) packed[bit / 8 + 1]) << 8;
+    }
+
+    registers_[i] = (v >> (bit % 8)) & ((1 << kRegisterBits) - 1);
+  }
+}
+
+bool HyperLogLog::isSparse() const {
+  return sparse_;
+}
+
+size_t HyperLogLog::memoryUsage() const {
+  return
+      (sparse_list_.capacity() + sparse_buf_.capacity()) * sizeof(uint32_t) +
+      registers_.capacity();
+}
+
+uint64_t HyperLogLog::hashKey(const String& key) {
+  /* FNV-1a followed by a murmur3 finalizer */
+  uint64_t h = 14695981039346656037ULL;
+  for (auto c : key) {
+    h ^= (unsigned char) c;
+    h *= 1099511628211ULL;
+  }
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9a34fe63ec5ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+uint32_t HyperLogLog::encodeSparse(uint64_t hash) {
+  uint32_t index = hash >> (64 - kSparsePrecision);
+  auto w = hash << kSparsePrecision;
+  uint32_t rank = w == 0 ? 64 - kSparsePrecision + 1 : __builtin_clzll(w) + 1;
+  return (index << kRegisterBits) | rank;
+}
+
+void HyperLogLog::decodeSparse(uint32_t entry, uint32_t* index, uint8_t* rank) {
+  static const uint32_t kExtraBits = kSparsePrecision - kPrecision;
+
+  auto sparse_index = entry >> kRegisterBits;
+  auto extra = sparse_index & ((1 << kExtraBits) - 1);
+
+  *index = sparse_index >> kExtraBits;
+
+  /* the rank is determined by the extra index bits unless they are all zero */
+  if (extra == 0) {
+    *rank = kExtraBits + (entry & ((1 << kRegisterBits) - 1));
+  } else {
+    *rank = __builtin_clz(extra) - (32 - kExtraBits) + 1;
+  }
+}
+
+void HyperLogLog::flushSparseBuffer() const {
+  if (sparse_buf_.empty()) {
+    return;
+  }
+
+  std::sort(sparse_buf_.begin(), sparse_buf_.end());
+  auto mid = sparse_list_.size();
+  sparse_list_.insert(
+      sparse_list_.end(),
+      sparse_buf_.begin(),
+      sparse_buf_.end());
+  std::inplace_merge(
+      sparse_list_.begin(),
+      sparse_list_.begin() + mid,
+      sparse_list_.end());
+  sparse_buf_.clear();
+
+  /* entries with the same index are adjacent, the last has the highest rank */
+  size_t n = 0;
+  for (size_t i = 0; i < sparse_list_.size(); ++i) {
+    auto entry = sparse_list_[i];
+    if (n > 0 && (sparse_list_[n - 1] >> kRegisterBits) ==
+                 (entry >> kRegisterBits)) {
+      sparse_list_[n - 1] = entry;
+    } else {
+      sparse_list_[n++] = entry;
+    }
+  }
+
+  sparse_list_.resize(n);
+}
+
+void HyperLogLog::insertSparse(const Vector<uint32_t>& entries) {
+  if (sparse_) {
+    sparse_buf_.insert(sparse_buf_.end(), entries.begin(), entries.end());
+    flushSparseBuffer();
+    if (sparse_list_.size() > kMaxSparseSize) {
+      convertToDense();
+    }
+
+    return;
+  }
+
+  for (auto e : entries) {
+    uint32_t index;
+    uint8_t rank;
+    decodeSparse(e, &index, &rank);
+    registers_[index] = std::max(registers_[index], rank);
+  }
+}
+
+void HyperLogLog::convertToDense() {
+  flushSparseBuffer();
+
+  Vector<uint32_t> entries;
+  entries.swap(sparse_list_);
+
+  sparse_ = false;
+  registers_.assign(kNumRegisters, 0);
+  insertSparse(entries);
+}
+
+} // namespace csql
@@ -0,0 +1,98 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <stx/io/inputstream.h>
+#include <stx/io/outputstream.h>
+
+using namespace stx;
+
+namespace csql {
+
+/**
+ * Estimates the number of distinct keys using HyperLogLog++ with 64 bit
+ * hashes and 2^kPrecision registers (~0.8% standard error).
+ *
+ * Small sets are stored in the sparse representation: a sorted list of
+ * (index, rank) pairs at the higher kSparsePrecision, which gives near exact
+ * estimates through linear counting. New pairs are collected in an unsorted
+ * buffer that is merged into the list when it is full. Once the sparse list
+ * would take more memory than the dense registers, the sketch is converted to
+ * the dense representation with one byte per register.
+ *
+ * The empirical bias correction of HLL++ is not applied. Instead, estimates
+ * up to 2.5 * kNumRegisters use linear counting on the dense registers, which
+ * covers the range where the raw estimate is biased.
+ */
+class HyperLogLog {
+public:
+
+  static const uint32_t kPrecision = 14;
+  static const uint32_t kSparsePrecision = 25;
+  static const size_t kNumRegisters = 1 << kPrecision;
+  static const size_t kMaxSparseSize = kNumRegisters / sizeof(uint32_t);
+  static const size_t kMaxSparseBufferSize = 256;
+
+  HyperLogLog();
+
+  /**
+   * Insert an encoded key (e.g. see SortKey::encodeJoinKey)
+   */
+  void insert(const String& key);
+
+  void insertHash(uint64_t hash);
+
+  /**
+   * Merge the other sketch into this one so that this sketch estimates the
+   * number of distinct keys in the union of both
+   */
+  void merge(const HyperLogLog& other);
+
+  uint64_t estimate() const;
+
+  void clear();
+
+  /**
+   * The sparse representation is stored as delta encoded varints, the dense
+   * representation as 6 bit packed registers
+   */
+  void encode(OutputStream* os) const;
+  void decode(InputStream* is);
+
+  bool isSparse() const;
+
+  /**
+   * Returns the number of bytes allocated for the registers or sparse lists
+   */
+  size_t memoryUsage() const;
+
+  static uint64_t hashKey(const String& key);
+
+protected:
+
+  static uint32_t encodeSparse(uint64_t hash);
+  static void decodeSparse(uint32_t entry, uint32_t* index, uint8_t* rank);
+
+  /**
+   * Merge the sparse buffer into the sorted sparse list, keeping the highest
+   * rank for each index
+   */
+  void flushSparseBuffer() const;
+
+  void insertSparse(const Vector<uint32_t>& entries);
+  void convertToDense();
+
+  bool sparse_;
+  mutable Vector<uint32_t> sparse_list_;
+  mutable Vector<uint32_t> sparse_buf_;
+  Vector<uint8_t> registers_;
+};
+
+} // namespace csql
@@ -0,0 +1,129 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <stx/exception.h>
+#include <csql/runtime/MemoryTracker.h>
+
+using namespace stx;
+
+namespace csql {
+
+MemoryTracker::MemoryTracker() :
+    soft_limit_(0),
+    hard_limit_(0),
+    used_(0),
+    peak_(0) {}
+
+void MemoryTracker::setLimits(size_t soft_limit, size_t hard_limit) {
+  soft_limit_ = soft_limit;
+  hard_limit_ = hard_limit;
+}
+
+size_t MemoryTracker::softLimit() const {
+  return soft_limit_;
+}
+
+size_t MemoryTracker::hardLimit() const {
+  return hard_limit_;
+}
+
+void MemoryTracker::reserve(size_t bytes) {
+  auto used = used_.fetch_add(bytes) + bytes;
+
+  auto hard_limit = hard_limit_.load();
+  if (hard_limit > 0 && used > hard_limit) {
+    used_ -= bytes;
+    RAISEF(
+        kRuntimeError,
+        "query exceeds the memory limit of $0 bytes",
+        hard_limit);
+  }
+
+  auto peak = peak_.load();
+  while (used > peak && !peak_.compare_exchange_weak(peak, used));
+}
+
+void MemoryTracker::release(size_t bytes) {
+  used_ -= bytes;
+}
+
+bool MemoryTracker::exceedsSoftLimit(size_t additional_bytes /* = 0 */) const {
+  auto soft_limit = soft_limit_.load();
+  return soft_limit > 0 && used_ + additional_bytes > soft_limit;
+}
+
+size_t MemoryTracker::usedBytes() const {
+  return used_;
+}
+
+size_t MemoryTracker::peakBytes() const {
+  return peak_;
+}
+
+MemoryReservation::MemoryReservation() :
+    tracker_(nullptr),
+    bytes_(0),
+    peak_(0) {}
+
+MemoryReservation::MemoryReservation(
+    MemoryTracker* tracker) :
+    tracker_(tracker),
+    bytes_(0),
+    peak_(0) {}
+
+MemoryReservation::~MemoryReservation() {
+  resize(0);
+}
+
+void MemoryReservation::setTracker(MemoryTracker* tracker) {
+  resize(0);
+  tracker_ = tracker;
+}
+
+MemoryTracker* MemoryReservation::tracker() const {
+  return tracker_;
+}
+
+void MemoryReservation::grow(size_t bytes) {
+  if (tracker_) {
+    tracker_->reserve(bytes);
+  }
+
+  bytes_ += bytes;
+  peak_ = std::max(peak_, bytes_);
+}
+
+void MemoryReservation::resize(size_t bytes) {
+  if (bytes > bytes_) {
+    grow(bytes - bytes_);
+    return;
+  }
+
+  if (tracker_) {
+    tracker_->release(bytes_ - bytes);
+  }
+
+  bytes_ = bytes;
+}
+
+size_t MemoryReservation::bytes() const {
+  return bytes_;
+}
+
+size_t MemoryReservation::peakBytes() const {
+  return peak_;
+}
+
+bool MemoryReservation::exceedsSoftLimit(
+    size_t additional_bytes /* = 0 */) const {
+  return tracker_ && tracker_->exceedsSoftLimit(additional_bytes);
+}
+
+} // namespace csql
@@ -0,0 +1,107 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <atomic>
+#include <stx/stdtypes.h>
+
+using namespace stx;
+
+namespace csql {
+
+/**
+ * Counts the memory that the operators of one transaction hold in buffers,
+ * hash tables and aggregation states.
+ *
+ * Operators that can spill to disk check exceedsSoftLimit() and start spilling
+ * once the transaction is over its soft limit. A reservation that would exceed
+ * the hard limit fails the query with an error instead. A limit of zero means
+ * unlimited.
+ */
+class MemoryTracker {
+public:
+
+  MemoryTracker();
+
+  void setLimits(size_t soft_limit, size_t hard_limit);
+
+  size_t softLimit() const;
+  size_t hardLimit() const;
+
+  /**
+   * Adds bytes to the used memory. Raises an error and leaves the used memory
+   * unchanged if the reservation would exceed the hard limit
+   */
+  void reserve(size_t bytes);
+
+  void release(size_t bytes);
+
+  /**
+   * Returns true if the used memory plus additional_bytes exceeds the soft
+   * limit
+   */
+  bool exceedsSoftLimit(size_t additional_bytes = 0) const;
+
+  size_t usedBytes() const;
+
+  /**
+   * Returns the maximum of usedBytes() over the lifetime of the transaction
+   */
+  size_t peakBytes() const;
+
+protected:
+  std::atomic<size_t> soft_limit_;
+  std::atomic<size_t> hard_limit_;
+  std::atomic<size_t> used_;
+  std::atomic<size_t> peak_;
+};
+
+/**
+ * The part of the used memory of a transaction that is held by one operator.
+ * The reserved bytes are released when the reservation is destroyed
+ */
+class MemoryReservation {
+public:
+
+  MemoryReservation();
+  explicit MemoryReservation(MemoryTracker* tracker);
+  ~MemoryReservation();
+
+  MemoryReservation(const MemoryReservation& other) = delete;
+  MemoryReservation& operator=(const MemoryReservation& other) = delete;
+
+  /**
+   * Releases the current reservation and reserves future bytes from tracker
+   */
+  void setTracker(MemoryTracker* tracker);
+  MemoryTracker* tracker() const;
+
+  void grow(size_t bytes);
+
+  /**
+   * Reserves or releases bytes so that the reservation holds exactly bytes
+   */
+  void resize(size_t bytes);
+
+  size_t bytes() const;
+
+  /**
+   * Returns the maximum of bytes() over the lifetime of the reservation
+   */
+  size_t peakBytes() const;
+
+  bool exceedsSoftLimit(size_t additional_bytes = 0) const;
+
+protected:
+  MemoryTracker* tracker_;
+  size_t bytes_;
+  size_t peak_;
+};
+
+} // namespace csql
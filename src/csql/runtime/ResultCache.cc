@@ -0,0 +1,235 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <stx/io/fileutil.h>
+#include <stx/stringutil.h>
+#include <csql/runtime/ResultCache.h>
+#include <csql/runtime/SpillFile.h>
+
+using namespace stx;
+
+namespace csql {
+
+const size_t ResultCache::kDefaultMaxSize = 1024 * 1024 * 1024;
+
+static const char kResultFileSuffix[] = ".result";
+
+class ResultCacheReader : public ResultCursor {
+public:
+
+  ResultCacheReader(
+      const String& path,
+      size_t num_rows) :
+      reader_(path, num_rows) {}
+
+  bool next(SValue* row, int row_len) override {
+    if (!reader_.readRow(&buf_)) {
+      return false;
+    }
+
+    for (size_t i = 0; i < size_t(row_len) && i < buf_.size(); ++i) {
+      row[i] = buf_[i];
+    }
+
+    return true;
+  }
+
+protected:
+  SpillFileReader reader_;
+  Vector<SValue> buf_;
+};
+
+class ResultCacheWriter : public ResultCursor {
+public:
+
+  ResultCacheWriter(
+      RefPtr<ResultCache> cache,
+      const SHA1Hash& key,
+      size_t num_columns,
+      ScopedPtr<ResultCursor> cursor) :
+      cache_(cache),
+      key_(key),
+      num_columns_(num_columns),
+      cursor_(std::move(cursor)),
+      writer_(makeSpillFilePath(cache_->cache_dir_, "result")),
+      done_(false) {}
+
+  ~ResultCacheWriter() {
+    if (!done_) {
+      writer_.close();
+      FileUtil::rm(writer_.path());
+    }
+  }
+
+  bool next(SValue* row, int row_len) override {
+    if (done_) {
+      return false;
+    }
+
+    /* read and store all columns, not only the ones this consumer reads */
+    if (buf_.size() < std::max(num_columns_, size_t(row_len))) {
+      buf_.resize(std::max(num_columns_, size_t(row_len)));
+    }
+
+    if (cursor_->next(buf_.data(), buf_.size())) {
+      writer_.appendRow(buf_.data(), num_columns_);
+      for (size_t i = 0; i < size_t(row_len); ++i) {
+        row[i] = buf_[i];
+      }
+
+      return true;
+    }
+
+    writer_.close();
+    done_ = true;
+    cache_->commit(
+        key_,
+        writer_.path(),
+        writer_.numRows(),
+        writer_.numBytes());
+
+    return false;
+  }
+
+  bool poll() override {
+    return done_ || cursor_->poll();
+  }
+
+  void wait(Function<void ()> callback) override {
+    cursor_->wait(callback);
+  }
+
+  void close() override {
+    cursor_->close();
+  }
+
+  void prefetch(int row_len) override {
+    cursor_->prefetch(row_len);
+  }
+
+protected:
+  RefPtr<ResultCache> cache_;
+  SHA1Hash key_;
+  size_t num_columns_;
+  ScopedPtr<ResultCursor> cursor_;
+  SpillFileWriter writer_;
+  Vector<SValue> buf_;
+  bool done_;
+};
+
+ResultCache::ResultCache(
+    const String& cache_dir,
+    size_t max_size /* = kDefaultMaxSize */) :
+    cache_dir_(cache_dir),
+    max_size_(max_size),
+    size_(0) {
+  FileUtil::ls(cache_dir_, [this] (const String& file) -> bool {
+    if (!StringUtil::endsWith(file, kResultFileSuffix)) {
+      return true;
+    }
+
+    auto parts = StringUtil::split(file, ".");
+    if (parts.size() != 3) {
+      return true;
+    }
+
+    CacheEntry entry;
+    entry.path = FileUtil::joinPaths(cache_dir_, file);
+    entry.num_rows = std::stoull(parts[1]);
+    entry.size = FileUtil::size(entry.path);
+    entry.lru_pos = lru_.insert(lru_.end(), parts[0]);
+    size_ += entry.size;
+    entries_.emplace(parts[0], entry);
+    return true;
+  });
+}
+
+ScopedPtr<ResultCursor> ResultCache::get(const SHA1Hash& key) {
+  std::unique_lock<std::mutex> lk(mutex_);
+
+  auto entry = entries_.find(key.toString());
+  if (entry == entries_.end()) {
+    return ScopedPtr<ResultCursor>(nullptr);
+  }
+
+  /* move the entry to the front of the lru list */
+  lru_.splice(lru_.begin(), lru_, entry->second.lru_pos);
+
+  /* the file stays readable if the entry is evicted while it is read */
+  return mkScoped<ResultCursor>(
+      new ResultCacheReader(entry->second.path, entry->second.num_rows));
+}
+
+ScopedPtr<ResultCursor> ResultCache::store(
+    const SHA1Hash& key,
+    size_t num_columns,
+    ScopedPtr<ResultCursor> cursor) {
+  return mkScoped<ResultCursor>(
+      new ResultCacheWriter(this, key, num_columns, std::move(cursor)));
+}
+
+size_t ResultCache::size() const {
+  std::unique_lock<std::mutex> lk(mutex_);
+  return size_;
+}
+
+size_t ResultCache::numEntries() const {
+  std::unique_lock<std::mutex> lk(mutex_);
+  return entries_.size();
+}
+
+void ResultCache::commit(
+    const SHA1Hash& key,
+    const String& tmp_path,
+    size_t num_rows,
+    size_t size) {
+  std::unique_lock<std::mutex> lk(mutex_);
+
+  auto key_str = key.toString();
+  if (entries_.count(key_str) > 0) {
+    evict(key_str);
+  }
+
+  if (size > max_size_) {
+    FileUtil::rm(tmp_path);
+    return;
+  }
+
+  while (size_ + size > max_size_ && !lru_.empty()) {
+    auto victim = lru_.back();
+    evict(victim);
+  }
+
+  CacheEntry entry;
+  entry.path = FileUtil::joinPaths(
+      cache_dir_,
+      StringUtil::format("$0.$1$2", key_str, num_rows, kResultFileSuffix));
+  entry.num_rows = num_rows;
+  entry.size = size;
+  entry.lru_pos = lru_.insert(lru_.begin(), key_str);
+
+  FileUtil::mv(tmp_path, entry.path);
+  size_ += size;
+  entries_.emplace(key_str, entry);
+}
+
+void ResultCache::evict(const String& key) {
+  auto entry = entries_.find(key);
+  if (entry == entries_.end()) {
+    return;
+  }
+
+  FileUtil::rm(entry->second.path);
+  lru_.erase(entry->second.lru_pos);
+  size_ -= entry->second.size;
+  entries_.erase(entry);
+}
+
+} // namespace csql
@@ -0,0 +1,104 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <list>
+#include <mutex>
+#include <stx/stdtypes.h>
+#include <stx/autoref.h>
+#include <stx/SHA1.h>
+#include <csql/result_cursor.h>
+
+using namespace stx;
+
+namespace csql {
+
+/**
+ * Stores the output rows of tasks with a cache key (see TaskFactory::cacheKey)
+ * in the cache dir so that later queries with the same key read the rows from
+ * disk instead of executing the task. Each result is written in the spill
+ * file format to "<key>.<num_rows>.result", so the cache survives a restart
+ * of the process.
+ *
+ * The total size of all results is limited to max_size bytes. If a new result
+ * exceeds the limit, the least recently used results are deleted.
+ */
+class ResultCache : public RefCounted {
+public:
+
+  static const size_t kDefaultMaxSize;
+
+  /**
+   * Loads the results that are already stored in the cache dir
+   */
+  ResultCache(const String& cache_dir, size_t max_size = kDefaultMaxSize);
+
+  /**
+   * Returns a cursor over the cached rows for key or nullptr if there is no
+   * cached result for the key
+   */
+  ScopedPtr<ResultCursor> get(const SHA1Hash& key);
+
+  /**
+   * Returns a cursor that returns the rows of the provided cursor and writes
+   * them to the cache at the same time. The result is only added to the cache
+   * once all rows have been read. If the cursor is closed before that, the
+   * rows are discarded.
+   *
+   * num_columns must be the full width of the cursor's rows. All columns are
+   * stored, even if the first consumer reads fewer, so that later consumers
+   * of the cached result can read any number of columns
+   */
+  ScopedPtr<ResultCursor> store(
+      const SHA1Hash& key,
+      size_t num_columns,
+      ScopedPtr<ResultCursor> cursor);
+
+  /**
+   * Returns the total size of all cached results in bytes
+   */
+  size_t size() const;
+
+  /**
+   * Returns the number of cached results
+   */
+  size_t numEntries() const;
+
+protected:
+
+  struct CacheEntry {
+    String path;
+    size_t num_rows;
+    size_t size;
+    std::list<String>::iterator lru_pos;
+  };
+
+  friend class ResultCacheWriter;
+
+  /**
+   * Moves the file at tmp_path into the cache and evicts the least recently
+   * used results until the cache fits into max_size again
+   */
+  void commit(
+      const SHA1Hash& key,
+      const String& tmp_path,
+      size_t num_rows,
+      size_t size);
+
+  void evict(const String& key);
+
+  String cache_dir_;
+  size_t max_size_;
+  size_t size_;
+  HashMap<String, CacheEntry> entries_;
+  std::list<String> lru_;
+  mutable std::mutex mutex_;
+};
+
+} // namespace csql
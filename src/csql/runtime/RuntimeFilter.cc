@@ -0,0 +1,118 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stx/exception.h>
+#include <csql/runtime/RuntimeFilter.h>
+#include <csql/runtime/SortKey.h>
+
+using namespace stx;
+
+namespace csql {
+
+const size_t RuntimeFilter::kMaxKeys = 4 * 1024 * 1024;
+const size_t RuntimeFilter::kBitsPerKey = 10;
+const size_t RuntimeFilter::kNumHashes = 7;
+
+RuntimeFilter::RuntimeFilter() :
+    published_(false),
+    num_bits_(0),
+    empty_(true) {}
+
+void RuntimeFilter::publish(const Vector<String>& keys) {
+  if (published_.load(std::memory_order_acquire)) {
+    RAISE(kIllegalStateError, "runtime filter was already published");
+  }
+
+  size_t num_keys = 0;
+  for (const auto& key : keys) {
+    if (key.empty()) {
+      continue;
+    }
+
+    if (empty_ || SortKey::compare(key, min_key_) < 0) {
+      min_key_ = key;
+    }
+
+    if (empty_ || SortKey::compare(key, max_key_) > 0) {
+      max_key_ = key;
+    }
+
+    empty_ = false;
+    ++num_keys;
+  }
+
+  num_bits_ = 64;
+  while (num_bits_ < num_keys * kBitsPerKey) {
+    num_bits_ *= 2;
+  }
+
+  bits_.assign(num_bits_ / 64, 0);
+  for (const auto& key : keys) {
+    if (key.empty()) {
+      continue;
+    }
+
+    auto h1 = hashKey(key);
+    auto h2 = (h1 >> 32) | (h1 << 32) | 1;
+    for (size_t i = 0; i < kNumHashes; ++i) {
+      auto bit = (h1 + i * h2) & (num_bits_ - 1);
+      bits_[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+  }
+
+  published_.store(true, std::memory_order_release);
+}
+
+bool RuntimeFilter::isPublished() const {
+  return published_.load(std::memory_order_acquire);
+}
+
+bool RuntimeFilter::mightContain(const String& key) const {
+  if (!published_.load(std::memory_order_acquire)) {
+    return true;
+  }
+
+  if (empty_ || key.empty()) {
+    return false;
+  }
+
+  if (SortKey::compare(key, min_key_) < 0 ||
+      SortKey::compare(key, max_key_) > 0) {
+    return false;
+  }
+
+  auto h1 = hashKey(key);
+  auto h2 = (h1 >> 32) | (h1 << 32) | 1;
+  for (size_t i = 0; i < kNumHashes; ++i) {
+    auto bit = (h1 + i * h2) & (num_bits_ - 1);
+    if ((bits_[bit / 64] & (uint64_t(1) << (bit % 64))) == 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+uint64_t RuntimeFilter::hashKey(const String& key) {
+  /* FNV-1a followed by a murmur3 finalizer */
+  uint64_t h = 14695981039346656037ULL;
+  for (auto c : key) {
+    h ^= (unsigned char) c;
+    h *= 1099511628211ULL;
+  }
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9a34fe63ec5ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+} // namespace csql
@@ -0,0 +1,75 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <atomic>
+#include <stx/stdtypes.h>
+#include <stx/autoref.h>
+#include <stx/SHA1.h>
+
+using namespace stx;
+
+namespace csql {
+
+/**
+ * A filter on normalized join keys (see SortKey::encodeEquiJoinKey) that is
+ * published by a join once it has read its build side and applied by the scans
+ * on the probe side to drop rows that can't possibly match before they are
+ * handed to the join.
+ *
+ * The filter consists of the min/max range of all build keys and a bloom
+ * filter with kBitsPerKey bits and kNumHashes hash functions per key (~1%
+ * false positive rate). Until the filter is published all keys pass.
+ */
+class RuntimeFilter : public RefCounted {
+public:
+
+  static const size_t kMaxKeys;
+  static const size_t kBitsPerKey;
+  static const size_t kNumHashes;
+
+  RuntimeFilter();
+
+  /**
+   * Publish the filter for the provided build keys. Empty keys (i.e. NULL
+   * keys that never match) are ignored. Must be called at most once
+   */
+  void publish(const Vector<String>& keys);
+
+  bool isPublished() const;
+
+  /**
+   * Returns false if the key is definitely not contained in the build keys
+   */
+  bool mightContain(const String& key) const;
+
+protected:
+
+  static uint64_t hashKey(const String& key);
+
+  std::atomic<bool> published_;
+  Vector<uint64_t> bits_;
+  uint64_t num_bits_;
+  String min_key_;
+  String max_key_;
+  bool empty_;
+};
+
+/**
+ * Identifies the runtime filter that a scan applies to the provided output
+ * columns. The query plan only stores the spec; the filter itself is created
+ * once per execution of the plan (see Transaction::getRuntimeFilter), so that
+ * re-executing a plan never applies the filter of an earlier execution
+ */
+struct RuntimeFilterSpec {
+  SHA1Hash filter_id;
+  Vector<size_t> key_columns;
+};
+
+} // namespace csql
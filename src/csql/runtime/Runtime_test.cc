@@ -8,23 +8,66 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <math.h>
+#include <unistd.h>
+#include <functional>
 #include <stx/stdtypes.h>
 #include <stx/exception.h>
 #include <stx/wallclock.h>
+#include <stx/io/fileutil.h>
 #include <stx/test/unittest.h>
 #include "csql/runtime/defaultruntime.h"
 #include "csql/qtree/SequentialScanNode.h"
 #include "csql/qtree/ColumnReferenceNode.h"
 #include "csql/qtree/CallExpressionNode.h"
 #include "csql/qtree/LiteralExpressionNode.h"
+#include "csql/qtree/JoinNode.h"
+#include "csql/expressions/aggregate.h"
+#include "csql/expressions/boolean.h"
+#include "csql/runtime/SortKey.h"
+#include "csql/runtime/RuntimeFilter.h"
+#include "csql/runtime/HyperLogLog.h"
+#include "csql/runtime/TDigest.h"
+#include "csql/runtime/ResultCache.h"
+#include "csql/runtime/MemoryTracker.h"
+#include "csql/runtime/AdmissionController.h"
+#include "csql/runtime/SpillFile.h"
+#include "csql/runtime/DistinctSet.h"
+#include "csql/CSTableScan.h"
 #include "csql/CSTableScanProvider.h"
 #include "csql/backends/csv/CSVTableProvider.h"
+#include "csql/schedulers/local_scheduler.h"
+#include "csql/schedulers/exchange.h"
+#include "csql/tasks/orderby.h"
+#include "csql/tasks/hash_join.h"
+#include "csql/tasks/merge_join.h"
+#include "csql/tasks/nested_loop_join.h"
+#include "csql/tasks/limit.h"
+#include "csql/tasks/subquery.h"
+#include "csql/tasks/groupby.h"
 
 using namespace stx;
 using namespace csql;
 
 UNIT_TEST(RuntimeTest);
 
+/**
+ * Removes a cache dir created by a test and all files in it
+ */
+static void removeCacheDir(const String& cache_dir) {
+  Vector<String> files;
+  FileUtil::ls(cache_dir, [&files] (const String& file) -> bool {
+    files.emplace_back(file);
+    return true;
+  });
+
+  for (const auto& file : files) {
+    FileUtil::rm(FileUtil::joinPaths(cache_dir, file));
+  }
+
+  ::rmdir(cache_dir.c_str());
+}
+
 TEST_CASE(RuntimeTest, TestStaticExpression, [] () {
   auto runtime = Runtime::getDefaultRuntime();
   auto ctx = runtime->newTransaction();
@@ -198,6 +241,50 @@ TEST_CASE(RuntimeTest, TestNestedCSTableAggregate, [] () {
   EXPECT_EQ(result.getRow(0)[0], "704");
 });
 
+TEST_CASE(RuntimeTest, TestIncrementalCSTableAggregate, [] () {
+  auto cache_dir = makeSpillFilePath("/tmp", "csql_test_checkpoint");
+  FileUtil::mkdir(cache_dir);
+
+  auto runtime = Runtime::getDefaultRuntime();
+  runtime->setCacheDir(cache_dir);
+  auto ctx = runtime->newTransaction();
+
+  auto provider = new CSTableScanProvider(
+      "testtable",
+      "src/csql/testdata/testtbl.cst");
+  provider->setCheckpointKey(SHA1::compute("testtable"));
+
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(provider);
+
+  auto query = R"(
+    select count(1), count(event.search_query.time) from testtable;
+  )";
+
+  /* the second query only merges the checkpointed state */
+  for (size_t i = 0; i < 2; ++i) {
+    ResultList result;
+    auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+    qplan->execute(0, &result);
+    EXPECT_EQ(result.getNumRows(), 1);
+    EXPECT_EQ(result.getRow(0)[0], "213");
+    EXPECT_EQ(result.getRow(0)[1], "704");
+  }
+
+  size_t num_checkpoints = 0;
+  FileUtil::ls(cache_dir, [&num_checkpoints] (const String& file) -> bool {
+    if (StringUtil::endsWith(file, ".checkpoint")) {
+      ++num_checkpoints;
+    }
+
+    return true;
+  });
+
+  EXPECT_EQ(num_checkpoints, 1);
+
+  removeCacheDir(cache_dir);
+});
+
 TEST_CASE(RuntimeTest, TestWithinRecordCSTableAggregate, [] () {
   auto runtime = Runtime::getDefaultRuntime();
   auto ctx = runtime->newTransaction();
@@ -639,6 +726,264 @@ TEST_CASE(RuntimeTest, TestTruncateExpr, [] () {
   }
 });
 
+TEST_CASE(RuntimeTest, TestNormalizedSortKeys, [] () {
+  auto key = [] (const SValue& val, bool desc) -> String {
+    String key;
+    SortKey::encode(val, desc, &key);
+    return key;
+  };
+
+  EXPECT_TRUE(
+      SortKey::compare(key(SValue(), false), key(SValue(int64_t(-1)), false)) > 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(int64_t(-5)), false),
+          key(SValue(int64_t(3)), false)) < 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(double(-1.5)), false),
+          key(SValue(int64_t(-1)), false)) < 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(double(2.5)), false),
+          key(SValue(int64_t(3)), false)) < 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(int64_t(9007199254740993)), false),
+          key(SValue(int64_t(9007199254740994)), false)) < 0);
+
+  /* integers and floats beyond 2^53 that round to the same double */
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(int64_t(9007199254740995)), false),
+          key(SValue(double(9007199254740996.0)), false)) < 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(int64_t(9007199254740993)), false),
+          key(SValue(double(9007199254740992.0)), false)) > 0);
+  EXPECT_EQ(
+      SortKey::compare(
+          key(SValue(int64_t(9007199254740992)), false),
+          key(SValue(double(9007199254740992.0)), false)),
+      0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(int64_t(9223372036854775807)), false),
+          key(SValue(double(9223372036854775808.0)), false)) < 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(double(-9223372036854775808.0)), false),
+          key(SValue(int64_t(-9223372036854775807)), false)) < 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(double(-1e300)), false),
+          key(SValue(double(-9223372036854775808.0)), false)) < 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(String("ab")), false),
+          key(SValue(String("abc")), false)) < 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(String("a\0b", 3)), false),
+          key(SValue(String("a")), false)) > 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(String("ab")), true),
+          key(SValue(String("abc")), true)) > 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(int64_t(-5)), true),
+          key(SValue(int64_t(3)), true)) > 0);
+});
+
+TEST_CASE(RuntimeTest, TestNormalizedSortKeysNull, [] () {
+  auto key = [] (const SValue& val, bool desc) -> String {
+    String key;
+    SortKey::encode(val, desc, &key);
+    return key;
+  };
+
+  /* NULL sorts after numbers and strings in ASC and before them in DESC. The
+   * legacy comparison treated NULL as 0 against numbers and sorted it before
+   * 5, this is intentionally no longer the case */
+  EXPECT_TRUE(
+      SortKey::compare(key(SValue(), false), key(SValue(int64_t(5)), false)) > 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(), false),
+          key(SValue(int64_t(-5)), false)) > 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(), false),
+          key(SValue(String("zzz")), false)) > 0);
+  EXPECT_TRUE(
+      SortKey::compare(key(SValue(), true), key(SValue(int64_t(5)), true)) < 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(), true),
+          key(SValue(String("zzz")), true)) < 0);
+  EXPECT_EQ(SortKey::compare(key(SValue(), false), key(SValue(), false)), 0);
+
+  /* a NULL in the first column decides before any later column */
+  bool asc[] = { false, false };
+  SValue null_row[] = { SValue(), SValue(int64_t(1)) };
+  SValue value_row[] = { SValue(int64_t(1)), SValue(int64_t(2)) };
+  String null_key;
+  String value_key;
+  SortKey::encode(null_row, asc, 2, &null_key);
+  SortKey::encode(value_row, asc, 2, &value_key);
+  EXPECT_TRUE(SortKey::compare(null_key, value_key) > 0);
+});
+
+TEST_CASE(RuntimeTest, TestNormalizedSortKeysMixedTypes, [] () {
+  auto key = [] (const SValue& val, bool desc) -> String {
+    String key;
+    SortKey::encode(val, desc, &key);
+    return key;
+  };
+
+  /* numbers sort before strings, regardless of the string's content */
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(int64_t(100)), false),
+          key(SValue(String("1")), false)) < 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(double(1e300)), false),
+          key(SValue(String("")), false)) < 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(int64_t(100)), true),
+          key(SValue(String("1")), true)) > 0);
+
+  /* integers and floats are compared by value */
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(double(2.0)), false),
+          key(SValue(int64_t(3)), false)) < 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(double(-0.0)), false),
+          key(SValue(double(0.0)), false)) == 0);
+  EXPECT_TRUE(
+      SortKey::compare(
+          key(SValue(SValue::BoolType(false)), false),
+          key(SValue(SValue::BoolType(true)), false)) < 0);
+});
+
+TEST_CASE(RuntimeTest, TestNormalizedSortKeysEmbeddedNul, [] () {
+  auto key = [] (const String& val, bool desc) -> String {
+    String key;
+    SortKey::encode(SValue(val), desc, &key);
+    return key;
+  };
+
+  Vector<String> values = {
+    String(""),
+    String("\0", 1),
+    String("\0\0", 2),
+    String("\0a", 2),
+    String("a"),
+    String("a\0", 2),
+    String("a\0\0", 3),
+    String("a\0b", 3),
+    String("a\x01", 2),
+    String("ab"),
+    String("b")
+  };
+
+  /* the values are in byte order, the keys must sort the same way */
+  for (size_t i = 0; i + 1 < values.size(); ++i) {
+    EXPECT_TRUE(SortKey::compare(key(values[i], false), key(values[i + 1], false)) < 0);
+    EXPECT_TRUE(SortKey::compare(key(values[i], true), key(values[i + 1], true)) > 0);
+  }
+
+  /* keys are prefix free: the second column never leaks into the first */
+  bool asc[] = { false, false };
+  SValue left[] = { SValue(String("a")), SValue(String("\xff")) };
+  SValue right[] = { SValue(String("a\0", 2)), SValue(String("")) };
+  String left_key;
+  String right_key;
+  SortKey::encode(left, asc, 2, &left_key);
+  SortKey::encode(right, asc, 2, &right_key);
+  EXPECT_TRUE(SortKey::compare(left_key, right_key) < 0);
+});
+
+TEST_CASE(RuntimeTest, TestRuntimeFilter, [] () {
+  auto key = [] (const SValue& val) -> String {
+    String key;
+    SortKey::encodeJoinKey(val, &key);
+    return key;
+  };
+
+  Vector<String> build_keys;
+  for (int64_t i = 100; i < 200; i += 2) {
+    build_keys.emplace_back(key(SValue(i)));
+  }
+
+  RuntimeFilter filter;
+  EXPECT_TRUE(filter.mightContain(key(SValue(int64_t(1)))));
+
+  filter.publish(build_keys);
+  EXPECT_TRUE(filter.isPublished());
+
+  for (const auto& k : build_keys) {
+    EXPECT_TRUE(filter.mightContain(k));
+  }
+
+  EXPECT_TRUE(filter.mightContain(key(SValue(double(100.0)))));
+  EXPECT_EQ(filter.mightContain(key(SValue(int64_t(99)))), false);
+  EXPECT_EQ(filter.mightContain(key(SValue(int64_t(200)))), false);
+  EXPECT_EQ(filter.mightContain(key(SValue(String("150")))), false);
+  EXPECT_EQ(filter.mightContain(String()), false);
+});
+
+TEST_CASE(RuntimeTest, TestRuntimeFilterPerExecution, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto txn = runtime->newTransaction();
+
+  /* the join and its scans share one filter per execution */
+  auto filter_id = SHA1::compute("filter");
+  auto filter = txn->getRuntimeFilter(filter_id);
+  EXPECT_TRUE(txn->getRuntimeFilter(filter_id).get() == filter.get());
+  filter->publish(Vector<String>{ "a" });
+
+  txn->clearRuntimeFilters();
+  auto next_filter = txn->getRuntimeFilter(filter_id);
+  EXPECT_TRUE(next_filter.get() != filter.get());
+  EXPECT_EQ(next_filter->isPublished(), false);
+
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "departments",
+          "src/csql/testdata/testtbl5.csv",
+          '\t'));
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "users",
+          "src/csql/testdata/testtbl6.csv",
+          '\t'));
+
+  auto query = R"(
+    SELECT username
+    FROM departments
+    JOIN users
+    ON users.deptid = departments.deptid;
+  )";
+
+  /* re-executing the plan must not apply the filter of the last execution */
+  auto qplan = runtime->buildQueryPlan(txn.get(), query, estrat.get());
+  auto qtree = qplan->getStatementQTree(0)->toString();
+  for (size_t i = 0; i < 3; ++i) {
+    ResultList result;
+    qplan->execute(0, &result);
+    EXPECT_EQ(result.getNumRows(), 3);
+  }
+
+  EXPECT_EQ(qplan->getStatementQTree(0)->toString(), qtree);
+});
+
 TEST_CASE(RuntimeTest, TestWildcardSelect, [] () {
   auto runtime = Runtime::getDefaultRuntime();
   auto ctx = runtime->newTransaction();
@@ -1460,6 +1805,53 @@ TEST_CASE(RuntimeTest, TestSimpleSelect, [] () {
 });
 
 
+TEST_CASE(RuntimeTest, TestSelectWithOrderLimitOffset, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto ctx = runtime->newTransaction();
+
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "customers",
+          "src/csql/testdata/testtbl2.csv",
+          '\t'));
+
+  {
+    ResultList result;
+    auto query = R"(
+      SELECT customername
+      FROM customers
+      ORDER BY customername
+      LIMIT 2 OFFSET 1;
+    )";
+
+    auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+    qplan->execute(0, &result);
+    EXPECT_EQ(result.getNumColumns(), 1);
+    EXPECT_EQ(result.getNumRows(), 2);
+    EXPECT_EQ(result.getRow(0)[0], "Ana Trujillo Emparedados y helados");
+    EXPECT_EQ(result.getRow(1)[0], "Antonio Moreno Taquería");
+  }
+
+  {
+    ResultList result;
+    auto query = R"(
+      SELECT customerid, customername
+      FROM customers
+      WHERE customerid > 1
+      LIMIT 2;
+    )";
+
+    auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+    qplan->execute(0, &result);
+    EXPECT_EQ(result.getNumColumns(), 2);
+    EXPECT_EQ(result.getNumRows(), 2);
+    EXPECT_EQ(result.getRow(0)[0], "2");
+    EXPECT_EQ(result.getRow(1)[0], "3");
+  }
+});
+
+
 TEST_CASE(RuntimeTest, TestSimpleSubSelect, [] () {
   auto runtime = Runtime::getDefaultRuntime();
   auto ctx = runtime->newTransaction();
@@ -1476,6 +1868,33 @@ TEST_CASE(RuntimeTest, TestSimpleSubSelect, [] () {
   EXPECT_EQ(result.getRow(0)[1], "123");
 });
 
+TEST_CASE(RuntimeTest, TestSubSelectWithLimit, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto ctx = runtime->newTransaction();
+
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "customers",
+          "src/csql/testdata/testtbl2.csv",
+          '\t'));
+
+  ResultList result;
+  auto query = R"(
+    SELECT t1.name
+    FROM (SELECT customerid AS id, customername AS name FROM customers) t1
+    WHERE t1.id > 1
+    LIMIT 2 OFFSET 1;
+  )";
+
+  auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+  qplan->execute(0, &result);
+  EXPECT_EQ(result.getNumColumns(), 1);
+  EXPECT_EQ(result.getNumRows(), 2);
+  EXPECT_EQ(result.getRow(0)[0], "Antonio Moreno Taquería");
+  EXPECT_EQ(result.getRow(1)[0], "Around the Horn");
+});
+
 TEST_CASE(RuntimeTest, TestWildcardOnSubselect, [] () {
   auto runtime = Runtime::getDefaultRuntime();
   auto ctx = runtime->newTransaction();
@@ -2104,6 +2523,2636 @@ TEST_CASE(RuntimeTest, TestNaturalJoin, [] () {
   }
 });
 
+TEST_CASE(RuntimeTest, TestSubqueryPredicates, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto ctx = runtime->newTransaction();
+
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "customers",
+          "src/csql/testdata/testtbl2.csv",
+          '\t'));
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "orders",
+          "src/csql/testdata/testtbl3.csv",
+          '\t'));
+
+  {
+    ResultList result;
+    auto query = R"(
+      SELECT customername
+      FROM customers
+      WHERE customerid IN (SELECT customerid FROM orders)
+      ORDER BY customername;
+    )";
+
+    auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+    qplan->execute(0, &result);
+    EXPECT_EQ(result.getNumColumns(), 1);
+    EXPECT_EQ(result.getNumRows(), 74);
+    EXPECT_EQ(result.getRow(0)[0], "Ana Trujillo Emparedados y helados");
+    EXPECT_EQ(result.getRow(73)[0], "Wolski");
+  }
+
+  {
+    ResultList result;
+    auto query = R"(
+      SELECT customername
+      FROM customers
+      WHERE customerid NOT IN (SELECT customerid FROM orders)
+      ORDER BY customername;
+    )";
+
+    auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+    qplan->execute(0, &result);
+    EXPECT_EQ(result.getNumColumns(), 1);
+    EXPECT_EQ(result.getNumRows(), 17);
+    EXPECT_EQ(result.getRow(0)[0], "Alfreds Futterkiste");
+    EXPECT_EQ(result.getRow(16)[0], "Trail's Head Gourmet Provisioners");
+  }
+
+  {
+    ResultList result;
+    auto query = R"(
+      SELECT customers.customername
+      FROM customers
+      WHERE customers.country = 'Germany' AND EXISTS (
+        SELECT orderid FROM orders
+        WHERE orders.customerid = customers.customerid AND shipperid = 3)
+      ORDER BY customers.customername;
+    )";
+
+    auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+    qplan->execute(0, &result);
+    EXPECT_EQ(result.getNumColumns(), 1);
+    EXPECT_EQ(result.getNumRows(), 5);
+    EXPECT_EQ(result.getRow(0)[0], "Drachenblut Delikatessend");
+    EXPECT_EQ(result.getRow(4)[0], "QUICK-Stop");
+  }
+});
+
+TEST_CASE(RuntimeTest, TestParallelScheduler, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto ctx = runtime->newTransaction();
+
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "customers",
+          "src/csql/testdata/testtbl2.csv",
+          '\t'));
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "orders",
+          "src/csql/testdata/testtbl3.csv",
+          '\t'));
+
+  auto query = R"(
+    SELECT customername
+    FROM customers
+    WHERE customerid IN (SELECT customerid FROM orders)
+    ORDER BY customername;
+  )";
+
+  ResultList expected;
+  {
+    auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+    qplan->setScheduler(LocalScheduler::getFactory(1));
+    qplan->execute(0, &expected);
+  }
+
+  ResultList result;
+  {
+    auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+    qplan->setScheduler(LocalScheduler::getFactory(4));
+    qplan->execute(0, &result);
+  }
+
+  EXPECT_EQ(expected.getNumRows(), 74);
+  EXPECT_EQ(result.getNumRows(), expected.getNumRows());
+  for (size_t i = 0; i < result.getNumRows(); ++i) {
+    EXPECT_EQ(result.getRow(i)[0], expected.getRow(i)[0]);
+  }
+});
+
+TEST_CASE(RuntimeTest, TestMorselDrivenScan, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto ctx = runtime->newTransaction();
+
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "gdp",
+          "src/csql/testdata/gdp_per_capita.csv",
+          ','));
+
+  auto query = R"(
+    SELECT count(1), sum(year), max(country)
+    FROM gdp
+    WHERE year > 2005;
+  )";
+
+  ResultList expected;
+  {
+    auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+    qplan->setScheduler(LocalScheduler::getFactory(1));
+    qplan->execute(0, &expected);
+  }
+
+  ResultList result;
+  {
+    auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+    qplan->setScheduler(LocalScheduler::getFactory(4));
+    qplan->execute(0, &result);
+  }
+
+  EXPECT_EQ(result.getNumRows(), 1);
+  EXPECT_EQ(result.getRow(0)[0], expected.getRow(0)[0]);
+  EXPECT_EQ(result.getRow(0)[1], expected.getRow(0)[1]);
+  EXPECT_EQ(result.getRow(0)[2], expected.getRow(0)[2]);
+
+  /* the limit applies to the rows of all workers together */
+  {
+    ResultList limited;
+    auto qplan = runtime->buildQueryPlan(
+        ctx.get(),
+        "SELECT country FROM (SELECT country, year FROM gdp) LIMIT 1500;",
+        estrat.get());
+    qplan->setScheduler(LocalScheduler::getFactory(4));
+    qplan->execute(0, &limited);
+    EXPECT_EQ(limited.getNumRows(), 1500);
+  }
+});
+
+class IntegerRangeCursor : public ResultCursor {
+public:
+
+  IntegerRangeCursor(int64_t begin, int64_t end) : pos_(begin), end_(end) {}
+
+  bool next(SValue* row, int row_len) override {
+    if (pos_ == end_) {
+      return false;
+    }
+
+    row[0] = SValue(SValue::IntegerType(pos_++));
+    return true;
+  }
+
+protected:
+  int64_t pos_;
+  int64_t end_;
+};
+
+class RowListCursor : public ResultCursor {
+public:
+
+  RowListCursor(Vector<Vector<SValue>> rows) : rows_(std::move(rows)), pos_(0) {}
+
+  bool next(SValue* row, int row_len) override {
+    if (pos_ == rows_.size()) {
+      return false;
+    }
+
+    const auto& src = rows_[pos_++];
+    for (size_t i = 0; i < src.size() && i < size_t(row_len); ++i) {
+      row[i] = src[i];
+    }
+
+    return true;
+  }
+
+protected:
+  Vector<Vector<SValue>> rows_;
+  size_t pos_;
+};
+
+TEST_CASE(RuntimeTest, TestParallelOrderBy, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto txn = runtime->newTransaction();
+
+  /* enough rows for the partitioned radix sort and the multiway merge */
+  auto num_rows = 2 * OrderBy::kMinRowsPerPartition + 1234;
+
+  /* (key1 ASC, key2 DESC, input position) with duplicates and NULLs */
+  Vector<Vector<SValue>> rows;
+  for (size_t i = 0; i < num_rows; ++i) {
+    Vector<SValue> row(3);
+    if (i % 13 != 0) {
+      row[0] = SValue(SValue::IntegerType((i * 7919) % 97));
+    }
+
+    if (i % 17 != 0) {
+      row[1] = SValue(StringUtil::format("s$0", (i * 31) % 23));
+    }
+
+    row[2] = SValue(SValue::IntegerType(i));
+    rows.emplace_back(row);
+  }
+
+  /* the expected order: std::stable_sort over the same keys */
+  Vector<std::pair<String, size_t>> expected;
+  for (size_t i = 0; i < num_rows; ++i) {
+    String key;
+    SortKey::encode(rows[i][0], false, &key);
+    SortKey::encode(rows[i][1], true, &key);
+    expected.emplace_back(key, i);
+  }
+
+  std::stable_sort(
+      expected.begin(),
+      expected.end(),
+      [] (
+          const std::pair<String, size_t>& left,
+          const std::pair<String, size_t>& right) -> bool {
+    return SortKey::compare(left.first, right.first) < 0;
+  });
+
+  Vector<OrderByFactory::SortExpr> sort_specs;
+  {
+    OrderByFactory::SortExpr spec;
+    spec.expr = new ColumnReferenceNode(size_t(0));
+    spec.descending = false;
+    sort_specs.emplace_back(spec);
+  }
+  {
+    OrderByFactory::SortExpr spec;
+    spec.expr = new ColumnReferenceNode(size_t(1));
+    spec.descending = true;
+    sort_specs.emplace_back(spec);
+  }
+
+  HashMap<TaskID, ScopedPtr<ResultCursor>> input;
+  input.emplace(SHA1::compute("input"), mkScoped(new RowListCursor(rows)));
+
+  OrderByFactory factory(sort_specs, 3);
+  auto task = factory.build(txn.get(), std::move(input));
+
+  /* ties keep their input order, so the exact positions must match */
+  size_t n = 0;
+  Vector<SValue> out(3);
+  while (task->nextRow(out.data(), out.size())) {
+    EXPECT_TRUE(n < num_rows);
+    if (n >= num_rows) {
+      break;
+    }
+
+    EXPECT_EQ(size_t(out[2].getInteger()), expected[n].second);
+    ++n;
+  }
+
+  EXPECT_EQ(n, num_rows);
+});
+
+TEST_CASE(RuntimeTest, TestOrderByLongCommonPrefix, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto txn = runtime->newTransaction();
+
+  /* keys that share far more than kMaxRadixSortDepth bytes and only differ
+   * at the end, in a range of rows that no single radix pass splits */
+  String prefix(256, 'x');
+  size_t num_rows = 10000;
+  Vector<Vector<SValue>> rows;
+  for (size_t i = 0; i < num_rows; ++i) {
+    Vector<SValue> row(2);
+    row[0] = SValue(StringUtil::format("$0$1", prefix, (i * 7919) % 101));
+    row[1] = SValue(SValue::IntegerType(i));
+    rows.emplace_back(row);
+  }
+
+  Vector<std::pair<String, size_t>> expected;
+  for (size_t i = 0; i < num_rows; ++i) {
+    expected.emplace_back(rows[i][0].getString(), i);
+  }
+
+  std::stable_sort(
+      expected.begin(),
+      expected.end(),
+      [] (
+          const std::pair<String, size_t>& left,
+          const std::pair<String, size_t>& right) -> bool {
+    return left.first < right.first;
+  });
+
+  Vector<OrderByFactory::SortExpr> sort_specs;
+  {
+    OrderByFactory::SortExpr spec;
+    spec.expr = new ColumnReferenceNode(size_t(0));
+    spec.descending = false;
+    sort_specs.emplace_back(spec);
+  }
+
+  HashMap<TaskID, ScopedPtr<ResultCursor>> input;
+  input.emplace(SHA1::compute("input"), mkScoped(new RowListCursor(rows)));
+
+  OrderByFactory factory(sort_specs, 2);
+  auto task = factory.build(txn.get(), std::move(input));
+
+  size_t n = 0;
+  Vector<SValue> out(2);
+  while (task->nextRow(out.data(), out.size())) {
+    EXPECT_TRUE(n < num_rows);
+    if (n >= num_rows) {
+      break;
+    }
+
+    EXPECT_EQ(size_t(out[1].getInteger()), expected[n].second);
+    ++n;
+  }
+
+  EXPECT_EQ(n, num_rows);
+});
+
+/**
+ * The join tests use (key, id, val) rows on both sides. The input row of the
+ * join is: base key, base id, base val, joined key, joined id, joined val
+ */
+static Vector<JoinNode::InputColumnRef> joinTestInputMap() {
+  Vector<JoinNode::InputColumnRef> input_map;
+  for (size_t table_idx = 0; table_idx < 2; ++table_idx) {
+    for (size_t column_idx = 0; column_idx < 3; ++column_idx) {
+      JoinNode::InputColumnRef ref;
+      ref.table_idx = table_idx;
+      ref.column_idx = column_idx;
+      input_map.emplace_back(ref);
+    }
+  }
+
+  return input_map;
+}
+
+/**
+ * Selects the base and joined ids
+ */
+static Vector<RefPtr<SelectListNode>> joinTestSelectList() {
+  Vector<RefPtr<SelectListNode>> select_exprs;
+  select_exprs.emplace_back(
+      new SelectListNode(new ColumnReferenceNode(size_t(1))));
+  select_exprs.emplace_back(
+      new SelectListNode(new ColumnReferenceNode(size_t(4))));
+  return select_exprs;
+}
+
+/**
+ * Runs a join task and returns the sorted "base id|joined id" result rows
+ */
+static Vector<String> runJoinTask(
+    Transaction* txn,
+    const TaskFactory& factory,
+    const Vector<Vector<SValue>>& base_rows,
+    const Vector<Vector<SValue>>& joined_rows,
+    TaskStats* stats = nullptr) {
+  HashMap<TaskID, ScopedPtr<ResultCursor>> input;
+  input.emplace(
+      SHA1::compute("base"),
+      mkScoped(new RowListCursor(base_rows)));
+  input.emplace(
+      SHA1::compute("joined"),
+      mkScoped(new RowListCursor(joined_rows)));
+  auto task = factory.build(txn, std::move(input));
+
+  Vector<String> result;
+  Vector<SValue> out(2);
+  while (task->nextRow(out.data(), out.size())) {
+    result.emplace_back(out[0].getString() + "|" + out[1].getString());
+  }
+
+  if (stats) {
+    task->collectStats(stats);
+  }
+
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+template <typename JoinFactoryType = HashJoinFactory>
+static Vector<String> runEquiJoin(
+    Transaction* txn,
+    JoinType join_type,
+    const Vector<Vector<SValue>>& base_rows,
+    const Vector<Vector<SValue>>& joined_rows,
+    bool with_join_cond,
+    TaskStats* stats = nullptr) {
+  Vector<JoinNode::EquiJoinKey> join_keys;
+  {
+    JoinNode::EquiJoinKey key;
+    key.base_key = new ColumnReferenceNode(size_t(0));
+    key.joined_key = new ColumnReferenceNode(size_t(3));
+    join_keys.emplace_back(key);
+  }
+
+  /* base.val < joined.val */
+  Option<RefPtr<ValueExpressionNode>> join_cond;
+  if (with_join_cond) {
+    join_cond = Some(RefPtr<ValueExpressionNode>(
+        new CallExpressionNode(
+            "lt",
+            Vector<RefPtr<ValueExpressionNode>> {
+              new ColumnReferenceNode(size_t(2)),
+              new ColumnReferenceNode(size_t(5))
+            })));
+  }
+
+  JoinFactoryType factory(
+      join_type,
+      Set<TaskID> { SHA1::compute("base") },
+      Set<TaskID> { SHA1::compute("joined") },
+      joinTestInputMap(),
+      joinTestSelectList(),
+      join_keys,
+      join_cond,
+      None<RefPtr<ValueExpressionNode>>());
+
+  return runJoinTask(txn, factory, base_rows, joined_rows, stats);
+}
+
+TEST_CASE(RuntimeTest, TestHashJoinMixedKeyTypes, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto txn = runtime->newTransaction();
+
+  auto row = [] (SValue key, const String& id, int64_t val) {
+    return Vector<SValue> {
+      key,
+      SValue(id),
+      SValue(SValue::IntegerType(val))
+    };
+  };
+
+  /* the join matches exactly the pairs for which base.key = joined.key */
+  Vector<Vector<SValue>> base_rows = {
+    row(SValue("5"), "b1", 1),
+    row(SValue(SValue::IntegerType(7)), "b2", 9),
+    row(SValue(), "b3", 1),
+    row(SValue("05"), "b4", 1),
+    row(SValue(SValue::FloatType(2.5)), "b5", 1),
+    row(SValue("x"), "b6", 1),
+  };
+
+  Vector<Vector<SValue>> joined_rows = {
+    row(SValue(SValue::IntegerType(5)), "j1", 5),
+    row(SValue("7"), "j2", 5),
+    row(SValue(), "j3", 5),
+    row(SValue("2.500000"), "j4", 5),
+    row(SValue(SValue::FloatType(5.0)), "j5", 5),
+    row(SValue("x"), "j6", 5),
+  };
+
+  /* pad either side so that the base table is the build side (it ends
+   * first) or the probe side */
+  auto base_build = base_rows;
+  auto base_probe = base_rows;
+  auto joined_build = joined_rows;
+  auto joined_probe = joined_rows;
+  for (int i = 0; i < 3; ++i) {
+    joined_probe.emplace_back(
+        row(SValue(StringUtil::format("p$0", i)), "jp", 5));
+    base_probe.emplace_back(
+        row(SValue(StringUtil::format("p$0", i + 10)), "bp", 1));
+  }
+
+  Vector<String> inner = { "b1|j1", "b2|j2", "b5|j4", "b6|j6" };
+  Vector<String> outer = {
+    "b1|j1", "b2|j2", "b3|NULL", "b4|NULL", "b5|j4", "b6|j6"
+  };
+
+  Vector<String> outer_probe = outer;
+  for (int i = 0; i < 3; ++i) {
+    outer_probe.emplace_back("bp|NULL");
+  }
+
+  std::sort(outer_probe.begin(), outer_probe.end());
+
+  EXPECT_TRUE(
+      runEquiJoin(txn.get(), JoinType::INNER, base_rows, joined_rows, false)
+      == inner);
+
+  EXPECT_TRUE(
+      runEquiJoin(
+          txn.get(),
+          JoinType::OUTER,
+          base_build,
+          joined_probe,
+          false) == outer);
+
+  EXPECT_TRUE(
+      runEquiJoin(
+          txn.get(),
+          JoinType::OUTER,
+          base_probe,
+          joined_build,
+          false) == outer_probe);
+
+  /* the residual condition base.val < joined.val rejects b2|j2 */
+  Vector<String> inner_cond = { "b1|j1", "b5|j4", "b6|j6" };
+  Vector<String> outer_cond = {
+    "b1|j1", "b2|NULL", "b3|NULL", "b4|NULL", "b5|j4", "b6|j6"
+  };
+
+  EXPECT_TRUE(
+      runEquiJoin(txn.get(), JoinType::INNER, base_rows, joined_rows, true)
+      == inner_cond);
+
+  EXPECT_TRUE(
+      runEquiJoin(
+          txn.get(),
+          JoinType::OUTER,
+          base_build,
+          joined_probe,
+          true) == outer_cond);
+
+  Vector<String> outer_cond_probe = outer_cond;
+  for (int i = 0; i < 3; ++i) {
+    outer_cond_probe.emplace_back("bp|NULL");
+  }
+
+  std::sort(outer_cond_probe.begin(), outer_cond_probe.end());
+
+  EXPECT_TRUE(
+      runEquiJoin(
+          txn.get(),
+          JoinType::OUTER,
+          base_probe,
+          joined_build,
+          true) == outer_cond_probe);
+
+  /* join key equality follows the = operator */
+  auto eq = [&txn] (SValue a, SValue b) -> bool {
+    SValue args[2] = { a, b };
+    SValue res;
+    expressions::eqExpr(Transaction::get(txn.get()), 2, args, &res);
+    return res.getBool();
+  };
+
+  EXPECT_TRUE(eq(SValue("5"), SValue(SValue::IntegerType(5))));
+  EXPECT_TRUE(!eq(SValue("05"), SValue(SValue::IntegerType(5))));
+  EXPECT_TRUE(!eq(SValue("5"), SValue(SValue::FloatType(5.0))));
+  EXPECT_TRUE(eq(SValue("2.500000"), SValue(SValue::FloatType(2.5))));
+});
+
+TEST_CASE(RuntimeTest, TestEquiJoinKeyBoolAndTimestamp, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto txn = runtime->newTransaction();
+
+  auto eq = [&txn] (SValue a, SValue b) -> bool {
+    SValue args[2] = { a, b };
+    SValue res;
+    expressions::eqExpr(Transaction::get(txn.get()), 2, args, &res);
+    return res.getBool();
+  };
+
+  auto ts = [] (uint64_t micros) {
+    return SValue(SValue::TimeType(micros));
+  };
+
+  auto ts_str = ts(1451606400000000).getString();
+
+  Vector<SValue> values = {
+    SValue(true),
+    SValue(false),
+    SValue(SValue::IntegerType(1)),
+    SValue(SValue::IntegerType(0)),
+    SValue(SValue::IntegerType(5)),
+    SValue(SValue::FloatType(1.0)),
+    SValue("true"),
+    SValue("false"),
+    SValue("1"),
+    SValue("x"),
+    ts(1451606400000000),
+    ts(1451606400000001),
+    ts(1451606401000000),
+    SValue(ts_str),
+    SValue(SValue::IntegerType(1451606400000000)),
+  };
+
+  /* any two values that are equal according to = have equal join keys and
+   * keys that are equal but marked exact on both sides are equal values */
+  for (const auto& a : values) {
+    for (const auto& b : values) {
+      String a_key;
+      String b_key;
+      bool a_exact = true;
+      bool b_exact = true;
+      EXPECT_TRUE(SortKey::encodeEquiJoinKey(a, &a_key, &a_exact));
+      EXPECT_TRUE(SortKey::encodeEquiJoinKey(b, &b_key, &b_exact));
+
+      auto is_eq = eq(a, b);
+      EXPECT_EQ(is_eq, eq(b, a));
+      if (is_eq) {
+        EXPECT_TRUE(a_key == b_key);
+      } else if (a_key == b_key) {
+        EXPECT_FALSE(a_exact && b_exact);
+      }
+    }
+  }
+
+  EXPECT_TRUE(eq(SValue(true), SValue(SValue::IntegerType(1))));
+  EXPECT_FALSE(eq(SValue(true), SValue(SValue::IntegerType(5))));
+  EXPECT_TRUE(eq(SValue(false), SValue(SValue::FloatType(0.0))));
+  EXPECT_TRUE(eq(SValue(true), SValue("true")));
+  EXPECT_FALSE(eq(SValue(true), SValue("1")));
+  EXPECT_TRUE(eq(ts(1451606400000000), ts(1451606400000000)));
+  EXPECT_FALSE(eq(ts(1451606400000000), ts(1451606400000001)));
+  EXPECT_TRUE(eq(ts(1451606400000001), SValue(ts_str)));
+  EXPECT_FALSE(
+      eq(ts(1451606400000000), SValue(SValue::IntegerType(1451606400000000))));
+
+  /* the hash join matches the same pairs */
+  auto row = [] (SValue key, const String& id) {
+    return Vector<SValue> {
+      key,
+      SValue(id),
+      SValue(SValue::IntegerType(1))
+    };
+  };
+
+  Vector<Vector<SValue>> base_rows = {
+    row(SValue(true), "b1"),
+    row(ts(1451606400000000), "b2"),
+    row(SValue(false), "b3"),
+    row(ts(1451606400000001), "b4"),
+  };
+
+  Vector<Vector<SValue>> joined_rows = {
+    row(SValue(SValue::IntegerType(1)), "j1"),
+    row(ts(1451606400000000), "j2"),
+    row(SValue("false"), "j3"),
+    row(SValue(SValue::IntegerType(5)), "j4"),
+    row(SValue(ts_str), "j5"),
+  };
+
+  Vector<String> inner = { "b1|j1", "b2|j2", "b2|j5", "b3|j3", "b4|j5" };
+  EXPECT_TRUE(
+      runEquiJoin(txn.get(), JoinType::INNER, base_rows, joined_rows, false)
+      == inner);
+});
+
+TEST_CASE(RuntimeTest, TestHashJoinSpill, [] () {
+  auto cache_dir = makeSpillFilePath("/tmp", "csql_test_hashjoin");
+  FileUtil::mkdir(cache_dir);
+
+  auto runtime = Runtime::getDefaultRuntime();
+  runtime->setCacheDir(cache_dir);
+
+  auto row = [] (SValue key, const String& id, int64_t val) {
+    return Vector<SValue> {
+      key,
+      SValue(id),
+      SValue(SValue::IntegerType(val))
+    };
+  };
+
+  /* integer keys on one side and string keys on the other, NULL keys and
+   * unmatched rows on both sides */
+  auto make_rows = [&row] (
+      size_t num_rows,
+      size_t num_keys,
+      bool string_keys,
+      const String& id_prefix) {
+    Vector<Vector<SValue>> rows;
+    for (size_t i = 0; i < num_rows; ++i) {
+      SValue key;
+      if (i % 13 != 0) {
+        auto k = (i * 7) % num_keys;
+        key = string_keys ?
+            SValue(StringUtil::toString(k)) :
+            SValue(SValue::IntegerType(k));
+      }
+
+      rows.emplace_back(
+          row(key, StringUtil::format("$0$1", id_prefix, i), i % 5));
+    }
+
+    return rows;
+  };
+
+  /* the side with the smaller rows becomes the build side while spilling */
+  auto small_base = make_rows(1500, 600, false, "b");
+  auto large_joined = make_rows(1000, 700, true, "joined-row-");
+  auto large_base = make_rows(1500, 600, false, "base-row-");
+  auto small_joined = make_rows(1000, 700, true, "j");
+
+  /* all rows share a single key, so no partition can ever be split up */
+  Vector<Vector<SValue>> skewed_base;
+  Vector<Vector<SValue>> skewed_joined;
+  for (size_t i = 0; i < 300; ++i) {
+    skewed_base.emplace_back(
+        row(SValue(SValue::IntegerType(1)), StringUtil::format("b$0", i), 1));
+  }
+
+  for (size_t i = 0; i < 200; ++i) {
+    skewed_joined.emplace_back(
+        row(SValue("1"), StringUtil::format("joined-row-$0", i), 2));
+  }
+
+  struct JoinCase {
+    JoinType join_type;
+    const Vector<Vector<SValue>>* base;
+    const Vector<Vector<SValue>>* joined;
+    bool with_join_cond;
+  };
+
+  Vector<JoinCase> cases = {
+    { JoinType::INNER, &small_base, &large_joined, false },
+    { JoinType::INNER, &large_base, &small_joined, true },
+    { JoinType::OUTER, &small_base, &large_joined, false },
+    { JoinType::OUTER, &large_base, &small_joined, false },
+    { JoinType::OUTER, &small_base, &large_joined, true },
+    { JoinType::INNER, &skewed_base, &skewed_joined, false },
+    { JoinType::OUTER, &skewed_base, &skewed_joined, true },
+  };
+
+  for (const auto& c : cases) {
+    runtime->setMemoryLimits(0, 0);
+    Vector<String> expected;
+    {
+      auto txn = runtime->newTransaction();
+      TaskStats stats;
+      expected = runEquiJoin(
+          txn.get(),
+          c.join_type,
+          *c.base,
+          *c.joined,
+          c.with_join_cond,
+          &stats);
+
+      EXPECT_EQ(stats.spill_bytes.load(), 0);
+    }
+
+    EXPECT_TRUE(expected.size() > 0);
+
+    /* with a soft limit of one byte every partition is repartitioned until
+     * kMaxSpillDepth is reached */
+    runtime->setMemoryLimits(1, 0);
+    {
+      auto txn = runtime->newTransaction();
+      TaskStats stats;
+      auto result = runEquiJoin(
+          txn.get(),
+          c.join_type,
+          *c.base,
+          *c.joined,
+          c.with_join_cond,
+          &stats);
+
+      EXPECT_EQ(result.size(), expected.size());
+      EXPECT_TRUE(result == expected);
+      EXPECT_TRUE(stats.spill_bytes.load() > 0);
+      EXPECT_TRUE(stats.bytes_read.load() > 0);
+    }
+
+    /* all spill files are removed */
+    size_t num_files = 0;
+    FileUtil::ls(cache_dir, [&num_files] (const String& file) -> bool {
+      if (StringUtil::beginsWith(file, "hashjoin.")) {
+        ++num_files;
+      }
+
+      return true;
+    });
+
+    EXPECT_EQ(num_files, 0);
+  }
+
+  /* the unmatched base rows are part of the OUTER join result */
+  {
+    auto txn = runtime->newTransaction();
+    auto inner = runEquiJoin(
+        txn.get(),
+        JoinType::INNER,
+        small_base,
+        large_joined,
+        false);
+
+    auto outer = runEquiJoin(
+        txn.get(),
+        JoinType::OUTER,
+        small_base,
+        large_joined,
+        false);
+
+    EXPECT_TRUE(outer.size() > inner.size());
+  }
+
+  runtime->setMemoryLimits(0, 0);
+
+  removeCacheDir(cache_dir);
+});
+
+TEST_CASE(RuntimeTest, TestMergeJoin, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto txn = runtime->newTransaction();
+
+  auto row = [] (SValue key, const String& id, int64_t val) {
+    return Vector<SValue> {
+      key,
+      SValue(id),
+      SValue(SValue::IntegerType(val))
+    };
+  };
+
+  auto ikey = [] (int64_t k) { return SValue(SValue::IntegerType(k)); };
+
+  /* both inputs sorted ascending with NULLs last and runs of duplicate
+   * keys on both sides */
+  Vector<Vector<SValue>> base_rows = {
+    row(ikey(1), "b1", 1),
+    row(ikey(2), "b2", 1),
+    row(ikey(2), "b3", 9),
+    row(ikey(4), "b4", 1),
+    row(ikey(5), "b5", 1),
+    row(SValue(), "b6", 1),
+  };
+
+  Vector<Vector<SValue>> joined_rows = {
+    row(ikey(2), "j1", 5),
+    row(ikey(2), "j2", 5),
+    row(ikey(3), "j3", 5),
+    row(ikey(4), "j4", 5),
+    row(ikey(6), "j5", 5),
+    row(SValue(), "j6", 5),
+  };
+
+  Vector<String> inner = { "b2|j1", "b2|j2", "b3|j1", "b3|j2", "b4|j4" };
+  Vector<String> outer = {
+    "b1|NULL", "b2|j1", "b2|j2", "b3|j1", "b3|j2", "b4|j4", "b5|NULL",
+    "b6|NULL"
+  };
+
+  /* the residual condition base.val < joined.val rejects b3 */
+  Vector<String> inner_cond = { "b2|j1", "b2|j2", "b4|j4" };
+  Vector<String> outer_cond = {
+    "b1|NULL", "b2|j1", "b2|j2", "b3|NULL", "b4|j4", "b5|NULL", "b6|NULL"
+  };
+
+  struct JoinCase {
+    JoinType join_type;
+    bool with_join_cond;
+    const Vector<String>* expected;
+  };
+
+  Vector<JoinCase> cases = {
+    { JoinType::INNER, false, &inner },
+    { JoinType::OUTER, false, &outer },
+    { JoinType::INNER, true, &inner_cond },
+    { JoinType::OUTER, true, &outer_cond },
+  };
+
+  for (const auto& c : cases) {
+    auto result = runEquiJoin<MergeJoinFactory>(
+        txn.get(),
+        c.join_type,
+        base_rows,
+        joined_rows,
+        c.with_join_cond);
+
+    EXPECT_TRUE(result == *c.expected);
+
+    /* a hash join produces the same result */
+    EXPECT_TRUE(
+        runEquiJoin<HashJoinFactory>(
+            txn.get(),
+            c.join_type,
+            base_rows,
+            joined_rows,
+            c.with_join_cond) == result);
+  }
+
+  EXPECT_EXCEPTION("merge JOIN: base table input is not sorted", [&] () {
+    runEquiJoin<MergeJoinFactory>(
+        txn.get(),
+        JoinType::INNER,
+        Vector<Vector<SValue>> { row(ikey(2), "b1", 1), row(ikey(1), "b2", 1) },
+        joined_rows,
+        false);
+  });
+
+  EXPECT_EXCEPTION("merge JOIN: joined table input is not sorted", [&] () {
+    runEquiJoin<MergeJoinFactory>(
+        txn.get(),
+        JoinType::INNER,
+        Vector<Vector<SValue>> { row(ikey(1), "b1", 1), row(ikey(5), "b2", 1) },
+        Vector<Vector<SValue>> { row(ikey(3), "j1", 5), row(ikey(1), "j2", 5) },
+        false);
+  });
+});
+
+/**
+ * Builds the tasks of the first join in the query tree and returns the
+ * factory of the join task
+ */
+static RefPtr<TaskFactory> buildJoinFactory(
+    Transaction* txn,
+    RefPtr<QueryTreeNode> node) {
+  if (auto join = dynamic_cast<JoinNode*>(node.get())) {
+    TaskDAG tasks;
+    auto task_ids = join->build(txn, &tasks);
+    return tasks.getTask(task_ids[0])->getFactory();
+  }
+
+  for (size_t i = 0; i < node->numChildren(); ++i) {
+    auto factory = buildJoinFactory(txn, node->child(i));
+    if (factory.get()) {
+      return factory;
+    }
+  }
+
+  return RefPtr<TaskFactory>();
+}
+
+TEST_CASE(RuntimeTest, TestMergeJoinPlanning, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto txn = runtime->newTransaction();
+
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "customers",
+          "src/csql/testdata/testtbl2.csv",
+          '\t'));
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "orders",
+          "src/csql/testdata/testtbl3.csv",
+          '\t'));
+
+  for (const auto& tbl : Vector<String> { "sorted1", "sorted2" }) {
+    auto provider = new CSTableScanProvider(
+        tbl,
+        "src/csql/testdata/testtbl.cst");
+    provider->setSortColumns(Vector<String> { "time" });
+    estrat->addTableProvider(provider);
+  }
+
+  estrat->addTableProvider(
+      new CSTableScanProvider(
+          "unsorted",
+          "src/csql/testdata/testtbl.cst"));
+
+  auto is_merge_join = [&] (const String& query) -> bool {
+    auto qplan = runtime->buildQueryPlan(txn.get(), query, estrat.get());
+    auto factory = buildJoinFactory(txn.get(), qplan->getStatementQTree(0));
+    EXPECT_TRUE(factory.get() != nullptr);
+    return dynamic_cast<MergeJoinFactory*>(factory.get()) != nullptr;
+  };
+
+  auto run_query = [&] (const String& query) -> Vector<String> {
+    ResultList result;
+    auto qplan = runtime->buildQueryPlan(txn.get(), query, estrat.get());
+    qplan->execute(0, &result);
+
+    Vector<String> rows;
+    for (size_t i = 0; i < result.getNumRows(); ++i) {
+      rows.emplace_back(StringUtil::join(result.getRow(i), "|"));
+    }
+
+    std::sort(rows.begin(), rows.end());
+    return rows;
+  };
+
+  auto join_query = [] (
+      const String& join,
+      const String& orders_order,
+      const String& customers_order) -> String {
+    return StringUtil::format(
+        "SELECT o.orderid, c.customername "
+        "FROM (SELECT customerid, orderid FROM orders $1) AS o "
+        "$0 (SELECT customerid, customername FROM customers $2) AS c "
+        "ON o.customerid = c.customerid;",
+        join,
+        orders_order,
+        customers_order);
+  };
+
+  /* both sides are sorted on the join key */
+  auto sorted_inner = join_query(
+      "JOIN",
+      "ORDER BY customerid",
+      "ORDER BY customerid");
+  auto sorted_outer = join_query(
+      "LEFT JOIN",
+      "ORDER BY customerid",
+      "ORDER BY customerid");
+  EXPECT_TRUE(is_merge_join(sorted_inner));
+  EXPECT_TRUE(is_merge_join(sorted_outer));
+
+  /* only one side sorted, sorted in descending order or on another column */
+  auto unsorted_inner = join_query("JOIN", "", "");
+  auto unsorted_outer = join_query("LEFT JOIN", "", "");
+  EXPECT_TRUE(!is_merge_join(unsorted_inner));
+  EXPECT_TRUE(!is_merge_join(join_query("JOIN", "ORDER BY customerid", "")));
+  EXPECT_TRUE(!is_merge_join(join_query("JOIN", "", "ORDER BY customerid")));
+  EXPECT_TRUE(
+      !is_merge_join(
+          join_query(
+              "JOIN",
+              "ORDER BY customerid DESC",
+              "ORDER BY customerid DESC")));
+  EXPECT_TRUE(
+      !is_merge_join(
+          join_query(
+              "JOIN",
+              "ORDER BY orderid",
+              "ORDER BY customerid")));
+
+  /* the merge join returns the same rows as the hash join */
+  auto expected_inner = run_query(unsorted_inner);
+  auto expected_outer = run_query(unsorted_outer);
+  EXPECT_TRUE(expected_inner.size() > 0);
+  EXPECT_TRUE(expected_outer.size() > expected_inner.size());
+  EXPECT_TRUE(run_query(sorted_inner) == expected_inner);
+  EXPECT_TRUE(run_query(sorted_outer) == expected_outer);
+
+  /* tables with declared sort columns */
+  EXPECT_TRUE(
+      is_merge_join(
+          "SELECT sorted1.time FROM sorted1 "
+          "JOIN sorted2 ON sorted1.time = sorted2.time;"));
+  EXPECT_TRUE(
+      !is_merge_join(
+          "SELECT sorted1.time FROM sorted1 "
+          "JOIN unsorted ON sorted1.time = unsorted.time;"));
+
+  /* keys of different or unknown types are hash joined, so that e.g. '5'
+   * matches 5 like it does with the = operator */
+  EXPECT_TRUE(
+      !is_merge_join(
+          "SELECT sorted1.time FROM sorted1 "
+          "JOIN (SELECT customerid FROM customers ORDER BY customerid) AS c "
+          "ON sorted1.time = c.customerid;"));
+  EXPECT_TRUE(
+      !is_merge_join(
+          "SELECT o.k FROM "
+          "(SELECT customerid + 0 AS k FROM orders ORDER BY k) AS o "
+          "JOIN (SELECT customerid + 0 AS k FROM customers ORDER BY k) AS c "
+          "ON o.k = c.k;"));
+});
+
+static Vector<String> runNestedLoopJoin(
+    Transaction* txn,
+    JoinType join_type,
+    const Vector<Vector<SValue>>& base_rows,
+    const Vector<Vector<SValue>>& joined_rows,
+    RefPtr<ValueExpressionNode> join_cond,
+    const Option<JoinNode::RangeJoinBounds>& range_bounds) {
+  NestedLoopJoinFactory factory(
+      join_type,
+      Set<TaskID> { SHA1::compute("base") },
+      Set<TaskID> { SHA1::compute("joined") },
+      joinTestInputMap(),
+      joinTestSelectList(),
+      Some(join_cond),
+      None<RefPtr<ValueExpressionNode>>());
+
+  if (!range_bounds.isEmpty()) {
+    factory.setRangeIndex(range_bounds.get());
+  }
+
+  return runJoinTask(txn, factory, base_rows, joined_rows);
+}
+
+TEST_CASE(RuntimeTest, TestNestedLoopJoinRangeIndex, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto txn = runtime->newTransaction();
+
+  typedef RefPtr<ValueExpressionNode> Expr;
+  auto col = [] (size_t idx) -> Expr {
+    return new ColumnReferenceNode(idx);
+  };
+
+  auto lit = [] (int64_t val) -> Expr {
+    return new LiteralExpressionNode(SValue(SValue::IntegerType(val)));
+  };
+
+  auto call = [] (const String& fn, Expr lhs, Expr rhs) -> Expr {
+    return new CallExpressionNode(fn, Vector<Expr> { lhs, rhs });
+  };
+
+  /* the padding makes both inputs span several 256KB blocks */
+  String padding(600, 'x');
+  auto row = [&padding] (SValue key, const String& id) {
+    return Vector<SValue> { key, SValue(id), SValue(padding) };
+  };
+
+  /* base keys >= 90 have no joined row with a greater or equal key */
+  Vector<Vector<SValue>> base_rows;
+  Vector<int64_t> base_keys;
+  for (size_t i = 0; i < 380; ++i) {
+    base_keys.emplace_back((i * 37) % 120);
+    base_rows.emplace_back(
+        row(
+            SValue(SValue::IntegerType(base_keys.back())),
+            StringUtil::format("b$0", i)));
+  }
+
+  Vector<Vector<SValue>> joined_rows;
+  Vector<int64_t> joined_keys;
+  for (size_t i = 0; i < 400; ++i) {
+    joined_keys.emplace_back((i * 53) % 90);
+    joined_rows.emplace_back(
+        row(
+            SValue(SValue::IntegerType(joined_keys.back())),
+            StringUtil::format("j$0", i)));
+  }
+
+  struct RangeCase {
+    Expr join_cond;
+    size_t table_idx;
+    Vector<Expr> lower_bounds;
+    Vector<Expr> upper_bounds;
+    std::function<bool (int64_t base_key, int64_t joined_key)> pred;
+  };
+
+  /* input row: 0 = base key, 3 = joined key */
+  Vector<RangeCase> cases = {
+    {
+      call("lt", col(3), col(0)), 1, {}, { col(0) },
+      [] (int64_t b, int64_t j) { return j < b; }
+    },
+    {
+      call("lte", col(3), col(0)), 1, {}, { col(0) },
+      [] (int64_t b, int64_t j) { return j <= b; }
+    },
+    {
+      call("gt", col(3), col(0)), 1, { col(0) }, {},
+      [] (int64_t b, int64_t j) { return j > b; }
+    },
+    {
+      call("gte", col(3), col(0)), 1, { col(0) }, {},
+      [] (int64_t b, int64_t j) { return j >= b; }
+    },
+    {
+      call("lt", col(0), col(3)), 1, { col(0) }, {},
+      [] (int64_t b, int64_t j) { return b < j; }
+    },
+    {
+      call(
+          "logical_and",
+          call("gte", col(3), call("sub", col(0), lit(5))),
+          call("lt", col(3), call("add", col(0), lit(5)))),
+      1,
+      { call("sub", col(0), lit(5)) },
+      { call("add", col(0), lit(5)) },
+      [] (int64_t b, int64_t j) { return j >= b - 5 && j < b + 5; }
+    },
+    {
+      /* the base table as the indexed inner table */
+      call("gt", col(0), col(3)), 0, { col(3) }, {},
+      [] (int64_t b, int64_t j) { return b > j; }
+    },
+  };
+
+  Vector<JoinType> join_types = { JoinType::INNER, JoinType::OUTER };
+  for (const auto& c : cases) {
+    JoinNode::RangeJoinBounds bounds;
+    bounds.table_idx = c.table_idx;
+    bounds.column_idx = 0;
+    bounds.lower_bounds = c.lower_bounds;
+    bounds.upper_bounds = c.upper_bounds;
+
+    for (auto join_type : join_types) {
+      Vector<String> expected;
+      size_t num_unmatched = 0;
+      for (size_t i = 0; i < base_rows.size(); ++i) {
+        bool matched = false;
+        for (size_t j = 0; j < joined_rows.size(); ++j) {
+          if (c.pred(base_keys[i], joined_keys[j])) {
+            expected.emplace_back(StringUtil::format("b$0|j$1", i, j));
+            matched = true;
+          }
+        }
+
+        if (!matched) {
+          ++num_unmatched;
+          if (join_type == JoinType::OUTER) {
+            expected.emplace_back(StringUtil::format("b$0|NULL", i));
+          }
+        }
+      }
+
+      std::sort(expected.begin(), expected.end());
+      EXPECT_TRUE(expected.size() > 0);
+      EXPECT_TRUE(num_unmatched > 0);
+
+      auto indexed = runNestedLoopJoin(
+          txn.get(),
+          join_type,
+          base_rows,
+          joined_rows,
+          c.join_cond,
+          Some(bounds));
+
+      auto unindexed = runNestedLoopJoin(
+          txn.get(),
+          join_type,
+          base_rows,
+          joined_rows,
+          c.join_cond,
+          None<JoinNode::RangeJoinBounds>());
+
+      EXPECT_EQ(indexed.size(), expected.size());
+      EXPECT_TRUE(indexed == expected);
+      EXPECT_TRUE(unindexed == expected);
+    }
+  }
+
+  /* if any inner value is not a number the comparisons may not follow the
+   * numeric order, so the index falls back to a full scan */
+  JoinNode::RangeJoinBounds bounds;
+  bounds.table_idx = 1;
+  bounds.column_idx = 0;
+  bounds.upper_bounds = { col(0) };
+
+  Vector<Vector<Vector<SValue>>> fallback_inputs(3);
+  for (size_t i = 0; i < joined_rows.size(); ++i) {
+    auto id = StringUtil::format("j$0", i);
+    auto key = joined_keys[i];
+
+    /* a single string */
+    fallback_inputs[0].emplace_back(
+        i == 200 ? row(SValue("abc"), id) : joined_rows[i]);
+
+    /* numeric strings, e.g. from a CSV file */
+    fallback_inputs[1].emplace_back(row(SValue(StringUtil::toString(key)), id));
+
+    /* a single NULL */
+    fallback_inputs[2].emplace_back(
+        i == 200 ? row(SValue(), id) : joined_rows[i]);
+  }
+
+  for (const auto& fallback_rows : fallback_inputs) {
+    for (auto join_type : join_types) {
+      auto indexed = runNestedLoopJoin(
+          txn.get(),
+          join_type,
+          base_rows,
+          fallback_rows,
+          call("lt", col(3), col(0)),
+          Some(bounds));
+
+      auto unindexed = runNestedLoopJoin(
+          txn.get(),
+          join_type,
+          base_rows,
+          fallback_rows,
+          call("lt", col(3), col(0)),
+          None<JoinNode::RangeJoinBounds>());
+
+      EXPECT_TRUE(indexed.size() > 0);
+      EXPECT_TRUE(indexed == unindexed);
+    }
+  }
+});
+
+/**
+ * Returns the integers in [begin, end) in every column and counts the rows
+ * that were read and whether the cursor was closed
+ */
+class CountingCursor : public ResultCursor {
+public:
+
+  struct Counters {
+    Counters() : rows_read(0), closed(false) {}
+    size_t rows_read;
+    bool closed;
+  };
+
+  CountingCursor(
+      int64_t begin,
+      int64_t end,
+      Counters* counters) :
+      pos_(begin),
+      end_(end),
+      counters_(counters) {}
+
+  bool next(SValue* row, int row_len) override {
+    if (counters_->closed || pos_ == end_) {
+      return false;
+    }
+
+    for (int i = 0; i < row_len; ++i) {
+      row[i] = SValue(SValue::IntegerType(pos_));
+    }
+
+    ++pos_;
+    ++counters_->rows_read;
+    return true;
+  }
+
+  void close() override {
+    counters_->closed = true;
+  }
+
+protected:
+  int64_t pos_;
+  int64_t end_;
+  Counters* counters_;
+};
+
+/**
+ * Runs a LIMIT over the input and returns the first column of the result rows
+ */
+static Vector<int64_t> runLimit(
+    Transaction* txn,
+    size_t limit,
+    size_t offset,
+    ScopedPtr<ResultCursor> input) {
+  HashMap<TaskID, ScopedPtr<ResultCursor>> inputs;
+  inputs.emplace(SHA1::compute("input"), std::move(input));
+  auto task = LimitFactory(limit, offset).build(txn, std::move(inputs));
+
+  Vector<int64_t> result;
+  Vector<SValue> out(2);
+  while (task->nextRow(out.data(), out.size())) {
+    result.emplace_back(out[0].getInteger());
+  }
+
+  return result;
+}
+
+TEST_CASE(RuntimeTest, TestLimitClosesInput, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto txn = runtime->newTransaction();
+
+  /* the limit reads exactly offset + limit rows and closes its input */
+  {
+    CountingCursor::Counters counters;
+    auto result = runLimit(
+        txn.get(),
+        5,
+        3,
+        mkScoped(new CountingCursor(0, 100000, &counters)));
+
+    EXPECT_TRUE(result == Vector<int64_t>({ 3, 4, 5, 6, 7 }));
+    EXPECT_EQ(counters.rows_read, 8);
+    EXPECT_TRUE(counters.closed);
+  }
+
+  {
+    CountingCursor::Counters counters;
+    auto result = runLimit(
+        txn.get(),
+        0,
+        0,
+        mkScoped(new CountingCursor(0, 100000, &counters)));
+
+    EXPECT_TRUE(result.empty());
+    EXPECT_EQ(counters.rows_read, 0);
+    EXPECT_TRUE(counters.closed);
+  }
+
+  /* in a pipeline the input is read in batches, so the limit reads ahead by
+   * less than one batch */
+  for (size_t limit : Vector<size_t>{ 5, 100 }) {
+    CountingCursor::Counters counters;
+    Vector<ScopedPtr<PipelineStage>> stages;
+    stages.emplace_back(LimitFactory(limit, 50).buildStage(txn.get()));
+
+    RefPtr<Task> pipeline(
+        new Pipeline(
+            std::move(stages),
+            mkScoped(new CountingCursor(0, 100000, &counters))));
+
+    size_t num_rows = 0;
+    SValue out;
+    while (pipeline->nextRow(&out, 1)) {
+      EXPECT_EQ(out.getInteger(), int64_t(50 + num_rows));
+      ++num_rows;
+    }
+
+    EXPECT_EQ(num_rows, limit);
+    EXPECT_TRUE(counters.closed);
+    EXPECT_TRUE(counters.rows_read >= 50 + limit);
+    EXPECT_TRUE(counters.rows_read < 50 + limit + Pipeline::kMaxBatchSize);
+  }
+
+  /* the close is propagated through a join to the probe side, which ends
+   * after a few rows instead of being drained */
+  {
+    Vector<JoinNode::EquiJoinKey> join_keys;
+    {
+      JoinNode::EquiJoinKey key;
+      key.base_key = new ColumnReferenceNode(size_t(0));
+      key.joined_key = new ColumnReferenceNode(size_t(3));
+      join_keys.emplace_back(key);
+    }
+
+    HashJoinFactory factory(
+        JoinType::INNER,
+        Set<TaskID> { SHA1::compute("base") },
+        Set<TaskID> { SHA1::compute("joined") },
+        joinTestInputMap(),
+        joinTestSelectList(),
+        join_keys,
+        None<RefPtr<ValueExpressionNode>>(),
+        None<RefPtr<ValueExpressionNode>>());
+
+    CountingCursor::Counters base_counters;
+    CountingCursor::Counters joined_counters;
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input;
+    input.emplace(
+        SHA1::compute("base"),
+        mkScoped(new CountingCursor(0, 100000, &base_counters)));
+    input.emplace(
+        SHA1::compute("joined"),
+        mkScoped(new CountingCursor(0, 10, &joined_counters)));
+
+    auto join = factory.build(txn.get(), std::move(input));
+    auto result = runLimit(
+        txn.get(),
+        3,
+        0,
+        mkScoped(new TaskResultCursor(join)));
+
+    EXPECT_EQ(result.size(), 3);
+    EXPECT_EQ(joined_counters.rows_read, 10);
+    EXPECT_TRUE(base_counters.closed);
+    EXPECT_TRUE(base_counters.rows_read < 100);
+  }
+
+  /* ... and through a subquery */
+  {
+    Vector<RefPtr<SelectListNode>> select_exprs;
+    select_exprs.emplace_back(
+        new SelectListNode(new ColumnReferenceNode(size_t(0))));
+
+    SubqueryFactory factory(
+        1,
+        select_exprs,
+        Some(RefPtr<ValueExpressionNode>(
+            new CallExpressionNode(
+                "gte",
+                Vector<RefPtr<ValueExpressionNode>> {
+                  new ColumnReferenceNode(size_t(0)),
+                  new LiteralExpressionNode(
+                      SValue(SValue::IntegerType(100)))
+                }))));
+
+    CountingCursor::Counters counters;
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input;
+    input.emplace(
+        SHA1::compute("input"),
+        mkScoped(new CountingCursor(0, 100000, &counters)));
+
+    auto subquery = factory.build(txn.get(), std::move(input));
+    auto result = runLimit(
+        txn.get(),
+        5,
+        2,
+        mkScoped(new TaskResultCursor(subquery)));
+
+    EXPECT_TRUE(result == Vector<int64_t>({ 102, 103, 104, 105, 106 }));
+    EXPECT_EQ(counters.rows_read, 107);
+    EXPECT_TRUE(counters.closed);
+  }
+
+  /* the scan of a query with a limit stops after about offset + limit rows */
+  {
+    auto estrat = mkRef(new DefaultExecutionStrategy());
+    estrat->addTableProvider(
+        new backends::csv::CSVTableProvider(
+            "gdp",
+            "src/csql/testdata/gdp_per_capita.csv",
+            ','));
+
+    Vector<String> queries = {
+      "EXPLAIN ANALYZE SELECT country FROM gdp LIMIT 10 OFFSET 20;",
+      "EXPLAIN ANALYZE SELECT country FROM (SELECT country, year FROM gdp) "
+          "LIMIT 10 OFFSET 20;",
+    };
+
+    for (const auto& query : queries) {
+      ResultList result;
+      auto qplan = runtime->buildQueryPlan(txn.get(), query, estrat.get());
+      qplan->setScheduler(LocalScheduler::getFactory(1));
+      qplan->execute(0, &result);
+
+      EXPECT_EQ(result.getRow(0)[2], "10");
+
+      auto last = result.getNumRows() - 1;
+      EXPECT_TRUE(StringUtil::endsWith(result.getRow(last)[0], "  scan gdp"));
+
+      auto rows_read = std::stoull(result.getRow(last)[1]);
+      EXPECT_TRUE(rows_read >= 30);
+      EXPECT_TRUE(rows_read < 30 + Pipeline::kMaxBatchSize);
+    }
+  }
+});
+
+/**
+ * Runs the group by task and returns the sorted result rows as strings
+ */
+static Vector<String> runGroupByTask(RefPtr<Task> task, size_t num_columns) {
+  Vector<String> result;
+  Vector<SValue> out(num_columns);
+  while (task->nextRow(out.data(), out.size())) {
+    Vector<String> row;
+    for (const auto& v : out) {
+      row.emplace_back(v.getString());
+    }
+
+    result.emplace_back(StringUtil::join(row, "|"));
+  }
+
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+TEST_CASE(RuntimeTest, TestParallelGroupBy, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto txn = runtime->newTransaction();
+
+  /* (key, val) rows with NULL keys and values */
+  Vector<Vector<SValue>> rows;
+  for (size_t i = 0; i < 1000; ++i) {
+    Vector<SValue> row(2);
+    if (i % 11 != 0) {
+      row[0] = SValue(StringUtil::format("k$0", i % 7));
+    }
+
+    if (i % 5 != 0) {
+      row[1] = SValue(SValue::IntegerType((i * 7919) % 101));
+    }
+
+    rows.emplace_back(row);
+  }
+
+  auto call = [] (const String& fn, RefPtr<ValueExpressionNode> arg) {
+    return RefPtr<ValueExpressionNode>(
+        new CallExpressionNode(
+            fn,
+            Vector<RefPtr<ValueExpressionNode>> { arg }));
+  };
+
+  Vector<RefPtr<SelectListNode>> select_exprs;
+  select_exprs.emplace_back(
+      new SelectListNode(new ColumnReferenceNode(size_t(0))));
+  for (const auto& fn : Vector<String> {
+        "count", "sum", "min", "max", "count_distinct" }) {
+    select_exprs.emplace_back(
+        new SelectListNode(call(fn, new ColumnReferenceNode(size_t(1)))));
+  }
+
+  GroupByFactory factory(
+      2,
+      select_exprs,
+      Vector<RefPtr<ValueExpressionNode>> {
+        new ColumnReferenceNode(size_t(0))
+      });
+
+  Vector<String> expected;
+  {
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input;
+    input.emplace(SHA1::compute("input"), mkScoped(new RowListCursor(rows)));
+    expected = runGroupByTask(
+        factory.build(txn.get(), std::move(input)),
+        select_exprs.size());
+  }
+
+  EXPECT_EQ(expected.size(), 8);
+
+  /* each partial task aggregates a part of the rows, the merge task merges
+   * the states of the groups that appear in multiple parts */
+  for (size_t num_parts : Vector<size_t> { 1, 3, 7 }) {
+    HashMap<TaskID, ScopedPtr<ResultCursor>> partials;
+    for (size_t part = 0; part < num_parts; ++part) {
+      Vector<Vector<SValue>> part_rows;
+      for (size_t i = part; i < rows.size(); i += num_parts) {
+        part_rows.emplace_back(rows[i]);
+      }
+
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input;
+      input.emplace(
+          SHA1::compute("input"),
+          mkScoped(new RowListCursor(part_rows)));
+
+      partials.emplace(
+          SHA1::compute(StringUtil::format("part$0", part)),
+          mkScoped(
+              new TaskResultCursor(
+                  factory.buildPartial(txn.get(), std::move(input)))));
+    }
+
+    auto result = runGroupByTask(
+        factory.buildMerge(txn.get(), std::move(partials)),
+        select_exprs.size());
+
+    EXPECT_TRUE(result == expected);
+  }
+
+  /* the workers of a split scan aggregate their rows locally */
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new CSTableScanProvider(
+          "testtable",
+          "src/csql/testdata/testtbl.cst"));
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "gdp",
+          "src/csql/testdata/gdp_per_capita.csv",
+          ','));
+
+  auto run_query = [&] (const String& query, size_t max_threads) {
+    ResultList result;
+    auto qplan = runtime->buildQueryPlan(txn.get(), query, estrat.get());
+    qplan->setScheduler(LocalScheduler::getFactory(max_threads));
+    qplan->execute(0, &result);
+
+    Vector<String> rows;
+    for (size_t i = 0; i < result.getNumRows(); ++i) {
+      rows.emplace_back(StringUtil::join(result.getRow(i), "|"));
+    }
+
+    std::sort(rows.begin(), rows.end());
+    return rows;
+  };
+
+  {
+    auto query = R"(
+      SELECT count(1), TRUNCATE(time / 60000000), max(time)
+      FROM testtable
+      GROUP BY TRUNCATE(time / 60000000);
+    )";
+
+    auto serial = run_query(query, 1);
+    EXPECT_EQ(serial.size(), 129);
+    EXPECT_TRUE(run_query(query, 4) == serial);
+  }
+
+  {
+    auto query = R"(
+      SELECT country, count(1), sum(year), min(year), max(isocode)
+      FROM gdp
+      WHERE year > 2003
+      GROUP BY country;
+    )";
+
+    auto serial = run_query(query, 1);
+    EXPECT_TRUE(serial.size() > 100);
+    EXPECT_TRUE(run_query(query, 4) == serial);
+  }
+});
+
+TEST_CASE(RuntimeTest, TestCSTableMorselSource, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto txn = runtime->newTransaction();
+
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new CSTableScanProvider(
+          "testtable",
+          "src/csql/testdata/testtbl.cst"));
+
+  auto query = "select time from testtable;";
+  auto qplan = runtime->buildQueryPlan(txn.get(), query, estrat.get());
+  auto stmt = qplan->getStatementQTree(0).asInstanceOf<SequentialScanNode>();
+
+  Vector<String> expected;
+  {
+    ResultList result;
+    qplan->execute(0, &result);
+    for (size_t i = 0; i < result.getNumRows(); ++i) {
+      expected.emplace_back(result.getRow(i)[0]);
+    }
+
+    std::sort(expected.begin(), expected.end());
+  }
+
+  EXPECT_EQ(expected.size(), 213);
+
+  /* three workers take ranges of 16 records from their stripes */
+  RefPtr<CSTableMorselSource> source(
+      new CSTableMorselSource(
+          txn.get(),
+          stmt,
+          "src/csql/testdata/testtbl.cst",
+          None<RuntimeFilterSpec>(),
+          16));
+
+  Vector<ScopedPtr<ResultCursor>> cursors;
+  for (size_t i = 0; i < 3; ++i) {
+    cursors.emplace_back(source->openCursor());
+  }
+
+  Vector<String> result;
+  Vector<size_t> rows_per_cursor(cursors.size(), 0);
+  for (bool more = true; more; ) {
+    more = false;
+    for (size_t i = 0; i < cursors.size(); ++i) {
+      SValue row;
+      if (cursors[i]->next(&row, 1)) {
+        result.emplace_back(row.getString());
+        ++rows_per_cursor[i];
+        more = true;
+      }
+    }
+  }
+
+  std::sort(result.begin(), result.end());
+  EXPECT_TRUE(result == expected);
+  for (auto n : rows_per_cursor) {
+    EXPECT_TRUE(n > 0);
+  }
+
+  /* each cursor takes ascending ranges, starting with its own stripe, and
+   * all records are taken exactly once */
+  {
+    RefPtr<CSTableMorselSource> stripes(
+        new CSTableMorselSource(
+            txn.get(),
+            stmt,
+            "src/csql/testdata/testtbl.cst",
+            None<RuntimeFilterSpec>(),
+            16));
+
+    Vector<ScopedPtr<ResultCursor>> stripe_cursors;
+    for (size_t i = 0; i < 3; ++i) {
+      stripe_cursors.emplace_back(stripes->openCursor());
+    }
+
+    uint64_t begin;
+    uint64_t end;
+    EXPECT_TRUE(stripes->nextMorsel(2, &begin, &end));
+    EXPECT_EQ(begin, 142);
+    EXPECT_EQ(end, 158);
+    EXPECT_TRUE(stripes->nextMorsel(1, &begin, &end));
+    EXPECT_EQ(begin, 71);
+    EXPECT_EQ(end, 87);
+
+    Vector<size_t> taken(213, 0);
+    Vector<uint64_t> last_end { 0, 87, 158 };
+    for (uint64_t i = 71; i < 87; ++i) {
+      ++taken[i];
+    }
+
+    for (uint64_t i = 142; i < 158; ++i) {
+      ++taken[i];
+    }
+
+    /* the first cursor takes its own stripe and then steals from the ends of
+     * the others, the others then finish their stripes */
+    for (size_t cursor = 0; cursor < 3; ++cursor) {
+      while (stripes->nextMorsel(cursor, &begin, &end)) {
+        EXPECT_TRUE(begin >= last_end[cursor]);
+        EXPECT_TRUE(end > begin);
+        EXPECT_TRUE(end - begin <= 16);
+        last_end[cursor] = end;
+        for (auto i = begin; i < end; ++i) {
+          ++taken[i];
+        }
+      }
+    }
+
+    for (size_t cursor = 0; cursor < 3; ++cursor) {
+      EXPECT_FALSE(stripes->nextMorsel(cursor, &begin, &end));
+    }
+
+    for (auto n : taken) {
+      EXPECT_EQ(n, 1);
+    }
+  }
+
+  /* the column readers can only move forward */
+  CSTableScan scan(
+      txn.get(),
+      stmt,
+      "src/csql/testdata/testtbl.cst",
+      runtime->queryBuilder().get());
+
+  scan.setRecordRange(32, 48);
+  EXPECT_EXCEPTION("record ranges must be set in ascending order", [&scan] {
+    scan.setRecordRange(0, 16);
+  });
+
+  /* sorted scans are never split, so the merge join sees its inputs in order
+   * with any number of threads */
+  for (const auto& tbl : Vector<String> { "sorted1", "sorted2" }) {
+    auto provider = new CSTableScanProvider(
+        tbl,
+        "src/csql/testdata/testtbl.cst");
+    provider->setSortColumns(Vector<String> { "time" });
+    estrat->addTableProvider(provider);
+  }
+
+  auto join_query =
+      "SELECT sorted1.time FROM sorted1 JOIN sorted2 "
+      "ON sorted1.time = sorted2.time;";
+
+  ResultList serial;
+  {
+    auto qplan = runtime->buildQueryPlan(txn.get(), join_query, estrat.get());
+    qplan->setScheduler(LocalScheduler::getFactory(1));
+    qplan->execute(0, &serial);
+  }
+
+  ResultList parallel;
+  {
+    auto qplan = runtime->buildQueryPlan(txn.get(), join_query, estrat.get());
+    qplan->setScheduler(LocalScheduler::getFactory(4));
+    qplan->execute(0, &parallel);
+  }
+
+  EXPECT_TRUE(serial.getNumRows() > 0);
+  EXPECT_EQ(parallel.getNumRows(), serial.getNumRows());
+});
+
+TEST_CASE(RuntimeTest, TestParallelUnion, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+
+  Vector<ScopedPtr<ResultCursor>> inputs;
+  for (int64_t i = 0; i < 6; ++i) {
+    inputs.emplace_back(new IntegerRangeCursor(i * 1000, (i + 1) * 1000));
+  }
+
+  Exchange union_cursor(runtime->scheduler(), std::move(inputs), 3);
+
+  size_t num_rows = 0;
+  int64_t sum = 0;
+  SValue row;
+  while (union_cursor.next(&row, 1)) {
+    ++num_rows;
+    sum += row.getInteger();
+  }
+
+  EXPECT_EQ(num_rows, 6000);
+  EXPECT_EQ(sum, 6000 * 5999 / 2);
+});
+
+static int64_t sumResultCursor(ResultCursor* cursor, size_t* num_rows) {
+  int64_t sum = 0;
+  SValue row;
+  *num_rows = 0;
+  while (cursor->next(&row, 1)) {
+    ++*num_rows;
+    sum += row.getInteger();
+  }
+
+  return sum;
+}
+
+TEST_CASE(RuntimeTest, TestResultCache, [] () {
+  auto cache_dir = makeSpillFilePath("/tmp", "csql_test_resultcache");
+  FileUtil::mkdir(cache_dir);
+
+  auto key1 = SHA1::compute("key1");
+  auto key2 = SHA1::compute("key2");
+  size_t num_rows;
+
+  {
+    auto cache = mkRef(new ResultCache(cache_dir, 16 * 1024));
+    EXPECT_TRUE(cache->get(key1).get() == nullptr);
+
+    auto writer = cache->store(
+        key1,
+        1,
+        mkScoped(new IntegerRangeCursor(0, 1000)));
+    EXPECT_EQ(sumResultCursor(writer.get(), &num_rows), 1000 * 999 / 2);
+    EXPECT_EQ(num_rows, 1000);
+    EXPECT_EQ(cache->numEntries(), 1);
+
+    auto reader = cache->get(key1);
+    EXPECT_TRUE(reader.get() != nullptr);
+    EXPECT_EQ(sumResultCursor(reader.get(), &num_rows), 1000 * 999 / 2);
+    EXPECT_EQ(num_rows, 1000);
+
+    /* results that were not read completely are not cached */
+    auto partial = cache->store(
+        key2,
+        1,
+        mkScoped(new IntegerRangeCursor(0, 1000)));
+    SValue row;
+    EXPECT_TRUE(partial->next(&row, 1));
+    partial->close();
+    partial.reset(nullptr);
+    EXPECT_EQ(cache->numEntries(), 1);
+    EXPECT_TRUE(cache->get(key2).get() == nullptr);
+  }
+
+  {
+    /* the results are loaded from the cache dir */
+    auto cache = mkRef(new ResultCache(cache_dir, 16 * 1024));
+    EXPECT_EQ(cache->numEntries(), 1);
+
+    auto reader = cache->get(key1);
+    EXPECT_TRUE(reader.get() != nullptr);
+    EXPECT_EQ(sumResultCursor(reader.get(), &num_rows), 1000 * 999 / 2);
+
+    /* the least recently used result is evicted */
+    auto writer = cache->store(
+        key2,
+        1,
+        mkScoped(new IntegerRangeCursor(1000, 2000)));
+    sumResultCursor(writer.get(), &num_rows);
+    EXPECT_EQ(cache->numEntries(), 1);
+    EXPECT_TRUE(cache->size() <= 16 * 1024);
+    EXPECT_TRUE(cache->get(key1).get() == nullptr);
+    EXPECT_TRUE(cache->get(key2).get() != nullptr);
+  }
+
+  {
+    /* all columns are stored, even if the first consumer reads only one */
+    auto cache = mkRef(new ResultCache(cache_dir, 16 * 1024));
+    auto key3 = SHA1::compute("key3");
+
+    Vector<Vector<SValue>> rows;
+    for (int64_t i = 0; i < 10; ++i) {
+      rows.emplace_back(
+          Vector<SValue>{
+            SValue(SValue::IntegerType(i)),
+            SValue(SValue::IntegerType(i * 10)),
+            SValue(StringUtil::format("row$0", i))
+          });
+    }
+
+    auto writer = cache->store(key3, 3, mkScoped(new RowListCursor(rows)));
+    EXPECT_EQ(sumResultCursor(writer.get(), &num_rows), 45);
+
+    auto reader = cache->get(key3);
+    EXPECT_TRUE(reader.get() != nullptr);
+
+    Vector<SValue> row(3);
+    for (int64_t i = 0; i < 10; ++i) {
+      EXPECT_TRUE(reader->next(row.data(), row.size()));
+      EXPECT_EQ(row[0].getInteger(), i);
+      EXPECT_EQ(row[1].getInteger(), i * 10);
+      EXPECT_EQ(row[2].getString(), StringUtil::format("row$0", i));
+    }
+
+    EXPECT_EQ(reader->next(row.data(), row.size()), false);
+  }
+
+  /* scans with a runtime filter are never cached */
+  {
+    auto runtime = Runtime::getDefaultRuntime();
+    auto txn = runtime->newTransaction();
+
+    auto estrat = mkRef(new DefaultExecutionStrategy());
+    estrat->addTableProvider(
+        new CSTableScanProvider(
+            "testtable",
+            "src/csql/testdata/testtbl.cst"));
+
+    auto qplan = runtime->buildQueryPlan(
+        txn.get(),
+        "select time, user_id from testtable;",
+        estrat.get());
+
+    auto stmt =
+        qplan->getStatementQTree(0).asInstanceOf<SequentialScanNode>();
+
+    auto factory = mkRef(
+        new CSTableScanFactory(stmt, "src/csql/testdata/testtbl.cst"));
+    factory->setCacheKey(SHA1::compute("testtbl"));
+    EXPECT_TRUE(!factory->cacheKey(Vector<SHA1Hash>{}).isEmpty());
+    EXPECT_EQ(factory->numOutputColumns(), 2);
+
+    RuntimeFilterSpec spec;
+    spec.filter_id = SHA1::compute("filter");
+    spec.key_columns = Vector<size_t>{ 0 };
+    EXPECT_TRUE(factory->setRuntimeFilter(spec));
+    EXPECT_TRUE(factory->cacheKey(Vector<SHA1Hash>{}).isEmpty());
+  }
+
+  removeCacheDir(cache_dir);
+});
+
+TEST_CASE(RuntimeTest, TestHyperLogLog, [] () {
+  HyperLogLog small;
+  for (size_t i = 0; i < 1000; ++i) {
+    small.insert(StringUtil::toString(i % 100));
+  }
+
+  EXPECT_EQ(small.isSparse(), true);
+  EXPECT_EQ(small.estimate(), 100);
+
+  HyperLogLog a;
+  HyperLogLog b;
+  for (size_t i = 0; i < 100000; ++i) {
+    a.insert(StringUtil::toString(i));
+    b.insert(StringUtil::toString(i + 50000));
+  }
+
+  EXPECT_EQ(a.isSparse(), false);
+  EXPECT_TRUE(fabs(a.estimate() - 100000.0) / 100000.0 < 0.05);
+
+  a.merge(b);
+  a.merge(small);
+  EXPECT_TRUE(fabs(a.estimate() - 150000.0) / 150000.0 < 0.05);
+
+  String buf;
+  auto os = StringOutputStream::fromString(&buf);
+  a.encode(os.get());
+  small.encode(os.get());
+
+  HyperLogLog a2;
+  HyperLogLog small2;
+  auto is = StringInputStream::fromString(buf);
+  a2.decode(is.get());
+  small2.decode(is.get());
+  EXPECT_EQ(a2.estimate(), a.estimate());
+  EXPECT_EQ(small2.estimate(), small.estimate());
+});
+
+TEST_CASE(RuntimeTest, TestApproxCountDistinct, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto ctx = runtime->newTransaction();
+
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "orders",
+          "src/csql/testdata/testtbl3.csv",
+          '\t'));
+
+  ResultList result;
+  auto query = R"(
+    SELECT approx_count_distinct(customerid), count(customerid) FROM orders;
+  )";
+
+  auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+  qplan->execute(0, &result);
+  EXPECT_EQ(result.getNumRows(), 1);
+  EXPECT_EQ(result.getRow(0)[0], "74");
+  EXPECT_EQ(result.getRow(0)[1], "196");
+});
+
+TEST_CASE(RuntimeTest, TestTDigest, [] () {
+  TDigest a;
+  TDigest b;
+  for (size_t i = 0; i < 100000; ++i) {
+    a.insert(i);
+    b.insert(i + 100000);
+  }
+
+  EXPECT_EQ(a.totalWeight(), 100000);
+  EXPECT_EQ(a.quantile(0), 0);
+  EXPECT_EQ(a.quantile(1), 99999);
+  EXPECT_TRUE(fabs(a.quantile(0.5) - 50000.0) < 1000);
+  EXPECT_TRUE(fabs(a.quantile(0.99) - 99000.0) < 100);
+  EXPECT_TRUE(fabs(a.quantile(0.001) - 100.0) < 10);
+
+  a.merge(b);
+  EXPECT_EQ(a.totalWeight(), 200000);
+  EXPECT_TRUE(fabs(a.quantile(0.5) - 100000.0) < 2000);
+  EXPECT_TRUE(fabs(a.quantile(0.75) - 150000.0) < 2000);
+
+  String buf;
+  auto os = StringOutputStream::fromString(&buf);
+  a.encode(os.get());
+
+  TDigest a2;
+  auto is = StringInputStream::fromString(buf);
+  a2.decode(is.get());
+  EXPECT_EQ(a2.totalWeight(), a.totalWeight());
+  EXPECT_EQ(a2.quantile(0.25), a.quantile(0.25));
+  EXPECT_EQ(a2.quantile(0.99), a.quantile(0.99));
+});
+
+TEST_CASE(RuntimeTest, TestApproxPercentile, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto ctx = runtime->newTransaction();
+
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "orders",
+          "src/csql/testdata/testtbl3.csv",
+          '\t'));
+
+  ResultList result;
+  auto query = R"(
+    SELECT
+      approx_median(orderid),
+      approx_percentile(orderid, 0.0),
+      approx_percentile(orderid, 1.0)
+    FROM orders;
+  )";
+
+  auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+  qplan->execute(0, &result);
+  EXPECT_EQ(result.getNumRows(), 1);
+  EXPECT_TRUE(fabs(std::stod(result.getRow(0)[0]) - 10345.5) < 2);
+  EXPECT_EQ(std::stod(result.getRow(0)[1]), 10248);
+  EXPECT_EQ(std::stod(result.getRow(0)[2]), 10443);
+});
+
+TEST_CASE(RuntimeTest, TestCountDistinct, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto ctx = runtime->newTransaction();
+
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "orders",
+          "src/csql/testdata/testtbl3.csv",
+          '\t'));
+
+  {
+    ResultList result;
+    auto query = R"(
+      SELECT count(DISTINCT customerid), count(customerid) FROM orders;
+    )";
+
+    auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+    qplan->execute(0, &result);
+    EXPECT_EQ(result.getNumRows(), 1);
+    EXPECT_EQ(result.getRow(0)[0], "74");
+    EXPECT_EQ(result.getRow(0)[1], "196");
+  }
+
+  {
+    ResultList result;
+    auto query = R"(
+      SELECT shipperid, count(DISTINCT employeeid)
+      FROM orders
+      GROUP BY shipperid
+      ORDER BY shipperid;
+    )";
+
+    auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+    qplan->execute(0, &result);
+    EXPECT_EQ(result.getNumRows(), 3);
+    EXPECT_EQ(result.getRow(0)[1], "9");
+    EXPECT_EQ(result.getRow(1)[1], "8");
+    EXPECT_EQ(result.getRow(2)[1], "9");
+  }
+});
+
+TEST_CASE(RuntimeTest, TestDistinctSetSpill, [] () {
+  auto cache_dir = makeSpillFilePath("/tmp", "csql_test_distinct");
+  FileUtil::mkdir(cache_dir);
+
+  auto runtime = Runtime::getDefaultRuntime();
+  runtime->setCacheDir(cache_dir);
+
+  auto num_runs = [&cache_dir] () -> size_t {
+    size_t n = 0;
+    FileUtil::ls(cache_dir, [&n] (const String& file) -> bool {
+      if (StringUtil::beginsWith(file, "distinct.")) {
+        ++n;
+      }
+
+      return true;
+    });
+
+    return n;
+  };
+
+  /* a transaction over its soft limit doesn't spill small sets */
+  auto txn = runtime->newTransaction();
+  txn->getMemoryTracker()->setLimits(1, 0);
+  {
+    DistinctSet set;
+    for (size_t i = 0; i < 1000; ++i) {
+      set.insert(txn.get(), StringUtil::format("key$0", i % 500));
+    }
+
+    EXPECT_EQ(set.count(), 500);
+    EXPECT_EQ(num_runs(), 0);
+  }
+
+  /* large sets spill, but never keep more than kMaxRuns runs */
+  {
+    DistinctSet set;
+    size_t max_runs = 0;
+    for (size_t i = 0; i < 600000; ++i) {
+      set.insert(txn.get(), StringUtil::format("key$0", i % 400000));
+      if (i % 10000 == 0) {
+        max_runs = std::max(max_runs, num_runs());
+      }
+    }
+
+    EXPECT_TRUE(num_runs() > 0);
+    EXPECT_TRUE(max_runs <= DistinctSet::kMaxRuns);
+    EXPECT_EQ(set.count(), 400000);
+
+    DistinctSet other;
+    other.insert(txn.get(), "key1");
+    other.insert(txn.get(), "other");
+    set.merge(txn.get(), other);
+    EXPECT_EQ(set.count(), 400001);
+  }
+
+  EXPECT_EQ(num_runs(), 0);
+
+  removeCacheDir(cache_dir);
+});
+
+TEST_CASE(RuntimeTest, TestMinMaxAggregate, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto ctx = runtime->newTransaction();
+
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "orders",
+          "src/csql/testdata/testtbl3.csv",
+          '\t'));
+
+  ResultList result;
+  auto query = R"(
+    SELECT min(orderid), max(orderid), min(orderdate), max(orderdate)
+    FROM orders;
+  )";
+
+  auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+  qplan->execute(0, &result);
+  EXPECT_EQ(result.getNumRows(), 1);
+  EXPECT_EQ(result.getRow(0)[0], "10248");
+  EXPECT_EQ(result.getRow(0)[1], "10443");
+  EXPECT_EQ(result.getRow(0)[2], "1996-07-04");
+  EXPECT_EQ(result.getRow(0)[3], "1997-02-12");
+});
+
+TEST_CASE(RuntimeTest, TestMinMaxEmptyField, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto ctx = runtime->newTransaction();
+
+  auto csv_path = makeSpillFilePath("/tmp", "csql_test_minmax") + ".csv";
+  FileUtil::write(
+      csv_path,
+      Buffer(String("id,name,score\n1,bob,5\n2,,7\n3,alice,\n")));
+
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider("scores", csv_path, ','));
+
+  ResultList result;
+  auto query = R"(
+    SELECT min(name), max(name), min(score), max(score), max(id)
+    FROM scores;
+  )";
+
+  auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+  qplan->execute(0, &result);
+  EXPECT_EQ(result.getNumRows(), 1);
+  EXPECT_EQ(result.getRow(0)[0], "");
+  EXPECT_EQ(result.getRow(0)[1], "bob");
+  EXPECT_EQ(result.getRow(0)[2], "");
+  EXPECT_EQ(result.getRow(0)[3], "7");
+  EXPECT_EQ(result.getRow(0)[4], "3");
+
+  FileUtil::rm(csv_path);
+});
+
+TEST_CASE(RuntimeTest, TestMinMaxMergeState, [] () {
+  auto txn_ref = Runtime::getDefaultRuntime()->newTransaction();
+  auto txn = Transaction::get(txn_ref.get());
+  const auto& fn = expressions::kMaxExpr;
+
+  Vector<char> a(fn.scratch_size);
+  Vector<char> b(fn.scratch_size);
+  Vector<char> c(fn.scratch_size);
+  fn.init(txn, a.data());
+  fn.init(txn, b.data());
+  fn.init(txn, c.data());
+
+  for (int64_t i = 0; i < 100; ++i) {
+    SValue v(SValue::IntegerType(i));
+    fn.accumulate(txn, a.data(), 1, &v);
+  }
+
+  SValue f(SValue::FloatType(123.5));
+  SValue n;
+  fn.accumulate(txn, b.data(), 1, &f);
+  fn.accumulate(txn, b.data(), 1, &n);
+
+  SValue out;
+  fn.get(txn, a.data(), &out);
+  EXPECT_EQ(out.getType(), SQL_INTEGER);
+  EXPECT_EQ(out.getInteger(), 99);
+
+  fn.merge(txn, a.data(), b.data());
+  fn.get(txn, a.data(), &out);
+  EXPECT_EQ(out.getType(), SQL_FLOAT);
+  EXPECT_EQ(out.getFloat(), 123.5);
+
+  String buf;
+  auto os = StringOutputStream::fromString(&buf);
+  fn.savestate(txn, a.data(), os.get());
+  auto is = StringInputStream::fromString(buf);
+  fn.loadstate(txn, c.data(), is.get());
+  fn.get(txn, c.data(), &out);
+  EXPECT_EQ(out.getFloat(), 123.5);
+
+  fn.reset(txn, c.data());
+  fn.get(txn, c.data(), &out);
+  EXPECT_EQ(out.getType(), SQL_NULL);
+
+  fn.free(txn, a.data());
+  fn.free(txn, b.data());
+  fn.free(txn, c.data());
+});
+
+TEST_CASE(RuntimeTest, TestMemoryTracker, [] () {
+  MemoryTracker tracker;
+  tracker.setLimits(1000, 2000);
+
+  {
+    MemoryReservation a(&tracker);
+    MemoryReservation b(&tracker);
+    a.grow(800);
+    EXPECT_FALSE(tracker.exceedsSoftLimit());
+    EXPECT_TRUE(tracker.exceedsSoftLimit(300));
+
+    b.grow(600);
+    EXPECT_TRUE(b.exceedsSoftLimit());
+    EXPECT_EQ(tracker.usedBytes(), 1400);
+
+    EXPECT_EXCEPTION("query exceeds the memory limit of 2000 bytes", [&a] () {
+      a.grow(1000);
+    });
+
+    EXPECT_EQ(a.bytes(), 800);
+    EXPECT_EQ(tracker.usedBytes(), 1400);
+
+    a.resize(100);
+    EXPECT_EQ(tracker.usedBytes(), 700);
+    EXPECT_FALSE(tracker.exceedsSoftLimit());
+  }
+
+  EXPECT_EQ(tracker.usedBytes(), 0);
+  EXPECT_EQ(tracker.peakBytes(), 1400);
+});
+
+TEST_CASE(RuntimeTest, TestTransactionMemoryLimit, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "orders",
+          "src/csql/testdata/testtbl3.csv",
+          '\t'));
+
+  auto query = R"(SELECT orderid FROM orders ORDER BY orderdate DESC;)";
+
+  {
+    auto ctx = runtime->newTransaction();
+    ResultList result;
+    auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+    qplan->execute(0, &result);
+    EXPECT_EQ(result.getNumRows(), 196);
+    EXPECT_EQ(ctx->getMemoryTracker()->usedBytes(), 0);
+    EXPECT_TRUE(ctx->getMemoryTracker()->peakBytes() > 0);
+  }
+
+  runtime->setMemoryLimits(0, 1024);
+
+  EXPECT_EXCEPTION("query exceeds the memory limit of 1024 bytes", [&] () {
+    auto ctx = runtime->newTransaction();
+    ResultList result;
+    auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+    qplan->execute(0, &result);
+  });
+});
+
+TEST_CASE(RuntimeTest, TestOperatorMemoryReservations, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "orders",
+          "src/csql/testdata/testtbl3.csv",
+          '\t'));
+
+  /* groups, the top n heap, the semi join build side and sketch states */
+  Vector<String> queries = {
+    "SELECT customerid, count(1) FROM orders GROUP BY customerid;",
+    "SELECT orderid FROM orders ORDER BY orderdate DESC LIMIT 10;",
+    "SELECT orderid FROM orders WHERE customerid IN "
+        "(SELECT customerid FROM orders WHERE shipperid = 1);",
+    "SELECT approx_count_distinct(customerid) FROM orders;",
+    "SELECT approx_percentile(orderid, 0.9) FROM orders;"
+  };
+
+  for (const auto& query : queries) {
+    {
+      auto ctx = runtime->newTransaction();
+      ctx->getMemoryTracker()->setLimits(0, 0);
+
+      ResultList result;
+      auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+      qplan->execute(0, &result);
+      EXPECT_TRUE(result.getNumRows() > 0);
+      EXPECT_TRUE(ctx->getMemoryTracker()->peakBytes() > 0);
+    }
+
+    EXPECT_EXCEPTION("query exceeds the memory limit of 64 bytes", [&] () {
+      auto ctx = runtime->newTransaction();
+      ctx->getMemoryTracker()->setLimits(0, 64);
+
+      ResultList result;
+      auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+      qplan->execute(0, &result);
+    });
+  }
+});
+
+TEST_CASE(RuntimeTest, TestTransactionAbort, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "orders",
+          "src/csql/testdata/testtbl3.csv",
+          '\t'));
+
+  /* the join loop evaluates 196 * 196 candidate pairs without output */
+  auto query = R"(
+    SELECT o1.orderid
+    FROM orders o1, orders o2
+    WHERE o1.orderid + o2.orderid < 0;
+  )";
+
+  {
+    auto ctx = runtime->newTransaction();
+    ctx->checkAborted();
+
+    ResultList result;
+    auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+    qplan->execute(0, &result);
+    EXPECT_EQ(result.getNumRows(), 0);
+  }
+
+  EXPECT_EXCEPTION("query cancelled", [&] () {
+    auto ctx = runtime->newTransaction();
+    ctx->cancel();
+    EXPECT_TRUE(ctx->isCancelled());
+
+    ResultList result;
+    auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+    qplan->execute(0, &result);
+  });
+
+  EXPECT_EXCEPTION("query exceeded its deadline", [&] () {
+    auto ctx = runtime->newTransaction();
+    ctx->setDeadline(WallClock::now());
+
+    ResultList result;
+    auto qplan = runtime->buildQueryPlan(ctx.get(), query, estrat.get());
+    qplan->execute(0, &result);
+  });
+});
+
+TEST_CASE(RuntimeTest, TestAdmissionController, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+
+  AdmissionController admission(8);
+  admission.setLimits(2, 1);
+  admission.setQueueTimeout(10 * kMicrosPerMilli);
+
+  auto batch1 = runtime->newTransaction();
+  auto batch2 = runtime->newTransaction();
+  batch1->setPriority(QueryPriority::BATCH);
+  batch2->setPriority(QueryPriority::BATCH);
+  auto interactive1 = runtime->newTransaction();
+  auto interactive2 = runtime->newTransaction();
+  auto interactive3 = runtime->newTransaction();
+
+  auto ticket1 = admission.admit(batch1.get());
+  EXPECT_EQ(ticket1->maxThreads(), 8);
+
+  /* the second slot is kept for interactive queries */
+  EXPECT_EXCEPTION("query timed out waiting for admission", [&] () {
+    admission.admit(batch2.get());
+  });
+
+  EXPECT_EQ(admission.numQueuedQueries(), 0);
+
+  auto ticket2 = admission.admit(interactive1.get());
+  EXPECT_EQ(ticket2->maxThreads(), 4);
+  EXPECT_EQ(ticket1->maxThreads(), 4);
+  EXPECT_EQ(admission.numRunningQueries(), 2);
+
+  EXPECT_EXCEPTION("query timed out waiting for admission", [&] () {
+    admission.admit(interactive2.get());
+  });
+
+  interactive3->cancel();
+  EXPECT_EXCEPTION("query cancelled", [&] () {
+    admission.admit(interactive3.get());
+  });
+
+  ticket1.reset(nullptr);
+  EXPECT_EQ(admission.numRunningQueries(), 1);
+  EXPECT_EQ(ticket2->maxThreads(), 8);
+
+  auto ticket3 = admission.admit(interactive2.get());
+  EXPECT_EQ(admission.numRunningQueries(), 2);
+});
+
+TEST_CASE(RuntimeTest, TestAdmissionReleasedWithResultCursor, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  runtime->setAdmissionLimits(1, 0);
+  runtime->setAdmissionQueueTimeout(10 * kMicrosPerMilli);
+  auto admission = runtime->admissionController();
+
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "orders",
+          "src/csql/testdata/testtbl3.csv",
+          '\t'));
+
+  auto query = "SELECT orderid FROM orders;";
+  auto txn1 = runtime->newTransaction();
+  auto txn2 = runtime->newTransaction();
+  auto qplan1 = runtime->buildQueryPlan(txn1.get(), query, estrat.get());
+  auto qplan2 = runtime->buildQueryPlan(txn2.get(), query, estrat.get());
+
+  /* the query is running until its last row was read */
+  {
+    auto cursor = qplan1->execute(0);
+    EXPECT_EQ(admission->numRunningQueries(), 1);
+    EXPECT_TRUE(txn1->getMaxThreads() > 0);
+
+    EXPECT_EXCEPTION("query timed out waiting for admission", [&] () {
+      qplan2->execute(0);
+    });
+
+    SValue row;
+    while (cursor->next(&row, 1)) {}
+    EXPECT_EQ(admission->numRunningQueries(), 0);
+    EXPECT_EQ(txn1->getMaxThreads(), 0);
+  }
+
+  /* ... or its cursor is closed or destroyed, the transaction is kept */
+  {
+    auto cursor = qplan2->execute(0);
+    EXPECT_EQ(admission->numRunningQueries(), 1);
+    cursor->close();
+    EXPECT_EQ(admission->numRunningQueries(), 0);
+  }
+
+  {
+    auto cursor = qplan1->execute(0);
+    SValue row;
+    EXPECT_TRUE(cursor->next(&row, 1));
+    EXPECT_EQ(admission->numRunningQueries(), 1);
+  }
+
+  EXPECT_EQ(admission->numRunningQueries(), 0);
+
+  ResultList result;
+  qplan2->execute(0, &result);
+  EXPECT_TRUE(result.getNumRows() > 0);
+  EXPECT_EQ(admission->numRunningQueries(), 0);
+});
+
+TEST_CASE(RuntimeTest, TestExplainAnalyze, [] () {
+  auto runtime = Runtime::getDefaultRuntime();
+  auto txn = runtime->newTransaction();
+  auto estrat = mkRef(new DefaultExecutionStrategy());
+  estrat->addTableProvider(
+      new backends::csv::CSVTableProvider(
+          "orders",
+          "src/csql/testdata/testtbl3.csv",
+          '\t'));
+
+  ResultList result;
+  auto query = R"(
+    EXPLAIN ANALYZE SELECT orderid FROM orders ORDER BY orderid DESC;
+  )";
+
+  auto qplan = runtime->buildQueryPlan(txn.get(), query, estrat.get());
+  qplan->execute(0, &result);
+
+  EXPECT_EQ(result.getNumColumns(), 9);
+  EXPECT_EQ(result.getColumns()[0], "operator");
+  EXPECT_EQ(result.getColumns()[1], "rows_in");
+  EXPECT_EQ(result.getColumns()[2], "rows_out");
+  EXPECT_TRUE(result.getNumRows() >= 2);
+
+  /* the first row is the root operator, the last one the table scan */
+  EXPECT_EQ(result.getRow(0)[0], "order by");
+  EXPECT_EQ(result.getRow(0)[1], "196");
+  EXPECT_EQ(result.getRow(0)[2], "196");
+
+  auto last = result.getNumRows() - 1;
+  EXPECT_TRUE(StringUtil::endsWith(result.getRow(last)[0], "  scan orders"));
+  EXPECT_EQ(result.getRow(last)[1], "196");
+  EXPECT_EQ(result.getRow(last)[2], "196");
+  EXPECT_TRUE(std::stoull(result.getRow(last)[6]) > 0);
+
+  /* the partial instances of a GROUP BY report their stats too */
+  {
+    ResultList result;
+    auto query = R"(
+      EXPLAIN ANALYZE
+      SELECT customerid, count(1) FROM orders GROUP BY customerid;
+    )";
+
+    auto qplan = runtime->buildQueryPlan(txn.get(), query, estrat.get());
+    qplan->execute(0, &result);
+
+    EXPECT_EQ(result.getRow(0)[0], "group by");
+    EXPECT_TRUE(std::stoull(result.getRow(0)[7]) > 0);
+
+    auto last = result.getNumRows() - 1;
+    EXPECT_TRUE(std::stoull(result.getRow(last)[6]) > 0);
+  }
+});
+
 TEST_CASE(RuntimeTest, TestShowTables, [] () {
   auto runtime = Runtime::getDefaultRuntime();
   auto txn = runtime->newTransaction();
@@ -0,0 +1,56 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stx/io/fileutil.h>
+#include <stx/io/inputstream.h>
+#include <stx/io/outputstream.h>
+#include <csql/runtime/ScanCheckpoint.h>
+#include <csql/runtime/SpillFile.h>
+
+using namespace stx;
+
+namespace csql {
+
+static String getScanCheckpointPath(
+    const String& cache_dir,
+    const SHA1Hash& key) {
+  return FileUtil::joinPaths(cache_dir, key.toString() + ".checkpoint");
+}
+
+bool loadScanCheckpoint(
+    const String& cache_dir,
+    const SHA1Hash& key,
+    ScanCheckpoint* checkpoint) {
+  auto path = getScanCheckpointPath(cache_dir, key);
+  if (!FileUtil::exists(path)) {
+    return false;
+  }
+
+  auto is = FileInputStream::openFile(path);
+  checkpoint->num_records = is->readVarUInt();
+  checkpoint->state = is->readLenencString();
+  return true;
+}
+
+void storeScanCheckpoint(
+    const String& cache_dir,
+    const SHA1Hash& key,
+    const ScanCheckpoint& checkpoint) {
+  auto tmp_path = makeSpillFilePath(cache_dir, "checkpoint");
+
+  {
+    auto os = FileOutputStream::openFile(tmp_path);
+    os->appendVarUInt(checkpoint.num_records);
+    os->appendLenencString(checkpoint.state.data(), checkpoint.state.size());
+  }
+
+  FileUtil::mv(tmp_path, getScanCheckpointPath(cache_dir, key));
+}
+
+} // namespace csql
@@ -0,0 +1,52 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <stx/SHA1.h>
+
+using namespace stx;
+
+namespace csql {
+
+/**
+ * The aggregate state of a scan over an append-only table after the first
+ * num_records records were scanned. A later scan of the same table loads the
+ * state, skips the first num_records records and only accumulates the records
+ * that were appended since (see CSTableScan::setCheckpointKey)
+ */
+struct ScanCheckpoint {
+  uint64_t num_records;
+
+  /**
+   * The serialized aggregate state of each select list expression (see
+   * VM::saveState)
+   */
+  String state;
+};
+
+/**
+ * Loads the checkpoint for key from the cache dir. Returns false if there is
+ * no checkpoint for the key
+ */
+bool loadScanCheckpoint(
+    const String& cache_dir,
+    const SHA1Hash& key,
+    ScanCheckpoint* checkpoint);
+
+/**
+ * Stores the checkpoint for key in the cache dir. The file is replaced
+ * atomically, so concurrent scans never read a partial checkpoint
+ */
+void storeScanCheckpoint(
+    const String& cache_dir,
+    const SHA1Hash& key,
+    const ScanCheckpoint& checkpoint);
+
+} // namespace csql
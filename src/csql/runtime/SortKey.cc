@@ -0,0 +1,245 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <csql/runtime/SortKey.h>
+
+using namespace stx;
+
+namespace csql {
+
+static const char kSortKeyNumberTag = 0x01;
+static const char kSortKeyStringTag = 0x02;
+static const char kSortKeyNullTag = 0x03;
+
+static void appendUInt64BigEndian(uint64_t value, String* dst) {
+  for (int i = 7; i >= 0; --i) {
+    dst->push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+  }
+}
+
+void SortKey::encode(const SValue& value, bool descending, String* dst) {
+  auto begin = dst->size();
+
+  switch (value.getType()) {
+
+    case SQL_NULL:
+      dst->push_back(kSortKeyNullTag);
+      break;
+
+    case SQL_INTEGER:
+    case SQL_TIMESTAMP:
+    case SQL_BOOL: {
+      auto ival = value.getInteger();
+      encodeNumber(ival, true, ival, dst);
+      break;
+    }
+
+    case SQL_FLOAT:
+      encodeNumber(value.getFloat(), false, 0, dst);
+      break;
+
+    case SQL_STRING:
+      encodeString(value.getString(), dst);
+      break;
+
+  }
+
+  if (descending) {
+    for (auto i = begin; i < dst->size(); ++i) {
+      (*dst)[i] = ~(*dst)[i];
+    }
+  }
+}
+
+void SortKey::encode(
+    const SValue* values,
+    const bool* descending,
+    size_t num_values,
+    String* dst) {
+  for (size_t i = 0; i < num_values; ++i) {
+    encode(values[i], descending[i], dst);
+  }
+}
+
+bool SortKey::encodeJoinKey(const SValue& value, String* dst) {
+  switch (value.getType()) {
+
+    case SQL_NULL:
+      return false;
+
+    case SQL_FLOAT: {
+      auto fval = value.getFloat();
+      if (fval == floor(fval) && fabs(fval) < 9.0e18) {
+        auto ival = SValue::IntegerType(fval);
+        encodeNumber(ival, true, ival, dst);
+        return true;
+      }
+      break;
+    }
+
+    default:
+      break;
+
+  }
+
+  encode(value, false, dst);
+  return true;
+}
+
+bool SortKey::encodeEquiJoinKey(
+    const SValue& value,
+    String* dst,
+    bool* exact) {
+  switch (value.getType()) {
+
+    case SQL_FLOAT: {
+      /* = compares floats to strings by their "%f" representation */
+      auto fval = value.getFloat();
+      auto rval = strtod(value.getString().c_str(), nullptr);
+      if (rval != fval) {
+        *exact = false;
+      }
+
+      return encodeJoinKey(SValue(SValue::FloatType(rval)), dst);
+    }
+
+    case SQL_TIMESTAMP: {
+      /* = compares timestamps to strings by their string representation,
+       * which drops the sub-second part */
+      if (value.getInteger() % 1000000 != 0) {
+        *exact = false;
+      }
+
+      encodeString(value.getString(), dst);
+      return true;
+    }
+
+    case SQL_STRING: {
+      auto str = value.getString();
+      if (str.empty()) {
+        break;
+      }
+
+      /* = compares booleans to strings as "true" and "false" */
+      if (str == "true" || str == "false") {
+        auto ival = str == "true" ? 1 : 0;
+        *exact = false;
+        encodeNumber(ival, true, ival, dst);
+        return true;
+      }
+
+      if (value.isConvertibleTo<SValue::IntegerType>()) {
+        errno = 0;
+        auto ival = strtoll(str.c_str(), nullptr, 10);
+        if (errno == 0) {
+          *exact = false;
+          encodeNumber(ival, true, ival, dst);
+          return true;
+        }
+
+        break;
+      }
+
+      char* end;
+      auto fval = strtod(str.c_str(), &end);
+      if (end == str.c_str() + str.size()) {
+        *exact = false;
+        return encodeJoinKey(SValue(SValue::FloatType(fval)), dst);
+      }
+
+      break;
+    }
+
+    default:
+      break;
+
+  }
+
+  return encodeJoinKey(value, dst);
+}
+
+int SortKey::compare(const String& left, const String& right) {
+  auto len = std::min(left.size(), right.size());
+  auto res = memcmp(left.data(), right.data(), len);
+  if (res != 0) {
+    return res;
+  }
+
+  if (left.size() == right.size()) {
+    return 0;
+  } else {
+    return left.size() < right.size() ? -1 : 1;
+  }
+}
+
+void SortKey::encodeNumber(
+    double float_value,
+    bool integral,
+    int64_t integer_value,
+    String* dst) {
+  dst->push_back(kSortKeyNumberTag);
+
+  /* normalize -0.0 to 0.0 */
+  if (float_value == 0) {
+    float_value = 0;
+  }
+
+  uint64_t fbits;
+  memcpy(&fbits, &float_value, sizeof(fbits));
+  if (fbits & (1ULL << 63)) {
+    fbits = ~fbits;
+  } else {
+    fbits ^= (1ULL << 63);
+  }
+
+  appendUInt64BigEndian(fbits, dst);
+
+  /* integers and integral floats that round to the same double are ordered
+   * by their exact value. Only floats beyond the int64 range can tie with an
+   * integer otherwise (e.g. 2^63 and INT64_MAX), they sort after all integers
+   * if positive and before them if negative */
+  if (!integral &&
+      float_value == floor(float_value) &&
+      float_value >= -9223372036854775808.0 &&
+      float_value < 9223372036854775808.0) {
+    integral = true;
+    integer_value = static_cast<int64_t>(float_value);
+  }
+
+  if (integral) {
+    dst->push_back(0x01);
+    appendUInt64BigEndian(
+        static_cast<uint64_t>(integer_value) ^ (1ULL << 63),
+        dst);
+  } else {
+    dst->push_back(float_value > 0 ? 0x02 : 0x00);
+    appendUInt64BigEndian(0, dst);
+  }
+}
+
+void SortKey::encodeString(const String& value, String* dst) {
+  dst->push_back(kSortKeyStringTag);
+
+  for (auto c : value) {
+    dst->push_back(c);
+    if (c == 0) {
+      dst->push_back(static_cast<char>(0xff));
+    }
+  }
+
+  dst->push_back(0x00);
+  dst->push_back(0x00);
+}
+
+} // namespace csql
@@ -0,0 +1,94 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <csql/svalue.h>
+
+using namespace stx;
+
+namespace csql {
+
+/**
+ * Encodes a list of values into a normalized, order-preserving byte string so
+ * that comparing two encoded keys with memcmp yields the same order as
+ * comparing the values one by one. Each value is encoded as:
+ *
+ *   - NULL: a single type byte; NULL sorts after all other values. This
+ *     intentionally differs from the legacy comparison, which compared NULL
+ *     as 0 against numbers, i.e. sorted it between negative and positive
+ *     numbers
+ *   - numbers (INTEGER, FLOAT, TIMESTAMP, BOOL): a type byte followed by the
+ *     value as a bit-twiddled big endian double and a tie breaker for values
+ *     beyond 2^53 that round to the same double: integers and integral floats
+ *     in the int64 range append their exact value as a sign-flipped big endian
+ *     int64, so e.g. 2^53 + 3 sorts before 2^53 + 4.0
+ *   - strings: a type byte followed by the string with 0x00 escaped as
+ *     0x00 0xff and terminated by 0x00 0x00
+ *
+ * All bytes of a DESC value are inverted, so NULL sorts first in DESC order.
+ * Numbers always sort before strings.
+ *
+ * The encoding is prefix free, so keys can be concatenated, radix sorted and
+ * written to disk (e.g. for external sorts) as-is.
+ */
+class SortKey {
+public:
+
+  static void encode(const SValue& value, bool descending, String* dst);
+
+  static void encode(
+      const SValue* values,
+      const bool* descending,
+      size_t num_values,
+      String* dst);
+
+  /**
+   * Encodes a value for use in equi-join keys. Integral floats are encoded
+   * as integers so that e.g. 1.0 and 1 produce the same bytes. Returns false
+   * if the value is NULL (NULL never compares equal to anything)
+   */
+  static bool encodeJoinKey(const SValue& value, String* dst);
+
+  /**
+   * Encodes a value for use in hash join keys so that any two values that are
+   * equal according to the SQL = operator produce the same bytes: strings
+   * that look like numbers are encoded as numbers (so that '5' matches 5),
+   * 'true' and 'false' as the booleans 1 and 0, floats as the value of their
+   * string representation and timestamps as their string representation.
+   *
+   * The reverse does not hold, e.g. '05' and 5 or 5.0000001 and 5.0 produce
+   * the same bytes but are not equal. Such values clear *exact; a match where
+   * either side is inexact must be confirmed with the = operator. Returns
+   * false if the value is NULL
+   */
+  static bool encodeEquiJoinKey(
+      const SValue& value,
+      String* dst,
+      bool* exact);
+
+  /**
+   * Compare two encoded keys. Returns < 0 if left sorts before right, 0 if
+   * both keys are equal and > 0 if left sorts after right
+   */
+  static int compare(const String& left, const String& right);
+
+protected:
+
+  static void encodeNumber(
+      double float_value,
+      bool integral,
+      int64_t integer_value,
+      String* dst);
+
+  static void encodeString(const String& value, String* dst);
+
+};
+
+} // namespace csql
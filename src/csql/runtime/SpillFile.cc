@@ -0,0 +1,98 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stx/random.h>
+#include <stx/io/fileutil.h>
+#include <csql/runtime/SpillFile.h>
+
+using namespace stx;
+
+namespace csql {
+
+const size_t SpillFileWriter::kBufferSize = 65536;
+
+SpillFileWriter::SpillFileWriter(
+    const String& path) :
+    path_(path),
+    file_(FileOutputStream::openFile(path)),
+    buf_os_(StringOutputStream::fromString(&buf_)),
+    num_rows_(0),
+    num_bytes_(0) {}
+
+void SpillFileWriter::appendRow(const SValue* row, size_t row_len) {
+  buf_os_->appendVarUInt(row_len);
+  for (size_t i = 0; i < row_len; ++i) {
+    row[i].encode(buf_os_.get());
+  }
+
+  ++num_rows_;
+
+  if (buf_.size() >= kBufferSize) {
+    flushBuffer();
+  }
+}
+
+void SpillFileWriter::close() {
+  flushBuffer();
+  file_.reset(nullptr);
+}
+
+void SpillFileWriter::flushBuffer() {
+  if (buf_.empty()) {
+    return;
+  }
+
+  file_->write(buf_.data(), buf_.size());
+  num_bytes_ += buf_.size();
+  buf_.clear();
+}
+
+const String& SpillFileWriter::path() const {
+  return path_;
+}
+
+size_t SpillFileWriter::numRows() const {
+  return num_rows_;
+}
+
+size_t SpillFileWriter::numBytes() const {
+  return num_bytes_ + buf_.size();
+}
+
+SpillFileReader::SpillFileReader(
+    const String& path,
+    size_t num_rows) :
+    file_(FileInputStream::openFile(path)),
+    rows_left_(num_rows) {}
+
+bool SpillFileReader::readRow(Vector<SValue>* row) {
+  if (rows_left_ == 0) {
+    return false;
+  }
+
+  auto row_len = file_->readVarUInt();
+  row->resize(row_len);
+  for (size_t i = 0; i < row_len; ++i) {
+    (*row)[i].decode(file_.get());
+  }
+
+  --rows_left_;
+  return true;
+}
+
+String makeSpillFilePath(const String& dir, const String& prefix) {
+  return FileUtil::joinPaths(
+      dir,
+      StringUtil::format(
+          "$0.$1.tmp",
+          prefix,
+          Random::singleton()->sha1().toString()));
+}
+
+} // namespace csql
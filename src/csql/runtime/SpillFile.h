@@ -0,0 +1,76 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <stx/io/inputstream.h>
+#include <stx/io/outputstream.h>
+#include <csql/svalue.h>
+
+using namespace stx;
+
+namespace csql {
+
+/**
+ * Writes rows to a temporary file so that operators can process inputs that
+ * do not fit into memory. Each row is stored as its number of columns
+ * followed by the encoded values. Writes are buffered in memory and flushed
+ * in kBufferSize chunks.
+ */
+class SpillFileWriter {
+public:
+  static const size_t kBufferSize;
+
+  SpillFileWriter(const String& path);
+  SpillFileWriter(const SpillFileWriter& other) = delete;
+  SpillFileWriter& operator=(const SpillFileWriter& other) = delete;
+
+  void appendRow(const SValue* row, size_t row_len);
+
+  /**
+   * Flush all buffered rows to disk. No rows may be appended after close
+   */
+  void close();
+
+  const String& path() const;
+  size_t numRows() const;
+  size_t numBytes() const;
+
+protected:
+  void flushBuffer();
+
+  String path_;
+  ScopedPtr<FileOutputStream> file_;
+  String buf_;
+  ScopedPtr<StringOutputStream> buf_os_;
+  size_t num_rows_;
+  size_t num_bytes_;
+};
+
+class SpillFileReader {
+public:
+
+  SpillFileReader(const String& path, size_t num_rows);
+
+  /**
+   * Read the next row. Returns false once all rows have been read
+   */
+  bool readRow(Vector<SValue>* row);
+
+protected:
+  ScopedPtr<FileInputStream> file_;
+  size_t rows_left_;
+};
+
+/**
+ * Returns a new, unique file path for a spill file in the provided directory
+ */
+String makeSpillFilePath(const String& dir, const String& prefix);
+
+} // namespace csql
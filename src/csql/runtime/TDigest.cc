@@ -0,0 +1,202 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <math.h>
+#include <csql/runtime/TDigest.h>
+
+using namespace stx;
+
+namespace csql {
+
+const size_t TDigest::kCompression;
+const size_t TDigest::kBufferSize;
+
+/* the k1 scale function maps a quantile to the index of its centroid */
+static double scaleK1(double q) {
+  return TDigest::kCompression / (2 * M_PI) * asin(2 * q - 1);
+}
+
+static double scaleK1Inverse(double k) {
+  auto x = std::min(k * 2 * M_PI / TDigest::kCompression, M_PI / 2);
+  return (sin(x) + 1) / 2;
+}
+
+TDigest::TDigest() :
+    total_weight_(0),
+    min_(0),
+    max_(0) {}
+
+void TDigest::insert(double value, double weight /* = 1 */) {
+  if (total_weight_ == 0) {
+    min_ = value;
+    max_ = value;
+  } else {
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+
+  total_weight_ += weight;
+  buffer_.emplace_back(Centroid { value, weight });
+  if (buffer_.size() >= kBufferSize) {
+    compress();
+  }
+}
+
+void TDigest::merge(const TDigest& other) {
+  if (other.total_weight_ == 0) {
+    return;
+  }
+
+  if (total_weight_ == 0) {
+    min_ = other.min_;
+    max_ = other.max_;
+  } else {
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+  }
+
+  total_weight_ += other.total_weight_;
+  buffer_.insert(buffer_.end(), other.buffer_.begin(), other.buffer_.end());
+  buffer_.insert(
+      buffer_.end(),
+      other.centroids_.begin(),
+      other.centroids_.end());
+
+  compress();
+}
+
+double TDigest::quantile(double q) const {
+  compress();
+
+  if (centroids_.empty()) {
+    return 0;
+  }
+
+  if (centroids_.size() == 1 || q <= 0) {
+    return q <= 0 ? min_ : centroids_[0].mean;
+  }
+
+  if (q >= 1) {
+    return max_;
+  }
+
+  /* interpolate between the centers of adjacent centroids */
+  auto index = q * total_weight_;
+  const auto& first = centroids_.front();
+  if (index < first.weight / 2) {
+    return min_ + (first.mean - min_) * index / (first.weight / 2);
+  }
+
+  double center = first.weight / 2;
+  for (size_t i = 0; i + 1 < centroids_.size(); ++i) {
+    const auto& left = centroids_[i];
+    const auto& right = centroids_[i + 1];
+    auto next_center = center + (left.weight + right.weight) / 2;
+
+    if (index < next_center) {
+      auto t = (index - center) / (next_center - center);
+      return left.mean + (right.mean - left.mean) * t;
+    }
+
+    center = next_center;
+  }
+
+  const auto& last = centroids_.back();
+  auto t = (index - center) / (last.weight / 2);
+  return last.mean + (max_ - last.mean) * std::min(t, 1.0);
+}
+
+double TDigest::totalWeight() const {
+  return total_weight_;
+}
+
+size_t TDigest::memoryUsage() const {
+  return (centroids_.capacity() + buffer_.capacity()) * sizeof(Centroid);
+}
+
+void TDigest::clear() {
+  centroids_.clear();
+  buffer_.clear();
+  total_weight_ = 0;
+  min_ = 0;
+  max_ = 0;
+}
+
+void TDigest::encode(OutputStream* os) const {
+  compress();
+
+  os->appendVarUInt(centroids_.size());
+  os->appendDouble(min_);
+  os->appendDouble(max_);
+  for (const auto& c : centroids_) {
+    os->appendDouble(c.mean);
+    os->appendDouble(c.weight);
+  }
+}
+
+void TDigest::decode(InputStream* is) {
+  clear();
+
+  auto n = is->readVarUInt();
+  min_ = is->readDouble();
+  max_ = is->readDouble();
+  for (size_t i = 0; i < n; ++i) {
+    Centroid c;
+    c.mean = is->readDouble();
+    c.weight = is->readDouble();
+    total_weight_ += c.weight;
+    centroids_.emplace_back(c);
+  }
+}
+
+void TDigest::compress() const {
+  if (buffer_.empty()) {
+    return;
+  }
+
+  Vector<Centroid> all;
+  all.reserve(centroids_.size() + buffer_.size());
+  all.insert(all.end(), centroids_.begin(), centroids_.end());
+  all.insert(all.end(), buffer_.begin(), buffer_.end());
+  buffer_.clear();
+
+  std::sort(all.begin(), all.end(), [] (const Centroid& a, const Centroid& b) {
+    return a.mean < b.mean;
+  });
+
+  double total = 0;
+  for (const auto& c : all) {
+    total += c.weight;
+  }
+
+  /* combine adjacent centroids while they fit into one unit of k */
+  centroids_.clear();
+  auto cur = all[0];
+  double weight_so_far = 0;
+  auto q_limit = scaleK1Inverse(scaleK1(0) + 1);
+  for (size_t i = 1; i < all.size(); ++i) {
+    const auto& next = all[i];
+    auto q = (weight_so_far + cur.weight + next.weight) / total;
+
+    if (q <= q_limit) {
+      cur.weight += next.weight;
+      cur.mean += (next.mean - cur.mean) * next.weight / cur.weight;
+    } else {
+      weight_so_far += cur.weight;
+      centroids_.emplace_back(cur);
+      q_limit = scaleK1Inverse(scaleK1(weight_so_far / total) + 1);
+      cur = next;
+    }
+  }
+
+  centroids_.emplace_back(cur);
+}
+
+} // namespace csql
@@ -0,0 +1,83 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <stx/io/inputstream.h>
+#include <stx/io/outputstream.h>
+
+using namespace stx;
+
+namespace csql {
+
+/**
+ * A merging t-digest that estimates quantiles of a stream of values in
+ * bounded memory.
+ *
+ * New values are collected in a buffer of kBufferSize values. When the buffer
+ * is full it is merged with the centroids, and adjacent centroids are
+ * combined while the result stays within the k1 scale function's size limit
+ * for kCompression. This keeps at most ~kCompression centroids, which are
+ * small near the tails and large around the median, so extreme quantiles
+ * stay accurate. Two digests are merged by combining their centroids.
+ */
+class TDigest {
+public:
+
+  static const size_t kCompression = 100;
+  static const size_t kBufferSize = 500;
+
+  TDigest();
+
+  void insert(double value, double weight = 1);
+
+  /**
+   * Merge the other digest into this one so that this digest estimates the
+   * quantiles of the union of both streams
+   */
+  void merge(const TDigest& other);
+
+  /**
+   * Returns the estimated value at quantile q (0 <= q <= 1). Must not be
+   * called on an empty digest
+   */
+  double quantile(double q) const;
+
+  double totalWeight() const;
+
+  /**
+   * Returns the number of bytes allocated for the centroids and the buffer
+   */
+  size_t memoryUsage() const;
+
+  void clear();
+
+  void encode(OutputStream* os) const;
+  void decode(InputStream* is);
+
+protected:
+
+  struct Centroid {
+    double mean;
+    double weight;
+  };
+
+  /**
+   * Merge the buffered values into the centroids
+   */
+  void compress() const;
+
+  mutable Vector<Centroid> centroids_;
+  mutable Vector<Centroid> buffer_;
+  double total_weight_;
+  double min_;
+  double max_;
+};
+
+} // namespace csql
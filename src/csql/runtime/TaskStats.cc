@@ -0,0 +1,78 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <csql/runtime/TaskStats.h>
+
+using namespace stx;
+
+namespace csql {
+
+const size_t TaskStats::kTimingSampleInterval;
+
+TaskStats::TaskStats() :
+    num_rows_in(0),
+    num_rows_out(0),
+    num_batches(0),
+    wall_time_micros(0),
+    cpu_time_micros(0),
+    bytes_read(0),
+    peak_memory_bytes(0),
+    spill_bytes(0) {}
+
+void TaskStats::updatePeakMemory(uint64_t bytes) {
+  auto peak = peak_memory_bytes.load();
+  while (bytes > peak && !peak_memory_bytes.compare_exchange_weak(peak, bytes));
+}
+
+TaskStats* ExecutionStats::getTaskStats(const TaskID& task_id) {
+  std::unique_lock<std::mutex> lk(mutex_);
+
+  auto& stats = tasks_[task_id];
+  if (stats.get() == nullptr) {
+    stats = mkScoped(new TaskStats());
+  }
+
+  return stats.get();
+}
+
+const TaskStats* ExecutionStats::findTaskStats(const TaskID& task_id) const {
+  std::unique_lock<std::mutex> lk(mutex_);
+
+  auto stats = tasks_.find(task_id);
+  if (stats == tasks_.end()) {
+    return nullptr;
+  }
+
+  return stats->second.get();
+}
+
+TaskStats* ExecutionStats::getPartialTaskStats(const TaskID& task_id) {
+  std::unique_lock<std::mutex> lk(mutex_);
+
+  auto& stats = partial_tasks_[task_id];
+  if (stats.get() == nullptr) {
+    stats = mkScoped(new TaskStats());
+  }
+
+  return stats.get();
+}
+
+const TaskStats* ExecutionStats::findPartialTaskStats(
+    const TaskID& task_id) const {
+  std::unique_lock<std::mutex> lk(mutex_);
+
+  auto stats = partial_tasks_.find(task_id);
+  if (stats == partial_tasks_.end()) {
+    return nullptr;
+  }
+
+  return stats->second.get();
+}
+
+} // namespace csql
@@ -0,0 +1,86 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <stx/stdtypes.h>
+#include <csql/tasks/TaskID.h>
+
+using namespace stx;
+
+namespace csql {
+
+/**
+ * Execution statistics of one task. All instances of a task (e.g. the morsel
+ * workers of a scan) add to the same TaskStats. The counters are updated once
+ * per batch of rows, not per row.
+ *
+ * The wall and cpu time are inclusive: they contain the time spent in the
+ * task's inputs if those are executed in the same thread. The time is
+ * measured for the first kTimingSampleInterval calls of each task instance
+ * and then for every kTimingSampleInterval-th call (see TaskResultCursor)
+ */
+struct TaskStats {
+  static const size_t kTimingSampleInterval = 64;
+
+  TaskStats();
+
+  /**
+   * The number of rows read from a table or spill file. The number of input
+   * rows of a task with input tasks is the number of output rows of its inputs
+   */
+  std::atomic<uint64_t> num_rows_in;
+  std::atomic<uint64_t> num_rows_out;
+  std::atomic<uint64_t> num_batches;
+  std::atomic<uint64_t> wall_time_micros;
+  std::atomic<uint64_t> cpu_time_micros;
+  std::atomic<uint64_t> bytes_read;
+  std::atomic<uint64_t> peak_memory_bytes;
+  std::atomic<uint64_t> spill_bytes;
+
+  void updatePeakMemory(uint64_t bytes);
+};
+
+/**
+ * The statistics of all tasks executed in a transaction, by task id
+ */
+class ExecutionStats {
+public:
+
+  /**
+   * Returns the stats for the task. The stats are created on the first call
+   */
+  TaskStats* getTaskStats(const TaskID& task_id);
+
+  /**
+   * Returns nullptr if no stats were recorded for the task
+   */
+  const TaskStats* findTaskStats(const TaskID& task_id) const;
+
+  /**
+   * Returns the stats for the partial instances of a task that is executed
+   * in two phases (see TaskFactory::buildPartial). They are kept apart from
+   * the task's own stats, so that the rows of the partial instances aren't
+   * counted as the task's output rows
+   */
+  TaskStats* getPartialTaskStats(const TaskID& task_id);
+
+  /**
+   * Returns nullptr if no partial stats were recorded for the task
+   */
+  const TaskStats* findPartialTaskStats(const TaskID& task_id) const;
+
+protected:
+  mutable std::mutex mutex_;
+  HashMap<TaskID, ScopedPtr<TaskStats>> tasks_;
+  HashMap<TaskID, ScopedPtr<TaskStats>> partial_tasks_;
+};
+
+} // namespace csql
@@ -9,9 +9,77 @@
  */
 #include <csql/runtime/queryplan.h>
 #include <csql/runtime/runtime.h>
+#include <csql/Transaction.h>
 
 namespace csql {
 
+/**
+ * Releases the transaction's admission once the last row was read or the
+ * cursor is closed or destroyed
+ */
+class AdmittedResultCursor : public ResultCursor {
+public:
+
+  AdmittedResultCursor(
+      Transaction* txn,
+      ScopedPtr<ResultCursor> cursor) :
+      txn_(txn),
+      cursor_(std::move(cursor)),
+      released_(false) {}
+
+  ~AdmittedResultCursor() {
+    cursor_.reset(nullptr);
+    release();
+  }
+
+  bool next(SValue* row, int row_len) override {
+    if (released_) {
+      return false;
+    }
+
+    if (cursor_->next(row, row_len)) {
+      return true;
+    }
+
+    release();
+    return false;
+  }
+
+  bool poll() override {
+    return released_ || cursor_->poll();
+  }
+
+  void wait(Function<void ()> callback) override {
+    if (released_) {
+      callback();
+    } else {
+      cursor_->wait(callback);
+    }
+  }
+
+  void close() override {
+    cursor_->close();
+    release();
+  }
+
+  void prefetch(int row_len) override {
+    cursor_->prefetch(row_len);
+  }
+
+protected:
+
+  void release() {
+    if (!released_) {
+      released_ = true;
+      txn_->release();
+    }
+  }
+
+  Transaction* txn_;
+  ScopedPtr<ResultCursor> cursor_;
+  bool released_;
+};
+
 QueryPlan::QueryPlan(
     Transaction* txn,
     Vector<RefPtr<QueryTreeNode>> qtrees) :
@@ -35,12 +103,26 @@ ScopedPtr<ResultCursor> QueryPlan::execute(size_t stmt_idx) {
     RAISE(kIndexError, "invalid statement index");
   }
 
-  auto sched = scheduler_(txn_, &tasks_, &callbacks_);
-  Set<TaskID> task_ids;
-  for (const auto& task_id : statement_tasks_[stmt_idx]) {
-    task_ids.emplace(task_id);
+  /* the scheduler sizes its thread budget by the admission ticket */
+  txn_->admit();
+
+  ScopedPtr<ResultCursor> cursor;
+  try {
+    txn_->clearRuntimeFilters();
+
+    auto sched = scheduler_(txn_, &tasks_, &callbacks_);
+    Set<TaskID> task_ids;
+    for (const auto& task_id : statement_tasks_[stmt_idx]) {
+      task_ids.emplace(task_id);
+    }
+
+    cursor = sched->execute(task_ids);
+  } catch (...) {
+    txn_->release();
+    throw;
   }
-  return sched->execute(task_ids);
+
+  return mkScoped(new AdmittedResultCursor(txn_, std::move(cursor)));
 }
 
 void QueryPlan::execute(size_t stmt_idx, ResultList* result_list) {
@@ -21,6 +21,7 @@
 #include <csql/qtree/ChartStatementNode.h>
 #include <csql/qtree/ShowTablesNode.h>
 #include <csql/qtree/DescribeTableNode.h>
+#include <csql/qtree/ExplainAnalyzeNode.h>
 #include <csql/qtree/RegexExpressionNode.h>
 #include <csql/qtree/LikeExpressionNode.h>
 #include <csql/qtree/SubqueryNode.h>
@@ -41,6 +42,15 @@ RefPtr<QueryTreeNode> QueryPlanBuilder::build(
     RefPtr<TableProvider> tables) {
   QueryTreeNode* node = nullptr;
 
+  if ((node = buildExplainAnalyze(txn, ast, tables)) != nullptr) {
+    return node;
+  }
+
+  /* rewrite IN/EXISTS subquery predicates into semi and anti joins */
+  if (hasSubqueryPredicate(ast)) {
+    rewriteSubqueryPredicates(txn, ast, tables);
+  }
+
   /* assign explicit column names to all output columns */
   if (hasImplicitlyNamedColumns(ast)) {
     assignExplicitColumnNames(txn, ast, tables);
@@ -102,6 +112,7 @@ Vector<RefPtr<QueryTreeNode>> QueryPlanBuilder::build(
       case ASTNode::T_SELECT_DEEP:
       case ASTNode::T_SHOW_TABLES:
       case ASTNode::T_DESCRIBE_TABLE:
+      case ASTNode::T_EXPLAIN_ANALYZE:
         nodes.emplace_back(build(txn, statements[i], tables));
         break;
 
@@ -273,6 +284,370 @@ bool QueryPlanBuilder::hasJoin(ASTNode* ast) const {
   return false;
 }
 
+static bool isSubqueryPredicate(ASTNode* ast) {
+  switch (ast->getType()) {
+    case ASTNode::T_IN_SUBQUERY_EXPR:
+    case ASTNode::T_NOT_IN_SUBQUERY_EXPR:
+    case ASTNode::T_EXISTS_EXPR:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static bool containsSubqueryPredicate(ASTNode* ast) {
+  if (isSubqueryPredicate(ast)) {
+    return true;
+  }
+
+  for (const auto& child : ast->getChildren()) {
+    if (*child == ASTNode::T_SELECT) {
+      continue;
+    }
+
+    if (containsSubqueryPredicate(child)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void splitConjunction(ASTNode* ast, Vector<ASTNode*>* conjuncts) {
+  if (*ast == ASTNode::T_AND_EXPR) {
+    for (const auto& child : ast->getChildren()) {
+      splitConjunction(child, conjuncts);
+    }
+  } else {
+    conjuncts->emplace_back(ast);
+  }
+}
+
+static ASTNode* buildConjunction(const Vector<ASTNode*>& conjuncts) {
+  ASTNode* expr = nullptr;
+  for (const auto& conj : conjuncts) {
+    if (expr == nullptr) {
+      expr = conj;
+    } else {
+      auto and_expr = new ASTNode(ASTNode::T_AND_EXPR);
+      and_expr->appendChild(expr);
+      and_expr->appendChild(conj);
+      expr = and_expr;
+    }
+  }
+
+  return expr;
+}
+
+static ASTNode* findWhereClause(ASTNode* ast) {
+  for (const auto& child : ast->getChildren()) {
+    if (*child == ASTNode::T_WHERE) {
+      return child;
+    }
+  }
+
+  return nullptr;
+}
+
+/**
+ * Collects all column names referenced by an expression, excluding nested
+ * subqueries
+ */
+static void findColumnNames(ASTNode* ast, Vector<ASTNode*>* columns) {
+  if (*ast == ASTNode::T_COLUMN_NAME) {
+    columns->emplace_back(ast);
+    return;
+  }
+
+  for (const auto& child : ast->getChildren()) {
+    if (*child == ASTNode::T_SELECT) {
+      continue;
+    }
+
+    findColumnNames(child, columns);
+  }
+}
+
+static Vector<String> columnNameParts(ASTNode* ast) {
+  Vector<String> parts;
+  for (auto cur = ast; cur->getToken() != nullptr; ) {
+    parts.emplace_back(cur->getToken()->getString());
+
+    if (cur->getChildren().size() != 1) {
+      break;
+    } else {
+      cur = cur->getChildren()[0];
+    }
+  }
+
+  return parts;
+}
+
+static void setColumnName(
+    ASTNode* ast,
+    const String& table_name,
+    const String& column_name) {
+  ast->clearChildren();
+  ast->setToken(new Token(Token::T_IDENTIFIER, table_name));
+  auto column = ast->appendChild(ASTNode::T_COLUMN_NAME);
+  column->setToken(new Token(Token::T_IDENTIFIER, column_name));
+}
+
+bool QueryPlanBuilder::hasSubqueryPredicate(ASTNode* ast) const {
+  if (!(*ast == ASTNode::T_SELECT || *ast == ASTNode::T_SELECT_DEEP)) {
+    return false;
+  }
+
+  auto where_clause = findWhereClause(ast);
+  return where_clause && containsSubqueryPredicate(where_clause);
+}
+
+void QueryPlanBuilder::rewriteSubqueryPredicates(
+    Transaction* txn,
+    ASTNode* ast,
+    RefPtr<TableProvider> tables) {
+  auto where_clause = findWhereClause(ast);
+  if (ast->getChildren().size() < 2 ||
+      where_clause == nullptr ||
+      where_clause->getChildren().size() != 1) {
+    RAISE(kRuntimeError, "corrupt AST");
+  }
+
+  Vector<ASTNode*> conjuncts;
+  splitConjunction(where_clause->getChildren()[0], &conjuncts);
+
+  /* each subquery predicate wraps the FROM clause into another join */
+  auto table_ref = ast->getChildren()[1];
+  Vector<ASTNode*> remaining;
+  size_t num_subqueries = 0;
+  for (const auto& conj : conjuncts) {
+    auto pred = conj;
+    bool negated = false;
+    if (*pred == ASTNode::T_NEGATE_EXPR &&
+        pred->getChildren().size() == 1 &&
+        isSubqueryPredicate(pred->getChildren()[0])) {
+      pred = pred->getChildren()[0];
+      negated = true;
+    }
+
+    if (!isSubqueryPredicate(pred)) {
+      if (containsSubqueryPredicate(conj)) {
+        RAISE(
+            kRuntimeError,
+            "IN and EXISTS subqueries are only supported as top level AND "
+            "conditions of the WHERE clause");
+      }
+
+      remaining.emplace_back(conj);
+      continue;
+    }
+
+    auto alias = StringUtil::format("__subquery_$0", num_subqueries++);
+    ASTNode* join = nullptr;
+    switch (pred->getType()) {
+      case ASTNode::T_IN_SUBQUERY_EXPR:
+        join = buildInSubqueryJoin(
+            pred,
+            negated ? ASTNode::T_NULL_AWARE_ANTI_JOIN : ASTNode::T_SEMI_JOIN,
+            alias);
+        break;
+      case ASTNode::T_NOT_IN_SUBQUERY_EXPR:
+        join = buildInSubqueryJoin(
+            pred,
+            negated ? ASTNode::T_SEMI_JOIN : ASTNode::T_NULL_AWARE_ANTI_JOIN,
+            alias);
+        break;
+      case ASTNode::T_EXISTS_EXPR:
+        join = buildExistsSubqueryJoin(
+            pred->getChildren()[0],
+            negated ? ASTNode::T_ANTI_JOIN : ASTNode::T_SEMI_JOIN,
+            alias,
+            tables);
+        break;
+      default:
+        RAISE(kRuntimeError, "corrupt AST");
+    }
+
+    join->appendChild(table_ref, 0);
+    table_ref = join;
+  }
+
+  ast->removeChildByIndex(1);
+  ast->appendChild(table_ref, 1);
+
+  if (remaining.empty()) {
+    ast->removeChild(where_clause);
+  } else {
+    where_clause->clearChildren();
+    where_clause->appendChild(buildConjunction(remaining));
+  }
+}
+
+ASTNode* QueryPlanBuilder::buildInSubqueryJoin(
+    ASTNode* expr,
+    ASTNode::kASTNodeType join_type,
+    const String& alias) {
+  if (expr->getChildren().size() != 2) {
+    RAISE(kRuntimeError, "corrupt AST");
+  }
+
+  auto subquery = expr->getChildren()[1];
+  if (!(*subquery == ASTNode::T_SELECT) ||
+      subquery->getChildren().size() < 1) {
+    RAISE(kRuntimeError, "corrupt AST");
+  }
+
+  auto select_list = subquery->getChildren()[0];
+  if (select_list->getChildren().size() != 1 ||
+      !(*select_list->getChildren()[0] == ASTNode::T_DERIVED_COLUMN)) {
+    RAISE(kRuntimeError, "IN subquery must return exactly one column");
+  }
+
+  /* the key column of the subquery is named like any other output column */
+  auto derived = select_list->getChildren()[0];
+  String key_column;
+  if (derived->getChildren().size() > 1 &&
+      *derived->getChildren()[1] == ASTNode::T_COLUMN_ALIAS) {
+    key_column = derived->getChildren()[1]->getToken()->getString();
+  } else {
+    key_column = ASTUtil::columnNameForExpression(derived->getChildren()[0]);
+  }
+
+  auto join = new ASTNode(join_type);
+
+  auto joined_table = join->appendChild(ASTNode::T_FROM);
+  joined_table->appendChild(subquery);
+  auto table_alias = joined_table->appendChild(ASTNode::T_TABLE_ALIAS);
+  table_alias->setToken(new Token(Token::T_IDENTIFIER, alias));
+
+  auto key = new ASTNode(ASTNode::T_COLUMN_NAME);
+  setColumnName(key, alias, key_column);
+
+  auto cond = join->appendChild(ASTNode::T_JOIN_CONDITION);
+  auto eq_expr = cond->appendChild(ASTNode::T_EQ_EXPR);
+  eq_expr->appendChild(expr->getChildren()[0]);
+  eq_expr->appendChild(key);
+
+  return join;
+}
+
+ASTNode* QueryPlanBuilder::buildExistsSubqueryJoin(
+    ASTNode* subquery,
+    ASTNode::kASTNodeType join_type,
+    const String& alias,
+    RefPtr<TableProvider> tables) {
+  auto join = new ASTNode(join_type);
+
+  auto joined_table = join->appendChild(ASTNode::T_FROM);
+  joined_table->appendChild(subquery);
+  auto table_alias = joined_table->appendChild(ASTNode::T_TABLE_ALIAS);
+  table_alias->setToken(new Token(Token::T_IDENTIFIER, alias));
+
+  /* only the WHERE clause of single table subqueries without aggregation is
+     decorrelated, everything else is executed as an uncorrelated subquery */
+  if (subquery->getChildren().size() != 3 ||
+      hasAggregationInSelectList(subquery)) {
+    return join;
+  }
+
+  auto from = subquery->getChildren()[1];
+  auto where_clause = subquery->getChildren()[2];
+  if (!(*from == ASTNode::T_FROM) ||
+      from->getChildren().size() < 1 ||
+      !(*from->getChildren()[0] == ASTNode::T_TABLE_NAME) ||
+      !(*where_clause == ASTNode::T_WHERE) ||
+      where_clause->getChildren().size() != 1) {
+    return join;
+  }
+
+  auto table_name = from->getChildren()[0]->getToken()->getString();
+  auto table = tables->describe(table_name);
+  if (table.isEmpty()) {
+    return join;
+  }
+
+  String qualifier = table_name;
+  if (from->getChildren().size() > 1 &&
+      *from->getChildren()[1] == ASTNode::T_TABLE_ALIAS) {
+    qualifier = from->getChildren()[1]->getToken()->getString();
+  }
+
+  Set<String> table_columns;
+  for (const auto& col : table.get().columns) {
+    table_columns.emplace(col.column_name);
+  }
+
+  /* conjuncts that reference columns of the outer query are moved into the
+     join condition; names that exist in the subquery's table are inner
+     columns */
+  Vector<ASTNode*> conjuncts;
+  splitConjunction(where_clause->getChildren()[0], &conjuncts);
+
+  Vector<ASTNode*> inner_conjuncts;
+  Vector<ASTNode*> correlated_conjuncts;
+  Set<String> inner_columns;
+  for (const auto& conj : conjuncts) {
+    Vector<ASTNode*> columns;
+    findColumnNames(conj, &columns);
+
+    Vector<std::pair<ASTNode*, String>> conj_inner_columns;
+    bool correlated = false;
+    for (const auto& col : columns) {
+      auto parts = columnNameParts(col);
+      if (parts.size() > 1 && parts[0] == qualifier) {
+        parts.erase(parts.begin());
+      }
+
+      auto column_name = StringUtil::join(parts, ".");
+      if (table_columns.count(column_name) > 0) {
+        conj_inner_columns.emplace_back(col, column_name);
+      } else {
+        correlated = true;
+      }
+    }
+
+    if (!correlated) {
+      inner_conjuncts.emplace_back(conj);
+      continue;
+    }
+
+    for (const auto& col : conj_inner_columns) {
+      setColumnName(col.first, alias, col.second);
+      inner_columns.emplace(col.second);
+    }
+
+    correlated_conjuncts.emplace_back(conj);
+  }
+
+  if (correlated_conjuncts.empty()) {
+    return join;
+  }
+
+  if (inner_conjuncts.empty()) {
+    subquery->removeChild(where_clause);
+  } else {
+    where_clause->clearChildren();
+    where_clause->appendChild(buildConjunction(inner_conjuncts));
+  }
+
+  /* the subquery only needs to return the columns used in the join condition */
+  if (!inner_columns.empty()) {
+    auto select_list = subquery->getChildren()[0];
+    select_list->clearChildren();
+    for (const auto& col : inner_columns) {
+      auto derived = select_list->appendChild(ASTNode::T_DERIVED_COLUMN);
+      auto column = derived->appendChild(ASTNode::T_COLUMN_NAME);
+      column->setToken(new Token(Token::T_IDENTIFIER, col));
+      auto column_alias = derived->appendChild(ASTNode::T_COLUMN_ALIAS);
+      column_alias->setToken(new Token(Token::T_IDENTIFIER, col));
+    }
+  }
+
+  auto cond = join->appendChild(ASTNode::T_JOIN_CONDITION);
+  cond->appendChild(buildConjunction(correlated_conjuncts));
+  return join;
+}
+
 bool QueryPlanBuilder::hasOrderByClause(ASTNode* ast) const {
   if (!(*ast == ASTNode::T_SELECT || *ast == ASTNode::T_SELECT_DEEP) ||
       ast->getChildren().size() < 2) {
@@ -303,7 +678,8 @@ bool QueryPlanBuilder::hasAggregationInSelectList(ASTNode* ast) const {
 }
 
 bool QueryPlanBuilder::hasAggregationExpression(ASTNode* ast) const {
-  if (ast->getType() == ASTNode::T_METHOD_CALL) {
+  if (ast->getType() == ASTNode::T_METHOD_CALL ||
+      ast->getType() == ASTNode::T_METHOD_CALL_DISTINCT) {
     if (!(ast->getToken() != nullptr)) {
       RAISE(kRuntimeError, "corrupt AST");
     }
@@ -492,6 +868,7 @@ bool QueryPlanBuilder::buildGroupBySelectList(
 
     /* push down aggregate function arguments */
     case ASTNode::T_METHOD_CALL:
+    case ASTNode::T_METHOD_CALL_DISTINCT:
       if (node->getToken() == nullptr) {
         RAISE(kRuntimeError, "corrupt AST");
       }
@@ -573,11 +950,17 @@ QueryTreeNode* QueryPlanBuilder::buildLimitClause(
     // clone ast + remove limit clause
     auto new_ast = ast->deepCopy();
     new_ast->removeChildrenByType(ASTNode::T_LIMIT);
+    auto subtree = build(txn, new_ast, tables);
+
+    /* fold the limit into a plain table scan so the scan can stop early. the
+       limit node is kept since a scan may be executed as multiple tasks */
+    auto seqscan = dynamic_cast<SequentialScanNode*>(subtree.get());
+    if (seqscan &&
+        seqscan->aggregationStrategy() == AggregationStrategy::NO_AGGREGATION) {
+      seqscan->setLimit(limit + offset);
+    }
 
-    return new LimitNode(
-        limit,
-        offset,
-        build(txn, new_ast, tables));
+    return new LimitNode(limit, offset, subtree);
   }
 
   return nullptr;
@@ -789,6 +1172,9 @@ QueryTreeNode* QueryPlanBuilder::buildJoin(
     case ASTNode::T_NATURAL_INNER_JOIN:
     case ASTNode::T_NATURAL_LEFT_JOIN:
     case ASTNode::T_NATURAL_RIGHT_JOIN:
+    case ASTNode::T_SEMI_JOIN:
+    case ASTNode::T_ANTI_JOIN:
+    case ASTNode::T_NULL_AWARE_ANTI_JOIN:
       break;
     default:
       return nullptr;
@@ -824,6 +1210,9 @@ QueryTreeNode* QueryPlanBuilder::buildTableReference(
     case ASTNode::T_NATURAL_INNER_JOIN:
     case ASTNode::T_NATURAL_LEFT_JOIN:
     case ASTNode::T_NATURAL_RIGHT_JOIN:
+    case ASTNode::T_SEMI_JOIN:
+    case ASTNode::T_ANTI_JOIN:
+    case ASTNode::T_NULL_AWARE_ANTI_JOIN:
       return buildJoinTableReference(
           txn,
           table_ref,
@@ -867,6 +1256,24 @@ QueryTreeNode* QueryPlanBuilder::buildTableReference(
   }
 }
 
+/**
+ * Resolves a column of the select list or where expression of a join. The
+ * joined table of semi joins is only visible to the join condition
+ */
+static size_t resolveJoinOutputColumn(
+    JoinNode* join_node,
+    const String& column_name,
+    bool allow_add) {
+  auto idx = join_node->getInputColumnIndex(column_name, allow_add);
+  if (idx != size_t(-1) &&
+      join_node->isSemiJoin() &&
+      join_node->inputColumnMap()[idx].table_idx != 0) {
+    return -1;
+  }
+
+  return idx;
+}
+
 QueryTreeNode* QueryPlanBuilder::buildJoinTableReference(
     Transaction* txn,
     ASTNode* table_ref,
@@ -881,6 +1288,7 @@ QueryTreeNode* QueryPlanBuilder::buildJoinTableReference(
   JoinType join_type;
   bool natural_join = false;
   bool reverse = false;
+  bool semi_join = false;
 
   switch (table_ref->getType()) {
     case ASTNode::T_NATURAL_INNER_JOIN:
@@ -902,6 +1310,18 @@ QueryTreeNode* QueryPlanBuilder::buildJoinTableReference(
       reverse = true;
       join_type = JoinType::OUTER;
       break;
+    case ASTNode::T_SEMI_JOIN:
+      semi_join = true;
+      join_type = JoinType::SEMI;
+      break;
+    case ASTNode::T_ANTI_JOIN:
+      semi_join = true;
+      join_type = JoinType::ANTI;
+      break;
+    case ASTNode::T_NULL_AWARE_ANTI_JOIN:
+      semi_join = true;
+      join_type = JoinType::NULL_AWARE_ANTI;
+      break;
     default:
       RAISE(kRuntimeError, "invalid JOIN type");
   }
@@ -940,11 +1360,12 @@ QueryTreeNode* QueryPlanBuilder::buildJoinTableReference(
       tables,
       true));
 
+  /* the WHERE clause doesn't apply to the joined table of semi joins */
   auto joined_table = mkRef(buildTableReference(
       txn,
       table_ref->getChildren()[1],
       child_sl.get(),
-      where_clause,
+      semi_join ? nullptr : where_clause,
       tables,
       true));
 
@@ -1033,9 +1454,11 @@ QueryTreeNode* QueryPlanBuilder::buildJoinTableReference(
       all_columns.emplace_back(col);
     }
 
-    for (const auto& col :
-            joined_table.asInstanceOf<TableExpressionNode>()->allColumns()) {
-      all_columns.emplace_back(col);
+    if (!semi_join) {
+      for (const auto& col :
+              joined_table.asInstanceOf<TableExpressionNode>()->allColumns()) {
+        all_columns.emplace_back(col);
+      }
     }
 
     if (table_ref->getChildren().size() > 2) {
@@ -1109,7 +1532,7 @@ QueryTreeNode* QueryPlanBuilder::buildJoinTableReference(
     QueryTreeUtil::resolveColumns(
         sl->expression(),
         std::bind(
-            &JoinNode::getInputColumnIndex,
+            &resolveJoinOutputColumn,
             join_node.get(),
             std::placeholders::_1,
             false));
@@ -1131,7 +1554,7 @@ QueryTreeNode* QueryPlanBuilder::buildJoinTableReference(
     QueryTreeUtil::resolveColumns(
         we.get(),
         std::bind(
-            &JoinNode::getInputColumnIndex,
+            &resolveJoinOutputColumn,
             join_node.get(),
             std::placeholders::_1,
             true));
@@ -1463,8 +1886,17 @@ RefPtr<ValueExpressionNode> QueryPlanBuilder::buildUnoptimizedValueExpression(
 
     case ASTNode::T_METHOD_CALL:
     case ASTNode::T_METHOD_CALL_WITHIN_RECORD:
+    case ASTNode::T_METHOD_CALL_DISTINCT:
       return buildMethodCall(txn, ast);
 
+    case ASTNode::T_IN_SUBQUERY_EXPR:
+    case ASTNode::T_NOT_IN_SUBQUERY_EXPR:
+    case ASTNode::T_EXISTS_EXPR:
+      RAISE(
+          kRuntimeError,
+          "IN and EXISTS subqueries are only supported as top level AND "
+          "conditions of the WHERE clause");
+
     default:
       ast->debugPrint();
       RAISE(kRuntimeError, "internal error: can't build expression");
@@ -1533,6 +1965,20 @@ ValueExpressionNode* QueryPlanBuilder::buildMethodCall(
 
   auto symbol = ast->getToken()->getString();
 
+  /* count(DISTINCT expr) is executed by the count_distinct aggregate */
+  if (ast->getType() == ASTNode::T_METHOD_CALL_DISTINCT) {
+    auto symbol_downcase = symbol;
+    StringUtil::toLower(&symbol_downcase);
+    if (symbol_downcase != "count" || ast->getChildren().size() != 1) {
+      RAISEF(
+          kRuntimeError,
+          "DISTINCT is only supported in count(DISTINCT expr), got: $0()",
+          symbol);
+    }
+
+    symbol = "count_distinct";
+  }
+
   Vector<RefPtr<ValueExpressionNode>> args;
   for (auto e : ast->getChildren()) {
     args.emplace_back(buildValueExpression(txn, e));
@@ -1669,6 +2115,17 @@ QueryTreeNode* QueryPlanBuilder::buildShowTables(
   return new ShowTablesNode();
 }
 
+QueryTreeNode* QueryPlanBuilder::buildExplainAnalyze(
+    Transaction* txn,
+    ASTNode* ast,
+    RefPtr<TableProvider> tables) {
+  if (!(*ast == ASTNode::T_EXPLAIN_ANALYZE) || ast->getChildren().size() != 1) {
+    return nullptr;
+  }
+
+  return new ExplainAnalyzeNode(build(txn, ast->getChildren()[0], tables));
+}
+
 QueryTreeNode* QueryPlanBuilder::buildDescribeTable(
     Transaction* txn,
     ASTNode* ast) {
@@ -64,6 +64,21 @@ public:
    */
   bool hasJoin(ASTNode* ast) const;
 
+  /**
+   * Returns true if the ast is a SELECT statement that has an IN, NOT IN or
+   * EXISTS subquery in its WHERE clause
+   */
+  bool hasSubqueryPredicate(ASTNode* ast) const;
+
+  /**
+   * Rewrites the IN, NOT IN, EXISTS and NOT EXISTS subquery conjuncts of the
+   * WHERE clause into semi and anti joins of the FROM clause
+   */
+  void rewriteSubqueryPredicates(
+      Transaction* txn,
+      ASTNode* ast,
+      RefPtr<TableProvider> tables);
+
   /**
    * Returns true if the ast is a SELECT statement that has a GROUP BY clause,
    * otherwise false
@@ -173,6 +188,17 @@ public:
       RefPtr<TableProvider> tables,
       bool in_join);
 
+  ASTNode* buildInSubqueryJoin(
+      ASTNode* expr,
+      ASTNode::kASTNodeType join_type,
+      const String& alias);
+
+  ASTNode* buildExistsSubqueryJoin(
+      ASTNode* subquery,
+      ASTNode::kASTNodeType join_type,
+      const String& alias,
+      RefPtr<TableProvider> tables);
+
   QueryTreeNode* buildShowTables(
       Transaction* txn,
       ASTNode* ast);
@@ -181,6 +207,11 @@ public:
       Transaction* txn,
       ASTNode* ast);
 
+  QueryTreeNode* buildExplainAnalyze(
+      Transaction* txn,
+      ASTNode* ast,
+      RefPtr<TableProvider> tables);
+
   ValueExpressionNode* buildOperator(
       Transaction* txn,
       const std::string& name,
@@ -7,6 +7,7 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <thread>
 #include <csql/runtime/runtime.h>
 #include <csql/tasks/groupby.h>
 #include <csql/qtree/QueryTreeUtil.h>
@@ -41,7 +42,10 @@ Runtime::Runtime(
     tpool_(tpool_opts),
     symbol_table_(symbol_table),
     query_builder_(query_builder),
-    query_plan_builder_(query_plan_builder) {}
+    query_plan_builder_(query_plan_builder),
+    memory_soft_limit_(0),
+    memory_hard_limit_(0),
+    admission_controller_(std::thread::hardware_concurrency()) {}
 
 ScopedPtr<QueryPlan> Runtime::buildQueryPlan(
     Transaction* txn,
@@ -188,6 +192,46 @@ void Runtime::setCacheDir(const String& cachedir) {
   cachedir_ = Some(cachedir);
 }
 
+void Runtime::enableResultCache(
+    size_t max_size /* = ResultCache::kDefaultMaxSize */) {
+  if (cachedir_.isEmpty()) {
+    RAISE(kIllegalStateError, "the result cache requires a cache dir");
+  }
+
+  result_cache_ = mkRef(new ResultCache(cachedir_.get(), max_size));
+}
+
+RefPtr<ResultCache> Runtime::resultCache() const {
+  return result_cache_;
+}
+
+void Runtime::setMemoryLimits(size_t soft_limit, size_t hard_limit) {
+  memory_soft_limit_ = soft_limit;
+  memory_hard_limit_ = hard_limit;
+}
+
+size_t Runtime::memorySoftLimit() const {
+  return memory_soft_limit_;
+}
+
+size_t Runtime::memoryHardLimit() const {
+  return memory_hard_limit_;
+}
+
+void Runtime::setAdmissionLimits(
+    size_t max_queries,
+    size_t max_batch_queries) {
+  admission_controller_.setLimits(max_queries, max_batch_queries);
+}
+
+void Runtime::setAdmissionQueueTimeout(uint64_t timeout_micros) {
+  admission_controller_.setQueueTimeout(timeout_micros);
+}
+
+AdmissionController* Runtime::admissionController() {
+  return &admission_controller_;
+}
+
 RefPtr<QueryBuilder> Runtime::queryBuilder() const {
   return query_builder_;
 }
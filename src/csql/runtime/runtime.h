@@ -23,6 +23,8 @@
 #include <csql/runtime/ResultFormat.h>
 #include <csql/runtime/ExecutionStrategy.h>
 #include <csql/runtime/resultlist.h>
+#include <csql/runtime/ResultCache.h>
+#include <csql/runtime/AdmissionController.h>
 
 namespace csql {
 
@@ -82,6 +84,41 @@ public:
   Option<String> cacheDir() const;
   void setCacheDir(const String& cachedir);
 
+  /**
+   * Cache the output of tasks that have a cache key in the cache dir (see
+   * ResultCache). Must be called after setCacheDir
+   */
+  void enableResultCache(size_t max_size = ResultCache::kDefaultMaxSize);
+
+  /**
+   * Returns a null reference if the result cache is not enabled
+   */
+  RefPtr<ResultCache> resultCache() const;
+
+  /**
+   * Set the default memory limits of new transactions in bytes (see
+   * MemoryTracker). A limit of zero means unlimited
+   */
+  void setMemoryLimits(size_t soft_limit, size_t hard_limit);
+
+  size_t memorySoftLimit() const;
+  size_t memoryHardLimit() const;
+
+  /**
+   * Limit the number of concurrently executing queries and the number of
+   * batch queries among them (see AdmissionController). A limit of zero
+   * means unlimited
+   */
+  void setAdmissionLimits(size_t max_queries, size_t max_batch_queries);
+
+  /**
+   * Set how long a query may wait for admission before it fails. Zero means
+   * the query waits until its deadline
+   */
+  void setAdmissionQueueTimeout(uint64_t timeout_micros);
+
+  AdmissionController* admissionController();
+
   RefPtr<QueryBuilder> queryBuilder() const;
   RefPtr<QueryPlanBuilder> queryPlanBuilder() const;
 
@@ -94,6 +131,10 @@ protected:
   RefPtr<QueryBuilder> query_builder_;
   RefPtr<QueryPlanBuilder> query_plan_builder_;
   Option<String> cachedir_;
+  RefPtr<ResultCache> result_cache_;
+  size_t memory_soft_limit_;
+  size_t memory_hard_limit_;
+  AdmissionController admission_controller_;
 };
 
 }
@@ -0,0 +1,240 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <csql/schedulers/exchange.h>
+
+using namespace stx;
+
+namespace csql {
+
+Exchange::Exchange(
+    TaskScheduler* scheduler,
+    ScopedPtr<ResultCursor> input) :
+    Exchange(scheduler, Vector<ScopedPtr<ResultCursor>>{}, 1) {
+  inputs_.emplace_back(std::move(input));
+}
+
+Exchange::Exchange(
+    TaskScheduler* scheduler,
+    Vector<ScopedPtr<ResultCursor>> inputs,
+    size_t max_producers) :
+    scheduler_(scheduler),
+    inputs_(std::move(inputs)),
+    max_producers_(std::max(max_producers, size_t(1))),
+    next_input_(0),
+    num_producers_(0),
+    num_columns_(0),
+    current_pos_(0),
+    started_(false),
+    producer_done_(false),
+    closed_(false) {
+  current_.num_rows = 0;
+}
+
+Exchange::~Exchange() {
+  close();
+
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (!producer_done_) {
+    cv_.wait(lk);
+  }
+}
+
+bool Exchange::next(SValue* row, int row_len) {
+  prefetch(row_len);
+
+  for (;;) {
+    if (current_pos_ < current_.num_rows) {
+      auto src = current_.values.data() + current_pos_++ * num_columns_;
+      std::move(src, src + std::min(num_columns_, size_t(row_len)), row);
+      return true;
+    }
+
+    std::unique_lock<std::mutex> lk(mutex_);
+    while (batches_.empty() && !producer_done_ && !closed_) {
+      cv_.wait(lk);
+    }
+
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+
+    if (batches_.empty() || closed_) {
+      return false;
+    }
+
+    current_ = std::move(batches_.front());
+    current_pos_ = 0;
+    batches_.pop_front();
+    cv_.notify_all();
+  }
+}
+
+bool Exchange::poll() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  return isReady();
+}
+
+void Exchange::wait(Function<void ()> callback) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  if (isReady()) {
+    lk.unlock();
+    callback();
+  } else {
+    waiters_.emplace_back(callback);
+  }
+}
+
+void Exchange::close() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  if (closed_) {
+    return;
+  }
+
+  closed_ = true;
+  batches_.clear();
+  current_pos_ = current_.num_rows;
+  cv_.notify_all();
+
+  /* the producers close the inputs they have started, the rest is closed here */
+  auto first_unstarted = next_input_;
+  next_input_ = inputs_.size();
+  if (!started_) {
+    started_ = true;
+    producer_done_ = true;
+  }
+
+  lk.unlock();
+
+  for (auto i = first_unstarted; i < inputs_.size(); ++i) {
+    inputs_[i]->close();
+  }
+}
+
+void Exchange::prefetch(int row_len) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  if (started_) {
+    return;
+  }
+
+  started_ = true;
+  num_columns_ = row_len;
+  num_producers_ = std::min(max_producers_, inputs_.size());
+  if (num_producers_ == 0) {
+    producer_done_ = true;
+    return;
+  }
+
+  auto num_producers = num_producers_;
+  lk.unlock();
+
+  for (size_t i = 0; i < num_producers; ++i) {
+    scheduler_->run(std::bind(&Exchange::produce, this));
+  }
+}
+
+void Exchange::produce() {
+  for (;;) {
+    std::unique_lock<std::mutex> lk(mutex_);
+    if (next_input_ >= inputs_.size()) {
+      break;
+    }
+
+    auto input = inputs_[next_input_++].get();
+    lk.unlock();
+
+    bool more;
+    try {
+      more = produceInput(input);
+    } catch (...) {
+      std::unique_lock<std::mutex> lk(mutex_);
+      if (!error_) {
+        error_ = std::current_exception();
+      }
+
+      cv_.notify_all();
+      more = false;
+    }
+
+    input->close();
+
+    if (!more) {
+      break;
+    }
+  }
+
+  std::unique_lock<std::mutex> lk(mutex_);
+  if (--num_producers_ > 0) {
+    return;
+  }
+
+  producer_done_ = true;
+  cv_.notify_all();
+  notifyWaiters(&lk);
+}
+
+bool Exchange::produceInput(ResultCursor* input) {
+  for (bool eof = false; !eof; ) {
+    Batch batch;
+    batch.values.resize(kBatchSize * num_columns_);
+    batch.num_rows = 0;
+
+    while (batch.num_rows < kBatchSize) {
+      auto row = batch.values.data() + batch.num_rows * num_columns_;
+      if (!input->next(row, num_columns_)) {
+        eof = true;
+        break;
+      }
+
+      ++batch.num_rows;
+    }
+
+    batch.values.resize(batch.num_rows * num_columns_);
+
+    std::unique_lock<std::mutex> lk(mutex_);
+    while (batches_.size() >= kMaxBatches && !closed_ && !error_) {
+      cv_.wait(lk);
+    }
+
+    /* stop producing once the consumer or another producer has failed */
+    if (closed_ || error_) {
+      return false;
+    }
+
+    if (batch.num_rows > 0) {
+      batches_.emplace_back(std::move(batch));
+      cv_.notify_all();
+      notifyWaiters(&lk);
+    }
+  }
+
+  return true;
+}
+
+bool Exchange::isReady() const {
+  return
+      current_pos_ < current_.num_rows ||
+      !batches_.empty() ||
+      producer_done_ ||
+      closed_ ||
+      error_;
+}
+
+void Exchange::notifyWaiters(std::unique_lock<std::mutex>* lk) {
+  auto waiters = std::move(waiters_);
+  waiters_.clear();
+  lk->unlock();
+
+  for (const auto& fn : waiters) {
+    fn();
+  }
+}
+
+}
@@ -0,0 +1,98 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <stx/stdtypes.h>
+#include <stx/thread/taskscheduler.h>
+#include <csql/result_cursor.h>
+
+using namespace stx;
+
+namespace csql {
+
+/**
+ * Reads all rows of the input cursors in background threads and hands them
+ * to the consumer in batches of kBatchSize rows through a bounded queue of
+ * at most kMaxBatches batches. The producers block while the queue is full.
+ *
+ * Up to max_producers inputs are read concurrently. Each producer reads one
+ * input until it is exhausted and then takes the next input that hasn't been
+ * started yet, so the rows of different inputs are interleaved in the output
+ * while the rows of a single input keep their order.
+ *
+ * The producers are started by the first call to prefetch or next, which also
+ * determines the number of columns of each row. An input cursor is only
+ * accessed from the producer thread that reads it once it has been started.
+ */
+class Exchange : public ResultCursor {
+public:
+
+  static const size_t kBatchSize = 256;
+  static const size_t kMaxBatches = 8;
+
+  Exchange(TaskScheduler* scheduler, ScopedPtr<ResultCursor> input);
+
+  Exchange(
+      TaskScheduler* scheduler,
+      Vector<ScopedPtr<ResultCursor>> inputs,
+      size_t max_producers);
+
+  ~Exchange();
+
+  bool next(SValue* row, int row_len) override;
+  bool poll() override;
+  void wait(Function<void ()> callback) override;
+  void close() override;
+  void prefetch(int row_len) override;
+
+protected:
+
+  struct Batch {
+    Vector<SValue> values;
+    size_t num_rows;
+  };
+
+  void produce();
+
+  /**
+   * Reads all rows of the input into the queue. Returns false if the exchange
+   * was closed in the meantime
+   */
+  bool produceInput(ResultCursor* input);
+
+  /**
+   * Returns true if a call to next would not block. Must be called with the
+   * mutex held
+   */
+  bool isReady() const;
+
+  void notifyWaiters(std::unique_lock<std::mutex>* lk);
+
+  TaskScheduler* scheduler_;
+  Vector<ScopedPtr<ResultCursor>> inputs_;
+  size_t max_producers_;
+  size_t next_input_;
+  size_t num_producers_;
+  size_t num_columns_;
+  Batch current_;
+  size_t current_pos_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Batch> batches_;
+  Vector<Function<void ()>> waiters_;
+  std::exception_ptr error_;
+  bool started_;
+  bool producer_done_;
+  bool closed_;
+};
+
+}
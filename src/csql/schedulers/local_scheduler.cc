@@ -7,54 +7,431 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
+#include <thread>
 #include <csql/schedulers/local_scheduler.h>
+#include <csql/tasks/pipeline.h>
+#include <csql/schedulers/exchange.h>
+#include <csql/Transaction.h>
+#include <csql/runtime/runtime.h>
 
 using namespace stx;
 
 namespace csql {
 
-SchedulerFactory LocalScheduler::getFactory() {
-  return [] (
+SchedulerFactory LocalScheduler::getFactory(size_t max_threads /* = 0 */) {
+  if (max_threads == 0) {
+    max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  return [max_threads] (
       Transaction* txn,
       TaskDAG* tasks,
       SchedulerCallbacks* callbacks) -> ScopedPtr<Scheduler> {
+    /* share the worker threads with the other running queries */
+    auto num_threads = max_threads;
+    if (txn->getMaxThreads() > 0) {
+      num_threads = std::min(num_threads, txn->getMaxThreads());
+    }
+
     return mkScoped<Scheduler>(
-        new LocalScheduler(txn, tasks, callbacks));
+        new LocalScheduler(txn, tasks, callbacks, num_threads));
   };
 }
 
 LocalScheduler::LocalScheduler(
     Transaction* txn,
     TaskDAG* tasks,
-    SchedulerCallbacks* callbacks) :
+    SchedulerCallbacks* callbacks,
+    size_t max_threads) :
     txn_(txn),
     tasks_(tasks),
-    callbacks_(callbacks) {}
+    callbacks_(callbacks),
+    max_threads_(max_threads),
+    num_threads_(1) {}
 
 ScopedPtr<ResultCursor> LocalScheduler::execute(Set<TaskID> tasks) {
-  Vector<ScopedPtr<ResultCursor>> cursors;
+  /* the result rows of multiple tasks are returned in no particular order */
+  auto num_producers = reserveUnionThreads(tasks.size());
 
+  Vector<ScopedPtr<ResultCursor>> cursors;
   for (const auto& task_id : tasks) {
-    cursors.emplace_back(buildInstance(task_id));
+    cursors.emplace_back(buildInstance(task_id, false));
   }
 
-  if (cursors.size() == 1) {
-    return std::move(cursors[0]);
-  } else {
-    return mkScoped(new ResultCursorList(std::move(cursors)));
+  return buildUnion(std::move(cursors), num_producers);
+}
+
+ScopedPtr<ResultCursor> LocalScheduler::buildInstance(
+    const TaskID& task_id,
+    bool sorted) {
+  auto result_cache = txn_->getRuntime()->resultCache();
+  if (result_cache.get() == nullptr) {
+    return buildTask(task_id, sorted);
   }
+
+  auto cache_key = getCacheKey(task_id);
+  if (cache_key.isEmpty()) {
+    return buildTask(task_id, sorted);
+  }
+
+  /* rows that were produced by multiple workers may be interleaved, so
+   * sorted and unsorted results are cached separately */
+  auto factory = tasks_->getTask(task_id)->getFactory();
+  auto num_columns = factory->numOutputColumns();
+  auto key = SHA1::compute(
+      StringUtil::format(
+          "$0~$1~$2",
+          cache_key.get().toString(),
+          sorted ? "sorted" : "unsorted",
+          num_columns));
+
+  auto cached = result_cache->get(key);
+  if (cached.get()) {
+    return cached;
+  }
+
+  return result_cache->store(key, num_columns, buildTask(task_id, sorted));
 }
 
-ScopedPtr<ResultCursor> LocalScheduler::buildInstance(const TaskID& task_id) {
+ScopedPtr<ResultCursor> LocalScheduler::buildTask(
+    const TaskID& task_id,
+    bool sorted) {
+  auto pipeline = buildPipeline(task_id, sorted);
+  if (pipeline.get()) {
+    return pipeline;
+  }
+
   auto task = tasks_->getTask(task_id);
+  auto factory = task->getFactory();
+  auto input_ids = tasks_->getInputTasksFor(task_id);
+  auto input_sorted = factory->requiresSortedInput();
+
+  if (input_ids.size() == 1 &&
+      !input_sorted &&
+      factory->allowsPartialExecution()) {
+    auto partial = buildPartialTasks(task_id);
+    if (partial.get()) {
+      return partial;
+    }
+  }
 
   HashMap<TaskID, ScopedPtr<ResultCursor>> input_cursors;
+  if (input_ids.size() > 1 && factory->allowsParallelUnion()) {
+    auto num_producers = reserveUnionThreads(input_ids.size());
+
+    Vector<ScopedPtr<ResultCursor>> cursors;
+    for (const auto& dep_id : input_ids) {
+      cursors.emplace_back(buildInstance(dep_id, input_sorted));
+    }
+
+    input_cursors.emplace(
+        *input_ids.begin(),
+        buildUnion(std::move(cursors), num_producers));
+  } else {
+    for (const auto& dep_id : input_ids) {
+      auto cursor = buildInstance(dep_id, input_sorted);
+      if (input_ids.size() > 1) {
+        cursor = buildExchange(std::move(cursor));
+      }
+
+      input_cursors.emplace(dep_id, std::move(cursor));
+    }
+  }
+
+  auto instance = factory->build(txn_, std::move(input_cursors));
+  return mkScoped(
+      new TaskResultCursor(
+          instance,
+          txn_->getExecutionStats()->getTaskStats(task_id)));
+}
+
+Option<SHA1Hash> LocalScheduler::getCacheKey(const TaskID& task_id) {
+  auto iter = cache_keys_.find(task_id);
+  if (iter != cache_keys_.end()) {
+    return iter->second;
+  }
+
+  auto cache_key = None<SHA1Hash>();
+  Vector<SHA1Hash> input_keys;
+  bool inputs_cacheable = true;
   for (const auto& dep_id : tasks_->getInputTasksFor(task_id)) {
-    input_cursors.emplace(dep_id, buildInstance(dep_id));
+    auto input_key = getCacheKey(dep_id);
+    if (input_key.isEmpty()) {
+      inputs_cacheable = false;
+      break;
+    }
+
+    input_keys.emplace_back(input_key.get());
+  }
+
+  if (inputs_cacheable) {
+    cache_key = tasks_->getTask(task_id)->getFactory()->cacheKey(input_keys);
+  }
+
+  cache_keys_.emplace(task_id, cache_key);
+  return cache_key;
+}
+
+ScopedPtr<ResultCursor> LocalScheduler::buildPartialTasks(
+    const TaskID& task_id) {
+  auto factory = tasks_->getTask(task_id)->getFactory();
+  auto input_id = *tasks_->getInputTasksFor(task_id).begin();
+
+  auto workers = buildPartitions(input_id);
+  if (workers.empty()) {
+    return ScopedPtr<ResultCursor>(nullptr);
+  }
+
+  /* each worker runs its own partial task in its own thread */
+  auto num_workers = workers.size();
+  auto partial_stats = txn_->getExecutionStats()->getPartialTaskStats(task_id);
+  Vector<ScopedPtr<ResultCursor>> partials;
+  for (auto& worker : workers) {
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input;
+    input.emplace(input_id, std::move(worker));
+    partials.emplace_back(
+        new TaskResultCursor(
+            factory->buildPartial(txn_, std::move(input)),
+            partial_stats));
+  }
+
+  HashMap<TaskID, ScopedPtr<ResultCursor>> input;
+  input.emplace(input_id, buildUnion(std::move(partials), num_workers));
+
+  auto instance = factory->buildMerge(txn_, std::move(input));
+  return mkScoped(
+      new TaskResultCursor(
+          instance,
+          txn_->getExecutionStats()->getTaskStats(task_id)));
+}
+
+TaskID LocalScheduler::buildStages(
+    const TaskID& task_id,
+    Vector<ScopedPtr<PipelineStage>>* stages,
+    Vector<TaskID>* stage_ids,
+    bool* sorted) {
+  /* walk down the chain of single input tasks, starting at the last stage */
+  auto source_id = task_id;
+  for (;;) {
+    auto input_ids = tasks_->getInputTasksFor(source_id);
+    if (input_ids.size() != 1) {
+      break;
+    }
+
+    auto factory = tasks_->getTask(source_id)->getFactory();
+    auto stage = factory->buildStage(txn_);
+    if (!stage) {
+      break;
+    }
+
+    if (factory->requiresSortedInput()) {
+      *sorted = true;
+    }
+
+    stages->emplace_back(stage);
+    stage_ids->emplace_back(source_id);
+    source_id = *input_ids.begin();
+  }
+
+  return source_id;
+}
+
+Vector<ScopedPtr<ResultCursor>> LocalScheduler::buildPartitions(
+    const TaskID& task_id) {
+  Vector<ScopedPtr<PipelineStage>> stages;
+  Vector<TaskID> stage_ids;
+  bool sorted = false;
+  auto source_id = buildStages(task_id, &stages, &stage_ids, &sorted);
+
+  if (sorted || max_threads_ - num_threads_ < 2) {
+    return Vector<ScopedPtr<ResultCursor>>{};
+  }
+
+  for (const auto& stage : stages) {
+    if (!stage->isPartitionable()) {
+      return Vector<ScopedPtr<ResultCursor>>{};
+    }
+  }
+
+  auto source_task = tasks_->getTask(source_id);
+  auto morsels = source_task->getFactory()->buildMorselSource(txn_);
+  if (morsels.get() == nullptr) {
+    return Vector<ScopedPtr<ResultCursor>>{};
+  }
+
+  return buildMorselWorkers(
+      morsels,
+      source_id,
+      std::move(stages),
+      stage_ids);
+}
+
+ScopedPtr<ResultCursor> LocalScheduler::buildPipeline(
+    const TaskID& task_id,
+    bool sorted) {
+  Vector<ScopedPtr<PipelineStage>> stages;
+  Vector<TaskID> stage_ids;
+  auto source_id = buildStages(task_id, &stages, &stage_ids, &sorted);
+
+  /* split the source into morsels if the order of its rows doesn't matter */
+  RefPtr<MorselSource> morsels;
+  if (!sorted && max_threads_ - num_threads_ > 1) {
+    auto source_task = tasks_->getTask(source_id);
+    morsels = source_task->getFactory()->buildMorselSource(txn_);
+  }
+
+  ScopedPtr<ResultCursor> input(nullptr);
+  if (morsels.get() == nullptr) {
+    if (stages.empty()) {
+      return ScopedPtr<ResultCursor>(nullptr);
+    }
+
+    input = buildInstance(source_id, sorted);
+  } else {
+    /* the stages below the last non-partitionable stage run in each worker */
+    auto num_worker_stages = stages.size();
+    for (size_t i = 0; i < stages.size(); ++i) {
+      if (!stages[i]->isPartitionable()) {
+        num_worker_stages = stages.size() - i - 1;
+      }
+    }
+
+    Vector<ScopedPtr<PipelineStage>> worker_stages;
+    Vector<TaskID> worker_stage_ids;
+    for (size_t i = stages.size() - num_worker_stages; i < stages.size(); ++i) {
+      worker_stages.emplace_back(std::move(stages[i]));
+      worker_stage_ids.emplace_back(stage_ids[i]);
+    }
+
+    stages.resize(stages.size() - num_worker_stages);
+    stage_ids.resize(stages.size());
+
+    auto workers = buildMorselWorkers(
+        morsels,
+        source_id,
+        std::move(worker_stages),
+        worker_stage_ids);
+
+    auto num_workers = workers.size();
+    input = buildUnion(std::move(workers), num_workers);
+
+    if (stages.empty()) {
+      return input;
+    }
+  }
+
+  std::reverse(stages.begin(), stages.end());
+  std::reverse(stage_ids.begin(), stage_ids.end());
+
+  auto pipeline = new Pipeline(std::move(stages), std::move(input));
+  pipeline->setStageStats(getStageStats(stage_ids));
+
+  auto instance = mkRef<Task>(pipeline);
+  return mkScoped(
+      new TaskResultCursor(
+          instance,
+          txn_->getExecutionStats()->getTaskStats(task_id)));
+}
+
+Vector<ScopedPtr<ResultCursor>> LocalScheduler::buildMorselWorkers(
+    RefPtr<MorselSource> source,
+    const TaskID& source_id,
+    Vector<ScopedPtr<PipelineStage>> stages,
+    const Vector<TaskID>& stage_ids) {
+  auto num_workers = max_threads_ - num_threads_;
+
+  /* the stages of each worker in order from the source to the last stage */
+  Vector<TaskID> worker_stage_ids;
+  worker_stage_ids.emplace_back(source_id);
+  worker_stage_ids.insert(
+      worker_stage_ids.end(),
+      stage_ids.rbegin(),
+      stage_ids.rend());
+
+  source->setStats(txn_->getExecutionStats()->getTaskStats(source_id));
+
+  /* all stages are built before any cursor is read */
+  Vector<ScopedPtr<ResultCursor>> workers;
+  for (size_t i = 0; i < num_workers; ++i) {
+    Vector<ScopedPtr<PipelineStage>> worker_stages;
+    if (i == 0) {
+      worker_stages = std::move(stages);
+    } else {
+      for (const auto& stage_id : stage_ids) {
+        auto task = tasks_->getTask(stage_id);
+        worker_stages.emplace_back(task->getFactory()->buildStage(txn_));
+      }
+    }
+
+    worker_stages.emplace_back(source->buildStage(txn_));
+    std::reverse(worker_stages.begin(), worker_stages.end());
+
+    auto pipeline = new Pipeline(
+        std::move(worker_stages),
+        source->openCursor());
+
+    pipeline->setStageStats(getStageStats(worker_stage_ids));
+
+    auto instance = mkRef<Task>(pipeline);
+    workers.emplace_back(
+        new TaskResultCursor(
+            instance,
+            txn_->getExecutionStats()->getTaskStats(
+                worker_stage_ids.back())));
+  }
+
+  num_threads_ += num_workers;
+  return workers;
+}
+
+Vector<TaskStats*> LocalScheduler::getStageStats(
+    const Vector<TaskID>& stage_ids) {
+  Vector<TaskStats*> stats;
+  for (const auto& stage_id : stage_ids) {
+    stats.emplace_back(txn_->getExecutionStats()->getTaskStats(stage_id));
+  }
+
+  return stats;
+}
+
+size_t LocalScheduler::reserveUnionThreads(size_t num_inputs) {
+  if (num_inputs < 2) {
+    return 0;
+  }
+
+  auto num_producers = std::min(max_threads_ - num_threads_, num_inputs);
+  num_threads_ += num_producers;
+  return num_producers;
+}
+
+ScopedPtr<ResultCursor> LocalScheduler::buildUnion(
+    Vector<ScopedPtr<ResultCursor>> cursors,
+    size_t num_producers) {
+  if (cursors.size() == 1) {
+    return std::move(cursors[0]);
+  }
+
+  if (num_producers == 0) {
+    return mkScoped(new ResultCursorList(std::move(cursors)));
+  }
+
+  return mkScoped<ResultCursor>(
+      new Exchange(
+          txn_->getRuntime()->scheduler(),
+          std::move(cursors),
+          num_producers));
+}
+
+ScopedPtr<ResultCursor> LocalScheduler::buildExchange(
+    ScopedPtr<ResultCursor> cursor) {
+  if (num_threads_ >= max_threads_) {
+    return cursor;
   }
 
-  auto instance = task->getFactory()->build(txn_, std::move(input_cursors));
-  return mkScoped(new TaskResultCursor(instance));
+  ++num_threads_;
+  return mkScoped<ResultCursor>(
+      new Exchange(txn_->getRuntime()->scheduler(), std::move(cursor)));
 }
 
 } // namespace csql
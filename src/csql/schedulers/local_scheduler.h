@@ -9,33 +9,150 @@
  */
 #pragma once
 #include <csql/runtime/Scheduler.h>
+#include <csql/tasks/morsel.h>
 
 using namespace stx;
 
 namespace csql {
 class Transaction;
 
+/**
+ * Executes the task DAG in the local process. If a task has more than one
+ * input, each input is executed concurrently on the runtime's thread pool and
+ * connected to the task through an Exchange. If the task reads its inputs as
+ * one stream (see TaskFactory::allowsParallelUnion), all inputs are executed
+ * as a parallel union by up to max_threads - 1 producers instead. At most
+ * max_threads - 1 background threads are used, the rest of the tasks are
+ * executed in the thread that reads the result cursor. With max_threads = 1
+ * all tasks are executed in the calling thread.
+ *
+ * Table scans whose rows may be returned in any order are split into morsels
+ * (see MorselSource) that are processed by all remaining threads. A task that
+ * can be executed in two phases (see TaskFactory::allowsPartialExecution) runs
+ * one partial task per worker on top of the morsels, e.g. a GROUP BY whose
+ * workers aggregate locally and only merge their groups at the end.
+ *
+ * If the runtime has a result cache, the output of each task with a cache key
+ * is read from the cache or stored in it (see ResultCache)
+ */
 class LocalScheduler : public Scheduler {
 public:
 
-  static SchedulerFactory getFactory();
+  /**
+   * The default number of threads is the number of hardware threads
+   */
+  static SchedulerFactory getFactory(size_t max_threads = 0);
 
   LocalScheduler(
       Transaction* txn,
       TaskDAG* tasks,
-      SchedulerCallbacks* callbacks);
+      SchedulerCallbacks* callbacks,
+      size_t max_threads);
 
   //void execute() override;
   ScopedPtr<ResultCursor> execute(Set<TaskID> tasks) override;
 
 protected:
 
-  ScopedPtr<ResultCursor> buildInstance(const TaskID& task_id);
+  /**
+   * Builds the cursor for task_id. If sorted is true, the rows must be
+   * returned in the order the task produces them, so the task's input won't
+   * be split into morsels. Reads the rows from the result cache if possible
+   */
+  ScopedPtr<ResultCursor> buildInstance(const TaskID& task_id, bool sorted);
+
+  /**
+   * Builds the cursor for task_id without using the result cache
+   */
+  ScopedPtr<ResultCursor> buildTask(const TaskID& task_id, bool sorted);
+
+  /**
+   * Returns the cache key of the task's output, computed from the cache keys
+   * of its inputs (see TaskFactory::cacheKey)
+   */
+  Option<SHA1Hash> getCacheKey(const TaskID& task_id);
+
+  /**
+   * Splits the input of task_id into morsels and runs one partial task per
+   * worker and a merge task on top of them (see
+   * TaskFactory::allowsPartialExecution). Returns nullptr if the input can't
+   * be split
+   */
+  ScopedPtr<ResultCursor> buildPartialTasks(const TaskID& task_id);
+
+  /**
+   * Builds the stages of the longest chain of tasks ending at task_id that can
+   * be executed as pipeline stages, in order from the last to the first stage.
+   * Returns the id of the task at the start of the chain. Sets sorted to true
+   * if one of the stages relies on the order of its input rows
+   */
+  TaskID buildStages(
+      const TaskID& task_id,
+      Vector<ScopedPtr<PipelineStage>>* stages,
+      Vector<TaskID>* stage_ids,
+      bool* sorted);
+
+  /**
+   * Returns one cursor per worker that reads morsels from the start of the
+   * chain of stages ending at task_id and executes all stages of the chain.
+   * Returns an empty list if the chain can't be split, e.g. because it
+   * contains a stage that must see all rows
+   */
+  Vector<ScopedPtr<ResultCursor>> buildPartitions(const TaskID& task_id);
+
+  /**
+   * Fuses the longest chain of tasks ending at task_id that can be executed as
+   * pipeline stages (see PipelineStage) into a single Pipeline task. If the
+   * task at the start of the chain can be split into morsels, the partitionable
+   * stages are executed by multiple workers. Returns nullptr if task_id can't
+   * be executed as a pipeline stage or morsel source
+   */
+  ScopedPtr<ResultCursor> buildPipeline(const TaskID& task_id, bool sorted);
+
+  /**
+   * Builds one worker per remaining thread that reads morsels from the source
+   * and pushes them through its own copy of the stages. The stages are given
+   * in order from the last to the first stage. Returns one cursor per worker
+   */
+  Vector<ScopedPtr<ResultCursor>> buildMorselWorkers(
+      RefPtr<MorselSource> source,
+      const TaskID& source_id,
+      Vector<ScopedPtr<PipelineStage>> stages,
+      const Vector<TaskID>& stage_ids);
+
+  /**
+   * Returns the stats of each of the stage tasks for Pipeline::setStageStats
+   */
+  Vector<TaskStats*> getStageStats(const Vector<TaskID>& stage_ids);
+
+  /**
+   * Reserves the threads for a parallel union of num_inputs inputs before the
+   * inputs are built, so that the union takes precedence over the parallelism
+   * within each input. Returns the number of reserved threads
+   */
+  size_t reserveUnionThreads(size_t num_inputs);
+
+  /**
+   * Returns a cursor over the rows of all cursors. With num_producers > 0 the
+   * cursors are executed as a parallel union (see Exchange) that interleaves
+   * their rows, otherwise they are read one after another
+   */
+  ScopedPtr<ResultCursor> buildUnion(
+      Vector<ScopedPtr<ResultCursor>> cursors,
+      size_t num_producers);
+
+  /**
+   * Executes the cursor in a background thread if there is a thread left
+   */
+  ScopedPtr<ResultCursor> buildExchange(ScopedPtr<ResultCursor> cursor);
 
   Transaction* txn_;
   TaskDAG* tasks_;
   SchedulerCallbacks* callbacks_;
+  size_t max_threads_;
+  size_t num_threads_;
   HashMap<TaskID, RefPtr<Task>> instances_;
+  HashMap<TaskID, Option<SHA1Hash>> cache_keys_;
 };
 
 } // namespace csql
@@ -673,6 +673,14 @@ bool SValue::isConvertibleToBool() const {
   }
 }
 
+size_t SValue::getMemoryUsage() const {
+  if (data_.type == SQL_STRING) {
+    return sizeof(SValue) + data_.u.t_string.len;
+  } else {
+    return sizeof(SValue);
+  }
+}
+
 void SValue::encode(OutputStream* os) const {
   os->appendUInt8(data_.type);
 
@@ -94,6 +94,11 @@ public:
   void encode(OutputStream* os) const;
   void decode(InputStream* is);
 
+  /**
+   * Returns the approximate number of bytes of memory used by this value
+   */
+  size_t getMemoryUsage() const;
+
   String toSQL() const;
 
   static std::string makeUniqueKey(SValue* arr, size_t len);
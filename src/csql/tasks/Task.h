@@ -15,6 +15,7 @@
 #include <csql/runtime/ExecutionContext.h>
 #include <csql/runtime/Statement.h>
 #include <csql/runtime/rowsink.h>
+#include <csql/runtime/TaskStats.h>
 #include <csql/tasks/TaskID.h>
 
 using namespace stx;
@@ -33,6 +34,20 @@ public:
   virtual void run() {}
   virtual bool nextRow(SValue* out, int out_len) = 0;
 
+  /**
+   * Called if the consumer doesn't need any more rows before nextRow has
+   * returned false. The task should stop reading, close all of its inputs and
+   * release any I/O resources. nextRow is not called again after close
+   */
+  virtual void close() {}
+
+  /**
+   * Adds the counters that only the task itself knows about (e.g. rows and
+   * bytes read from tables or spill files, peak memory and spilled bytes) to
+   * stats. Called once after the task is finished or closed
+   */
+  virtual void collectStats(TaskStats* stats) const {}
+
   //virtual void onInputsReady() {}
 
   //virtual bool onInputRow(
@@ -30,7 +30,9 @@ const Vector<TaskDAGNode::Dependency>& TaskDAGNode::getDependencies() const {
   return dependencies_;
 }
 
-TaskID TaskDAG::addTask(RefPtr<TaskDAGNode> task) {
+TaskID TaskDAG::addTask(
+    RefPtr<TaskDAGNode> task,
+    const QueryTreeNode* origin /* = nullptr */) {
   auto task_id = Random::singleton()->sha1();
   const auto& task_dependecies = task->getDependencies();
   auto task_status = task_dependecies.size() > 0 ?
@@ -44,6 +46,10 @@ TaskID TaskDAG::addTask(RefPtr<TaskDAGNode> task) {
     task_deps_reverse_[dep.task_id].emplace(task_id);
   }
 
+  if (origin) {
+    node_tasks_[origin].emplace_back(task_id);
+  }
+
   return task_id;
 }
 
@@ -163,4 +169,13 @@ size_t TaskDAG::getNumTasks() const {
   return tasks_.size();
 }
 
+TaskIDList TaskDAG::getTasksForNode(const QueryTreeNode* node) const {
+  const auto& iter = node_tasks_.find(node);
+  if (iter == node_tasks_.end()) {
+    return TaskIDList();
+  } else {
+    return iter->second;
+  }
+}
+
 } // namespace csql
@@ -15,6 +15,7 @@
 using namespace stx;
 
 namespace csql {
+class QueryTreeNode;
 
 enum TaskStatus {
   WAITING, RUNNABLE, COMPLETED
@@ -42,7 +43,13 @@ protected:
 class TaskDAG {
 public:
 
-  TaskID addTask(RefPtr<TaskDAGNode> task);
+  /**
+   * Adds the task to the DAG. If origin is provided, the task is recorded as
+   * one of the tasks that execute that query tree node (see getTasksForNode)
+   */
+  TaskID addTask(
+      RefPtr<TaskDAGNode> task,
+      const QueryTreeNode* origin = nullptr);
 
   RefPtr<TaskDAGNode> getTask(const TaskID& task_id) const;
 
@@ -59,6 +66,11 @@ public:
 
   size_t getNumTasks() const;
 
+  /**
+   * Returns the tasks that were added with the query tree node as their origin
+   */
+  TaskIDList getTasksForNode(const QueryTreeNode* node) const;
+
 protected:
 
   void findRunnableTasks();
@@ -67,6 +79,7 @@ protected:
   HashMap<TaskID, TaskStatus> task_status_;
   HashMap<TaskID, Set<TaskID>> task_deps_;
   HashMap<TaskID, Set<TaskID>> task_deps_reverse_;
+  HashMap<const QueryTreeNode*, TaskIDList> node_tasks_;
 };
 
 } // namespace csql
@@ -14,7 +14,8 @@ namespace csql {
 
 SimpleTableExpressionFactory::SimpleTableExpressionFactory(
     FactoryFn factory_fn) :
-    factory_fn_(factory_fn) {}
+    factory_fn_(factory_fn),
+    num_columns_(0) {}
 
 RefPtr<Task> SimpleTableExpressionFactory::build(
     Transaction* txn,
@@ -22,4 +23,29 @@ RefPtr<Task> SimpleTableExpressionFactory::build(
   return factory_fn_(txn, std::move(input));
 }
 
+Option<SHA1Hash> SimpleTableExpressionFactory::cacheKey(
+    const Vector<SHA1Hash>& input_keys) const {
+  if (cache_key_.isEmpty() || input_keys.empty()) {
+    return cache_key_;
+  }
+
+  auto key = cache_key_.get().toString();
+  for (const auto& input_key : input_keys) {
+    key += "~" + input_key.toString();
+  }
+
+  return Some(SHA1::compute(key));
+}
+
+size_t SimpleTableExpressionFactory::numOutputColumns() const {
+  return num_columns_;
+}
+
+void SimpleTableExpressionFactory::setCacheKey(
+    const SHA1Hash& key,
+    size_t num_columns) {
+  cache_key_ = Some(key);
+  num_columns_ = num_columns;
+}
+
 } // namespace csql
@@ -11,8 +11,12 @@
 #include <stx/stdtypes.h>
 #include <stx/autoref.h>
 #include <stx/SHA1.h>
+#include <stx/exception.h>
 #include <csql/tasks/Task.h>
+#include <csql/tasks/pipeline.h>
+#include <csql/tasks/morsel.h>
 #include <csql/runtime/RowSink.h>
+#include <csql/runtime/RuntimeFilter.h>
 #include <csql/result_cursor.h>
 
 using namespace stx;
@@ -27,6 +31,93 @@ public:
       Transaction* txn,
       HashMap<TaskID, ScopedPtr<ResultCursor>> input) const = 0;
 
+  /**
+   * Build the task as a pipeline stage (see PipelineStage) that can be fused
+   * with the tasks before and after it. Returns nullptr if the task can't be
+   * executed as a pipeline stage
+   */
+  virtual PipelineStage* buildStage(Transaction* txn) const {
+    return nullptr;
+  }
+
+  /**
+   * Build the task as a morsel source (see MorselSource) so that the rows of
+   * the task can be processed by multiple workers. Returns a null reference
+   * if the task can't be split into morsels
+   */
+  virtual RefPtr<MorselSource> buildMorselSource(Transaction* txn) const {
+    return RefPtr<MorselSource>();
+  }
+
+  /**
+   * Returns true if the task relies on the sort order of its input rows, in
+   * which case its inputs are never split into morsels
+   */
+  virtual bool requiresSortedInput() const {
+    return false;
+  }
+
+  /**
+   * Returns true if the task reads the rows of all its inputs as one stream in
+   * no particular order. The inputs of such a task may be executed as a
+   * parallel union that interleaves the rows of all inputs
+   */
+  virtual bool allowsParallelUnion() const {
+    return false;
+  }
+
+  /**
+   * Returns true if the task can be executed in two phases, e.g. a GROUP BY
+   * that aggregates the rows of each worker locally. If the input of such a
+   * task is split into morsels, each worker runs a partial task (see
+   * buildPartial) on its own rows and a single merge task (see buildMerge)
+   * combines the output rows of all partial tasks
+   */
+  virtual bool allowsPartialExecution() const {
+    return false;
+  }
+
+  virtual RefPtr<Task> buildPartial(
+      Transaction* txn,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input) const {
+    RAISE(kIllegalStateError, "task can't be executed in two phases");
+  }
+
+  virtual RefPtr<Task> buildMerge(
+      Transaction* txn,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input) const {
+    RAISE(kIllegalStateError, "task can't be executed in two phases");
+  }
+
+  /**
+   * Drop the output rows whose key in spec.key_columns is not contained in
+   * the runtime filter spec.filter_id (see RuntimeFilterSpec). Returns false
+   * if the task can't apply runtime filters
+   */
+  virtual bool setRuntimeFilter(const RuntimeFilterSpec& spec) {
+    return false;
+  }
+
+  /**
+   * Returns a key that identifies the output rows of the task so that they
+   * can be cached and reused by later queries (see ResultCache). input_keys
+   * contains the cache keys of all inputs, in the order of their task ids.
+   * Only called if all inputs have a cache key. Returns None if the output
+   * of the task must not be cached
+   */
+  virtual Option<SHA1Hash> cacheKey(const Vector<SHA1Hash>& input_keys) const {
+    return None<SHA1Hash>();
+  }
+
+  /**
+   * Returns the number of columns of the task's output rows. A cached result
+   * stores all columns (see ResultCache::store). Only called if cacheKey
+   * returned a key
+   */
+  virtual size_t numOutputColumns() const {
+    RAISE(kIllegalStateError, "task has no cache key");
+  }
+
 };
 
 using TableExpressionFactoryRef = RefPtr<TaskFactory>;
@@ -44,8 +135,21 @@ public:
       Transaction* txn,
       HashMap<TaskID, ScopedPtr<ResultCursor>> input) const override;
 
+  Option<SHA1Hash> cacheKey(
+      const Vector<SHA1Hash>& input_keys) const override;
+
+  size_t numOutputColumns() const override;
+
+  /**
+   * Set the cache key of the task's output, e.g. a hash of the table version
+   * and the scan parameters, and the number of columns of the output rows
+   */
+  void setCacheKey(const SHA1Hash& key, size_t num_columns);
+
 protected:
   FactoryFn factory_fn_;
+  Option<SHA1Hash> cache_key_;
+  size_t num_columns_;
 };
 
 } // namespace csql
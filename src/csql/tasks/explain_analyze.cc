@@ -0,0 +1,143 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <csql/tasks/explain_analyze.h>
+
+using namespace stx;
+
+namespace csql {
+
+ExplainAnalyze::ExplainAnalyze(
+    Transaction* txn,
+    Vector<ExplainAnalyzeOperator> operators,
+    size_t num_input_columns,
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input) :
+    txn_(txn),
+    operators_(std::move(operators)),
+    num_input_columns_(num_input_columns),
+    input_(new ResultCursorList(std::move(input))),
+    executed_(false),
+    pos_(0),
+    abort_check_(txn) {}
+
+bool ExplainAnalyze::nextRow(SValue* out, int out_len) {
+  if (!executed_) {
+    execute();
+    executed_ = true;
+  }
+
+  if (pos_ >= operators_.size()) {
+    return false;
+  }
+
+  const auto& op = operators_[pos_++];
+  auto stats = txn_->getExecutionStats();
+
+  uint64_t rows_in = 0;
+  uint64_t rows_out = 0;
+  uint64_t batches = 0;
+  uint64_t wall_time = 0;
+  uint64_t cpu_time = 0;
+  uint64_t bytes_read = 0;
+  uint64_t peak_memory = 0;
+  uint64_t spill_bytes = 0;
+
+  /* operators that read a table count their rows, all others their inputs */
+  for (const auto& task_id : op.input_tasks) {
+    auto s = stats->findTaskStats(task_id);
+    if (s) {
+      rows_in += s->num_rows_out;
+    }
+  }
+
+  for (const auto& task_id : op.output_tasks) {
+    auto s = stats->findTaskStats(task_id);
+    if (s) {
+      rows_out += s->num_rows_out;
+    }
+  }
+
+  for (const auto& task_id : op.tasks) {
+    auto s = stats->findTaskStats(task_id);
+    if (s) {
+      if (op.input_tasks.empty()) {
+        rows_in += s->num_rows_in;
+      }
+
+      batches += s->num_batches;
+      wall_time += s->wall_time_micros;
+      cpu_time += s->cpu_time_micros;
+      bytes_read += s->bytes_read;
+      peak_memory += s->peak_memory_bytes;
+      spill_bytes += s->spill_bytes;
+    }
+
+    /* the partial instances of a two phase task run in their own threads */
+    auto p = stats->findPartialTaskStats(task_id);
+    if (p) {
+      batches += p->num_batches;
+      wall_time += p->wall_time_micros;
+      cpu_time += p->cpu_time_micros;
+      bytes_read += p->bytes_read;
+      peak_memory += p->peak_memory_bytes;
+      spill_bytes += p->spill_bytes;
+    }
+  }
+
+  SValue row[] = {
+    SValue(op.label),
+    SValue(SValue::IntegerType(rows_in)),
+    SValue(SValue::IntegerType(rows_out)),
+    SValue(SValue::IntegerType(batches)),
+    SValue(SValue::FloatType(wall_time / 1000.0)),
+    SValue(SValue::FloatType(cpu_time / 1000.0)),
+    SValue(SValue::IntegerType(bytes_read)),
+    SValue(SValue::IntegerType(peak_memory)),
+    SValue(SValue::IntegerType(spill_bytes))
+  };
+
+  auto row_len = sizeof(row) / sizeof(row[0]);
+  for (size_t i = 0; i < row_len && i < size_t(out_len); ++i) {
+    out[i] = row[i];
+  }
+
+  return true;
+}
+
+void ExplainAnalyze::close() {
+  input_->close();
+}
+
+void ExplainAnalyze::execute() {
+  Vector<SValue> row(num_input_columns_);
+  while (input_->next(row.data(), row.size())) {
+    abort_check_.tick();
+  }
+
+  /* the stats of the input tasks are complete once their cursors are closed */
+  input_->close();
+}
+
+ExplainAnalyzeFactory::ExplainAnalyzeFactory(
+    Vector<ExplainAnalyzeOperator> operators,
+    size_t num_input_columns) :
+    operators_(std::move(operators)),
+    num_input_columns_(num_input_columns) {}
+
+RefPtr<Task> ExplainAnalyzeFactory::build(
+    Transaction* txn,
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input) const {
+  return new ExplainAnalyze(
+      txn,
+      operators_,
+      num_input_columns_,
+      std::move(input));
+}
+
+} // namespace csql
@@ -0,0 +1,80 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <csql/tasks/Task.h>
+#include <csql/Transaction.h>
+
+using namespace stx;
+
+namespace csql {
+
+/**
+ * One operator (query tree node) of an EXPLAIN ANALYZE result
+ */
+struct ExplainAnalyzeOperator {
+  String label;
+
+  /* all tasks that execute the operator */
+  TaskIDList tasks;
+
+  /* the tasks whose rows are the output rows of the operator */
+  TaskIDList output_tasks;
+
+  /* the tasks of other operators that the operator reads rows from */
+  TaskIDList input_tasks;
+};
+
+/**
+ * Executes the query, discards its rows and then returns one row with the
+ * execution stats (see TaskStats) of each operator
+ */
+class ExplainAnalyze : public Task {
+public:
+
+  ExplainAnalyze(
+      Transaction* txn,
+      Vector<ExplainAnalyzeOperator> operators,
+      size_t num_input_columns,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input);
+
+  bool nextRow(SValue* out, int out_len) override;
+  void close() override;
+
+protected:
+
+  void execute();
+
+  Transaction* txn_;
+  Vector<ExplainAnalyzeOperator> operators_;
+  size_t num_input_columns_;
+  ScopedPtr<ResultCursorList> input_;
+  bool executed_;
+  size_t pos_;
+  AbortCheck abort_check_;
+};
+
+class ExplainAnalyzeFactory : public TaskFactory {
+public:
+
+  ExplainAnalyzeFactory(
+      Vector<ExplainAnalyzeOperator> operators,
+      size_t num_input_columns);
+
+  RefPtr<Task> build(
+      Transaction* txn,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input) const override;
+
+protected:
+  Vector<ExplainAnalyzeOperator> operators_;
+  size_t num_input_columns_;
+};
+
+} // namespace csql
@@ -9,66 +9,180 @@
  */
 #include <stx/io/BufferedOutputStream.h>
 #include <stx/io/fileutil.h>
+#include <stx/io/inputstream.h>
+#include <stx/io/outputstream.h>
 #include <csql/tasks/groupby.h>
 
 namespace csql {
 
 GroupBy::GroupBy(
     Transaction* txn,
+    Mode mode,
+    size_t num_input_columns,
     Vector<ValueExpression> select_expressions,
     Vector<ValueExpression> group_expressions,
     HashMap<TaskID, ScopedPtr<ResultCursor>> input) :
     txn_(txn),
+    mode_(mode),
+    num_input_columns_(num_input_columns),
     select_exprs_(std::move(select_expressions)),
     group_exprs_(std::move(group_expressions)),
-    input_(new ResultCursorList(std::move(input))) {}
+    input_(new ResultCursorList(std::move(input))),
+    executed_(false),
+    memory_(txn->getMemoryTracker()),
+    abort_check_(txn) {}
+
+GroupBy::~GroupBy() {
+  freeResult();
+}
 
 bool GroupBy::nextRow(SValue* out, int out_len) {
-  return false;
-}
-//bool GroupBy::onInputRow(
-//      const TaskID& input_id,
-//      const SValue* row,
-//      int row_len) {
-//  Vector<SValue> gkey(group_exprs_.size(), SValue{});
-//  for (size_t i = 0; i < group_exprs_.size(); ++i) {
-//    VM::evaluate(txn_, group_exprs_[i].program(), row_len, row, &gkey[i]);
-//  }
-//
-//  auto group_key = SValue::makeUniqueKey(gkey.data(), gkey.size());
-//  auto& group = groups_[group_key];
-//  if (group.size() == 0) {
-//    for (const auto& e : select_exprs_) {
-//      group.emplace_back(VM::allocInstance(txn_, e.program(), &scratch_));
-//    }
-//  }
-//
-//  for (size_t i = 0; i < select_exprs_.size(); ++i) {
-//    VM::accumulate(txn_, select_exprs_[i].program(), &group[i], row_len, row);
-//  }
-//
-//  return true;
-//}
-//
-//void GroupBy::onInputsReady() {
-//  try {
-//    Vector<SValue> out_row(select_exprs_.size(), SValue{});
-//    for (auto& group : groups_) {
-//      for (size_t i = 0; i < select_exprs_.size(); ++i) {
-//        VM::result(txn_, select_exprs_[i].program(), &group.second[i], &out_row[i]);
-//      }
-//
-//      if (!input_(out_row.data(), out_row.size())) {
-//        break;
-//      }
-//    }
-//  } catch (...) {
-//    freeResult();
-//    throw;
-//  }
-//
-//  freeResult();
-//}
+  if (!executed_) {
+    execute();
+    executed_ = true;
+    groups_iter_ = groups_.begin();
+  }
+
+  if (groups_iter_ == groups_.end()) {
+    freeResult();
+    groups_iter_ = groups_.end();
+    return false;
+  }
+
+  auto& group = groups_iter_->second;
+  switch (mode_) {
+
+    case Mode::FULL:
+    case Mode::MERGE:
+      for (size_t i = 0; i < select_exprs_.size() && i < size_t(out_len); ++i) {
+        VM::result(txn_, select_exprs_[i].program(), &group[i], &out[i]);
+      }
+      break;
+
+    case Mode::PARTIAL:
+      if (out_len > 0) {
+        out[0] = SValue(groups_iter_->first);
+      }
+
+      for (size_t i = 0; i < select_exprs_.size(); ++i) {
+        if (i + 1 >= size_t(out_len)) {
+          break;
+        }
+
+        String state;
+        auto os = StringOutputStream::fromString(&state);
+        VM::saveState(txn_, select_exprs_[i].program(), &group[i], os.get());
+        out[i + 1] = SValue(state);
+      }
+      break;
+
+  }
+
+  ++groups_iter_;
+  return true;
+}
+
+void GroupBy::close() {
+  input_->close();
+  executed_ = true;
+  freeResult();
+  groups_iter_ = groups_.end();
+}
+
+void GroupBy::collectStats(TaskStats* stats) const {
+  stats->updatePeakMemory(memory_.peakBytes());
+}
+
+void GroupBy::execute() {
+  /* the rows of partial tasks are the group key and one state per column */
+  auto row_len = mode_ == Mode::MERGE ?
+      select_exprs_.size() + 1 :
+      num_input_columns_;
+
+  Vector<SValue> row(row_len, SValue{});
+  while (input_->next(row.data(), row.size())) {
+    abort_check_.tick();
+
+    if (mode_ == Mode::MERGE) {
+      mergeRow(row);
+    } else {
+      accumulateRow(row);
+    }
+  }
+}
+
+void GroupBy::accumulateRow(const Vector<SValue>& row) {
+  Vector<SValue> gkey(group_exprs_.size(), SValue{});
+  for (size_t i = 0; i < group_exprs_.size(); ++i) {
+    VM::evaluate(
+        txn_,
+        group_exprs_[i].program(),
+        row.size(),
+        row.data(),
+        &gkey[i]);
+  }
+
+  bool created;
+  auto group = findOrCreateGroup(
+      SValue::makeUniqueKey(gkey.data(), gkey.size()),
+      &created);
+
+  for (size_t i = 0; i < select_exprs_.size(); ++i) {
+    VM::accumulate(
+        txn_,
+        select_exprs_[i].program(),
+        &(*group)[i],
+        row.size(),
+        row.data());
+  }
+}
+
+void GroupBy::mergeRow(const Vector<SValue>& row) {
+  bool created;
+  auto group = findOrCreateGroup(row[0].getString(), &created);
+
+  if (merge_tmp_.empty()) {
+    for (const auto& e : select_exprs_) {
+      merge_tmp_.emplace_back(VM::allocInstance(txn_, e.program(), &scratch_));
+    }
+  }
+
+  /* the first state of a group is loaded as-is, all others are merged */
+  for (size_t i = 0; i < select_exprs_.size(); ++i) {
+    auto program = select_exprs_[i].program();
+    auto is = StringInputStream::fromString(row[i + 1].getString());
+    if (created) {
+      VM::loadState(txn_, program, &(*group)[i], is.get());
+    } else {
+      VM::loadState(txn_, program, &merge_tmp_[i], is.get());
+      VM::merge(txn_, program, &(*group)[i], &merge_tmp_[i]);
+      VM::reset(txn_, program, &merge_tmp_[i]);
+    }
+  }
+}
+
+Vector<VM::Instance>* GroupBy::findOrCreateGroup(
+    const String& group_key,
+    bool* created) {
+  auto& group = groups_[group_key];
+  *created = group.empty();
+  if (*created) {
+    /* the dynamic state of some aggregates (e.g. count(DISTINCT)) is
+     * reserved by the aggregate itself */
+    auto group_bytes = group_key.size() + sizeof(group);
+    for (const auto& e : select_exprs_) {
+      auto program = e.program();
+      group.emplace_back(VM::allocInstance(txn_, program, &scratch_));
+      group_bytes += sizeof(VM::Instance) + (program->has_aggregate_ ?
+          program->dynamic_storage_size_ :
+          sizeof(SValue));
+    }
+
+    memory_.grow(group_bytes);
+  }
+
+  return &group;
+}
 
 void GroupBy::freeResult() {
   for (auto& group : groups_) {
@@ -77,32 +191,76 @@ void GroupBy::freeResult() {
     }
   }
 
+  for (size_t i = 0; i < merge_tmp_.size(); ++i) {
+    VM::freeInstance(txn_, select_exprs_[i].program(), &merge_tmp_[i]);
+  }
+
   groups_.clear();
+  merge_tmp_.clear();
+  memory_.resize(0);
 }
 
-//Option<SHA1Hash> GroupBy::cacheKey() const {
-//  auto source_key = source_->cacheKey();
-//  if (source_key.isEmpty()) {
-//    return None<SHA1Hash>();
-//  }
-//
-//  return Some(
-//      SHA1::compute(
-//          StringUtil::format(
-//              "$0~$1",
-//              source_key.get().toString(),
-//              qtree_fingerprint_.toString())));
-//}
-
 GroupByFactory::GroupByFactory(
+    size_t num_input_columns,
     Vector<RefPtr<SelectListNode>> select_exprs,
     Vector<RefPtr<ValueExpressionNode>> group_exprs) :
+    num_input_columns_(num_input_columns),
     select_exprs_(select_exprs),
     group_exprs_(group_exprs) {}
 
+bool GroupByFactory::allowsParallelUnion() const {
+  return true;
+}
+
+bool GroupByFactory::allowsPartialExecution() const {
+  return true;
+}
+
+Option<SHA1Hash> GroupByFactory::cacheKey(
+    const Vector<SHA1Hash>& input_keys) const {
+  String key = "groupby";
+  for (const auto& input_key : input_keys) {
+    key += "~" + input_key.toString();
+  }
+
+  for (const auto& e : select_exprs_) {
+    key += "~" + e->toString();
+  }
+
+  key += "~group";
+  for (const auto& e : group_exprs_) {
+    key += "~" + e->toString();
+  }
+
+  return Some(SHA1::compute(key));
+}
+
+size_t GroupByFactory::numOutputColumns() const {
+  return select_exprs_.size();
+}
+
 RefPtr<Task> GroupByFactory::build(
     Transaction* txn,
     HashMap<TaskID, ScopedPtr<ResultCursor>> input) const {
+  return buildGroupBy(txn, GroupBy::Mode::FULL, std::move(input));
+}
+
+RefPtr<Task> GroupByFactory::buildPartial(
+    Transaction* txn,
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input) const {
+  return buildGroupBy(txn, GroupBy::Mode::PARTIAL, std::move(input));
+}
+
+RefPtr<Task> GroupByFactory::buildMerge(
+    Transaction* txn,
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input) const {
+  return buildGroupBy(txn, GroupBy::Mode::MERGE, std::move(input));
+}
+
+RefPtr<Task> GroupByFactory::buildGroupBy(
+    Transaction* txn,
+    GroupBy::Mode mode,
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input) const {
   Vector<ValueExpression> select_expressions;
   Vector<ValueExpression> group_expressions;
 
@@ -120,6 +278,8 @@ RefPtr<Task> GroupByFactory::build(
 
   return new GroupBy(
       txn,
+      mode,
+      num_input_columns_,
       std::move(select_expressions),
       std::move(group_expressions),
       std::move(input));
@@ -10,45 +10,82 @@
 #pragma once
 #include <stx/stdtypes.h>
 #include <stx/SHA1.h>
+#include <csql/Transaction.h>
 #include <csql/tasks/Task.h>
 #include <csql/runtime/defaultruntime.h>
+#include <csql/runtime/MemoryTracker.h>
 
 namespace csql {
 
+/**
+ * Groups the input rows by the group expressions and evaluates the select
+ * list on each group. The aggregation can be split into two phases: PARTIAL
+ * tasks aggregate a part of the input each and return one row per group with
+ * the group key and the serialized aggregate state of each select expression
+ * (see VM::saveState). A MERGE task reads the rows of all partial tasks and
+ * merges the states of each group (see VM::merge) before it evaluates the
+ * select list
+ */
 class GroupBy : public Task {
 public:
 
+  enum class Mode {
+    FULL,
+    PARTIAL,
+    MERGE
+  };
+
   GroupBy(
       Transaction* txn,
+      Mode mode,
+      size_t num_input_columns,
       Vector<ValueExpression> select_expressions,
       Vector<ValueExpression> group_expressions,
       HashMap<TaskID, ScopedPtr<ResultCursor>> input);
 
-  bool nextRow(SValue* out, int out_len) override;
+  ~GroupBy();
 
-  //bool onInputRow(
-  //    const TaskID& input_id,
-  //    const SValue* row,
-  //    int row_len) override;
+  bool nextRow(SValue* out, int out_len) override;
+  void close() override;
 
-  //void onInputsReady() override;
+  void collectStats(TaskStats* stats) const override;
 
 protected:
 
+  /**
+   * Reads all input rows into groups_
+   */
+  void execute();
+
+  void accumulateRow(const Vector<SValue>& row);
+  void mergeRow(const Vector<SValue>& row);
+
+  Vector<VM::Instance>* findOrCreateGroup(
+      const String& group_key,
+      bool* created);
+
   void freeResult();
 
   Transaction* txn_;
+  Mode mode_;
+  size_t num_input_columns_;
   Vector<ValueExpression> select_exprs_;
   Vector<ValueExpression> group_exprs_;
   ScopedPtr<ResultCursorList> input_;
   HashMap<String, Vector<VM::Instance>> groups_;
+  HashMap<String, Vector<VM::Instance>>::iterator groups_iter_;
+  Vector<VM::Instance> merge_tmp_;
   ScratchMemory scratch_;
+  bool executed_;
+  MemoryReservation memory_;
+  AbortCheck abort_check_;
 };
 
 class GroupByFactory : public TaskFactory {
 public:
 
   GroupByFactory(
+      size_t num_input_columns,
       Vector<RefPtr<SelectListNode>> select_exprs,
       Vector<RefPtr<ValueExpressionNode>> group_exprs);
 
@@ -56,7 +93,30 @@ public:
       Transaction* txn,
       HashMap<TaskID, ScopedPtr<ResultCursor>> input) const override;
 
+  bool allowsParallelUnion() const override;
+  bool allowsPartialExecution() const override;
+
+  RefPtr<Task> buildPartial(
+      Transaction* txn,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input) const override;
+
+  RefPtr<Task> buildMerge(
+      Transaction* txn,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input) const override;
+
+  Option<SHA1Hash> cacheKey(
+      const Vector<SHA1Hash>& input_keys) const override;
+
+  size_t numOutputColumns() const override;
+
 protected:
+
+  RefPtr<Task> buildGroupBy(
+      Transaction* txn,
+      GroupBy::Mode mode,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input) const;
+
+  size_t num_input_columns_;
   Vector<RefPtr<SelectListNode>> select_exprs_;
   Vector<RefPtr<ValueExpressionNode>> group_exprs_;
 };
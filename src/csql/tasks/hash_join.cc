@@ -0,0 +1,875 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <stx/io/fileutil.h>
+#include <csql/tasks/hash_join.h>
+#include <csql/runtime/SortKey.h>
+#include <csql/expressions/boolean.h>
+
+namespace csql {
+
+const size_t HashJoin::kMaxInMemoryBytes = 512 * 1024 * 1024;
+const size_t HashJoin::kNumSpillPartitions = 16;
+const size_t HashJoin::kMaxSpillDepth = 3;
+
+static size_t estimateRowSize(const Vector<SValue>& row) {
+  size_t size = sizeof(row);
+  for (const auto& val : row) {
+    size += val.getMemoryUsage();
+  }
+
+  return size;
+}
+
+HashJoin::HashJoin(
+    Transaction* txn,
+    JoinType join_type,
+    const Set<TaskID>& base_tbl_ids,
+    const Set<TaskID>& joined_tbl_ids,
+    const Vector<JoinNode::InputColumnRef>& input_map,
+    Vector<ValueExpression> select_expressions,
+    Vector<ValueExpression> base_key_exprs,
+    Vector<ValueExpression> joined_key_exprs,
+    Option<ValueExpression> join_cond_expr,
+    Option<ValueExpression> where_expr,
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input) :
+    txn_(txn),
+    join_type_(join_type),
+    input_map_(input_map),
+    select_exprs_(std::move(select_expressions)),
+    join_cond_expr_(std::move(join_cond_expr)),
+    where_expr_(std::move(where_expr)),
+    built_(false),
+    build_side_(1),
+    probe_side_(0),
+    slot_mask_(0),
+    probe_has_key_(false),
+    probe_exact_(true),
+    probe_active_(false),
+    probe_matched_(false),
+    probe_pos_(0),
+    probe_done_(false),
+    unmatched_pos_(0),
+    inbuf_(input_map.size(), SValue{}),
+    spilling_(false),
+    resident_(false),
+    resident_bytes_(0),
+    spill_bytes_written_(0),
+    spill_bytes_read_(0),
+    memory_(txn->getMemoryTracker()),
+    abort_check_(txn) {
+  if (join_type_ == JoinType::CARTESIAN) {
+    RAISE(kIllegalArgumentError, "can't execute CARTESIAN join as hash join");
+  }
+
+  if (base_key_exprs.size() == 0 ||
+      base_key_exprs.size() != joined_key_exprs.size()) {
+    RAISE(kIllegalArgumentError, "can't execute hash join: invalid join keys");
+  }
+
+  key_exprs_[0] = std::move(base_key_exprs);
+  key_exprs_[1] = std::move(joined_key_exprs);
+
+  Vector<ScopedPtr<ResultCursor>> cursors[2];
+  for (auto& in : input) {
+    if (base_tbl_ids.count(in.first) > 0) {
+      cursors[0].emplace_back(std::move(in.second));
+    } else if (joined_tbl_ids.count(in.first) > 0) {
+      cursors[1].emplace_back(std::move(in.second));
+    } else {
+      RAISE(kIllegalStateError, "hash join: unknown input task");
+    }
+  }
+
+  for (size_t side = 0; side < 2; ++side) {
+    input_[side] = mkScoped(new ResultCursorList(std::move(cursors[side])));
+    row_width_[side] = 1;
+  }
+
+  for (const auto& m : input_map_) {
+    if (m.table_idx > 1) {
+      RAISE(kRuntimeError, "invalid table index");
+    }
+
+    row_width_[m.table_idx] = std::max(
+        row_width_[m.table_idx],
+        m.column_idx + 1);
+  }
+}
+
+HashJoin::~HashJoin() {
+  for (size_t side = 0; side < 2; ++side) {
+    for (auto& file : spill_files_[side]) {
+      if (file.get()) {
+        file->close();
+        FileUtil::rm(file->path());
+      }
+    }
+  }
+
+  for (const auto& part : spilled_partitions_) {
+    if (!part.build_file.empty()) {
+      FileUtil::rm(part.build_file);
+    }
+
+    if (!part.probe_file.empty()) {
+      FileUtil::rm(part.probe_file);
+    }
+  }
+
+  if (probe_reader_.get()) {
+    probe_reader_.reset(nullptr);
+    FileUtil::rm(probe_reader_file_);
+  }
+}
+
+void HashJoin::setRuntimeFilter(
+    size_t table_idx,
+    RefPtr<RuntimeFilter> filter) {
+  if (table_idx > 1) {
+    RAISE(kRuntimeError, "invalid table index");
+  }
+
+  runtime_filters_[table_idx] = filter;
+}
+
+bool HashJoin::nextRow(SValue* out, int out_len) {
+  if (!built_) {
+    input_[0]->prefetch(row_width_[0]);
+    input_[1]->prefetch(row_width_[1]);
+    buildHashTable();
+    built_ = true;
+  }
+
+  for (;;) {
+    if (probe_active_) {
+      while (probe_pos_ != 0) {
+        abort_check_.tick();
+        auto idx = probe_pos_ - 1;
+        probe_pos_ = build_next_[idx];
+
+        loadInputRow(build_side_, &build_rows_[idx]);
+        loadInputRow(probe_side_, &probe_row_);
+
+        if ((!probe_exact_ || !build_exact_[idx]) && !keysEqual()) {
+          continue;
+        }
+
+        if (!evaluatePredicate(join_cond_expr_) ||
+            !evaluatePredicate(where_expr_)) {
+          continue;
+        }
+
+        build_matched_[idx] = true;
+        probe_matched_ = true;
+        evaluateSelectList(out, out_len);
+        return true;
+      }
+
+      probe_active_ = false;
+
+      if (join_type_ == JoinType::OUTER &&
+          probe_side_ == 0 &&
+          !probe_matched_) {
+        loadInputRow(0, &probe_row_);
+        loadInputRow(1, nullptr);
+
+        if (evaluatePredicate(where_expr_)) {
+          evaluateSelectList(out, out_len);
+          return true;
+        }
+      }
+    }
+
+    if (nextProbeRow()) {
+      probe_active_ = true;
+      probe_matched_ = false;
+      probe_pos_ = 0;
+
+      if (probe_has_key_) {
+        auto hash = std::hash<String>()(probe_key_);
+        probe_pos_ = slots_[findSlot(hash, probe_key_)].head;
+      }
+
+      continue;
+    }
+
+    if (emitUnmatchedBuildRow(out, out_len)) {
+      return true;
+    }
+
+    if (!loadNextPartition()) {
+      return false;
+    }
+  }
+}
+
+void HashJoin::close() {
+  input_[0]->close();
+  input_[1]->close();
+}
+
+void HashJoin::collectStats(TaskStats* stats) const {
+  stats->updatePeakMemory(memory_.peakBytes());
+  stats->spill_bytes += spill_bytes_written_;
+  stats->bytes_read += spill_bytes_read_;
+}
+
+bool HashJoin::emitUnmatchedBuildRow(SValue* out, int out_len) {
+  if (join_type_ != JoinType::OUTER || build_side_ != 0) {
+    return false;
+  }
+
+  /* emit the base table rows that did not match for OUTER joins */
+  while (unmatched_pos_ < build_rows_.size()) {
+    auto idx = unmatched_pos_++;
+    if (build_matched_[idx]) {
+      continue;
+    }
+
+    loadInputRow(0, &build_rows_[idx]);
+    loadInputRow(1, nullptr);
+
+    if (evaluatePredicate(where_expr_)) {
+      evaluateSelectList(out, out_len);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void HashJoin::buildHashTable() {
+  /* read both inputs in lockstep; the one that ends first is the build side */
+  List<Vector<SValue>> rows[2];
+  size_t bytes[2] = { 0, 0 };
+  bool eof[2] = { false, false };
+  while (!eof[0] && !eof[1]) {
+    /* neither input fits into memory */
+    if (bytes[0] > kMaxInMemoryBytes && bytes[1] > kMaxInMemoryBytes) {
+      break;
+    }
+
+    if (exceedsMemoryLimit(0)) {
+      break;
+    }
+
+    abort_check_.tick();
+
+    for (size_t side = 0; side < 2; ++side) {
+      Vector<SValue> row;
+      if (readRow(side, &row)) {
+        auto row_size = estimateRowSize(row);
+        memory_.grow(row_size);
+        bytes[side] += row_size;
+        rows[side].emplace_back(std::move(row));
+      } else {
+        eof[side] = true;
+      }
+    }
+  }
+
+  if (eof[0] || eof[1]) {
+    build_side_ = eof[1] ? 1 : 0;
+  } else {
+    build_side_ = bytes[1] <= bytes[0] ? 1 : 0;
+  }
+
+  probe_side_ = 1 - build_side_;
+  probe_buf_ = std::move(rows[probe_side_]);
+
+  if (!eof[build_side_] || exceedsMemoryLimit(bytes[build_side_])) {
+    startSpilling(&rows[build_side_]);
+    return;
+  }
+
+  resetHashTable(rows[build_side_].size());
+  for (auto& row : rows[build_side_]) {
+    String key;
+    bool exact = true;
+    if (!computeKey(build_side_, row, &key, &exact)) {
+      key.clear();
+    }
+
+    insertRow(std::move(row), std::move(key), exact);
+  }
+
+  publishRuntimeFilter();
+}
+
+void HashJoin::publishRuntimeFilter() {
+  auto filter = runtime_filters_[probe_side_];
+  if (filter.get() == nullptr || filter->isPublished()) {
+    return;
+  }
+
+  /* unmatched base table rows are part of the result of OUTER joins */
+  if (join_type_ == JoinType::OUTER && probe_side_ == 0) {
+    return;
+  }
+
+  if (build_keys_.size() > RuntimeFilter::kMaxKeys) {
+    return;
+  }
+
+  filter->publish(build_keys_);
+}
+
+void HashJoin::resetHashTable(size_t num_rows) {
+  /* the probe rows that are still buffered are not counted */
+  memory_.resize(0);
+
+  build_rows_.clear();
+  build_keys_.clear();
+  build_exact_.clear();
+  build_next_.clear();
+  build_matched_.clear();
+  unmatched_pos_ = 0;
+
+  size_t nslots = 16;
+  while (nslots < num_rows * 2) {
+    nslots *= 2;
+  }
+
+  slots_.assign(nslots, HashTableSlot { 0, 0, 0 });
+  slot_mask_ = nslots - 1;
+  build_rows_.reserve(num_rows);
+}
+
+bool HashJoin::readRow(size_t side, Vector<SValue>* row) {
+  row->resize(row_width_[side]);
+  return input_[side]->next(row->data(), row->size());
+}
+
+bool HashJoin::nextProbeRow() {
+  for (;;) {
+    abort_check_.tick();
+
+    bool from_input = false;
+
+    if (!probe_buf_.empty()) {
+      probe_row_ = std::move(probe_buf_.front());
+      probe_buf_.pop_front();
+    } else if (probe_reader_.get()) {
+      if (!probe_reader_->readRow(&probe_row_)) {
+        probe_reader_.reset(nullptr);
+        FileUtil::rm(probe_reader_file_);
+        return false;
+      }
+    } else if (!probe_done_ && readRow(probe_side_, &probe_row_)) {
+      from_input = true;
+    } else {
+      if (!probe_done_) {
+        probe_done_ = true;
+        if (spilling_) {
+          finishSpilling(0);
+        }
+      }
+
+      return false;
+    }
+
+    probe_key_.clear();
+    probe_exact_ = true;
+    probe_has_key_ = computeKey(
+        probe_side_,
+        probe_row_,
+        &probe_key_,
+        &probe_exact_);
+
+    /* probe rows for spilled partitions are joined later */
+    if (from_input && spilling_) {
+      auto p = findSpillPartition(probe_key_, probe_has_key_, 0);
+      if (p != 0 || !resident_) {
+        spillRow(probe_side_, p, probe_row_);
+        continue;
+      }
+    }
+
+    return true;
+  }
+}
+
+bool HashJoin::exceedsMemoryLimit(size_t bytes) const {
+  if (bytes > kMaxInMemoryBytes) {
+    return true;
+  }
+
+  return
+      memory_.exceedsSoftLimit() &&
+      !txn_->getRuntime()->cacheDir().isEmpty();
+}
+
+void HashJoin::startSpilling(List<Vector<SValue>>* build_rows) {
+  if (txn_->getRuntime()->cacheDir().isEmpty()) {
+    RAISE(
+        kRuntimeError,
+        "hash JOIN build side exceeds the memory limit and no cache dir is"
+        " configured for spilling");
+  }
+
+  spilling_ = true;
+  resident_ = true;
+  resident_bytes_ = 0;
+
+  /* the buffered rows are counted again as they are partitioned */
+  memory_.resize(0);
+  for (size_t side = 0; side < 2; ++side) {
+    spill_files_[side].resize(kNumSpillPartitions);
+  }
+
+  String key;
+  auto spill_build_row = [this, &key] (Vector<SValue>* row) {
+    key.clear();
+    auto has_key = computeKey(build_side_, *row, &key);
+    auto p = findSpillPartition(key, has_key, 0);
+    if (p != 0 || !resident_) {
+      spillRow(build_side_, p, *row);
+      return;
+    }
+
+    auto row_size = estimateRowSize(*row);
+    memory_.grow(row_size);
+    resident_bytes_ += row_size;
+    resident_rows_.emplace_back(std::move(*row));
+
+    /* the resident partition doesn't fit into memory either */
+    if (exceedsMemoryLimit(resident_bytes_)) {
+      for (const auto& r : resident_rows_) {
+        spillRow(build_side_, 0, r);
+      }
+
+      resident_rows_.clear();
+      resident_ = false;
+      memory_.resize(0);
+    }
+  };
+
+  for (auto& row : *build_rows) {
+    spill_build_row(&row);
+  }
+
+  build_rows->clear();
+
+  Vector<SValue> row;
+  while (readRow(build_side_, &row)) {
+    abort_check_.tick();
+    spill_build_row(&row);
+  }
+
+  resetHashTable(resident_rows_.size());
+  for (auto& r : resident_rows_) {
+    key.clear();
+    bool exact = true;
+    if (!computeKey(build_side_, r, &key, &exact)) {
+      key.clear();
+    }
+
+    insertRow(std::move(r), key, exact);
+  }
+
+  resident_rows_.clear();
+
+  /* partition the already buffered probe rows */
+  List<Vector<SValue>> resident_probe_rows;
+  for (auto& r : probe_buf_) {
+    key.clear();
+    auto has_key = computeKey(probe_side_, r, &key);
+    auto p = findSpillPartition(key, has_key, 0);
+    if (p == 0 && resident_) {
+      resident_probe_rows.emplace_back(std::move(r));
+    } else {
+      spillRow(probe_side_, p, r);
+    }
+  }
+
+  probe_buf_ = std::move(resident_probe_rows);
+}
+
+size_t HashJoin::findSpillPartition(
+    const String& key,
+    bool has_key,
+    size_t depth) {
+  /* rows with a NULL key never match, so any partition will do */
+  if (!has_key) {
+    return 0;
+  }
+
+  /* use a different hash function on each level so partitions split up */
+  uint64_t hash = std::hash<String>()(key);
+  hash ^= (depth + 1) * 0x9e3779b97f4a7c15ULL;
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+
+  return hash % kNumSpillPartitions;
+}
+
+void HashJoin::spillRow(
+    size_t side,
+    size_t partition,
+    const Vector<SValue>& row) {
+  auto& file = spill_files_[side][partition];
+  if (file.get() == nullptr) {
+    file = mkScoped(
+        new SpillFileWriter(
+            makeSpillFilePath(
+                txn_->getRuntime()->cacheDir().get(),
+                "hashjoin")));
+  }
+
+  file->appendRow(row.data(), row.size());
+}
+
+void HashJoin::finishSpilling(size_t depth) {
+  auto probe_preserved =
+      join_type_ == JoinType::OUTER && probe_side_ == 0;
+  auto build_preserved =
+      join_type_ == JoinType::OUTER && build_side_ == 0;
+
+  for (size_t p = 0; p < kNumSpillPartitions; ++p) {
+    auto& build_file = spill_files_[build_side_][p];
+    auto& probe_file = spill_files_[probe_side_][p];
+
+    SpillPartition part;
+    part.build_rows = 0;
+    part.build_bytes = 0;
+    part.probe_rows = 0;
+    part.probe_bytes = 0;
+    part.depth = depth;
+
+    if (build_file.get()) {
+      build_file->close();
+      part.build_file = build_file->path();
+      part.build_rows = build_file->numRows();
+      part.build_bytes = build_file->numBytes();
+      build_file.reset(nullptr);
+    }
+
+    if (probe_file.get()) {
+      probe_file->close();
+      part.probe_file = probe_file->path();
+      part.probe_rows = probe_file->numRows();
+      part.probe_bytes = probe_file->numBytes();
+      probe_file.reset(nullptr);
+    }
+
+    spill_bytes_written_ += part.build_bytes + part.probe_bytes;
+
+    /* skip partitions that can't produce any output */
+    auto skip =
+        (part.build_rows == 0 && !probe_preserved) ||
+        (part.probe_rows == 0 && !build_preserved);
+
+    if (skip) {
+      if (!part.build_file.empty()) {
+        FileUtil::rm(part.build_file);
+      }
+
+      if (!part.probe_file.empty()) {
+        FileUtil::rm(part.probe_file);
+      }
+
+      continue;
+    }
+
+    spilled_partitions_.emplace_back(part);
+  }
+}
+
+bool HashJoin::loadNextPartition() {
+  while (!spilled_partitions_.empty()) {
+    auto part = spilled_partitions_.front();
+    spilled_partitions_.pop_front();
+
+    /* both files are read back, either to repartition or to join them */
+    spill_bytes_read_ += part.build_bytes + part.probe_bytes;
+
+    /* the hash table of the previous partition is replaced */
+    memory_.resize(0);
+
+    auto too_large =
+        part.build_bytes > kMaxInMemoryBytes ||
+        memory_.exceedsSoftLimit(part.build_bytes);
+
+    if (too_large && part.depth < kMaxSpillDepth) {
+      repartition(part);
+      continue;
+    }
+
+    resetHashTable(part.build_rows);
+
+    if (!part.build_file.empty()) {
+      SpillFileReader reader(part.build_file, part.build_rows);
+      Vector<SValue> row;
+      while (reader.readRow(&row)) {
+        abort_check_.tick();
+        String key;
+        bool exact = true;
+        if (!computeKey(build_side_, row, &key, &exact)) {
+          key.clear();
+        }
+
+        insertRow(std::move(row), std::move(key), exact);
+        row = Vector<SValue>();
+      }
+
+      FileUtil::rm(part.build_file);
+    }
+
+    if (!part.probe_file.empty()) {
+      probe_reader_ = mkScoped(
+          new SpillFileReader(part.probe_file, part.probe_rows));
+      probe_reader_file_ = part.probe_file;
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+void HashJoin::repartition(const SpillPartition& part) {
+  size_t sides[2] = { build_side_, probe_side_ };
+  const String* files[2] = { &part.build_file, &part.probe_file };
+  size_t nrows[2] = { part.build_rows, part.probe_rows };
+
+  for (size_t i = 0; i < 2; ++i) {
+    if (files[i]->empty()) {
+      continue;
+    }
+
+    SpillFileReader reader(*files[i], nrows[i]);
+    Vector<SValue> row;
+    String key;
+    while (reader.readRow(&row)) {
+      abort_check_.tick();
+      key.clear();
+      auto has_key = computeKey(sides[i], row, &key);
+      spillRow(
+          sides[i],
+          findSpillPartition(key, has_key, part.depth + 1),
+          row);
+    }
+
+    FileUtil::rm(*files[i]);
+  }
+
+  finishSpilling(part.depth + 1);
+}
+
+bool HashJoin::computeKey(
+    size_t side,
+    const Vector<SValue>& row,
+    String* key,
+    bool* exact) {
+  loadInputRow(side, &row);
+
+  bool key_exact = true;
+  for (const auto& expr : key_exprs_[side]) {
+    SValue val;
+    VM::evaluate(txn_, expr.program(), inbuf_.size(), inbuf_.data(), &val);
+    if (!SortKey::encodeEquiJoinKey(val, key, &key_exact)) {
+      return false;
+    }
+  }
+
+  if (exact) {
+    *exact = key_exact;
+  }
+
+  return true;
+}
+
+bool HashJoin::keysEqual() {
+  for (size_t i = 0; i < key_exprs_[0].size(); ++i) {
+    SValue args[2];
+    for (size_t side = 0; side < 2; ++side) {
+      VM::evaluate(
+          txn_,
+          key_exprs_[side][i].program(),
+          inbuf_.size(),
+          inbuf_.data(),
+          &args[side]);
+    }
+
+    SValue eq;
+    expressions::eqExpr(Transaction::get(txn_), 2, args, &eq);
+    if (!eq.getBool()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void HashJoin::insertRow(Vector<SValue> row, String key, bool exact) {
+  auto idx = build_rows_.size();
+  auto indexed = !key.empty();
+  memory_.grow(estimateRowSize(row));
+
+  build_rows_.emplace_back(std::move(row));
+  build_keys_.emplace_back(std::move(key));
+  build_exact_.emplace_back(exact);
+  build_next_.emplace_back(0);
+  build_matched_.emplace_back(false);
+
+  /* rows with a NULL key are kept for OUTER joins but never match */
+  if (!indexed) {
+    return;
+  }
+
+  const auto& row_key = build_keys_.back();
+  auto hash = std::hash<String>()(row_key);
+  auto& slot = slots_[findSlot(hash, row_key)];
+  if (slot.head == 0) {
+    slot.hash = hash;
+    slot.head = idx + 1;
+  } else {
+    build_next_[slot.tail - 1] = idx + 1;
+  }
+
+  slot.tail = idx + 1;
+}
+
+size_t HashJoin::findSlot(uint64_t hash, const String& key) const {
+  for (auto i = hash & slot_mask_; ; i = (i + 1) & slot_mask_) {
+    const auto& slot = slots_[i];
+    if (slot.head == 0) {
+      return i;
+    }
+
+    if (slot.hash == hash && build_keys_[slot.head - 1] == key) {
+      return i;
+    }
+  }
+}
+
+void HashJoin::loadInputRow(size_t side, const Vector<SValue>* row) {
+  for (size_t i = 0; i < input_map_.size(); ++i) {
+    const auto& m = input_map_[i];
+    if (m.table_idx == side) {
+      inbuf_[i] = row ? (*row)[m.column_idx] : SValue();
+    }
+  }
+}
+
+bool HashJoin::evaluatePredicate(const Option<ValueExpression>& expr) {
+  if (expr.isEmpty()) {
+    return true;
+  }
+
+  SValue pred;
+  VM::evaluate(
+      txn_,
+      expr.get().program(),
+      inbuf_.size(),
+      inbuf_.data(),
+      &pred);
+
+  return pred.getBool();
+}
+
+void HashJoin::evaluateSelectList(SValue* out, int out_len) {
+  for (int i = 0; i < select_exprs_.size() && i < out_len; ++i) {
+    VM::evaluate(
+        txn_,
+        select_exprs_[i].program(),
+        inbuf_.size(),
+        inbuf_.data(),
+        &out[i]);
+  }
+}
+
+HashJoinFactory::HashJoinFactory(
+    JoinType join_type,
+    const Set<TaskID>& base_tbl_ids,
+    const Set<TaskID>& joined_tbl_ids,
+    const Vector<JoinNode::InputColumnRef>& input_map,
+    Vector<RefPtr<SelectListNode>> select_exprs,
+    Vector<JoinNode::EquiJoinKey> join_keys,
+    Option<RefPtr<ValueExpressionNode>> join_cond_expr,
+    Option<RefPtr<ValueExpressionNode>> where_expr) :
+    join_type_(join_type),
+    base_tbl_ids_(base_tbl_ids),
+    joined_tbl_ids_(joined_tbl_ids),
+    input_map_(input_map),
+    select_exprs_(select_exprs),
+    join_keys_(join_keys),
+    join_cond_expr_(join_cond_expr),
+    where_expr_(where_expr) {}
+
+void HashJoinFactory::setRuntimeFilter(
+    size_t table_idx,
+    const SHA1Hash& filter_id) {
+  if (table_idx > 1) {
+    RAISE(kRuntimeError, "invalid table index");
+  }
+
+  runtime_filters_[table_idx] = Some(filter_id);
+}
+
+RefPtr<Task> HashJoinFactory::build(
+    Transaction* txn,
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input) const {
+  auto qbuilder = txn->getRuntime()->queryBuilder();
+
+  Vector<ValueExpression> select_expressions;
+  for (const auto& slnode : select_exprs_) {
+    select_expressions.emplace_back(
+        qbuilder->buildValueExpression(txn, slnode->expression()));
+  }
+
+  Vector<ValueExpression> base_key_exprs;
+  Vector<ValueExpression> joined_key_exprs;
+  for (const auto& key : join_keys_) {
+    base_key_exprs.emplace_back(
+        qbuilder->buildValueExpression(txn, key.base_key));
+    joined_key_exprs.emplace_back(
+        qbuilder->buildValueExpression(txn, key.joined_key));
+  }
+
+  Option<ValueExpression> join_cond_expr;
+  if (!join_cond_expr_.isEmpty()) {
+    join_cond_expr = std::move(Option<ValueExpression>(
+        qbuilder->buildValueExpression(txn, join_cond_expr_.get())));
+  }
+
+  Option<ValueExpression> where_expr;
+  if (!where_expr_.isEmpty()) {
+    where_expr = std::move(Option<ValueExpression>(
+        qbuilder->buildValueExpression(txn, where_expr_.get())));
+  }
+
+  auto hash_join = new HashJoin(
+      txn,
+      join_type_,
+      base_tbl_ids_,
+      joined_tbl_ids_,
+      input_map_,
+      std::move(select_expressions),
+      std::move(base_key_exprs),
+      std::move(joined_key_exprs),
+      std::move(join_cond_expr),
+      std::move(where_expr),
+      std::move(input));
+
+  for (size_t table_idx = 0; table_idx < 2; ++table_idx) {
+    if (!runtime_filters_[table_idx].isEmpty()) {
+      hash_join->setRuntimeFilter(
+          table_idx,
+          txn->getRuntimeFilter(runtime_filters_[table_idx].get()));
+    }
+  }
+
+  return hash_join;
+}
+
+}
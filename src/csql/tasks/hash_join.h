@@ -0,0 +1,240 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <csql/Transaction.h>
+#include <csql/tasks/Task.h>
+#include <csql/runtime/defaultruntime.h>
+#include <csql/runtime/SpillFile.h>
+#include <csql/runtime/RuntimeFilter.h>
+#include <csql/runtime/MemoryTracker.h>
+#include <csql/qtree/JoinNode.h>
+
+namespace csql {
+
+/**
+ * Executes an INNER or (left) OUTER equi-join. Both inputs are read in
+ * lockstep until one of them is exhausted; that (smaller) input becomes the
+ * build side and is loaded into an open addressing hash table on its join
+ * keys. The other input is then streamed through the hash table.
+ *
+ * Rows with a NULL join key never match. Keys are encoded with
+ * SortKey::encodeEquiJoinKey so that e.g. the string '5' matches the number 5
+ * like it does with the = operator; candidate pairs with an inexact key are
+ * confirmed by evaluating = on the key values. The residual join condition
+ * (all conjuncts that are not equalities between the two inputs) and the
+ * where expression are evaluated on every candidate pair.
+ *
+ * If the build side exceeds kMaxInMemoryBytes (or the transaction exceeds its
+ * soft memory limit while the build side is read), both inputs are hash
+ * partitioned into kNumSpillPartitions spill files in the runtime's cache dir
+ * (hybrid hash join: the first partition stays resident as long as it fits
+ * into memory and is joined while partitioning the probe side). The spilled
+ * partition pairs are then joined one by one; partitions that still do not
+ * fit into memory are partitioned again, up to kMaxSpillDepth times.
+ *
+ * Once an in-memory build side is complete, its keys are published to the
+ * runtime filter of the probe side (if any) so that the probe side scans can
+ * drop rows that won't match.
+ */
+class HashJoin : public Task {
+public:
+
+  static const size_t kMaxInMemoryBytes;
+  static const size_t kNumSpillPartitions;
+  static const size_t kMaxSpillDepth;
+
+  HashJoin(
+      Transaction* txn,
+      JoinType join_type,
+      const Set<TaskID>& base_tbl_ids,
+      const Set<TaskID>& joined_tbl_ids,
+      const Vector<JoinNode::InputColumnRef>& input_map,
+      Vector<ValueExpression> select_expressions,
+      Vector<ValueExpression> base_key_exprs,
+      Vector<ValueExpression> joined_key_exprs,
+      Option<ValueExpression> join_cond_expr,
+      Option<ValueExpression> where_expr,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input);
+
+  ~HashJoin();
+
+  /**
+   * Set the runtime filter for the base (table_idx = 0) or joined
+   * (table_idx = 1) table
+   */
+  void setRuntimeFilter(size_t table_idx, RefPtr<RuntimeFilter> filter);
+
+  bool nextRow(SValue* out, int out_len) override;
+  void close() override;
+
+  /**
+   * Reports the peak hash table size, the bytes written to spill files and
+   * the bytes read back from them
+   */
+  void collectStats(TaskStats* stats) const override;
+
+protected:
+
+  struct HashTableSlot {
+    uint64_t hash;
+    size_t head; // index of first row + 1, 0 == empty slot
+    size_t tail; // index of last row + 1
+  };
+
+  struct SpillPartition {
+    String build_file;
+    size_t build_rows;
+    size_t build_bytes;
+    String probe_file;
+    size_t probe_rows;
+    size_t probe_bytes;
+    size_t depth;
+  };
+
+  void buildHashTable();
+  void resetHashTable(size_t num_rows);
+
+  bool readRow(size_t side, Vector<SValue>* row);
+
+  /**
+   * Fetch the next probe row into probe_row_ and its key into probe_key_.
+   * Returns false once the probe side of the current partition is exhausted
+   */
+  bool nextProbeRow();
+
+  bool emitUnmatchedBuildRow(SValue* out, int out_len);
+
+  void publishRuntimeFilter();
+
+  /**
+   * Returns true if a hash table of bytes should be spilled: it either
+   * exceeds kMaxInMemoryBytes or the transaction is over its soft memory limit
+   * and there is a cache dir to spill to
+   */
+  bool exceedsMemoryLimit(size_t bytes) const;
+
+  void startSpilling(List<Vector<SValue>>* build_rows);
+  size_t findSpillPartition(const String& key, bool has_key, size_t depth);
+  void spillRow(size_t side, size_t partition, const Vector<SValue>& row);
+  void finishSpilling(size_t depth);
+
+  /**
+   * Load the next spilled partition into the hash table. Returns false if
+   * there are no more partitions
+   */
+  bool loadNextPartition();
+  void repartition(const SpillPartition& partition);
+
+  /**
+   * Computes the normalized join key of a row. Returns false if any of the
+   * key values is NULL. Clears *exact if any of the key values is inexact
+   * (see SortKey::encodeEquiJoinKey)
+   */
+  bool computeKey(
+      size_t side,
+      const Vector<SValue>& row,
+      String* key,
+      bool* exact = nullptr);
+
+  /**
+   * Returns true if the key values of the rows currently loaded into inbuf_
+   * are equal according to the = operator
+   */
+  bool keysEqual();
+
+  void insertRow(Vector<SValue> row, String key, bool exact);
+  size_t findSlot(uint64_t hash, const String& key) const;
+
+  void loadInputRow(size_t side, const Vector<SValue>* row);
+  bool evaluatePredicate(const Option<ValueExpression>& expr);
+  void evaluateSelectList(SValue* out, int out_len);
+
+  Transaction* txn_;
+  JoinType join_type_;
+  Vector<JoinNode::InputColumnRef> input_map_;
+  Vector<ValueExpression> select_exprs_;
+  Vector<ValueExpression> key_exprs_[2];
+  Option<ValueExpression> join_cond_expr_;
+  Option<ValueExpression> where_expr_;
+  ScopedPtr<ResultCursor> input_[2];
+  size_t row_width_[2];
+  bool built_;
+  size_t build_side_;
+  size_t probe_side_;
+  Vector<Vector<SValue>> build_rows_;
+  Vector<String> build_keys_;
+  Vector<bool> build_exact_;
+  Vector<size_t> build_next_;
+  Vector<bool> build_matched_;
+  Vector<HashTableSlot> slots_;
+  size_t slot_mask_;
+  List<Vector<SValue>> probe_buf_;
+  Vector<SValue> probe_row_;
+  String probe_key_;
+  bool probe_has_key_;
+  bool probe_exact_;
+  bool probe_active_;
+  bool probe_matched_;
+  size_t probe_pos_;
+  bool probe_done_;
+  size_t unmatched_pos_;
+  Vector<SValue> inbuf_;
+  bool spilling_;
+  bool resident_;
+  size_t resident_bytes_;
+  List<Vector<SValue>> resident_rows_;
+  Vector<ScopedPtr<SpillFileWriter>> spill_files_[2];
+  List<SpillPartition> spilled_partitions_;
+  ScopedPtr<SpillFileReader> probe_reader_;
+  String probe_reader_file_;
+  size_t spill_bytes_written_;
+  size_t spill_bytes_read_;
+  RefPtr<RuntimeFilter> runtime_filters_[2];
+  MemoryReservation memory_;
+  AbortCheck abort_check_;
+};
+
+class HashJoinFactory : public TaskFactory {
+public:
+
+  HashJoinFactory(
+      JoinType join_type,
+      const Set<TaskID>& base_tbl_ids,
+      const Set<TaskID>& joined_tbl_ids,
+      const Vector<JoinNode::InputColumnRef>& input_map,
+      Vector<RefPtr<SelectListNode>> select_exprs,
+      Vector<JoinNode::EquiJoinKey> join_keys,
+      Option<RefPtr<ValueExpressionNode>> join_cond_expr,
+      Option<RefPtr<ValueExpressionNode>> where_expr);
+
+  /**
+   * Publish the runtime filter filter_id (see RuntimeFilterSpec) for the
+   * scan of the base (table_idx = 0) or joined (table_idx = 1) table
+   */
+  void setRuntimeFilter(size_t table_idx, const SHA1Hash& filter_id);
+
+  RefPtr<Task> build(
+      Transaction* txn,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input) const override;
+
+protected:
+  JoinType join_type_;
+  Set<TaskID> base_tbl_ids_;
+  Set<TaskID> joined_tbl_ids_;
+  Vector<JoinNode::InputColumnRef> input_map_;
+  Vector<RefPtr<SelectListNode>> select_exprs_;
+  Vector<JoinNode::EquiJoinKey> join_keys_;
+  Option<RefPtr<ValueExpressionNode>> join_cond_expr_;
+  Option<RefPtr<ValueExpressionNode>> where_expr_;
+  Option<SHA1Hash> runtime_filters_[2];
+};
+
+}
@@ -0,0 +1,427 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <csql/tasks/hash_semi_join.h>
+#include <csql/runtime/SortKey.h>
+#include <csql/expressions/boolean.h>
+
+namespace csql {
+
+static size_t estimateRowSize(const Vector<SValue>& row) {
+  size_t size = sizeof(row);
+  for (const auto& val : row) {
+    size += val.getMemoryUsage();
+  }
+
+  return size;
+}
+
+HashSemiJoin::HashSemiJoin(
+    Transaction* txn,
+    JoinType join_type,
+    const Set<TaskID>& base_tbl_ids,
+    const Set<TaskID>& joined_tbl_ids,
+    const Vector<JoinNode::InputColumnRef>& input_map,
+    Vector<ValueExpression> select_expressions,
+    Vector<ValueExpression> base_key_exprs,
+    Vector<ValueExpression> joined_key_exprs,
+    Option<ValueExpression> join_cond_expr,
+    Option<ValueExpression> where_expr,
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input) :
+    txn_(txn),
+    join_type_(join_type),
+    input_map_(input_map),
+    select_exprs_(std::move(select_expressions)),
+    join_cond_expr_(std::move(join_cond_expr)),
+    where_expr_(std::move(where_expr)),
+    inbuf_(input_map.size(), SValue{}),
+    built_(false),
+    build_empty_(true),
+    build_has_null_key_(false),
+    memory_(txn->getMemoryTracker()),
+    abort_check_(txn) {
+  switch (join_type_) {
+    case JoinType::SEMI:
+    case JoinType::ANTI:
+      break;
+    case JoinType::NULL_AWARE_ANTI:
+      if (base_key_exprs.size() == 0 || !join_cond_expr_.isEmpty()) {
+        RAISE(
+            kIllegalArgumentError,
+            "can't execute NULL_AWARE_ANTI join: invalid join condition");
+      }
+      break;
+    default:
+      RAISE(kIllegalArgumentError, "can't execute join as hash semi join");
+  }
+
+  if (base_key_exprs.size() != joined_key_exprs.size()) {
+    RAISE(
+        kIllegalArgumentError,
+        "can't execute hash semi join: invalid join keys");
+  }
+
+  key_exprs_[0] = std::move(base_key_exprs);
+  key_exprs_[1] = std::move(joined_key_exprs);
+
+  Vector<ScopedPtr<ResultCursor>> cursors[2];
+  for (auto& in : input) {
+    if (base_tbl_ids.count(in.first) > 0) {
+      cursors[0].emplace_back(std::move(in.second));
+    } else if (joined_tbl_ids.count(in.first) > 0) {
+      cursors[1].emplace_back(std::move(in.second));
+    } else {
+      RAISE(kIllegalStateError, "hash semi join: unknown input task");
+    }
+  }
+
+  for (size_t side = 0; side < 2; ++side) {
+    input_[side] = mkScoped(new ResultCursorList(std::move(cursors[side])));
+    row_width_[side] = 1;
+  }
+
+  for (const auto& m : input_map_) {
+    if (m.table_idx > 1) {
+      RAISE(kRuntimeError, "invalid table index");
+    }
+
+    row_width_[m.table_idx] = std::max(
+        row_width_[m.table_idx],
+        m.column_idx + 1);
+  }
+}
+
+void HashSemiJoin::setRuntimeFilter(RefPtr<RuntimeFilter> filter) {
+  runtime_filter_ = filter;
+}
+
+bool HashSemiJoin::nextRow(SValue* out, int out_len) {
+  if (!built_) {
+    input_[0]->prefetch(row_width_[0]);
+    input_[1]->prefetch(row_width_[1]);
+    readBuildSide();
+    built_ = true;
+  }
+
+  /* no base table row can qualify, so don't even read the base table */
+  if ((join_type_ == JoinType::SEMI && build_empty_) ||
+      (join_type_ == JoinType::NULL_AWARE_ANTI && build_has_null_key_)) {
+    input_[0]->close();
+    return false;
+  }
+
+  while (readRow(0, &base_row_)) {
+    abort_check_.tick();
+    loadInputRow(0, &base_row_);
+    loadInputRow(1, nullptr);
+    if (!evaluatePredicate(where_expr_)) {
+      continue;
+    }
+
+    String key;
+    bool exact = true;
+    bool matched;
+    if (computeKey(0, base_row_, &key, &exact)) {
+      matched = findMatch(key, exact);
+    } else if (join_type_ == JoinType::NULL_AWARE_ANTI && !build_empty_) {
+      /* NULL NOT IN (<non-empty set>) is NULL */
+      continue;
+    } else {
+      matched = false;
+    }
+
+    if (matched != (join_type_ == JoinType::SEMI)) {
+      continue;
+    }
+
+    loadInputRow(0, &base_row_);
+    loadInputRow(1, nullptr);
+    evaluateSelectList(out, out_len);
+    return true;
+  }
+
+  return false;
+}
+
+void HashSemiJoin::close() {
+  input_[0]->close();
+  input_[1]->close();
+}
+
+void HashSemiJoin::collectStats(TaskStats* stats) const {
+  stats->updatePeakMemory(memory_.peakBytes());
+}
+
+void HashSemiJoin::readBuildSide() {
+  bool keep_rows = !join_cond_expr_.isEmpty();
+
+  Vector<SValue> row;
+  while (readRow(1, &row)) {
+    abort_check_.tick();
+    build_empty_ = false;
+
+    if (key_exprs_[1].empty()) {
+      /* without keys or a residual condition every base row matches */
+      if (!keep_rows) {
+        input_[1]->close();
+        break;
+      }
+
+      memory_.grow(estimateRowSize(row));
+      build_index_[""].emplace_back(build_rows_.size());
+      build_rows_.emplace_back(std::move(row));
+      build_exact_.emplace_back(true);
+      continue;
+    }
+
+    String key;
+    String distinct_key;
+    bool exact = true;
+    auto has_key = computeKey(
+        1,
+        row,
+        &key,
+        &exact,
+        keep_rows ? nullptr : &distinct_key);
+
+    if (!has_key) {
+      build_has_null_key_ = true;
+
+      /* x NOT IN (<set containing NULL>) is never true */
+      if (join_type_ == JoinType::NULL_AWARE_ANTI) {
+        input_[1]->close();
+        break;
+      }
+
+      continue;
+    }
+
+    /* without a residual condition rows with the same key values are
+     * interchangeable */
+    if (!keep_rows && !build_distinct_keys_.emplace(distinct_key).second) {
+      continue;
+    }
+
+    memory_.grow(estimateRowSize(row) + key.size() + distinct_key.size());
+    build_index_[key].emplace_back(build_rows_.size());
+    build_rows_.emplace_back(std::move(row));
+    build_exact_.emplace_back(exact);
+  }
+
+  publishRuntimeFilter();
+}
+
+void HashSemiJoin::publishRuntimeFilter() {
+  if (runtime_filter_.get() == nullptr ||
+      runtime_filter_->isPublished() ||
+      join_type_ != JoinType::SEMI ||
+      key_exprs_[1].empty()) {
+    return;
+  }
+
+  if (build_index_.size() > RuntimeFilter::kMaxKeys) {
+    return;
+  }
+
+  Vector<String> keys;
+  for (const auto& e : build_index_) {
+    keys.emplace_back(e.first);
+  }
+
+  runtime_filter_->publish(keys);
+}
+
+bool HashSemiJoin::findMatch(const String& key, bool exact) {
+  if (join_cond_expr_.isEmpty() && key_exprs_[1].empty()) {
+    return !build_empty_;
+  }
+
+  auto candidates = build_index_.find(key);
+  if (candidates == build_index_.end()) {
+    return false;
+  }
+
+  loadInputRow(0, &base_row_);
+  for (auto idx : candidates->second) {
+    loadInputRow(1, &build_rows_[idx]);
+    if ((!exact || !build_exact_[idx]) && !keysEqual()) {
+      continue;
+    }
+
+    if (evaluatePredicate(join_cond_expr_)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool HashSemiJoin::readRow(size_t side, Vector<SValue>* row) {
+  row->resize(row_width_[side]);
+  return input_[side]->next(row->data(), row->size());
+}
+
+bool HashSemiJoin::computeKey(
+    size_t side,
+    const Vector<SValue>& row,
+    String* key,
+    bool* exact,
+    String* distinct_key) {
+  loadInputRow(side, &row);
+
+  for (const auto& expr : key_exprs_[side]) {
+    SValue val;
+    VM::evaluate(txn_, expr.program(), inbuf_.size(), inbuf_.data(), &val);
+    if (!SortKey::encodeEquiJoinKey(val, key, exact)) {
+      return false;
+    }
+
+    if (distinct_key) {
+      distinct_key->push_back(static_cast<char>(val.getType()));
+      SortKey::encode(val, false, distinct_key);
+    }
+  }
+
+  return true;
+}
+
+bool HashSemiJoin::keysEqual() {
+  for (size_t i = 0; i < key_exprs_[0].size(); ++i) {
+    SValue args[2];
+    for (size_t side = 0; side < 2; ++side) {
+      VM::evaluate(
+          txn_,
+          key_exprs_[side][i].program(),
+          inbuf_.size(),
+          inbuf_.data(),
+          &args[side]);
+    }
+
+    SValue eq;
+    expressions::eqExpr(Transaction::get(txn_), 2, args, &eq);
+    if (!eq.getBool()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void HashSemiJoin::loadInputRow(size_t side, const Vector<SValue>* row) {
+  for (size_t i = 0; i < input_map_.size(); ++i) {
+    const auto& m = input_map_[i];
+    if (m.table_idx == side) {
+      inbuf_[i] = row ? (*row)[m.column_idx] : SValue();
+    }
+  }
+}
+
+bool HashSemiJoin::evaluatePredicate(const Option<ValueExpression>& expr) {
+  if (expr.isEmpty()) {
+    return true;
+  }
+
+  SValue pred;
+  VM::evaluate(
+      txn_,
+      expr.get().program(),
+      inbuf_.size(),
+      inbuf_.data(),
+      &pred);
+
+  return pred.getBool();
+}
+
+void HashSemiJoin::evaluateSelectList(SValue* out, int out_len) {
+  for (int i = 0; i < select_exprs_.size() && i < out_len; ++i) {
+    VM::evaluate(
+        txn_,
+        select_exprs_[i].program(),
+        inbuf_.size(),
+        inbuf_.data(),
+        &out[i]);
+  }
+}
+
+HashSemiJoinFactory::HashSemiJoinFactory(
+    JoinType join_type,
+    const Set<TaskID>& base_tbl_ids,
+    const Set<TaskID>& joined_tbl_ids,
+    const Vector<JoinNode::InputColumnRef>& input_map,
+    Vector<RefPtr<SelectListNode>> select_exprs,
+    Vector<JoinNode::EquiJoinKey> join_keys,
+    Option<RefPtr<ValueExpressionNode>> join_cond_expr,
+    Option<RefPtr<ValueExpressionNode>> where_expr) :
+    join_type_(join_type),
+    base_tbl_ids_(base_tbl_ids),
+    joined_tbl_ids_(joined_tbl_ids),
+    input_map_(input_map),
+    select_exprs_(select_exprs),
+    join_keys_(join_keys),
+    join_cond_expr_(join_cond_expr),
+    where_expr_(where_expr) {}
+
+void HashSemiJoinFactory::setRuntimeFilter(const SHA1Hash& filter_id) {
+  runtime_filter_ = Some(filter_id);
+}
+
+RefPtr<Task> HashSemiJoinFactory::build(
+    Transaction* txn,
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input) const {
+  auto qbuilder = txn->getRuntime()->queryBuilder();
+
+  Vector<ValueExpression> select_expressions;
+  for (const auto& slnode : select_exprs_) {
+    select_expressions.emplace_back(
+        qbuilder->buildValueExpression(txn, slnode->expression()));
+  }
+
+  Vector<ValueExpression> base_key_exprs;
+  Vector<ValueExpression> joined_key_exprs;
+  for (const auto& key : join_keys_) {
+    base_key_exprs.emplace_back(
+        qbuilder->buildValueExpression(txn, key.base_key));
+    joined_key_exprs.emplace_back(
+        qbuilder->buildValueExpression(txn, key.joined_key));
+  }
+
+  Option<ValueExpression> join_cond_expr;
+  if (!join_cond_expr_.isEmpty()) {
+    join_cond_expr = std::move(Option<ValueExpression>(
+        qbuilder->buildValueExpression(txn, join_cond_expr_.get())));
+  }
+
+  Option<ValueExpression> where_expr;
+  if (!where_expr_.isEmpty()) {
+    where_expr = std::move(Option<ValueExpression>(
+        qbuilder->buildValueExpression(txn, where_expr_.get())));
+  }
+
+  auto semi_join = new HashSemiJoin(
+      txn,
+      join_type_,
+      base_tbl_ids_,
+      joined_tbl_ids_,
+      input_map_,
+      std::move(select_expressions),
+      std::move(base_key_exprs),
+      std::move(joined_key_exprs),
+      std::move(join_cond_expr),
+      std::move(where_expr),
+      std::move(input));
+
+  if (!runtime_filter_.isEmpty()) {
+    semi_join->setRuntimeFilter(txn->getRuntimeFilter(runtime_filter_.get()));
+  }
+
+  return semi_join;
+}
+
+}
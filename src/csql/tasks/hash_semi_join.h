@@ -0,0 +1,158 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <unordered_set>
+#include <stx/stdtypes.h>
+#include <csql/Transaction.h>
+#include <csql/tasks/Task.h>
+#include <csql/runtime/defaultruntime.h>
+#include <csql/runtime/RuntimeFilter.h>
+#include <csql/runtime/MemoryTracker.h>
+#include <csql/qtree/JoinNode.h>
+
+namespace csql {
+
+/**
+ * Executes a SEMI, ANTI or NULL_AWARE_ANTI join (IN, EXISTS, NOT EXISTS and
+ * NOT IN subqueries). The joined table is always the build side and each base
+ * table row is emitted at most once, depending on whether it has a match on
+ * the build side.
+ *
+ * The build rows are indexed on their keys (see HashJoin for the key
+ * encoding) and probing stops at the first row that satisfies the residual
+ * condition. If there is no residual join condition only one build row per
+ * distinct list of key values is kept in memory. Without any join keys
+ * (uncorrelated EXISTS) only a single build row is read.
+ *
+ * Rows with a NULL join key never match. For NULL_AWARE_ANTI joins (NOT IN)
+ * no rows are emitted if the build side contains a NULL key and base rows
+ * with a NULL key are only emitted if the build side is empty.
+ */
+class HashSemiJoin : public Task {
+public:
+
+  HashSemiJoin(
+      Transaction* txn,
+      JoinType join_type,
+      const Set<TaskID>& base_tbl_ids,
+      const Set<TaskID>& joined_tbl_ids,
+      const Vector<JoinNode::InputColumnRef>& input_map,
+      Vector<ValueExpression> select_expressions,
+      Vector<ValueExpression> base_key_exprs,
+      Vector<ValueExpression> joined_key_exprs,
+      Option<ValueExpression> join_cond_expr,
+      Option<ValueExpression> where_expr,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input);
+
+  /**
+   * Set the runtime filter of the base table. The filter is only published
+   * for SEMI joins
+   */
+  void setRuntimeFilter(RefPtr<RuntimeFilter> filter);
+
+  bool nextRow(SValue* out, int out_len) override;
+  void close() override;
+
+  void collectStats(TaskStats* stats) const override;
+
+protected:
+
+  void readBuildSide();
+  void publishRuntimeFilter();
+
+  /**
+   * Returns true if the current base row matches any build row
+   */
+  bool findMatch(const String& key, bool exact);
+
+  bool readRow(size_t side, Vector<SValue>* row);
+
+  /**
+   * Computes the normalized join key of a row. Returns false if any of the
+   * key values is NULL. Clears *exact if any of the key values is inexact
+   * (see SortKey::encodeEquiJoinKey). If distinct_key is given, the key values
+   * are also appended to it in a type preserving encoding
+   */
+  bool computeKey(
+      size_t side,
+      const Vector<SValue>& row,
+      String* key,
+      bool* exact,
+      String* distinct_key = nullptr);
+
+  /**
+   * Returns true if the key values of the rows currently loaded into inbuf_
+   * are equal according to the = operator
+   */
+  bool keysEqual();
+
+  void loadInputRow(size_t side, const Vector<SValue>* row);
+  bool evaluatePredicate(const Option<ValueExpression>& expr);
+  void evaluateSelectList(SValue* out, int out_len);
+
+  Transaction* txn_;
+  JoinType join_type_;
+  Vector<JoinNode::InputColumnRef> input_map_;
+  Vector<ValueExpression> select_exprs_;
+  Vector<ValueExpression> key_exprs_[2];
+  Option<ValueExpression> join_cond_expr_;
+  Option<ValueExpression> where_expr_;
+  ScopedPtr<ResultCursor> input_[2];
+  size_t row_width_[2];
+  Vector<SValue> inbuf_;
+  bool built_;
+  bool build_empty_;
+  bool build_has_null_key_;
+  std::unordered_set<String> build_distinct_keys_;
+  HashMap<String, Vector<size_t>> build_index_;
+  Vector<Vector<SValue>> build_rows_;
+  Vector<bool> build_exact_;
+  MemoryReservation memory_;
+  Vector<SValue> base_row_;
+  RefPtr<RuntimeFilter> runtime_filter_;
+  AbortCheck abort_check_;
+};
+
+class HashSemiJoinFactory : public TaskFactory {
+public:
+
+  HashSemiJoinFactory(
+      JoinType join_type,
+      const Set<TaskID>& base_tbl_ids,
+      const Set<TaskID>& joined_tbl_ids,
+      const Vector<JoinNode::InputColumnRef>& input_map,
+      Vector<RefPtr<SelectListNode>> select_exprs,
+      Vector<JoinNode::EquiJoinKey> join_keys,
+      Option<RefPtr<ValueExpressionNode>> join_cond_expr,
+      Option<RefPtr<ValueExpressionNode>> where_expr);
+
+  /**
+   * Publish the runtime filter filter_id (see RuntimeFilterSpec) for the
+   * scan of the base table
+   */
+  void setRuntimeFilter(const SHA1Hash& filter_id);
+
+  RefPtr<Task> build(
+      Transaction* txn,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input) const override;
+
+protected:
+  JoinType join_type_;
+  Set<TaskID> base_tbl_ids_;
+  Set<TaskID> joined_tbl_ids_;
+  Vector<JoinNode::InputColumnRef> input_map_;
+  Vector<RefPtr<SelectListNode>> select_exprs_;
+  Vector<JoinNode::EquiJoinKey> join_keys_;
+  Option<RefPtr<ValueExpressionNode>> join_cond_expr_;
+  Option<RefPtr<ValueExpressionNode>> where_expr_;
+  Option<SHA1Hash> runtime_filter_;
+};
+
+}
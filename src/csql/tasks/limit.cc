@@ -7,6 +7,7 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
 #include <csql/tasks/limit.h>
 
 namespace csql {
@@ -20,21 +21,63 @@ Limit::Limit(
     input_(new ResultCursorList(std::move(input))),
     counter_(0) {}
 
-//bool Limit::onInputRow(
-//    const TaskID& input_id,
-//    const SValue* row,
-//    int row_len) {
-//  if (counter_++ < offset_) {
-//    return true;
-//  }
-//
-//  if (counter_ > (offset_ + limit_)) {
-//    return false;
-//  }
-//
-//  return input_(row, row_len);
-//}
 bool Limit::nextRow(SValue* out, int out_len) {
+  if (counter_ >= offset_ + limit_) {
+    input_->close();
+    return false;
+  }
+
+  for (; counter_ < offset_; ++counter_) {
+    if (!input_->next(out, out_len)) {
+      return false;
+    }
+  }
+
+  if (!input_->next(out, out_len)) {
+    return false;
+  }
+
+  /* stop the upstream tasks right away instead of on the next call */
+  if (++counter_ == offset_ + limit_) {
+    input_->close();
+  }
+
+  return true;
+}
+
+void Limit::close() {
+  input_->close();
+}
+
+LimitStage::LimitStage(
+    size_t limit,
+    size_t offset) :
+    limit_(limit),
+    offset_(offset),
+    counter_(0) {}
+
+size_t LimitStage::numInputColumns(size_t num_output_columns) const {
+  return num_output_columns;
+}
+
+bool LimitStage::process(
+    const SValue* row,
+    int row_len,
+    SValue* out,
+    int out_len) {
+  if (isDone() || counter_++ < offset_) {
+    return false;
+  }
+
+  std::copy(row, row + std::min(row_len, out_len), out);
+  return true;
+}
+
+bool LimitStage::isDone() const {
+  return counter_ >= offset_ + limit_;
+}
+
+bool LimitStage::isPartitionable() const {
   return false;
 }
 
@@ -44,10 +87,18 @@ LimitFactory::LimitFactory(
     limit_(limit),
     offset_(offset) {}
 
+bool LimitFactory::allowsParallelUnion() const {
+  return true;
+}
+
 RefPtr<Task> LimitFactory::build(
     Transaction* txn,
     HashMap<TaskID, ScopedPtr<ResultCursor>> input) const {
   return new Limit(limit_, offset_, std::move(input));
 }
 
+PipelineStage* LimitFactory::buildStage(Transaction* txn) const {
+  return new LimitStage(limit_, offset_);
+}
+
 }
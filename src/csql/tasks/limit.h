@@ -10,10 +10,16 @@
 #pragma once
 #include <stx/stdtypes.h>
 #include <csql/tasks/Task.h>
+#include <csql/tasks/pipeline.h>
 #include <csql/runtime/defaultruntime.h>
 
 namespace csql {
 
+/**
+ * Skips the first offset rows and returns up to limit rows of its input. The
+ * input is closed as soon as the last row was returned, so that the upstream
+ * tasks stop producing rows
+ */
 class Limit : public Task {
 public:
 
@@ -23,11 +29,7 @@ public:
       HashMap<TaskID, ScopedPtr<ResultCursor>> input);
 
   bool nextRow(SValue* out, int out_len) override;
-
-  //bool onInputRow(
-  //    const TaskID& input_id,
-  //    const SValue* row,
-  //    int row_len) override;
+  void close() override;
 
 protected:
   size_t limit_;
@@ -36,6 +38,28 @@ protected:
   size_t counter_;
 };
 
+class LimitStage : public PipelineStage {
+public:
+
+  LimitStage(size_t limit, size_t offset);
+
+  size_t numInputColumns(size_t num_output_columns) const override;
+
+  bool process(
+      const SValue* row,
+      int row_len,
+      SValue* out,
+      int out_len) override;
+
+  bool isDone() const override;
+  bool isPartitionable() const override;
+
+protected:
+  size_t limit_;
+  size_t offset_;
+  size_t counter_;
+};
+
 class LimitFactory : public TaskFactory {
 public:
 
@@ -45,6 +69,10 @@ public:
       Transaction* txn,
       HashMap<TaskID, ScopedPtr<ResultCursor>> input) const override;
 
+  bool allowsParallelUnion() const override;
+
+  PipelineStage* buildStage(Transaction* txn) const override;
+
 protected:
   size_t limit_;
   size_t offset_;
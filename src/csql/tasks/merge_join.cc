@@ -0,0 +1,355 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <csql/tasks/merge_join.h>
+#include <csql/runtime/SortKey.h>
+
+namespace csql {
+
+static size_t estimateRowSize(const Vector<SValue>& row) {
+  size_t size = sizeof(row);
+  for (const auto& val : row) {
+    size += val.getMemoryUsage();
+  }
+
+  return size;
+}
+
+MergeJoin::MergeJoin(
+    Transaction* txn,
+    JoinType join_type,
+    const Set<TaskID>& base_tbl_ids,
+    const Set<TaskID>& joined_tbl_ids,
+    const Vector<JoinNode::InputColumnRef>& input_map,
+    Vector<ValueExpression> select_expressions,
+    Vector<ValueExpression> base_key_exprs,
+    Vector<ValueExpression> joined_key_exprs,
+    Option<ValueExpression> join_cond_expr,
+    Option<ValueExpression> where_expr,
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input) :
+    txn_(txn),
+    join_type_(join_type),
+    input_map_(input_map),
+    select_exprs_(std::move(select_expressions)),
+    join_cond_expr_(std::move(join_cond_expr)),
+    where_expr_(std::move(where_expr)),
+    inbuf_(input_map.size(), SValue{}),
+    started_(false),
+    base_has_key_(false),
+    base_active_(false),
+    base_matched_(false),
+    joined_valid_(false),
+    run_valid_(false),
+    run_pos_(0),
+    memory_(txn->getMemoryTracker()),
+    abort_check_(txn) {
+  if (join_type_ == JoinType::CARTESIAN) {
+    RAISE(kIllegalArgumentError, "can't execute CARTESIAN join as merge join");
+  }
+
+  if (base_key_exprs.size() == 0 ||
+      base_key_exprs.size() != joined_key_exprs.size()) {
+    RAISE(kIllegalArgumentError, "can't execute merge join: invalid join keys");
+  }
+
+  key_exprs_[0] = std::move(base_key_exprs);
+  key_exprs_[1] = std::move(joined_key_exprs);
+
+  Vector<ScopedPtr<ResultCursor>> cursors[2];
+  for (auto& in : input) {
+    if (base_tbl_ids.count(in.first) > 0) {
+      cursors[0].emplace_back(std::move(in.second));
+    } else if (joined_tbl_ids.count(in.first) > 0) {
+      cursors[1].emplace_back(std::move(in.second));
+    } else {
+      RAISE(kIllegalStateError, "merge join: unknown input task");
+    }
+  }
+
+  for (size_t side = 0; side < 2; ++side) {
+    if (cursors[side].size() != 1) {
+      RAISE(kIllegalStateError, "merge join: expected exactly one input");
+    }
+
+    input_[side] = std::move(cursors[side][0]);
+    row_width_[side] = 1;
+  }
+
+  for (const auto& m : input_map_) {
+    if (m.table_idx > 1) {
+      RAISE(kRuntimeError, "invalid table index");
+    }
+
+    row_width_[m.table_idx] = std::max(
+        row_width_[m.table_idx],
+        m.column_idx + 1);
+  }
+}
+
+bool MergeJoin::nextRow(SValue* out, int out_len) {
+  if (!started_) {
+    input_[0]->prefetch(row_width_[0]);
+    input_[1]->prefetch(row_width_[1]);
+    advanceJoinedRow();
+    started_ = true;
+  }
+
+  for (;;) {
+    abort_check_.tick();
+
+    if (base_active_) {
+      while (run_pos_ < run_.size()) {
+        abort_check_.tick();
+        const auto& joined_row = run_[run_pos_++];
+
+        loadInputRow(0, &base_row_);
+        loadInputRow(1, &joined_row);
+
+        if (!evaluatePredicate(join_cond_expr_) ||
+            !evaluatePredicate(where_expr_)) {
+          continue;
+        }
+
+        base_matched_ = true;
+        evaluateSelectList(out, out_len);
+        return true;
+      }
+
+      base_active_ = false;
+
+      if (join_type_ == JoinType::OUTER && !base_matched_) {
+        loadInputRow(0, &base_row_);
+        loadInputRow(1, nullptr);
+
+        if (evaluatePredicate(where_expr_)) {
+          evaluateSelectList(out, out_len);
+          return true;
+        }
+      }
+    }
+
+    if (!readBaseRow()) {
+      return false;
+    }
+
+    base_active_ = true;
+    base_matched_ = false;
+
+    /* rows with a NULL key never match */
+    if (!base_has_key_) {
+      run_pos_ = run_.size();
+      continue;
+    }
+
+    run_pos_ = 0;
+
+    /* the previous base row had the same key */
+    if (run_valid_ && run_key_ == base_key_) {
+      continue;
+    }
+
+    run_.clear();
+    run_valid_ = false;
+    memory_.resize(0);
+
+    while (joined_valid_ && SortKey::compare(joined_key_, base_key_) < 0) {
+      advanceJoinedRow();
+    }
+
+    if (joined_valid_ && joined_key_ == base_key_) {
+      run_key_ = base_key_;
+      run_valid_ = true;
+
+      while (joined_valid_ && joined_key_ == run_key_) {
+        memory_.grow(estimateRowSize(joined_row_));
+        run_.emplace_back(std::move(joined_row_));
+        advanceJoinedRow();
+      }
+    }
+  }
+}
+
+void MergeJoin::close() {
+  input_[0]->close();
+  input_[1]->close();
+}
+
+void MergeJoin::collectStats(TaskStats* stats) const {
+  stats->updatePeakMemory(memory_.peakBytes());
+}
+
+bool MergeJoin::readBaseRow() {
+  base_row_.resize(row_width_[0]);
+  if (!input_[0]->next(base_row_.data(), base_row_.size())) {
+    return false;
+  }
+
+  base_key_.clear();
+  base_has_key_ = computeKey(0, base_row_, &base_key_);
+  if (base_has_key_) {
+    if (!prev_base_key_.empty() &&
+        SortKey::compare(prev_base_key_, base_key_) > 0) {
+      RAISE(kRuntimeError, "merge JOIN: base table input is not sorted");
+    }
+
+    prev_base_key_ = base_key_;
+  }
+
+  return true;
+}
+
+void MergeJoin::advanceJoinedRow() {
+  String prev_key;
+  if (joined_valid_) {
+    prev_key = joined_key_;
+  }
+
+  for (;;) {
+    joined_row_.resize(row_width_[1]);
+    if (!input_[1]->next(joined_row_.data(), joined_row_.size())) {
+      joined_valid_ = false;
+      return;
+    }
+
+    joined_key_.clear();
+    if (computeKey(1, joined_row_, &joined_key_)) {
+      break;
+    }
+  }
+
+  if (!prev_key.empty() && SortKey::compare(prev_key, joined_key_) > 0) {
+    RAISE(kRuntimeError, "merge JOIN: joined table input is not sorted");
+  }
+
+  joined_valid_ = true;
+}
+
+bool MergeJoin::computeKey(
+    size_t side,
+    const Vector<SValue>& row,
+    String* key) {
+  loadInputRow(side, &row);
+
+  for (const auto& expr : key_exprs_[side]) {
+    SValue val;
+    VM::evaluate(txn_, expr.program(), inbuf_.size(), inbuf_.data(), &val);
+    if (!SortKey::encodeJoinKey(val, key)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void MergeJoin::loadInputRow(size_t side, const Vector<SValue>* row) {
+  for (size_t i = 0; i < input_map_.size(); ++i) {
+    const auto& m = input_map_[i];
+    if (m.table_idx == side) {
+      inbuf_[i] = row ? (*row)[m.column_idx] : SValue();
+    }
+  }
+}
+
+bool MergeJoin::evaluatePredicate(const Option<ValueExpression>& expr) {
+  if (expr.isEmpty()) {
+    return true;
+  }
+
+  SValue pred;
+  VM::evaluate(
+      txn_,
+      expr.get().program(),
+      inbuf_.size(),
+      inbuf_.data(),
+      &pred);
+
+  return pred.getBool();
+}
+
+void MergeJoin::evaluateSelectList(SValue* out, int out_len) {
+  for (int i = 0; i < select_exprs_.size() && i < out_len; ++i) {
+    VM::evaluate(
+        txn_,
+        select_exprs_[i].program(),
+        inbuf_.size(),
+        inbuf_.data(),
+        &out[i]);
+  }
+}
+
+MergeJoinFactory::MergeJoinFactory(
+    JoinType join_type,
+    const Set<TaskID>& base_tbl_ids,
+    const Set<TaskID>& joined_tbl_ids,
+    const Vector<JoinNode::InputColumnRef>& input_map,
+    Vector<RefPtr<SelectListNode>> select_exprs,
+    Vector<JoinNode::EquiJoinKey> join_keys,
+    Option<RefPtr<ValueExpressionNode>> join_cond_expr,
+    Option<RefPtr<ValueExpressionNode>> where_expr) :
+    join_type_(join_type),
+    base_tbl_ids_(base_tbl_ids),
+    joined_tbl_ids_(joined_tbl_ids),
+    input_map_(input_map),
+    select_exprs_(select_exprs),
+    join_keys_(join_keys),
+    join_cond_expr_(join_cond_expr),
+    where_expr_(where_expr) {}
+
+bool MergeJoinFactory::requiresSortedInput() const {
+  return true;
+}
+
+RefPtr<Task> MergeJoinFactory::build(
+    Transaction* txn,
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input) const {
+  auto qbuilder = txn->getRuntime()->queryBuilder();
+
+  Vector<ValueExpression> select_expressions;
+  for (const auto& slnode : select_exprs_) {
+    select_expressions.emplace_back(
+        qbuilder->buildValueExpression(txn, slnode->expression()));
+  }
+
+  Vector<ValueExpression> base_key_exprs;
+  Vector<ValueExpression> joined_key_exprs;
+  for (const auto& key : join_keys_) {
+    base_key_exprs.emplace_back(
+        qbuilder->buildValueExpression(txn, key.base_key));
+    joined_key_exprs.emplace_back(
+        qbuilder->buildValueExpression(txn, key.joined_key));
+  }
+
+  Option<ValueExpression> join_cond_expr;
+  if (!join_cond_expr_.isEmpty()) {
+    join_cond_expr = std::move(Option<ValueExpression>(
+        qbuilder->buildValueExpression(txn, join_cond_expr_.get())));
+  }
+
+  Option<ValueExpression> where_expr;
+  if (!where_expr_.isEmpty()) {
+    where_expr = std::move(Option<ValueExpression>(
+        qbuilder->buildValueExpression(txn, where_expr_.get())));
+  }
+
+  return new MergeJoin(
+      txn,
+      join_type_,
+      base_tbl_ids_,
+      joined_tbl_ids_,
+      input_map_,
+      std::move(select_expressions),
+      std::move(base_key_exprs),
+      std::move(joined_key_exprs),
+      std::move(join_cond_expr),
+      std::move(where_expr),
+      std::move(input));
+}
+
+}
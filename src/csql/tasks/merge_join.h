@@ -0,0 +1,125 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <csql/Transaction.h>
+#include <csql/tasks/Task.h>
+#include <csql/runtime/defaultruntime.h>
+#include <csql/runtime/MemoryTracker.h>
+#include <csql/qtree/JoinNode.h>
+
+namespace csql {
+
+/**
+ * Executes an INNER or (left) OUTER equi-join on two inputs that are both
+ * sorted in ascending order of their join keys. Both inputs are streamed in
+ * lockstep; only the current run of joined table rows with the same key is
+ * kept in memory.
+ *
+ * Rows with a NULL join key never match. Raises an error if either input
+ * turns out not to be sorted.
+ *
+ * The keys are compared in the order the inputs are sorted in (see
+ * SortKey::encodeJoinKey), so a string key never matches a numeric key. The
+ * planner only uses a merge join if the keys of both inputs have the same
+ * type (see JoinNode::joinKeyTypesMatch), in which case this is the same as
+ * the = operator and the HashJoin key semantics.
+ */
+class MergeJoin : public Task {
+public:
+
+  MergeJoin(
+      Transaction* txn,
+      JoinType join_type,
+      const Set<TaskID>& base_tbl_ids,
+      const Set<TaskID>& joined_tbl_ids,
+      const Vector<JoinNode::InputColumnRef>& input_map,
+      Vector<ValueExpression> select_expressions,
+      Vector<ValueExpression> base_key_exprs,
+      Vector<ValueExpression> joined_key_exprs,
+      Option<ValueExpression> join_cond_expr,
+      Option<ValueExpression> where_expr,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input);
+
+  bool nextRow(SValue* out, int out_len) override;
+  void close() override;
+
+  void collectStats(TaskStats* stats) const override;
+
+protected:
+
+  bool readBaseRow();
+  void advanceJoinedRow();
+
+  bool computeKey(size_t side, const Vector<SValue>& row, String* key);
+
+  void loadInputRow(size_t side, const Vector<SValue>* row);
+  bool evaluatePredicate(const Option<ValueExpression>& expr);
+  void evaluateSelectList(SValue* out, int out_len);
+
+  Transaction* txn_;
+  JoinType join_type_;
+  Vector<JoinNode::InputColumnRef> input_map_;
+  Vector<ValueExpression> select_exprs_;
+  Vector<ValueExpression> key_exprs_[2];
+  Option<ValueExpression> join_cond_expr_;
+  Option<ValueExpression> where_expr_;
+  ScopedPtr<ResultCursor> input_[2];
+  size_t row_width_[2];
+  Vector<SValue> inbuf_;
+  bool started_;
+  Vector<SValue> base_row_;
+  String base_key_;
+  bool base_has_key_;
+  String prev_base_key_;
+  bool base_active_;
+  bool base_matched_;
+  Vector<SValue> joined_row_;
+  String joined_key_;
+  bool joined_valid_;
+  Vector<Vector<SValue>> run_;
+  String run_key_;
+  bool run_valid_;
+  size_t run_pos_;
+  MemoryReservation memory_;
+  AbortCheck abort_check_;
+};
+
+class MergeJoinFactory : public TaskFactory {
+public:
+
+  MergeJoinFactory(
+      JoinType join_type,
+      const Set<TaskID>& base_tbl_ids,
+      const Set<TaskID>& joined_tbl_ids,
+      const Vector<JoinNode::InputColumnRef>& input_map,
+      Vector<RefPtr<SelectListNode>> select_exprs,
+      Vector<JoinNode::EquiJoinKey> join_keys,
+      Option<RefPtr<ValueExpressionNode>> join_cond_expr,
+      Option<RefPtr<ValueExpressionNode>> where_expr);
+
+  RefPtr<Task> build(
+      Transaction* txn,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input) const override;
+
+  bool requiresSortedInput() const override;
+
+protected:
+  JoinType join_type_;
+  Set<TaskID> base_tbl_ids_;
+  Set<TaskID> joined_tbl_ids_;
+  Vector<JoinNode::InputColumnRef> input_map_;
+  Vector<RefPtr<SelectListNode>> select_exprs_;
+  Vector<JoinNode::EquiJoinKey> join_keys_;
+  Option<RefPtr<ValueExpressionNode>> join_cond_expr_;
+  Option<RefPtr<ValueExpressionNode>> where_expr_;
+};
+
+}
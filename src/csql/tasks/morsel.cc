@@ -0,0 +1,134 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <csql/tasks/morsel.h>
+#include <csql/tasks/tablescan.h>
+
+using namespace stx;
+
+namespace csql {
+
+TableIteratorMorselSource::TableIteratorMorselSource(
+    RefPtr<SequentialScanNode> stmt,
+    ScopedPtr<TableIterator> iter,
+    const Option<RuntimeFilterSpec>& runtime_filter) :
+    stmt_(stmt),
+    iter_(std::move(iter)),
+    runtime_filter_(runtime_filter),
+    num_columns_(iter_->numColumns()),
+    num_cursors_(0),
+    done_(false) {}
+
+PipelineStage* TableIteratorMorselSource::buildStage(
+    Transaction* txn) {
+  return new TableScanStage(txn, stmt_, iter_.get(), runtime_filter_);
+}
+
+ScopedPtr<ResultCursor> TableIteratorMorselSource::openCursor() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  ++num_cursors_;
+  return mkScoped<ResultCursor>(new MorselCursor(this));
+}
+
+size_t TableIteratorMorselSource::numColumns() const {
+  return num_columns_;
+}
+
+bool TableIteratorMorselSource::readMorsel(
+    Vector<SValue>* rows,
+    size_t* num_rows) {
+  rows->resize(kMorselSize * num_columns_);
+  *num_rows = 0;
+
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (!done_ && *num_rows < kMorselSize) {
+    auto row = rows->data() + *num_rows * num_columns_;
+    if (!iter_->nextRow(row)) {
+      closeIterator();
+      break;
+    }
+
+    ++*num_rows;
+  }
+
+  return *num_rows > 0;
+}
+
+void TableIteratorMorselSource::closeCursor() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  if (--num_cursors_ > 0 || done_) {
+    return;
+  }
+
+  closeIterator();
+}
+
+void TableIteratorMorselSource::closeIterator() {
+  done_ = true;
+  iter_->close();
+
+  if (stats_) {
+    stats_->bytes_read += iter_->bytesRead();
+  }
+}
+
+size_t PassThroughStage::numInputColumns(size_t num_output_columns) const {
+  return num_output_columns;
+}
+
+bool PassThroughStage::process(
+    const SValue* row,
+    int row_len,
+    SValue* out,
+    int out_len) {
+  std::copy(row, row + std::min(row_len, out_len), out);
+  return true;
+}
+
+MorselCursor::MorselCursor(
+    RefPtr<TableIteratorMorselSource> source) :
+    source_(source),
+    num_rows_(0),
+    pos_(0),
+    closed_(false) {}
+
+MorselCursor::~MorselCursor() {
+  close();
+}
+
+bool MorselCursor::next(SValue* row, int row_len) {
+  if (closed_) {
+    return false;
+  }
+
+  if (pos_ == num_rows_) {
+    pos_ = 0;
+    if (!source_->readMorsel(&rows_, &num_rows_)) {
+      close();
+      return false;
+    }
+  }
+
+  auto ncols = source_->numColumns();
+  auto src = rows_.data() + pos_++ * ncols;
+  std::move(src, src + std::min(ncols, size_t(row_len)), row);
+  return true;
+}
+
+void MorselCursor::close() {
+  if (closed_) {
+    return;
+  }
+
+  closed_ = true;
+  source_->closeCursor();
+}
+
+}
@@ -0,0 +1,156 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <mutex>
+#include <stx/stdtypes.h>
+#include <stx/autoref.h>
+#include <csql/svalue.h>
+#include <csql/result_cursor.h>
+#include <csql/tasks/pipeline.h>
+#include <csql/runtime/RuntimeFilter.h>
+#include <csql/runtime/TaskStats.h>
+
+using namespace stx;
+
+namespace csql {
+class Transaction;
+class TableIterator;
+class SequentialScanNode;
+
+/**
+ * Splits the rows of a task into morsels that are processed by multiple
+ * workers. Each worker reads morsels from its own cursor (see openCursor) and
+ * pushes the rows through its own pipeline, so a worker that is done with its
+ * morsel early simply takes the next one and skewed morsels don't hold up the
+ * other workers
+ */
+class MorselSource : public RefCounted {
+public:
+
+  MorselSource() : stats_(nullptr) {}
+  virtual ~MorselSource() {}
+
+  /**
+   * Count the bytes read by all cursors in the stats of the source task. Must
+   * be called before any cursor is opened
+   */
+  void setStats(TaskStats* stats) {
+    stats_ = stats;
+  }
+
+  TaskStats* stats() const {
+    return stats_;
+  }
+
+  /**
+   * Build the stage that processes the rows of each morsel. Each worker needs
+   * its own stage. Must be called before any cursor is read
+   */
+  virtual PipelineStage* buildStage(Transaction* txn) = 0;
+
+  /**
+   * Returns a new cursor for one worker
+   */
+  virtual ScopedPtr<ResultCursor> openCursor() = 0;
+
+protected:
+  TaskStats* stats_;
+};
+
+/**
+ * Splits the rows of a TableIterator into morsels of up to kMorselSize rows.
+ *
+ * Reading a morsel from the table iterator is serialized, evaluating the
+ * WHERE expression, the select list and all fused stages on it is not
+ */
+class TableIteratorMorselSource : public MorselSource {
+public:
+
+  static const size_t kMorselSize = 1024;
+
+  TableIteratorMorselSource(
+      RefPtr<SequentialScanNode> stmt,
+      ScopedPtr<TableIterator> iter,
+      const Option<RuntimeFilterSpec>& runtime_filter =
+          None<RuntimeFilterSpec>());
+
+  /**
+   * Builds a TableScanStage
+   */
+  PipelineStage* buildStage(Transaction* txn) override;
+
+  /**
+   * The table iterator is closed once all cursors have been closed or the
+   * last morsel has been read
+   */
+  ScopedPtr<ResultCursor> openCursor() override;
+
+  size_t numColumns() const;
+
+  /**
+   * Read the next morsel into rows. Returns false once all rows have been
+   * read
+   */
+  bool readMorsel(Vector<SValue>* rows, size_t* num_rows);
+
+  void closeCursor();
+
+protected:
+
+  /**
+   * Closes the table iterator and counts the bytes it read. Must be called
+   * with the mutex held
+   */
+  void closeIterator();
+
+  RefPtr<SequentialScanNode> stmt_;
+  ScopedPtr<TableIterator> iter_;
+  Option<RuntimeFilterSpec> runtime_filter_;
+  size_t num_columns_;
+  std::mutex mutex_;
+  size_t num_cursors_;
+  bool done_;
+};
+
+/**
+ * Passes the rows through unchanged. Used as the worker stage of morsel
+ * sources whose cursors already return the output rows of the scan
+ */
+class PassThroughStage : public PipelineStage {
+public:
+
+  size_t numInputColumns(size_t num_output_columns) const override;
+
+  bool process(
+      const SValue* row,
+      int row_len,
+      SValue* out,
+      int out_len) override;
+
+};
+
+class MorselCursor : public ResultCursor {
+public:
+
+  MorselCursor(RefPtr<TableIteratorMorselSource> source);
+  ~MorselCursor();
+
+  bool next(SValue* row, int row_len) override;
+  void close() override;
+
+protected:
+  RefPtr<TableIteratorMorselSource> source_;
+  Vector<SValue> rows_;
+  size_t num_rows_;
+  size_t pos_;
+  bool closed_;
+};
+
+}
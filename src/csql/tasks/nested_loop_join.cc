@@ -7,10 +7,24 @@
  * copy of the GNU General Public License along with this program. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
 #include <csql/tasks/nested_loop_join.h>
 
 namespace csql {
 
+const size_t NestedLoopJoin::kBlockBytes = 256 * 1024;
+
+static const size_t kMaxInMemoryRows = 1000000;
+
+static size_t estimateRowSize(const Vector<SValue>& row) {
+  size_t size = 0;
+  for (const auto& val : row) {
+    size += val.getMemoryUsage();
+  }
+
+  return size;
+}
+
 NestedLoopJoin::NestedLoopJoin(
     Transaction* txn,
     JoinType join_type,
@@ -23,291 +37,415 @@ NestedLoopJoin::NestedLoopJoin(
     HashMap<TaskID, ScopedPtr<ResultCursor>> input) :
     txn_(txn),
     join_type_(join_type),
-    base_tbl_ids_(base_tbl_ids),
-    joined_tbl_ids_(joined_tbl_ids),
     input_map_(input_map),
     select_exprs_(std::move(select_expressions)),
     join_cond_expr_(std::move(join_cond_expr)),
-    where_expr_(std::move(where_expr)) {}
+    where_expr_(std::move(where_expr)),
+    inner_side_(1),
+    outer_side_(0),
+    has_range_index_(false),
+    range_column_idx_(0),
+    inner_read_(false),
+    inner_count_(0),
+    inner_block_rows_(1),
+    inner_unmatched_pos_(0),
+    outer_count_(0),
+    outer_unmatched_pos_(0),
+    outer_done_(false),
+    block_active_(false),
+    inner_block_begin_(0),
+    outer_pos_(0),
+    inner_pos_(0),
+    outer_row_loaded_(false),
+    inbuf_(input_map.size(), SValue{}),
+    memory_(txn->getMemoryTracker()),
+    abort_check_(txn) {
+  Vector<ScopedPtr<ResultCursor>> cursors[2];
+  for (auto& in : input) {
+    if (base_tbl_ids.count(in.first) > 0) {
+      cursors[0].emplace_back(std::move(in.second));
+    } else if (joined_tbl_ids.count(in.first) > 0) {
+      cursors[1].emplace_back(std::move(in.second));
+    } else {
+      RAISE(kIllegalStateError, "nested loop join: unknown input task");
+    }
+  }
 
-static const size_t kMaxInMemoryRows = 1000000;
+  for (size_t side = 0; side < 2; ++side) {
+    input_[side] = mkScoped(new ResultCursorList(std::move(cursors[side])));
+    row_width_[side] = 1;
+  }
 
-bool NestedLoopJoin::nextRow(SValue* out, int out_len) {
-  return false;
+  for (const auto& m : input_map_) {
+    if (m.table_idx > 1) {
+      RAISE(kRuntimeError, "invalid table index");
+    }
+
+    row_width_[m.table_idx] = std::max(
+        row_width_[m.table_idx],
+        m.column_idx + 1);
+  }
 }
 
-//bool NestedLoopJoin::onInputRow(
-//    const TaskID& input_id,
-//    const SValue* row,
-//    int row_len) {
-//  if (base_tbl_ids_.count(input_id) > 0) {
-//    base_tbl_.emplace_back(row, row + row_len);
-//    if (base_tbl_.size() >= kMaxInMemoryRows) {
-//      RAISE(
-//          kRuntimeError,
-//          "Nested Loop JOIN intermediate result set is too large, try using an"
-//          " equi-join instead.");
-//    }
-//    return true;
-//  }
-//
-//  if (joined_tbl_ids_.count(input_id) > 0) {
-//    joined_tbl_.emplace_back(row, row + row_len);
-//    if (joined_tbl_.size() >= kMaxInMemoryRows) {
-//      RAISE(
-//          kRuntimeError,
-//          "Nested Loop JOIN intermediate result set is too large, try using an"
-//          " equi-join instead.");
-//    }
-//    return true;
-//  }
-//
-//  RAISE(kIllegalStateError);
-//}
-//
-//void NestedLoopJoin::onInputsReady() {
-//  switch (join_type_) {
-//    case JoinType::OUTER:
-//      executeOuterJoin();
-//      break;
-//    case JoinType::INNER:
-//      if (join_cond_expr_.isEmpty()) {
-//        /* fallthrough */
-//      } else {
-//        executeInnerJoin();
-//        break;
-//      }
-//    case JoinType::CARTESIAN:
-//      executeCartesianJoin();
-//      break;
-//  }
-//
-//  base_tbl_.clear();
-//  joined_tbl_.clear();
-//}
-
-void NestedLoopJoin::executeCartesianJoin() {
-  Vector<SValue> outbuf(select_exprs_.size(), SValue{});
-  Vector<SValue> inbuf(input_map_.size(), SValue{});
-
-  for (const auto& r1 : base_tbl_) {
-    for (const auto& r2 : joined_tbl_) {
-
-      for (size_t i = 0; i < input_map_.size(); ++i) {
-        const auto& m = input_map_[i];
-
-        switch (m.table_idx) {
-          case 0:
-            inbuf[i] = r1[m.column_idx];
-            break;
-          case 1:
-            inbuf[i] = r2[m.column_idx];
-            break;
-          default:
-            RAISE(kRuntimeError, "invalid table index");
-        }
-      }
+void NestedLoopJoin::setRangeIndex(
+    size_t table_idx,
+    size_t column_idx,
+    Vector<ValueExpression> lower_bounds,
+    Vector<ValueExpression> upper_bounds) {
+  if (table_idx > 1) {
+    RAISE(kRuntimeError, "invalid table index");
+  }
+
+  if (inner_read_) {
+    RAISE(kIllegalStateError, "nested loop join has already been started");
+  }
 
-      if (!where_expr_.isEmpty()) {
-        SValue pred;
-        VM::evaluate(
-            txn_,
-            where_expr_.get().program(),
-            inbuf.size(),
-            inbuf.data(),
-            &pred);
-
-        if (!pred.getBool()) {
-          continue;
+  inner_side_ = table_idx;
+  outer_side_ = 1 - table_idx;
+  has_range_index_ = true;
+  range_column_idx_ = column_idx;
+  lower_bounds_ = std::move(lower_bounds);
+  upper_bounds_ = std::move(upper_bounds);
+  row_width_[table_idx] = std::max(row_width_[table_idx], column_idx + 1);
+}
+
+bool NestedLoopJoin::nextRow(SValue* out, int out_len) {
+  if (!inner_read_) {
+    input_[0]->prefetch(row_width_[0]);
+    input_[1]->prefetch(row_width_[1]);
+    readInnerTable();
+    inner_read_ = true;
+  }
+
+  for (;;) {
+    if (block_active_) {
+      /* join the outer block with one inner block at a time */
+      while (inner_block_begin_ < inner_count_) {
+        auto inner_block_end = std::min(
+            inner_block_begin_ + inner_block_rows_,
+            inner_count_);
+
+        while (outer_pos_ < outer_count_) {
+          const auto& range = outer_ranges_[outer_pos_];
+          if (!outer_row_loaded_) {
+            loadInputRow(
+                outer_side_,
+                &outer_rows_[outer_pos_ * row_width_[outer_side_]]);
+
+            inner_pos_ = std::max(range.first, inner_block_begin_);
+            outer_row_loaded_ = true;
+          }
+
+          auto inner_end = std::min(range.second, inner_block_end);
+          while (inner_pos_ < inner_end) {
+            abort_check_.tick();
+            auto idx = inner_pos_++;
+            loadInputRow(
+                inner_side_,
+                &inner_rows_[idx * row_width_[inner_side_]]);
+
+            if (!evaluatePredicate(join_cond_expr_) ||
+                !evaluatePredicate(where_expr_)) {
+              continue;
+            }
+
+            if (!outer_matched_.empty()) {
+              outer_matched_[outer_pos_] = true;
+            }
+
+            if (!inner_matched_.empty()) {
+              inner_matched_[idx] = true;
+            }
+
+            evaluateSelectList(out, out_len);
+            return true;
+          }
+
+          ++outer_pos_;
+          outer_row_loaded_ = false;
         }
+
+        outer_pos_ = 0;
+        inner_block_begin_ = inner_block_end;
       }
 
-      for (int i = 0; i < select_exprs_.size(); ++i) {
-        VM::evaluate(
-            txn_,
-            select_exprs_[i].program(),
-            inbuf.size(),
-            inbuf.data(),
-            &outbuf[i]);
+      if (emitUnmatchedOuterRow(out, out_len)) {
+        return true;
       }
 
-      //if (!input_(outbuf.data(), outbuf.size()))  {
-      //  return;
-      //}
+      block_active_ = false;
+    }
+
+    if (!outer_done_ && readOuterBlock()) {
+      block_active_ = true;
+      inner_block_begin_ = 0;
+      outer_pos_ = 0;
+      outer_row_loaded_ = false;
+      continue;
     }
+
+    outer_done_ = true;
+    return emitUnmatchedInnerRow(out, out_len);
   }
 }
 
-void NestedLoopJoin::executeInnerJoin() {
-  Vector<SValue> outbuf(select_exprs_.size(), SValue{});
-  Vector<SValue> inbuf(input_map_.size(), SValue{});
-
-  for (const auto& r1 : base_tbl_) {
-    for (const auto& r2 : joined_tbl_) {
-
-      for (size_t i = 0; i < input_map_.size(); ++i) {
-        const auto& m = input_map_[i];
-
-        switch (m.table_idx) {
-          case 0:
-            inbuf[i] = r1[m.column_idx];
-            break;
-          case 1:
-            inbuf[i] = r2[m.column_idx];
-            break;
-          default:
-            RAISE(kRuntimeError, "invalid table index");
-        }
-      }
+void NestedLoopJoin::close() {
+  input_[0]->close();
+  input_[1]->close();
+}
 
-      {
-        SValue pred;
-        VM::evaluate(
-            txn_,
-            join_cond_expr_.get().program(),
-            inbuf.size(),
-            inbuf.data(),
-            &pred);
-
-        if (!pred.getBool()) {
-          continue;
-        }
-      }
+void NestedLoopJoin::collectStats(TaskStats* stats) const {
+  stats->updatePeakMemory(memory_.peakBytes());
+}
 
-      if (!where_expr_.isEmpty()) {
-        SValue pred;
-        VM::evaluate(
-            txn_,
-            where_expr_.get().program(),
-            inbuf.size(),
-            inbuf.data(),
-            &pred);
-
-        if (!pred.getBool()) {
-          continue;
-        }
-      }
+void NestedLoopJoin::readInnerTable() {
+  Vector<SValue> row;
+  size_t bytes = 0;
+  while (readRow(inner_side_, &row)) {
+    abort_check_.tick();
+    auto row_size = estimateRowSize(row);
+    memory_.grow(row_size);
+    bytes += row_size;
+
+    for (auto& val : row) {
+      inner_rows_.emplace_back(std::move(val));
+    }
 
-      for (int i = 0; i < select_exprs_.size(); ++i) {
-        VM::evaluate(
-            txn_,
-            select_exprs_[i].program(),
-            inbuf.size(),
-            inbuf.data(),
-            &outbuf[i]);
-      }
+    if (++inner_count_ >= kMaxInMemoryRows) {
+      RAISE(
+          kRuntimeError,
+          "Nested Loop JOIN intermediate result set is too large, try using an"
+          " equi-join instead.");
+    }
+  }
+
+  /* half of the block budget is used for the inner block */
+  if (inner_count_ > 0) {
+    auto row_size = std::max(bytes / inner_count_, size_t(1));
+    inner_block_rows_ = std::max((kBlockBytes / 2) / row_size, size_t(1));
+  }
 
-      //if (!input_(outbuf.data(), outbuf.size()))  {
-      //  return;
-      //}
+  if (has_range_index_) {
+    buildRangeIndex();
+  }
+
+  if (join_type_ == JoinType::OUTER && inner_side_ == 0) {
+    inner_matched_.assign(inner_count_, false);
+  }
+}
+
+void NestedLoopJoin::buildRangeIndex() {
+  auto row_width = row_width_[inner_side_];
+
+  /* comparisons only follow the numeric order if all values are numbers */
+  Vector<double> keys(inner_count_);
+  for (size_t i = 0; i < inner_count_; ++i) {
+    const auto& val = inner_rows_[i * row_width + range_column_idx_];
+    switch (val.getType()) {
+      case SQL_INTEGER:
+      case SQL_FLOAT:
+      case SQL_TIMESTAMP:
+        keys[i] = val.getFloat();
+        break;
+      default:
+        has_range_index_ = false;
+        return;
     }
   }
+
+  Vector<size_t> order(inner_count_);
+  for (size_t i = 0; i < inner_count_; ++i) {
+    order[i] = i;
+  }
+
+  std::stable_sort(
+      order.begin(),
+      order.end(),
+      [&keys] (size_t a, size_t b) {
+    return keys[a] < keys[b];
+  });
+
+  Vector<SValue> sorted_rows;
+  sorted_rows.reserve(inner_rows_.size());
+  inner_keys_.reserve(inner_count_);
+  for (auto idx : order) {
+    for (size_t i = 0; i < row_width; ++i) {
+      sorted_rows.emplace_back(std::move(inner_rows_[idx * row_width + i]));
+    }
+
+    inner_keys_.emplace_back(keys[idx]);
+  }
+
+  inner_rows_ = std::move(sorted_rows);
 }
 
-void NestedLoopJoin::executeOuterJoin() {
-  Vector<SValue> outbuf(select_exprs_.size(), SValue{});
-  Vector<SValue> inbuf(input_map_.size(), SValue{});
-
-  for (const auto& r1 : base_tbl_) {
-    bool match = false;
-
-    for (const auto& r2 : joined_tbl_) {
-      for (size_t i = 0; i < input_map_.size(); ++i) {
-        const auto& m = input_map_[i];
-
-        switch (m.table_idx) {
-          case 0:
-            inbuf[i] = r1[m.column_idx];
-            break;
-          case 1:
-            inbuf[i] = r2[m.column_idx];
-            break;
-          default:
-            RAISE(kRuntimeError, "invalid table index");
-        }
-      }
+bool NestedLoopJoin::readOuterBlock() {
+  outer_rows_.clear();
+  outer_count_ = 0;
 
-      {
-        SValue pred;
-        VM::evaluate(
-            txn_,
-            join_cond_expr_.get().program(),
-            inbuf.size(),
-            inbuf.data(),
-            &pred);
-
-        if (!pred.getBool()) {
-          continue;
-        }
+  /* the other half of the block budget is used for the outer block */
+  Vector<SValue> row;
+  size_t bytes = 0;
+  while (bytes < kBlockBytes / 2 && readRow(outer_side_, &row)) {
+    abort_check_.tick();
+    bytes += estimateRowSize(row);
+
+    for (auto& val : row) {
+      outer_rows_.emplace_back(std::move(val));
+    }
+
+    ++outer_count_;
+  }
+
+  if (outer_count_ == 0) {
+    return false;
+  }
+
+  if (join_type_ == JoinType::OUTER && outer_side_ == 0) {
+    outer_matched_.assign(outer_count_, false);
+    outer_unmatched_pos_ = 0;
+  }
+
+  computeInnerRanges();
+  return true;
+}
+
+void NestedLoopJoin::computeInnerRanges() {
+  outer_ranges_.assign(outer_count_, std::make_pair(size_t(0), inner_count_));
+  if (!has_range_index_) {
+    return;
+  }
+
+  for (size_t i = 0; i < outer_count_; ++i) {
+    loadInputRow(outer_side_, &outer_rows_[i * row_width_[outer_side_]]);
+
+    /* the bounds are inclusive so that the range is a superset of all rows
+       that match the condition */
+    auto& range = outer_ranges_[i];
+    for (const auto& expr : lower_bounds_) {
+      double bound;
+      if (evaluateBound(expr, &bound)) {
+        range.first = std::max(
+            range.first,
+            size_t(
+                std::lower_bound(inner_keys_.begin(), inner_keys_.end(), bound)
+                - inner_keys_.begin()));
       }
+    }
 
-      if (!where_expr_.isEmpty()) {
-        SValue pred;
-        VM::evaluate(
-            txn_,
-            where_expr_.get().program(),
-            inbuf.size(),
-            inbuf.data(),
-            &pred);
-
-        if (!pred.getBool()) {
-          continue;
-        }
+    for (const auto& expr : upper_bounds_) {
+      double bound;
+      if (evaluateBound(expr, &bound)) {
+        range.second = std::min(
+            range.second,
+            size_t(
+                std::upper_bound(inner_keys_.begin(), inner_keys_.end(), bound)
+                - inner_keys_.begin()));
       }
+    }
 
-      match = true;
+    if (range.first > range.second) {
+      range.first = range.second;
+    }
+  }
+}
 
-      for (int i = 0; i < select_exprs_.size(); ++i) {
-        VM::evaluate(
-            txn_,
-            select_exprs_[i].program(),
-            inbuf.size(),
-            inbuf.data(),
-            &outbuf[i]);
-      }
+bool NestedLoopJoin::evaluateBound(const ValueExpression& expr, double* bound) {
+  SValue val;
+  VM::evaluate(txn_, expr.program(), inbuf_.size(), inbuf_.data(), &val);
+
+  switch (val.getType()) {
+    case SQL_INTEGER:
+    case SQL_FLOAT:
+    case SQL_TIMESTAMP:
+      *bound = val.getFloat();
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool NestedLoopJoin::emitUnmatchedOuterRow(SValue* out, int out_len) {
+  if (outer_matched_.empty()) {
+    return false;
+  }
 
-      //if (!input_(outbuf.data(), outbuf.size()))  {
-      //  return;
-      //}
+  while (outer_unmatched_pos_ < outer_count_) {
+    auto idx = outer_unmatched_pos_++;
+    if (outer_matched_[idx]) {
+      continue;
     }
 
-    if (!match) {
-      for (size_t i = 0; i < input_map_.size(); ++i) {
-        const auto& m = input_map_[i];
+    loadInputRow(0, &outer_rows_[idx * row_width_[0]]);
+    loadInputRow(1, nullptr);
 
-        if (m.table_idx != 0) {
-          inbuf[i] = SValue();
-        }
-      }
+    if (evaluatePredicate(where_expr_)) {
+      evaluateSelectList(out, out_len);
+      return true;
+    }
+  }
 
-      if (!where_expr_.isEmpty()) {
-        SValue pred;
-        VM::evaluate(
-            txn_,
-            where_expr_.get().program(),
-            inbuf.size(),
-            inbuf.data(),
-            &pred);
-
-        if (!pred.getBool()) {
-          continue;
-        }
-      }
+  return false;
+}
 
-      for (int i = 0; i < select_exprs_.size(); ++i) {
-        VM::evaluate(
-            txn_,
-            select_exprs_[i].program(),
-            inbuf.size(),
-            inbuf.data(),
-            &outbuf[i]);
-      }
+bool NestedLoopJoin::emitUnmatchedInnerRow(SValue* out, int out_len) {
+  while (inner_unmatched_pos_ < inner_matched_.size()) {
+    auto idx = inner_unmatched_pos_++;
+    if (inner_matched_[idx]) {
+      continue;
+    }
+
+    loadInputRow(0, &inner_rows_[idx * row_width_[0]]);
+    loadInputRow(1, nullptr);
 
-      //if (!input_(outbuf.data(), outbuf.size()))  {
-      //  return;
-      //}
+    if (evaluatePredicate(where_expr_)) {
+      evaluateSelectList(out, out_len);
+      return true;
     }
   }
+
+  return false;
+}
+
+bool NestedLoopJoin::readRow(size_t side, Vector<SValue>* row) {
+  row->resize(row_width_[side]);
+  return input_[side]->next(row->data(), row->size());
+}
+
+void NestedLoopJoin::loadInputRow(size_t side, const SValue* row) {
+  for (size_t i = 0; i < input_map_.size(); ++i) {
+    const auto& m = input_map_[i];
+    if (m.table_idx == side) {
+      inbuf_[i] = row ? row[m.column_idx] : SValue();
+    }
+  }
+}
+
+bool NestedLoopJoin::evaluatePredicate(const Option<ValueExpression>& expr) {
+  if (expr.isEmpty()) {
+    return true;
+  }
+
+  SValue pred;
+  VM::evaluate(
+      txn_,
+      expr.get().program(),
+      inbuf_.size(),
+      inbuf_.data(),
+      &pred);
+
+  return pred.getBool();
+}
+
+void NestedLoopJoin::evaluateSelectList(SValue* out, int out_len) {
+  for (int i = 0; i < select_exprs_.size() && i < out_len; ++i) {
+    VM::evaluate(
+        txn_,
+        select_exprs_[i].program(),
+        inbuf_.size(),
+        inbuf_.data(),
+        &out[i]);
+  }
 }
 
 NestedLoopJoinFactory::NestedLoopJoinFactory(
@@ -326,6 +464,11 @@ NestedLoopJoinFactory::NestedLoopJoinFactory(
     join_cond_expr_(join_cond_expr),
     where_expr_(where_expr) {}
 
+void NestedLoopJoinFactory::setRangeIndex(
+    const JoinNode::RangeJoinBounds& bounds) {
+  range_bounds_ = Some(bounds);
+}
+
 RefPtr<Task> NestedLoopJoinFactory::build(
     Transaction* txn,
     HashMap<TaskID, ScopedPtr<ResultCursor>> input) const {
@@ -349,7 +492,7 @@ RefPtr<Task> NestedLoopJoinFactory::build(
         qbuilder->buildValueExpression(txn, where_expr_.get())));
   }
 
-  return new NestedLoopJoin(
+  auto join = new NestedLoopJoin(
       txn,
       join_type_,
       base_tbl_ids_,
@@ -359,6 +502,28 @@ RefPtr<Task> NestedLoopJoinFactory::build(
       std::move(join_cond_expr),
       std::move(where_expr),
       std::move(input));
+
+  if (!range_bounds_.isEmpty()) {
+    const auto& bounds = range_bounds_.get();
+
+    Vector<ValueExpression> lower_bounds;
+    for (const auto& e : bounds.lower_bounds) {
+      lower_bounds.emplace_back(qbuilder->buildValueExpression(txn, e));
+    }
+
+    Vector<ValueExpression> upper_bounds;
+    for (const auto& e : bounds.upper_bounds) {
+      upper_bounds.emplace_back(qbuilder->buildValueExpression(txn, e));
+    }
+
+    join->setRangeIndex(
+        bounds.table_idx,
+        bounds.column_idx,
+        std::move(lower_bounds),
+        std::move(upper_bounds));
+  }
+
+  return join;
 }
 
 }
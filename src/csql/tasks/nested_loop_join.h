@@ -9,15 +9,33 @@
  */
 #pragma once
 #include <stx/stdtypes.h>
+#include <csql/Transaction.h>
 #include <csql/tasks/Task.h>
 #include <csql/runtime/defaultruntime.h>
+#include <csql/runtime/MemoryTracker.h>
 #include <csql/qtree/JoinNode.h>
 
 namespace csql {
 
+/**
+ * Executes a CARTESIAN, INNER or (left) OUTER join with an arbitrary join
+ * condition as a block nested loop join. One input (the inner table) is
+ * materialized into a contiguous row buffer; the other (outer) input is
+ * streamed in blocks. Every outer block is joined with the inner table one
+ * inner block at a time, with both blocks sized to fit into kBlockBytes
+ * (roughly the L2 cache). The outer row is loaded once per inner block and
+ * the join condition is then evaluated against all rows of the block.
+ *
+ * If a range index is set (see setRangeIndex), the inner table is sorted on
+ * the indexed column and each outer row is only joined with the inner rows
+ * whose value lies within the lower and upper bounds computed from the outer
+ * row. The full join condition is still evaluated on each candidate pair.
+ */
 class NestedLoopJoin : public Task {
 public:
 
+  static const size_t kBlockBytes;
+
   NestedLoopJoin(
       Transaction* txn,
       JoinType join_type,
@@ -29,33 +47,74 @@ public:
       Option<ValueExpression> where_expr,
       HashMap<TaskID, ScopedPtr<ResultCursor>> input);
 
-  //bool onInputRow(
-  //    const TaskID& input_id,
-  //    const SValue* row,
-  //    int row_len) override;
-
-  //void onInputsReady() override;
+  /**
+   * Use the column with index column_idx of the base (table_idx = 0) or
+   * joined (table_idx = 1) table as the inner table range index. The lower
+   * and upper bound expressions are evaluated on the other table's rows.
+   * Must be called before the first row is read
+   */
+  void setRangeIndex(
+      size_t table_idx,
+      size_t column_idx,
+      Vector<ValueExpression> lower_bounds,
+      Vector<ValueExpression> upper_bounds);
 
   bool nextRow(SValue* out, int out_len) override;
+  void close() override;
+
+  void collectStats(TaskStats* stats) const override;
 
 protected:
 
-  void executeCartesianJoin();
-  void executeInnerJoin();
-  void executeOuterJoin();
+  void readInnerTable();
+  void buildRangeIndex();
+  bool readOuterBlock();
+  void computeInnerRanges();
+  bool evaluateBound(const ValueExpression& expr, double* bound);
+
+  bool emitUnmatchedOuterRow(SValue* out, int out_len);
+  bool emitUnmatchedInnerRow(SValue* out, int out_len);
+
+  bool readRow(size_t side, Vector<SValue>* row);
+  void loadInputRow(size_t side, const SValue* row);
+  bool evaluatePredicate(const Option<ValueExpression>& expr);
+  void evaluateSelectList(SValue* out, int out_len);
 
   Transaction* txn_;
   JoinType join_type_;
-  Set<TaskID> base_tbl_ids_;
-  Set<TaskID> joined_tbl_ids_;
   Vector<JoinNode::InputColumnRef> input_map_;
-  Vector<String> column_names_;
   Vector<ValueExpression> select_exprs_;
   Option<ValueExpression> join_cond_expr_;
   Option<ValueExpression> where_expr_;
-  HashMap<TaskID, ScopedPtr<ResultCursor>> input_;
-  List<Vector<SValue>> base_tbl_;
-  List<Vector<SValue>> joined_tbl_;
+  ScopedPtr<ResultCursor> input_[2];
+  size_t row_width_[2];
+  size_t inner_side_;
+  size_t outer_side_;
+  bool has_range_index_;
+  size_t range_column_idx_;
+  Vector<ValueExpression> lower_bounds_;
+  Vector<ValueExpression> upper_bounds_;
+  bool inner_read_;
+  Vector<SValue> inner_rows_;
+  size_t inner_count_;
+  size_t inner_block_rows_;
+  Vector<double> inner_keys_;
+  Vector<bool> inner_matched_;
+  size_t inner_unmatched_pos_;
+  Vector<SValue> outer_rows_;
+  size_t outer_count_;
+  Vector<std::pair<size_t, size_t>> outer_ranges_;
+  Vector<bool> outer_matched_;
+  size_t outer_unmatched_pos_;
+  bool outer_done_;
+  bool block_active_;
+  size_t inner_block_begin_;
+  size_t outer_pos_;
+  size_t inner_pos_;
+  bool outer_row_loaded_;
+  Vector<SValue> inbuf_;
+  MemoryReservation memory_;
+  AbortCheck abort_check_;
 };
 
 class NestedLoopJoinFactory  : public TaskFactory {
@@ -70,6 +129,8 @@ public:
       Option<RefPtr<ValueExpressionNode>> join_cond_expr,
       Option<RefPtr<ValueExpressionNode>> where_expr);
 
+  void setRangeIndex(const JoinNode::RangeJoinBounds& bounds);
+
   RefPtr<Task> build(
       Transaction* txn,
       HashMap<TaskID, ScopedPtr<ResultCursor>> input) const override;
@@ -82,6 +143,7 @@ protected:
   Vector<RefPtr<SelectListNode>> select_exprs_;
   Option<RefPtr<ValueExpressionNode>> join_cond_expr_;
   Option<RefPtr<ValueExpressionNode>> where_expr_;
+  Option<JoinNode::RangeJoinBounds> range_bounds_;
 };
 
 }
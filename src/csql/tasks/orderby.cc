@@ -8,13 +8,30 @@
  * <http://www.gnu.org/licenses/>.
  */
 #include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <string.h>
 #include <csql/tasks/orderby.h>
-#include <csql/expressions/boolean.h>
+#include <csql/runtime/SortKey.h>
 #include <csql/runtime/runtime.h>
-#include <stx/inspect.h>
 
 namespace csql {
 
+const size_t OrderBy::kMinRowsPerPartition = 65536;
+const size_t OrderBy::kMaxPartitions = 64;
+const size_t OrderBy::kRadixSortCutoff = 64;
+const size_t OrderBy::kMaxRadixSortDepth = 8;
+
+static size_t estimateRowSize(const Vector<SValue>& row) {
+  size_t size = sizeof(row);
+  for (const auto& val : row) {
+    size += val.getMemoryUsage();
+  }
+
+  return size;
+}
+
 OrderBy::OrderBy(
     Transaction* ctx,
     Vector<SortExpr> sort_specs,
@@ -23,75 +40,308 @@ OrderBy::OrderBy(
     ctx_(ctx),
     sort_specs_(std::move(sort_specs)),
     num_columns_(num_columns),
-    input_(new ResultCursorList(std::move(input))) {
+    input_(new ResultCursorList(std::move(input))),
+    executed_(false),
+    pos_(0),
+    memory_(ctx->getMemoryTracker()),
+    abort_check_(ctx) {
   if (sort_specs_.size() == 0) {
     RAISE(kIllegalArgumentError, "can't execute ORDER BY: no sort specs");
   }
 }
 
 bool OrderBy::nextRow(SValue* out, int out_len) {
-  return false;
+  if (!executed_) {
+    execute();
+    executed_ = true;
+  }
+
+  if (pos_ >= rows_.size()) {
+    rows_.clear();
+    memory_.resize(0);
+    return false;
+  }
+
+  const auto& row = rows_[pos_++].row;
+  for (size_t i = 0; i < row.size() && i < out_len; ++i) {
+    out[i] = row[i];
+  }
+
+  return true;
+}
+
+void OrderBy::close() {
+  input_->close();
+}
+
+void OrderBy::collectStats(TaskStats* stats) const {
+  stats->updatePeakMemory(memory_.peakBytes());
+}
+
+void OrderBy::execute() {
+  Vector<SValue> row(num_columns_);
+  while (input_->next(row.data(), row.size())) {
+    abort_check_.tick();
+    memory_.grow(estimateRowSize(row));
+
+    SortedRow srow;
+    srow.row = row;
+    rows_.emplace_back(std::move(srow));
+  }
+
+  auto nparts = numPartitions();
+  if (nparts <= 1) {
+    Vector<SortedRow> tmp;
+    encodeKeys(0, rows_.size());
+    radixSort(0, rows_.size(), 0, &tmp);
+    return;
+  }
+
+  Vector<size_t> runs;
+  for (size_t i = 0; i < nparts; ++i) {
+    runs.emplace_back((rows_.size() * i) / nparts);
+  }
+  runs.emplace_back(rows_.size());
+
+  runParallel(nparts, [this, &runs] (size_t i) {
+    Vector<SortedRow> tmp;
+    encodeKeys(runs[i], runs[i + 1]);
+    radixSort(runs[i], runs[i + 1], 0, &tmp);
+  });
+
+  mergeRuns(runs);
+}
+
+size_t OrderBy::numPartitions() const {
+  /* partitions are also cache friendlier to sort, so split large inputs even
+   * on a single core. This also keeps the code path independent of the host */
+  size_t nthreads = std::thread::hardware_concurrency();
+  if (nthreads < 2) {
+    nthreads = 2;
+  }
+
+  auto nparts = std::min(nthreads, rows_.size() / kMinRowsPerPartition);
+  return std::min(nparts, kMaxPartitions);
+}
+
+void OrderBy::encodeKeys(size_t begin, size_t end) {
+  for (size_t i = begin; i < end; ++i) {
+    auto& srow = rows_[i];
+    for (const auto& sort : sort_specs_) {
+      SValue val;
+      VM::evaluate(
+          ctx_,
+          sort.expr.program(),
+          srow.row.size(),
+          srow.row.data(),
+          &val);
+
+      SortKey::encode(val, sort.descending, &srow.key);
+    }
+  }
+}
+
+void OrderBy::radixSort(
+    size_t begin,
+    size_t end,
+    size_t depth,
+    Vector<SortedRow>* tmp) {
+  if (end - begin < kRadixSortCutoff || depth >= kMaxRadixSortDepth) {
+    stableSort(begin, end, depth);
+    return;
+  }
+
+  /* bucket 0 holds keys that end at depth, bucket n + 1 keys with byte n */
+  size_t offsets[258];
+  memset(offsets, 0, sizeof(offsets));
+  for (size_t i = begin; i < end; ++i) {
+    const auto& key = rows_[i].key;
+    auto bucket = key.size() > depth ? uint8_t(key[depth]) + 1 : 0;
+    ++offsets[bucket + 1];
+  }
+
+  /* if this byte doesn't split the range, e.g. for long common prefixes,
+   * another pass would only copy all rows again */
+  for (size_t i = 1; i < 258; ++i) {
+    if (offsets[i] == end - begin) {
+      stableSort(begin, end, depth);
+      return;
+    }
+  }
+
+  for (size_t i = 1; i < 258; ++i) {
+    offsets[i] += offsets[i - 1];
+  }
+
+  tmp->resize(end - begin);
+  {
+    size_t pos[257];
+    memcpy(pos, offsets, sizeof(pos));
+    for (size_t i = begin; i < end; ++i) {
+      const auto& key = rows_[i].key;
+      auto bucket = key.size() > depth ? uint8_t(key[depth]) + 1 : 0;
+      (*tmp)[pos[bucket]++] = std::move(rows_[i]);
+    }
+  }
+
+  std::move(tmp->begin(), tmp->end(), rows_.begin() + begin);
+
+  for (size_t bucket = 1; bucket < 257; ++bucket) {
+    auto bucket_size = offsets[bucket + 1] - offsets[bucket];
+    if (bucket_size > 1) {
+      radixSort(
+          begin + offsets[bucket],
+          begin + offsets[bucket + 1],
+          depth + 1,
+          tmp);
+    }
+  }
+}
+
+void OrderBy::stableSort(size_t begin, size_t end, size_t depth) {
+  std::stable_sort(
+      rows_.begin() + begin,
+      rows_.begin() + end,
+      [depth] (const SortedRow& left, const SortedRow& right) -> bool {
+    return left.key.compare(
+        depth,
+        String::npos,
+        right.key,
+        depth,
+        String::npos) < 0;
+  });
+}
+
+void OrderBy::mergeRuns(const Vector<size_t>& runs) {
+  auto nruns = runs.size() - 1;
+  auto nparts = nruns;
+
+  /* pick splitters from evenly spaced samples of every run */
+  static const size_t kSamplesPerRun = 32;
+  Vector<const String*> samples;
+  for (size_t i = 0; i < nruns; ++i) {
+    auto run_len = runs[i + 1] - runs[i];
+    for (size_t j = 1; j <= kSamplesPerRun; ++j) {
+      auto idx = runs[i] + (run_len * j) / (kSamplesPerRun + 1);
+      samples.emplace_back(&rows_[idx].key);
+    }
+  }
+
+  std::sort(
+      samples.begin(),
+      samples.end(),
+      [] (const String* left, const String* right) -> bool {
+    return SortKey::compare(*left, *right) < 0;
+  });
+
+  Vector<const String*> splitters;
+  for (size_t i = 1; i < nparts; ++i) {
+    splitters.emplace_back(samples[(samples.size() * i) / nparts]);
+  }
+
+  /* bounds[p][r] is the first row of run r that belongs to output part p */
+  Vector<Vector<size_t>> bounds(nparts + 1, Vector<size_t>(nruns));
+  for (size_t r = 0; r < nruns; ++r) {
+    bounds[0][r] = runs[r];
+    bounds[nparts][r] = runs[r + 1];
+
+    for (size_t p = 1; p < nparts; ++p) {
+      const auto& splitter = *splitters[p - 1];
+      auto iter = std::lower_bound(
+          rows_.begin() + bounds[p - 1][r],
+          rows_.begin() + runs[r + 1],
+          splitter,
+          [] (const SortedRow& row, const String& key) -> bool {
+        return SortKey::compare(row.key, key) < 0;
+      });
+
+      bounds[p][r] = iter - rows_.begin();
+    }
+  }
+
+  Vector<size_t> out_offsets(nparts + 1, 0);
+  for (size_t p = 0; p < nparts; ++p) {
+    out_offsets[p + 1] = out_offsets[p];
+    for (size_t r = 0; r < nruns; ++r) {
+      out_offsets[p + 1] += bounds[p + 1][r] - bounds[p][r];
+    }
+  }
+
+  Vector<SortedRow> out(rows_.size());
+  runParallel(nparts, [this, nruns, &bounds, &out, &out_offsets] (size_t p) {
+    Vector<size_t> cursors(bounds[p]);
+    const auto& ends = bounds[p + 1];
+
+    /* min-heap of run indexes; equal keys are taken from the lower run */
+    auto heap_cmp = [this, &cursors] (size_t left, size_t right) -> bool {
+      auto cmp = SortKey::compare(
+          rows_[cursors[left]].key,
+          rows_[cursors[right]].key);
+
+      return cmp == 0 ? left > right : cmp > 0;
+    };
+
+    Vector<size_t> heap;
+    for (size_t r = 0; r < nruns; ++r) {
+      if (cursors[r] < ends[r]) {
+        heap.emplace_back(r);
+      }
+    }
+
+    std::make_heap(heap.begin(), heap.end(), heap_cmp);
+
+    auto out_pos = out_offsets[p];
+    while (!heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end(), heap_cmp);
+      auto r = heap.back();
+      out[out_pos++] = std::move(rows_[cursors[r]++]);
+
+      if (cursors[r] < ends[r]) {
+        std::push_heap(heap.begin(), heap.end(), heap_cmp);
+      } else {
+        heap.pop_back();
+      }
+    }
+  });
+
+  rows_ = std::move(out);
+}
+
+void OrderBy::runParallel(size_t n, Function<void (size_t i)> fn) {
+  std::mutex mutex;
+  std::condition_variable cv;
+  size_t pending = n;
+  std::exception_ptr error;
+
+  auto sched = ctx_->getRuntime()->scheduler();
+  for (size_t i = 0; i < n; ++i) {
+    sched->run([i, &fn, &mutex, &cv, &pending, &error] {
+      std::exception_ptr e;
+      try {
+        fn(i);
+      } catch (...) {
+        e = std::current_exception();
+      }
+
+      std::unique_lock<std::mutex> lk(mutex);
+      if (e && !error) {
+        error = e;
+      }
+
+      --pending;
+      cv.notify_all();
+    });
+  }
+
+  std::unique_lock<std::mutex> lk(mutex);
+  while (pending > 0) {
+    cv.wait(lk);
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
 }
-// FIXPAUL this should mergesort while inserting...
-//bool OrderBy::onInputRow(
-//    const TaskID& input_id,
-//    const SValue* argv,
-//    int argc) {
-//  Vector<SValue> row;
-//  for (int i = 0; i < argc; i++) {
-//    row.emplace_back(argv[i]);
-//  }
-//
-//  rows_.emplace_back(row);
-//  return true;
-//}
-//
-//void OrderBy::onInputsReady() {
-//  auto rt = ctx_->getRuntime();
-//  std::sort(
-//      rows_.begin(),
-//      rows_.end(),
-//      [this, rt] (const Vector<SValue>& left, const Vector<SValue>& right) -> bool {
-//    for (const auto& sort : sort_specs_) {
-//      SValue args[2];
-//      SValue res(false);
-//      args[0] = rt->evaluateScalarExpression(
-//          ctx_,
-//          sort.expr,
-//          left.size(),
-//          left.data());
-//      args[1] = rt->evaluateScalarExpression(
-//          ctx_,
-//          sort.expr,
-//          right.size(),
-//          right.data());
-//
-//      expressions::eqExpr(Transaction::get(ctx_), 2, args, &res);
-//      if (res.getBool()) {
-//        continue;
-//      }
-//
-//      if (sort.descending) {
-//        expressions::gtExpr(Transaction::get(ctx_), 2, args, &res);
-//      } else {
-//        expressions::ltExpr(Transaction::get(ctx_), 2, args, &res);
-//      }
-//
-//      return res.getBool();
-//    }
-//
-//    /* all dimensions equal */
-//    return false;
-//  });
-//
-//  for (auto& row : rows_) {
-//    if (!input_(row.data(), row.size())) {
-//      break;
-//    }
-//  }
-//
-//  rows_.clear();
-//}
 
 OrderByFactory::OrderByFactory(
     Vector<SortExpr> sort_specs,
@@ -99,6 +349,10 @@ OrderByFactory::OrderByFactory(
     sort_specs_(sort_specs),
     num_columns_(num_columns) {}
 
+bool OrderByFactory::allowsParallelUnion() const {
+  return true;
+}
+
 RefPtr<Task> OrderByFactory::build(
     Transaction* txn,
     HashMap<TaskID, ScopedPtr<ResultCursor>> input) const {
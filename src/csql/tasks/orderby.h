@@ -12,13 +12,25 @@
 #include <csql/Transaction.h>
 #include <csql/tasks/Task.h>
 #include <csql/runtime/ValueExpression.h>
+#include <csql/runtime/MemoryTracker.h>
 #include <csql/qtree/OrderByNode.h>
 
 namespace csql {
 
+/**
+ * Sorts all input rows by their normalized sort key (see SortKey). Large
+ * inputs are split into partitions that are sorted concurrently on the
+ * runtime's thread pool with an MSD radix sort and then merged with a
+ * parallel multiway merge.
+ */
 class OrderBy : public Task {
 public:
 
+  static const size_t kMinRowsPerPartition;
+  static const size_t kMaxPartitions;
+  static const size_t kRadixSortCutoff;
+  static const size_t kMaxRadixSortDepth;
+
   struct SortExpr {
     ValueExpression expr;
     bool descending; // false == ASCENDING, true == DESCENDING
@@ -31,13 +43,61 @@ public:
       HashMap<TaskID, ScopedPtr<ResultCursor>> input);
 
   bool nextRow(SValue* out, int out_len) override;
+  void close() override;
+
+  void collectStats(TaskStats* stats) const override;
 
 protected:
+
+  struct SortedRow {
+    String key;
+    Vector<SValue> row;
+  };
+
+  void execute();
+
+  size_t numPartitions() const;
+
+  void encodeKeys(size_t begin, size_t end);
+
+  /**
+   * Sort rows_[begin, end) by the bytes of their keys starting at depth. All
+   * keys in the range must share the first depth bytes. The sort is stable.
+   * Ranges below kRadixSortCutoff rows, ranges at kMaxRadixSortDepth and
+   * ranges whose next byte doesn't split them are sorted with stableSort
+   */
+  void radixSort(
+      size_t begin,
+      size_t end,
+      size_t depth,
+      Vector<SortedRow>* tmp);
+
+  /**
+   * Sort rows_[begin, end) by the bytes of their keys starting at depth with
+   * std::stable_sort
+   */
+  void stableSort(size_t begin, size_t end, size_t depth);
+
+  /**
+   * Merge the sorted runs rows_[runs[i], runs[i + 1]) into one sorted run
+   */
+  void mergeRuns(const Vector<size_t>& runs);
+
+  /**
+   * Execute fn(0) ... fn(n - 1) on the runtime's thread pool and wait for all
+   * of them to finish. Rethrows the first exception thrown by any of them
+   */
+  void runParallel(size_t n, Function<void (size_t i)> fn);
+
   Transaction* ctx_;
   Vector<SortExpr> sort_specs_;
   size_t num_columns_;
-  Vector<Vector<SValue>> rows_;
+  Vector<SortedRow> rows_;
   ScopedPtr<ResultCursorList> input_;
+  bool executed_;
+  size_t pos_;
+  MemoryReservation memory_;
+  AbortCheck abort_check_;
 };
 
 class OrderByFactory : public TaskFactory {
@@ -56,6 +116,8 @@ public:
       Transaction* txn,
       HashMap<TaskID, ScopedPtr<ResultCursor>> input) const override;
 
+  bool allowsParallelUnion() const override;
+
 protected:
   Vector<SortExpr> sort_specs_;
   size_t num_columns_;
@@ -0,0 +1,180 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <csql/tasks/pipeline.h>
+
+namespace csql {
+
+Pipeline::Pipeline(
+    Vector<ScopedPtr<PipelineStage>> stages,
+    ScopedPtr<ResultCursor> input) :
+    stages_(std::move(stages)),
+    input_(std::move(input)),
+    batch_capacity_(kMinBatchSize),
+    batch_size_(0),
+    batch_pos_(0),
+    initialized_(false),
+    done_(false),
+    input_rows_(0) {
+  if (stages_.empty()) {
+    RAISE(kIllegalArgumentError, "pipeline needs at least one stage");
+  }
+}
+
+void Pipeline::setStageStats(Vector<TaskStats*> stats) {
+  if (stats.size() != stages_.size()) {
+    RAISE(kIllegalArgumentError, "need one stats entry per pipeline stage");
+  }
+
+  stage_stats_ = std::move(stats);
+  stage_rows_.assign(stages_.size(), 0);
+}
+
+bool Pipeline::nextRow(SValue* out, int out_len) {
+  if (!initialized_) {
+    init(out_len);
+  }
+
+  while (!done_) {
+    while (batch_pos_ < batch_size_) {
+      auto row = batch_.data() + batch_pos_++ * num_columns_[0];
+      auto emitted = processRow(row, out, out_len);
+
+      if (done_) {
+        input_->close();
+      }
+
+      if (emitted) {
+        return true;
+      }
+
+      if (done_) {
+        break;
+      }
+    }
+
+    if (done_) {
+      break;
+    }
+
+    if (!readBatch()) {
+      done_ = true;
+    }
+  }
+
+  flushStageStats();
+  return false;
+}
+
+void Pipeline::close() {
+  done_ = true;
+  input_->close();
+  flushStageStats();
+}
+
+void Pipeline::init(size_t num_columns) {
+  initialized_ = true;
+
+  /* the width of each row is determined from the output backwards */
+  num_columns_.resize(stages_.size() + 1);
+  num_columns_[stages_.size()] = num_columns;
+  for (size_t i = stages_.size(); i-- > 0; ) {
+    num_columns_[i] = stages_[i]->numInputColumns(num_columns_[i + 1]);
+  }
+
+  for (size_t i = 0; i + 1 < stages_.size(); ++i) {
+    stage_out_.emplace_back(num_columns_[i + 1], SValue{});
+  }
+
+  for (const auto& stage : stages_) {
+    if (stage->isDone()) {
+      done_ = true;
+      input_->close();
+      return;
+    }
+  }
+
+  input_->prefetch(num_columns_[0]);
+}
+
+bool Pipeline::readBatch() {
+  flushStageStats();
+
+  batch_.resize(batch_capacity_ * num_columns_[0]);
+  batch_size_ = 0;
+  batch_pos_ = 0;
+
+  while (batch_size_ < batch_capacity_) {
+    auto row = batch_.data() + batch_size_ * num_columns_[0];
+    if (!input_->next(row, num_columns_[0])) {
+      break;
+    }
+
+    ++batch_size_;
+  }
+
+  input_rows_ += batch_size_;
+  batch_capacity_ = std::min(batch_capacity_ * 2, kMaxBatchSize);
+  return batch_size_ > 0;
+}
+
+bool Pipeline::processRow(const SValue* row, SValue* out, int out_len) {
+  auto in = row;
+  int in_len = num_columns_[0];
+
+  for (size_t i = 0; i < stages_.size(); ++i) {
+    auto last = i + 1 == stages_.size();
+    auto stage_out = last ? out : stage_out_[i].data();
+    int stage_out_len = last ? out_len : num_columns_[i + 1];
+
+    auto emitted = stages_[i]->process(in, in_len, stage_out, stage_out_len);
+
+    /* none of the stages below will receive another row */
+    if (stages_[i]->isDone()) {
+      done_ = true;
+    }
+
+    if (!emitted) {
+      return false;
+    }
+
+    if (!stage_rows_.empty()) {
+      ++stage_rows_[i];
+    }
+
+    in = stage_out;
+    in_len = stage_out_len;
+  }
+
+  return true;
+}
+
+void Pipeline::flushStageStats() {
+  if (stage_stats_.empty()) {
+    return;
+  }
+
+  if (stage_stats_[0]) {
+    stage_stats_[0]->num_rows_in += input_rows_;
+  }
+
+  for (size_t i = 0; i + 1 < stage_stats_.size(); ++i) {
+    if (stage_stats_[i] && stage_rows_[i] > 0) {
+      stage_stats_[i]->num_rows_out += stage_rows_[i];
+      stage_stats_[i]->num_batches += 1;
+    }
+
+    stage_rows_[i] = 0;
+  }
+
+  input_rows_ = 0;
+}
+
+}
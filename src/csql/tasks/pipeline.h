@@ -0,0 +1,117 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <csql/svalue.h>
+#include <csql/tasks/Task.h>
+#include <csql/result_cursor.h>
+
+namespace csql {
+
+/**
+ * A non-blocking operator that maps each input row to at most one output row
+ * without buffering any rows, e.g. a filter/projection or a limit. Chains of
+ * tasks that can be executed as pipeline stages are fused into a single
+ * Pipeline task by the scheduler
+ */
+class PipelineStage {
+public:
+
+  virtual ~PipelineStage() {}
+
+  /**
+   * Returns the number of columns of the input rows given the number of
+   * columns of the output rows
+   */
+  virtual size_t numInputColumns(size_t num_output_columns) const = 0;
+
+  /**
+   * Process the next input row. Returns true if an output row was written to
+   * out and false if the row was dropped. The output storage is not changed if
+   * the row is dropped
+   */
+  virtual bool process(
+      const SValue* row,
+      int row_len,
+      SValue* out,
+      int out_len) = 0;
+
+  /**
+   * Returns true once the stage won't emit any more rows
+   */
+  virtual bool isDone() const {
+    return false;
+  }
+
+  /**
+   * Returns false if the stage has to see all rows of its input, e.g. a limit.
+   * Only partitionable stages are replicated when the input is split across
+   * multiple workers
+   */
+  virtual bool isPartitionable() const {
+    return true;
+  }
+
+};
+
+/**
+ * Executes a chain of pipeline stages on a single input. Rows are read from
+ * the input in batches and each row is pushed through all stages in one loop,
+ * so there is no cursor call between two stages. The batch size starts small
+ * and grows up to kMaxBatchSize so that a LIMIT doesn't read far ahead
+ */
+class Pipeline : public Task {
+public:
+
+  static const size_t kMinBatchSize = 16;
+  static const size_t kMaxBatchSize = 1024;
+
+  /**
+   * The stages are executed in order, i.e. the first stage reads the input
+   * rows and the last stage produces the output rows
+   */
+  Pipeline(
+      Vector<ScopedPtr<PipelineStage>> stages,
+      ScopedPtr<ResultCursor> input);
+
+  /**
+   * Count the rows emitted by stage i in stats[i] and the rows read from the
+   * input in stats[0]. Entries may be nullptr. The rows emitted by the last
+   * stage are the output rows of the pipeline, which are counted by its cursor
+   * (see TaskResultCursor). The counters are added to the stats once per batch
+   */
+  void setStageStats(Vector<TaskStats*> stats);
+
+  bool nextRow(SValue* out, int out_len) override;
+  void close() override;
+
+protected:
+
+  void init(size_t num_columns);
+  bool readBatch();
+  bool processRow(const SValue* row, SValue* out, int out_len);
+  void flushStageStats();
+
+  Vector<ScopedPtr<PipelineStage>> stages_;
+  ScopedPtr<ResultCursor> input_;
+  Vector<size_t> num_columns_;
+  Vector<Vector<SValue>> stage_out_;
+  Vector<SValue> batch_;
+  size_t batch_capacity_;
+  size_t batch_size_;
+  size_t batch_pos_;
+  bool initialized_;
+  bool done_;
+  Vector<TaskStats*> stage_stats_;
+  Vector<uint64_t> stage_rows_;
+  uint64_t input_rows_;
+};
+
+}
@@ -12,49 +12,83 @@
 
 namespace csql {
 
-Subquery::Subquery(
+SubqueryStage::SubqueryStage(
     Transaction* txn,
+    size_t num_input_columns,
     Vector<ValueExpression> select_expressions,
-    Option<ValueExpression> where_expr,
-    HashMap<TaskID, ScopedPtr<ResultCursor>> input) :
+    Option<ValueExpression> where_expr) :
     txn_(txn),
+    num_input_columns_(num_input_columns),
     select_exprs_(std::move(select_expressions)),
     where_expr_(std::move(where_expr)),
-    input_(new ResultCursorList(std::move(input))) {}
+    abort_check_(txn) {}
+
+size_t SubqueryStage::numInputColumns(size_t num_output_columns) const {
+  return num_input_columns_;
+}
+
+bool SubqueryStage::process(
+    const SValue* row,
+    int row_len,
+    SValue* out,
+    int out_len) {
+  abort_check_.tick();
+
+  if (!where_expr_.isEmpty()) {
+    SValue pred;
+    VM::evaluate(txn_, where_expr_.get().program(), row_len, row, &pred);
+    if (!pred.getBool()) {
+      return false;
+    }
+  }
+
+  for (int i = 0; i < select_exprs_.size() && i < out_len; ++i) {
+    VM::evaluate(txn_, select_exprs_[i].program(), row_len, row, &out[i]);
+  }
+
+  return true;
+}
+
+Subquery::Subquery(
+    ScopedPtr<SubqueryStage> stage,
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input) :
+    stage_(std::move(stage)),
+    input_(new ResultCursorList(std::move(input))),
+    inbuf_(stage_->numInputColumns(0), SValue{}) {}
 
 bool Subquery::nextRow(SValue* out, int out_len) {
+  while (input_->next(inbuf_.data(), inbuf_.size())) {
+    if (stage_->process(inbuf_.data(), inbuf_.size(), out, out_len)) {
+      return true;
+    }
+  }
+
   return false;
 }
 
-//bool Subquery::onInputRow(
-//    const TaskID& input_id,
-//    const SValue* row,
-//    int row_len) {
-//  if (!where_expr_.isEmpty()) {
-//    SValue pred;
-//    VM::evaluate(txn_, where_expr_.get().program(), row_len, row, &pred);
-//    if (!pred.getBool()) {
-//      return true;
-//    }
-//  }
-//
-//  Vector<SValue> out_row(select_exprs_.size(), SValue{});
-//  for (int i = 0; i < select_exprs_.size(); ++i) {
-//    VM::evaluate(txn_, select_exprs_[i].program(), row_len, row, &out_row[i]);
-//  }
-//
-//  return input_(out_row.data(), out_row.size());
-//}
+void Subquery::close() {
+  input_->close();
+}
 
 SubqueryFactory::SubqueryFactory(
+    size_t num_input_columns,
     Vector<RefPtr<SelectListNode>> select_exprs,
     Option<RefPtr<ValueExpressionNode>> where_expr) :
+    num_input_columns_(num_input_columns),
     select_exprs_(select_exprs),
     where_expr_(where_expr) {}
 
+bool SubqueryFactory::allowsParallelUnion() const {
+  return true;
+}
+
 RefPtr<Task> SubqueryFactory::build(
     Transaction* txn,
     HashMap<TaskID, ScopedPtr<ResultCursor>> input) const {
+  return new Subquery(mkScoped(buildStage(txn)), std::move(input));
+}
+
+SubqueryStage* SubqueryFactory::buildStage(Transaction* txn) const {
   Vector<ValueExpression> select_expressions;
   Option<ValueExpression> where_expr;
 
@@ -70,11 +104,11 @@ RefPtr<Task> SubqueryFactory::build(
         qbuilder->buildValueExpression(txn, slnode->expression()));
   }
 
-  return new Subquery(
+  return new SubqueryStage(
       txn,
+      num_input_columns_,
       std::move(select_expressions),
-      std::move(where_expr),
-      std::move(input));
+      std::move(where_expr));
 }
 
 }
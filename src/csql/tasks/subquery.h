@@ -9,38 +9,62 @@
  */
 #pragma once
 #include <stx/stdtypes.h>
+#include <csql/Transaction.h>
 #include <csql/tasks/Task.h>
+#include <csql/tasks/pipeline.h>
 #include <csql/runtime/defaultruntime.h>
 
 namespace csql {
 
-class Subquery : public Task {
+/**
+ * Evaluates the WHERE expression and the select list on each input row
+ */
+class SubqueryStage : public PipelineStage {
 public:
 
-  Subquery(
+  SubqueryStage(
       Transaction* txn,
+      size_t num_input_columns,
       Vector<ValueExpression> select_expressions,
-      Option<ValueExpression> where_expr,
-      HashMap<TaskID, ScopedPtr<ResultCursor>> input);
+      Option<ValueExpression> where_expr);
 
-  bool nextRow(SValue* out, int out_len) override;
+  size_t numInputColumns(size_t num_output_columns) const override;
+
+  bool process(
+      const SValue* row,
+      int row_len,
+      SValue* out,
+      int out_len) override;
 
-//  bool onInputRow(
-//      const TaskID& input_id,
-//      const SValue* row,
-//      int row_len) override;
-//
 protected:
   Transaction* txn_;
+  size_t num_input_columns_;
   Vector<ValueExpression> select_exprs_;
   Option<ValueExpression> where_expr_;
+  AbortCheck abort_check_;
+};
+
+class Subquery : public Task {
+public:
+
+  Subquery(
+      ScopedPtr<SubqueryStage> stage,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input);
+
+  bool nextRow(SValue* out, int out_len) override;
+  void close() override;
+
+protected:
+  ScopedPtr<SubqueryStage> stage_;
   ScopedPtr<ResultCursorList> input_;
+  Vector<SValue> inbuf_;
 };
 
 class SubqueryFactory : public TaskFactory {
 public:
 
   SubqueryFactory(
+      size_t num_input_columns,
       Vector<RefPtr<SelectListNode>> select_exprs,
       Option<RefPtr<ValueExpressionNode>> where_expr);
 
@@ -48,7 +72,12 @@ public:
       Transaction* txn,
       HashMap<TaskID, ScopedPtr<ResultCursor>> input) const override;
 
+  bool allowsParallelUnion() const override;
+
+  SubqueryStage* buildStage(Transaction* txn) const override;
+
 protected:
+  size_t num_input_columns_;
   Vector<RefPtr<SelectListNode>> select_exprs_;
   Option<RefPtr<ValueExpressionNode>> where_expr_;
 };
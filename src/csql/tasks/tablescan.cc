@@ -11,16 +11,20 @@
 #include <csql/qtree/QueryTreeUtil.h>
 #include <csql/runtime/QueryBuilder.h>
 #include <csql/runtime/runtime.h>
+#include <csql/runtime/SortKey.h>
 #include <csql/tasks/tablescan.h>
 
 namespace csql {
 
-TableScan::TableScan(
+TableScanStage::TableScanStage(
     Transaction* txn,
     RefPtr<SequentialScanNode> stmt,
-    ScopedPtr<TableIterator> iter) :
+    TableIterator* iter,
+    const Option<RuntimeFilterSpec>& runtime_filter) :
     txn_(txn),
-    iter_(std::move(iter)) {
+    num_input_columns_(iter->numColumns()),
+    num_rows_(0),
+    abort_check_(txn) {
   auto qbuilder = txn->getRuntime()->queryBuilder();
 
   for (const auto& slnode : stmt->selectList()) {
@@ -28,7 +32,7 @@ TableScan::TableScan(
         slnode->expression(),
         std::bind(
             &TableIterator::findColumn,
-            iter_.get(),
+            iter,
             std::placeholders::_1));
 
     select_exprs_.emplace_back(
@@ -40,49 +44,173 @@ TableScan::TableScan(
         stmt->whereExpression().get(),
         std::bind(
             &TableIterator::findColumn,
-            iter_.get(),
+            iter,
             std::placeholders::_1));
 
     where_expr_ = std::move(Option<ValueExpression>(
         qbuilder->buildValueExpression(txn, stmt->whereExpression().get())));
   }
+
+  if (!runtime_filter.isEmpty() &&
+      stmt->aggregationStrategy() == AggregationStrategy::NO_AGGREGATION) {
+    auto select_list = stmt->selectList();
+    for (auto idx : runtime_filter.get().key_columns) {
+      if (idx >= select_list.size()) {
+        RAISE(kIllegalStateError, "invalid runtime filter column");
+      }
+
+      runtime_filter_keys_.emplace_back(
+          qbuilder->buildValueExpression(txn, select_list[idx]->expression()));
+    }
+
+    runtime_filter_ = txn->getRuntimeFilter(runtime_filter.get().filter_id);
+  }
+
+  if (stmt->aggregationStrategy() == AggregationStrategy::NO_AGGREGATION) {
+    limit_ = stmt->limit();
+  }
+}
+
+size_t TableScanStage::numInputColumns(size_t num_output_columns) const {
+  return num_input_columns_;
+}
+
+bool TableScanStage::process(
+    const SValue* row,
+    int row_len,
+    SValue* out,
+    int out_len) {
+  if (isDone()) {
+    return false;
+  }
+
+  abort_check_.tick();
+
+  if (!where_expr_.isEmpty()) {
+    SValue pred;
+    VM::evaluate(txn_, where_expr_.get().program(), row_len, row, &pred);
+
+    if (!pred.getBool()) {
+      return false;
+    }
+  }
+
+  if (!runtime_filter_keys_.empty() && !evaluateRuntimeFilter(row, row_len)) {
+    return false;
+  }
+
+  for (int i = 0; i < select_exprs_.size() && i < out_len; ++i) {
+    VM::evaluate(txn_, select_exprs_[i].program(), row_len, row, &out[i]);
+  }
+
+  ++num_rows_;
+  return true;
+}
+
+bool TableScanStage::isDone() const {
+  return !limit_.isEmpty() && num_rows_ >= limit_.get();
 }
 
+Option<size_t> TableScanStage::limit() const {
+  return limit_;
+}
+
+bool TableScanStage::filtersRows() const {
+  return !where_expr_.isEmpty() || !runtime_filter_keys_.empty();
+}
+
+bool TableScanStage::evaluateRuntimeFilter(const SValue* row, int row_len) {
+  String key;
+  bool exact = true;
+  for (const auto& expr : runtime_filter_keys_) {
+    SValue val;
+    VM::evaluate(txn_, expr.program(), row_len, row, &val);
+    if (!SortKey::encodeEquiJoinKey(val, &key, &exact)) {
+      return false;
+    }
+  }
+
+  return runtime_filter_->mightContain(key);
+}
+
+TableScan::TableScan(
+    Transaction* txn,
+    RefPtr<SequentialScanNode> stmt,
+    ScopedPtr<TableIterator> iter,
+    const Option<RuntimeFilterSpec>& runtime_filter) :
+    iter_(std::move(iter)),
+    stage_(txn, stmt, iter_.get(), runtime_filter),
+    inbuf_(iter_->numColumns(), SValue{}),
+    rows_read_(0) {}
+
 bool TableScan::nextRow(SValue* out, int out_len) {
+  if (stage_.isDone()) {
+    iter_->close();
+    return false;
+  }
+
+  while (iter_->nextRow(inbuf_.data())) {
+    ++rows_read_;
+    if (!stage_.process(inbuf_.data(), inbuf_.size(), out, out_len)) {
+      continue;
+    }
+
+    /* stop reading the table as soon as the last row was emitted */
+    if (stage_.isDone()) {
+      iter_->close();
+    }
+
+    return true;
+  }
+
   return false;
 }
 
-//void TableScan::onInputsReady() {
-//  Vector<SValue> inbuf(iter_->numColumns());
-//  Vector<SValue> outbuf(select_exprs_.size());
-//  while (iter_->nextRow(inbuf.data())) {
-//    if (!where_expr_.isEmpty()) {
-//      SValue pred;
-//      VM::evaluate(
-//          txn_,
-//          where_expr_.get().program(),
-//          inbuf.size(),
-//          inbuf.data(),
-//          &pred);
-//
-//      if (!pred.getBool()) {
-//        continue;
-//      }
-//    }
-//
-//    for (int i = 0; i < select_exprs_.size(); ++i) {
-//      VM::evaluate(
-//          txn_,
-//          select_exprs_[i].program(),
-//          inbuf.size(),
-//          inbuf.data(),
-//          &outbuf[i]);
-//    }
-//
-//    if (!output_(outbuf.data(), outbuf.size())) {
-//      return;
-//    }
-//  }
-//}
+void TableScan::close() {
+  iter_->close();
+}
+
+void TableScan::collectStats(TaskStats* stats) const {
+  stats->num_rows_in += rows_read_;
+  stats->bytes_read += iter_->bytesRead();
+}
+
+Option<size_t> TableScan::limit() const {
+  return stage_.limit();
+}
+
+bool TableScan::filtersRows() const {
+  return stage_.filtersRows();
+}
+
+TableScanFactory::TableScanFactory(
+    RefPtr<SequentialScanNode> stmt,
+    IteratorFactoryFn iter_factory) :
+    stmt_(stmt),
+    iter_factory_(iter_factory) {}
+
+RefPtr<Task> TableScanFactory::build(
+    Transaction* txn,
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input) const {
+  return new TableScan(txn, stmt_, iter_factory_(), runtime_filter_);
+}
+
+RefPtr<MorselSource> TableScanFactory::buildMorselSource(
+    Transaction* txn) const {
+  /* the row limit of the scan applies to all morsels together */
+  if (!stmt_->limit().isEmpty()) {
+    return RefPtr<MorselSource>();
+  }
+
+  return new TableIteratorMorselSource(
+      stmt_,
+      iter_factory_(),
+      runtime_filter_);
+}
+
+bool TableScanFactory::setRuntimeFilter(const RuntimeFilterSpec& spec) {
+  runtime_filter_ = Some(spec);
+  return true;
+}
 
 }
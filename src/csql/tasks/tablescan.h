@@ -12,41 +12,154 @@
 #include <string>
 #include <vector>
 #include <assert.h>
+#include <csql/Transaction.h>
 #include <csql/parser/token.h>
 #include <csql/parser/astnode.h>
 #include <csql/runtime/queryplannode.h>
 #include <csql/runtime/tablerepository.h>
 #include <csql/runtime/compiler.h>
 #include <csql/runtime/vm.h>
+#include <csql/runtime/RuntimeFilter.h>
+#include <csql/tasks/pipeline.h>
+#include <csql/tasks/morsel.h>
 #include <stx/exception.h>
 
 namespace csql {
 
 class TableIterator {
 public:
+  virtual ~TableIterator() {}
   virtual bool nextRow(SValue* row) = 0;
   virtual size_t findColumn(const String& name) = 0;
   virtual size_t numColumns() const = 0;
+
+  /**
+   * Stop reading and release the underlying I/O resources. All subsequent
+   * calls to nextRow return false
+   */
+  virtual void close() {}
+
+  /**
+   * Returns the number of bytes read from the table so far, or zero if the
+   * iterator doesn't know
+   */
+  virtual uint64_t bytesRead() const {
+    return 0;
+  }
 };
 
-class TableScan : public Task {
+/**
+ * Evaluates the WHERE expression, the runtime filter and the select list of a
+ * sequential scan on each row returned by a TableIterator. The iterator is
+ * only used to resolve the column names and may be a different instance than
+ * the one the rows are read from
+ */
+class TableScanStage : public PipelineStage {
 public:
 
-  TableScan(
+  TableScanStage(
       Transaction* txn,
       RefPtr<SequentialScanNode> stmt,
-      ScopedPtr<TableIterator> iter);
+      TableIterator* iter,
+      const Option<RuntimeFilterSpec>& runtime_filter =
+          None<RuntimeFilterSpec>());
 
-  //void onInputsReady() override;
+  size_t numInputColumns(size_t num_output_columns) const override;
 
-  bool nextRow(SValue* out, int out_len) override;
+  bool process(
+      const SValue* row,
+      int row_len,
+      SValue* out,
+      int out_len) override;
+
+  /**
+   * Returns true once the scan's row limit was reached, if any
+   */
+  bool isDone() const override;
+
+  /**
+   * Returns the maximum number of rows this scan emits, if any
+   */
+  Option<size_t> limit() const;
+
+  /**
+   * Returns true if the scan drops some of the rows it reads, i.e. if it has
+   * a WHERE expression or a runtime filter
+   */
+  bool filtersRows() const;
 
 protected:
 
+  bool evaluateRuntimeFilter(const SValue* row, int row_len);
+
   Transaction* txn_;
-  ScopedPtr<TableIterator> iter_;
+  size_t num_input_columns_;
   Vector<ValueExpression> select_exprs_;
   Option<ValueExpression> where_expr_;
+  RefPtr<RuntimeFilter> runtime_filter_;
+  Vector<ValueExpression> runtime_filter_keys_;
+  Option<size_t> limit_;
+  size_t num_rows_;
+  AbortCheck abort_check_;
+};
+
+class TableScan : public Task {
+public:
+
+  TableScan(
+      Transaction* txn,
+      RefPtr<SequentialScanNode> stmt,
+      ScopedPtr<TableIterator> iter,
+      const Option<RuntimeFilterSpec>& runtime_filter =
+          None<RuntimeFilterSpec>());
+
+  bool nextRow(SValue* out, int out_len) override;
+  void close() override;
+
+  void collectStats(TaskStats* stats) const override;
+
+  /**
+   * Returns the maximum number of rows this scan emits, if any
+   */
+  Option<size_t> limit() const;
+
+  /**
+   * See TableScanStage::filtersRows
+   */
+  bool filtersRows() const;
+
+protected:
+  ScopedPtr<TableIterator> iter_;
+  TableScanStage stage_;
+  Vector<SValue> inbuf_;
+  size_t rows_read_;
+};
+
+/**
+ * Builds TableScan tasks on top of the iterators returned by the provided
+ * function. The scan can also be executed as a morsel source (see
+ * MorselSource) so that multiple workers process the rows of a single table
+ */
+class TableScanFactory : public TaskFactory {
+public:
+  typedef Function<ScopedPtr<TableIterator> ()> IteratorFactoryFn;
+
+  TableScanFactory(
+      RefPtr<SequentialScanNode> stmt,
+      IteratorFactoryFn iter_factory);
+
+  RefPtr<Task> build(
+      Transaction* txn,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input) const override;
+
+  RefPtr<MorselSource> buildMorselSource(Transaction* txn) const override;
+
+  bool setRuntimeFilter(const RuntimeFilterSpec& spec) override;
+
+protected:
+  RefPtr<SequentialScanNode> stmt_;
+  IteratorFactoryFn iter_factory_;
+  Option<RuntimeFilterSpec> runtime_filter_;
 };
 
 } // namespace csql
@@ -0,0 +1,164 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <csql/tasks/topn.h>
+#include <csql/runtime/SortKey.h>
+#include <csql/runtime/runtime.h>
+
+namespace csql {
+
+static size_t estimateEntrySize(const String& key, const Vector<SValue>& row) {
+  size_t size = sizeof(row) + key.size();
+  for (const auto& val : row) {
+    size += val.getMemoryUsage();
+  }
+
+  return size;
+}
+
+TopN::TopN(
+    Transaction* txn,
+    Vector<SortExpr> sort_specs,
+    size_t limit,
+    size_t offset,
+    size_t num_columns,
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input) :
+    txn_(txn),
+    sort_specs_(std::move(sort_specs)),
+    limit_(limit),
+    offset_(offset),
+    num_columns_(num_columns),
+    input_(new ResultCursorList(std::move(input))),
+    executed_(false),
+    pos_(0),
+    memory_(txn->getMemoryTracker()),
+    abort_check_(txn) {
+  if (sort_specs_.size() == 0) {
+    RAISE(kIllegalArgumentError, "can't execute TOP N: no sort specs");
+  }
+}
+
+bool TopN::nextRow(SValue* out, int out_len) {
+  if (!executed_) {
+    execute();
+    executed_ = true;
+  }
+
+  if (pos_ >= heap_.size()) {
+    return false;
+  }
+
+  const auto& row = heap_[pos_++].row;
+  for (size_t i = 0; i < row.size() && i < out_len; ++i) {
+    out[i] = row[i];
+  }
+
+  return true;
+}
+
+void TopN::close() {
+  input_->close();
+}
+
+void TopN::collectStats(TaskStats* stats) const {
+  stats->updatePeakMemory(memory_.peakBytes());
+}
+
+void TopN::execute() {
+  auto max_rows = limit_ + offset_;
+  if (max_rows == 0) {
+    return;
+  }
+
+  heap_.reserve(max_rows + 1);
+
+  /* the heap is ordered so that the row that sorts last is on top */
+  auto heap_cmp = [] (const HeapEntry& left, const HeapEntry& right) {
+    return SortKey::compare(left.key, right.key) < 0;
+  };
+
+  Vector<SValue> row(num_columns_);
+  String key;
+  while (input_->next(row.data(), row.size())) {
+    abort_check_.tick();
+    key.clear();
+    encodeSortKey(row, &key);
+
+    if (heap_.size() == max_rows) {
+      if (SortKey::compare(key, heap_.front().key) >= 0) {
+        continue;
+      }
+
+      std::pop_heap(heap_.begin(), heap_.end(), heap_cmp);
+      auto& entry = heap_.back();
+      memory_.resize(
+          memory_.bytes() +
+          estimateEntrySize(key, row) -
+          estimateEntrySize(entry.key, entry.row));
+
+      entry.key.swap(key);
+      entry.row.swap(row);
+    } else {
+      memory_.grow(estimateEntrySize(key, row));
+      heap_.emplace_back(HeapEntry { key, row });
+    }
+
+    std::push_heap(heap_.begin(), heap_.end(), heap_cmp);
+  }
+
+  std::sort_heap(heap_.begin(), heap_.end(), heap_cmp);
+  pos_ = offset_;
+}
+
+void TopN::encodeSortKey(const Vector<SValue>& row, String* key) {
+  for (const auto& ss : sort_specs_) {
+    SValue val;
+    VM::evaluate(txn_, ss.expr.program(), row.size(), row.data(), &val);
+    SortKey::encode(val, ss.descending, key);
+  }
+}
+
+TopNFactory::TopNFactory(
+    Vector<SortExpr> sort_specs,
+    size_t limit,
+    size_t offset,
+    size_t num_columns) :
+    sort_specs_(sort_specs),
+    limit_(limit),
+    offset_(offset),
+    num_columns_(num_columns) {}
+
+bool TopNFactory::allowsParallelUnion() const {
+  return true;
+}
+
+RefPtr<Task> TopNFactory::build(
+    Transaction* txn,
+    HashMap<TaskID, ScopedPtr<ResultCursor>> input) const {
+  auto qbuilder = txn->getRuntime()->queryBuilder();
+
+  Vector<TopN::SortExpr> sort_exprs;
+  for (const auto& ss : sort_specs_) {
+    TopN::SortExpr se;
+    se.descending = ss.descending;
+    se.expr = qbuilder->buildValueExpression(txn, ss.expr);
+    sort_exprs.emplace_back(std::move(se));
+  }
+
+  return new TopN(
+      txn,
+      std::move(sort_exprs),
+      limit_,
+      offset_,
+      num_columns_,
+      std::move(input));
+}
+
+} // namespace csql
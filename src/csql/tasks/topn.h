@@ -0,0 +1,102 @@
+/**
+ * This file is part of the "libcsql" project
+ *   Copyright (c) 2016 Paul Asmuth
+ *
+ * FnordMetric is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License v3.0. You should have received a
+ * copy of the GNU General Public License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <stx/stdtypes.h>
+#include <csql/Transaction.h>
+#include <csql/tasks/Task.h>
+#include <csql/tasks/TaskFactory.h>
+#include <csql/runtime/ValueExpression.h>
+#include <csql/runtime/MemoryTracker.h>
+#include <csql/qtree/ValueExpressionNode.h>
+
+namespace csql {
+
+/**
+ * Computes ORDER BY ... LIMIT in a single pass by keeping a bounded heap of
+ * the best (limit + offset) rows seen so far. Rows that can not make the cut
+ * are discarded as soon as their sort key has been computed.
+ *
+ * If a TopN task has more than one input, the inputs are expected to be
+ * partial top-N results (e.g. one per parallel or remote shard); they are
+ * merged into the final result.
+ */
+class TopN : public Task {
+public:
+
+  struct SortExpr {
+    ValueExpression expr;
+    bool descending; // false == ASCENDING, true == DESCENDING
+  };
+
+  TopN(
+      Transaction* txn,
+      Vector<SortExpr> sort_specs,
+      size_t limit,
+      size_t offset,
+      size_t num_columns,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input);
+
+  bool nextRow(SValue* out, int out_len) override;
+  void close() override;
+
+  void collectStats(TaskStats* stats) const override;
+
+protected:
+
+  struct HeapEntry {
+    String key;
+    Vector<SValue> row;
+  };
+
+  void execute();
+
+  void encodeSortKey(const Vector<SValue>& row, String* key);
+
+  Transaction* txn_;
+  Vector<SortExpr> sort_specs_;
+  size_t limit_;
+  size_t offset_;
+  size_t num_columns_;
+  ScopedPtr<ResultCursorList> input_;
+  Vector<HeapEntry> heap_;
+  bool executed_;
+  size_t pos_;
+  MemoryReservation memory_;
+  AbortCheck abort_check_;
+};
+
+class TopNFactory : public TaskFactory {
+public:
+
+  struct SortExpr {
+    RefPtr<ValueExpressionNode> expr;
+    bool descending; // false == ASCENDING, true == DESCENDING
+  };
+
+  TopNFactory(
+      Vector<SortExpr> sort_specs,
+      size_t limit,
+      size_t offset,
+      size_t num_columns);
+
+  RefPtr<Task> build(
+      Transaction* txn,
+      HashMap<TaskID, ScopedPtr<ResultCursor>> input) const override;
+
+  bool allowsParallelUnion() const override;
+
+protected:
+  Vector<SortExpr> sort_specs_;
+  size_t limit_;
+  size_t offset_;
+  size_t num_columns_;
+};
+
+}